@@ -1,5 +1,7 @@
 #pragma once
 
+#include "TabStripLayout.h"
+
 /* Aero default theme drawn an internal border (2 pixels) */
 #define AERO_FRAME_BORDER_SIZE 2;
 
@@ -20,6 +22,9 @@ protected:
 
   bool        m_bAppActive;
 
+  // tab positions, for hit testing and to repaint only what moved
+  TabStripLayout m_layout;
+
   // Constructor
 public:
 
@@ -31,6 +36,7 @@ public:
     ,m_iMargin(6)
     ,m_iLeftSpacing(2)
     ,m_iRadius(3)
+    ,m_layout()
   {
     // We can't use a member initialization list to initialize
     // members of our base class, so do it explictly by assignment here.
@@ -102,6 +108,8 @@ public:
       {
         m_fontSel.Attach(AtlGetDefaultGuiFont());
       }
+
+      this->ResetTextSizes();
     }
 
     // Background brush
@@ -964,6 +972,15 @@ public:
       }
     }
 
+    // the tabs are back to back from the indent, whatever their widths
+    m_layout.SetCount(nCount);
+    for( size_t i=0; i<nCount; ++i )
+    {
+      RECT rcTab = m_Items[i]->GetRect();
+      m_layout.SetWidth(i, rcTab.right - rcTab.left);
+    }
+    m_layout.Arrange(m_settings.iIndent);
+
     dc.SelectFont(hOldFont);
   }
 
@@ -982,51 +999,32 @@ public:
     // Recalculate tab positions and widths
     // See DrawItem_ImageAndText for a discussion of how CDotNetTabCtrlImpl
     //  interprets margin, padding, etc.
+    // Text sizes are cached by the items, only tabs whose text changed
+    //  are measured again
     size_t nCount = m_Items.GetCount();
-    int xpos = m_settings.iIndent;
-    HFONT hRestoreNormalFont = NULL;
+    m_layout.SetCount(nCount);
     for( size_t i=0; i<nCount; ++i )
     {
-      bool bSelected = ((int)i == m_iCurSel);
-      if(bSelected)
-      {
-        hRestoreNormalFont = dc.SelectFont(m_fontSel);
-      }
-
-      TItem* pItem = m_Items[i];
-      ATLASSERT(pItem != NULL);
-      rcItem.left = rcItem.right = xpos;
-      rcItem.right += m_settings.iMargin;
-      if(pItem->UsingImage() && !m_imageList.IsNull())
-      {
-        IMAGEINFO ii = {0};
-        int nImageIndex = pItem->GetImageIndex();
-        m_imageList.GetImageInfo(nImageIndex, &ii);
-        rcItem.right += (ii.rcImage.right - ii.rcImage.left);
-      }
-      if(pItem->UsingText())
-      {
-        rcItem.right += pItem->GetTextSize(dc) + (m_settings.iPadding * 2);
-      }
-
-      // close button
-      if( bSelected )
-      {
-        UpdateLayout_CloseButton(rcItem);
-      }
-      rcItem.right += m_iCloseButtonWidth;
+      m_layout.SetWidth(i, CalcItemWidth(dc, i));
+    }
+    m_layout.Arrange(m_settings.iIndent);
 
-      rcItem.right += m_settings.iMargin;
-      pItem->SetRect(rcItem);
-      xpos += (rcItem.right - rcItem.left);
+    for( size_t i=0; i<nCount; ++i )
+    {
+      rcItem.left  = m_layout.GetLeft(i);
+      rcItem.right = m_layout.GetRight(i);
+      m_Items[i]->SetRect(rcItem);
+    }
 
-      if(hRestoreNormalFont != NULL)
-      {
-        dc.SelectFont(hRestoreNormalFont);
-        hRestoreNormalFont = NULL;
-      }
+    // close button
+    if( m_iCurSel >= 0 && (size_t)m_iCurSel < nCount )
+    {
+      rcItem.left  = m_layout.GetLeft(m_iCurSel);
+      rcItem.right = m_layout.GetRight(m_iCurSel) - m_iCloseButtonWidth - m_settings.iMargin;
+      UpdateLayout_CloseButton(rcItem);
     }
-    xpos += m_settings.iIndent;
+
+    int xpos = m_layout.GetEnd() + m_settings.iIndent;
 
     // If we've been scrolled to the left, and resize so
     // there's more client area to the right, adjust the
@@ -1044,6 +1042,103 @@ public:
       m_rcCloseButton.right = rcTabItemArea.right;
   }
 
+  long CalcItemWidth(WTL::CClientDC& dc, size_t nItem)
+  {
+    TItem* pItem = m_Items[nItem];
+    ATLASSERT(pItem != NULL);
+
+    long nWidth = m_settings.iMargin;
+    if(pItem->UsingImage() && !m_imageList.IsNull())
+    {
+      IMAGEINFO ii = {0};
+      int nImageIndex = pItem->GetImageIndex();
+      m_imageList.GetImageInfo(nImageIndex, &ii);
+      nWidth += (ii.rcImage.right - ii.rcImage.left);
+    }
+    if(pItem->UsingText())
+    {
+      HFONT hRestoreNormalFont = NULL;
+      if((int)nItem == m_iCurSel)
+      {
+        hRestoreNormalFont = dc.SelectFont(m_fontSel);
+      }
+
+      nWidth += pItem->GetTextSize(dc) + (m_settings.iPadding * 2);
+
+      if(hRestoreNormalFont != NULL)
+      {
+        dc.SelectFont(hRestoreNormalFont);
+      }
+    }
+    nWidth += m_iCloseButtonWidth;
+    nWidth += m_settings.iMargin;
+
+    return nWidth;
+  }
+
+  // Tabs are left to right, so search the layout instead of every tab
+  int HitTest(LPCTCHITTESTINFO pHitTestInfo) const
+  {
+    if(!::PtInRect(&m_rcTabItemArea, pHitTestInfo->pt) ||
+      m_layout.GetCount() != m_Items.GetCount())
+    {
+      return baseClass::HitTest(pHitTestInfo);
+    }
+
+    pHitTestInfo->flags = CTCHT_NOWHERE;
+
+    int nItem = m_layout.HitTest(pHitTestInfo->pt.x - m_iScrollOffset);
+    if(nItem >= 0)
+    {
+      RECT rcItemDP = {0};
+      this->GetItemRect(nItem, &rcItemDP);
+
+      if( ::PtInRect(&rcItemDP, pHitTestInfo->pt) )
+      {
+        pHitTestInfo->flags = CTCHT_ONITEM;
+        return nItem;
+      }
+    }
+    return -1;
+  }
+
+  // Call after changing an item's text; repaints the item, and the ones
+  // after it only if they moved
+  void UpdateItemText(int nItem)
+  {
+    DWORD dwOldOverflow     = m_dwState & (ectcOverflowLeft|ectcOverflowRight);
+    int   nOldScrollOffset  = m_iScrollOffset;
+    RECT  rcOldCloseButton  = m_rcCloseButton;
+
+    T* pT = static_cast<T*>(this);
+    pT->UpdateLayout();
+
+    if( (m_dwState & (ectcOverflowLeft|ectcOverflowRight)) != dwOldOverflow ||
+      m_iScrollOffset != nOldScrollOffset ||
+      !::EqualRect(&m_rcCloseButton, &rcOldCloseButton) ||
+      m_layout.GetCount() != m_Items.GetCount() ||
+      nItem < 0 || (size_t)nItem >= m_Items.GetCount() )
+    {
+      this->Invalidate();
+      return;
+    }
+
+    RECT rcInvalid = {0};
+    this->GetItemRect(nItem, &rcInvalid);
+
+    size_t nFirstMoved = m_layout.GetFirstMoved();
+    if( nFirstMoved < m_Items.GetCount() )
+    {
+      RECT rcMoved = {0};
+      this->GetItemRect(nFirstMoved, &rcMoved);
+
+      if( rcMoved.left < rcInvalid.left ) rcInvalid.left = rcMoved.left;
+      rcInvalid.right = m_rcTabItemArea.right;
+    }
+
+    this->InvalidateRect(&rcInvalid);
+  }
+
 };
 
 template <class TItem = CCustomTabItem>
@@ -0,0 +1,294 @@
+#include "stdafx.h"
+
+#include <string.h>
+#include <algorithm>
+
+#include "PixelKernels.h"
+#include "BackgroundTiles.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static const int TILE_PITCH = BackgroundTiles::TILE_SIZE * 4;
+
+// remainder that's never negative, for positions left of or above the origin
+static inline int Wrap(int nValue, int nSize)
+{
+	int nWrapped = nValue % nSize;
+
+	return (nWrapped < 0) ? nWrapped + nSize : nWrapped;
+}
+
+static bool LessRecentlyUsed(const std::unique_ptr<BackgroundTiles::Tile>* pTile1, const std::unique_ptr<BackgroundTiles::Tile>* pTile2)
+{
+	return (*pTile1)->dwLastUse < (*pTile2)->dwLastUse;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+BackgroundTiles::BackgroundTiles(int nWidth, int nHeight, unsigned int dwBackground, unsigned int dwTint, unsigned char byTintOpacity, size_t stMaxTiles)
+: m_nWidth(nWidth)
+, m_nHeight(nHeight)
+, m_nColumns((nWidth + TILE_SIZE - 1) / TILE_SIZE)
+, m_nRows((nHeight + TILE_SIZE - 1) / TILE_SIZE)
+, m_dwBackground(dwBackground)
+, m_dwTint(dwTint)
+, m_byTintOpacity(byTintOpacity)
+, m_sources()
+, m_placements()
+, m_filters()
+, m_tiles()
+, m_stMaxTiles(stMaxTiles)
+, m_dwPaint(0)
+, m_stats()
+{
+	if (m_nColumns < 0) m_nColumns = 0;
+	if (m_nRows < 0) m_nRows = 0;
+
+	m_tiles.resize(m_nColumns * m_nRows);
+
+	m_stats.stMaxTiles = stMaxTiles;
+}
+
+BackgroundTiles::~BackgroundTiles()
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+size_t BackgroundTiles::AddSource(const TileSource& source)
+{
+	m_sources.push_back(source);
+
+	return m_sources.size() - 1;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void BackgroundTiles::AddPlacement(const TilePlacement& placement)
+{
+	m_placements.push_back(placement);
+	m_filters.push_back(std::shared_ptr<Resampler::Filters>());
+
+	Clear();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void BackgroundTiles::Paint(int nLeft, int nTop, int nRight, int nBottom, const PaintCallback& paint)
+{
+	if (nLeft < 0) nLeft = 0;
+	if (nTop < 0) nTop = 0;
+	if (nRight > m_nWidth) nRight = m_nWidth;
+	if (nBottom > m_nHeight) nBottom = m_nHeight;
+
+	if ((nLeft >= nRight) || (nTop >= nBottom)) return;
+
+	++m_dwPaint;
+
+	for (int nRow = nTop / TILE_SIZE; nRow <= (nBottom - 1) / TILE_SIZE; ++nRow)
+	{
+		for (int nColumn = nLeft / TILE_SIZE; nColumn <= (nRight - 1) / TILE_SIZE; ++nColumn)
+		{
+			std::unique_ptr<Tile>& tile = m_tiles[nRow * m_nColumns + nColumn];
+
+			if (tile)
+			{
+				++m_stats.dwHits;
+			}
+			else
+			{
+				tile.reset(new Tile());
+
+				tile->nLeft	= nColumn * TILE_SIZE;
+				tile->nTop	= nRow * TILE_SIZE;
+				tile->pixels.resize(TILE_SIZE * TILE_PITCH);
+
+				RenderTile(*tile);
+
+				++m_stats.stTiles;
+				++m_stats.dwRenders;
+			}
+
+			tile->dwLastUse = m_dwPaint;
+
+			paint(*tile);
+		}
+	}
+
+	Trim();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void BackgroundTiles::Clear()
+{
+	for (size_t i = 0; i < m_tiles.size(); ++i) m_tiles[i].reset();
+
+	m_stats.stTiles = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+BackgroundTilesStats BackgroundTiles::GetStats() const
+{
+	BackgroundTilesStats stats(m_stats);
+
+	stats.stBytes = stats.stTiles * TILE_SIZE * TILE_PITCH;
+
+	return stats;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void BackgroundTiles::RenderTile(Tile& tile)
+{
+	unsigned char* pPixels = &tile.pixels[0];
+
+	PixelKernels::Fill(pPixels, TILE_PITCH, TILE_SIZE, TILE_SIZE, m_dwBackground);
+
+	for (size_t i = 0; i < m_placements.size(); ++i) PaintPlacement(i, tile);
+
+	if (m_byTintOpacity > 0) PixelKernels::Tint(pPixels, TILE_PITCH, TILE_SIZE, TILE_SIZE, m_dwTint, m_byTintOpacity);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void BackgroundTiles::PaintPlacement(size_t stPlacement, Tile& tile)
+{
+	const TilePlacement&	placement	= m_placements[stPlacement];
+	const TileSource&		source		= m_sources[placement.stSource];
+
+	if (!source.pPixels || (source.nWidth <= 0) || (source.nHeight <= 0)) return;
+	if ((placement.nWidth <= 0) || (placement.nHeight <= 0)) return;
+
+	// part of the tile the placement covers
+	int nLeft	= (std::max)(tile.nLeft, placement.nClipLeft);
+	int nTop	= (std::max)(tile.nTop, placement.nClipTop);
+	int nRight	= (std::min)(tile.nLeft + TILE_SIZE, placement.nClipRight);
+	int nBottom	= (std::min)(tile.nTop + TILE_SIZE, placement.nClipBottom);
+
+	if (!placement.bTile)
+	{
+		nLeft	= (std::max)(nLeft, placement.nLeft);
+		nTop	= (std::max)(nTop, placement.nTop);
+		nRight	= (std::min)(nRight, placement.nLeft + placement.nWidth);
+		nBottom	= (std::min)(nBottom, placement.nTop + placement.nHeight);
+	}
+
+	if ((nLeft >= nRight) || (nTop >= nBottom)) return;
+
+	unsigned char* pDst = &tile.pixels[(nTop - tile.nTop) * TILE_PITCH + (nLeft - tile.nLeft) * 4];
+
+	if (placement.bTile)
+	{
+		for (int y = nTop; y < nBottom; ++y, pDst += TILE_PITCH)
+		{
+			const unsigned char*	pSrcRow	= source.pPixels + Wrap(y - placement.nTop, source.nHeight) * source.nPitch;
+			unsigned char*			pPixel	= pDst;
+
+			// copy up to the right edge of the image, then wrap around
+			for (int x = nLeft; x < nRight; )
+			{
+				int nSrcX	= Wrap(x - placement.nLeft, source.nWidth);
+				int nCount	= (std::min)(source.nWidth - nSrcX, nRight - x);
+
+				::memcpy(pPixel, pSrcRow + nSrcX * 4, nCount * 4);
+
+				x		+= nCount;
+				pPixel	+= nCount * 4;
+			}
+		}
+	}
+	else if ((placement.nWidth == source.nWidth) && (placement.nHeight == source.nHeight))
+	{
+		const unsigned char* pSrc = source.pPixels + (nTop - placement.nTop) * source.nPitch + (nLeft - placement.nLeft) * 4;
+
+		for (int y = nTop; y < nBottom; ++y, pDst += TILE_PITCH, pSrc += source.nPitch)
+		{
+			::memcpy(pDst, pSrc, (nRight - nLeft) * 4);
+		}
+	}
+	else
+	{
+		std::shared_ptr<Resampler::Filters>& filters = m_filters[stPlacement];
+
+		if (!filters)
+		{
+			filters.reset(new Resampler::Filters());
+			Resampler::CalcFilters(source.nWidth, source.nHeight, placement.nWidth, placement.nHeight, *filters);
+		}
+
+		Resampler::ResampleRect(
+						*filters,
+						source.pPixels,
+						source.nPitch,
+						nLeft - placement.nLeft,
+						nTop - placement.nTop,
+						nRight - nLeft,
+						nBottom - nTop,
+						pDst,
+						TILE_PITCH);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void BackgroundTiles::Trim()
+{
+	if (m_stats.stTiles <= m_stMaxTiles) return;
+
+	// least recently painted first, the ones just painted stay
+	vector<std::unique_ptr<Tile>*> tiles;
+
+	for (size_t i = 0; i < m_tiles.size(); ++i)
+	{
+		if (m_tiles[i] && (m_tiles[i]->dwLastUse != m_dwPaint)) tiles.push_back(&m_tiles[i]);
+	}
+
+	std::sort(tiles.begin(), tiles.end(), LessRecentlyUsed);
+
+	for (size_t i = 0; (i < tiles.size()) && (m_stats.stTiles > m_stMaxTiles); ++i)
+	{
+		tiles[i]->reset();
+
+		--m_stats.stTiles;
+		++m_stats.dwEvictions;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
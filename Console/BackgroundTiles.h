@@ -0,0 +1,193 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "Resampler.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// 32 bpp source image of a relative background, rows top-down (a negative
+// pitch for bottom-up DIBs)
+
+struct TileSource
+{
+	TileSource()
+	: owner()
+	, pPixels(0)
+	, nPitch(0)
+	, nWidth(0)
+	, nHeight(0)
+	{
+	}
+
+	// keeps the pixels alive
+	std::shared_ptr<const void>	owner;
+
+	const unsigned char*		pPixels;
+	int							nPitch;
+	int							nWidth;
+	int							nHeight;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// One source image painted on the layout: scaled to nWidth x nHeight with its
+// top left corner at (nLeft, nTop), or repeated from there when tiled, and
+// clipped to the clip rectangle (e.g. a monitor).
+
+struct TilePlacement
+{
+	TilePlacement()
+	: stSource(0)
+	, nClipLeft(0)
+	, nClipTop(0)
+	, nClipRight(0)
+	, nClipBottom(0)
+	, nLeft(0)
+	, nTop(0)
+	, nWidth(0)
+	, nHeight(0)
+	, bTile(false)
+	{
+	}
+
+	size_t	stSource;
+
+	int		nClipLeft;
+	int		nClipTop;
+	int		nClipRight;
+	int		nClipBottom;
+
+	int		nLeft;
+	int		nTop;
+	// tiled images aren't scaled, these are the source size
+	int		nWidth;
+	int		nHeight;
+
+	bool	bTile;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+struct BackgroundTilesStats
+{
+	BackgroundTilesStats()
+	: stTiles(0)
+	, stMaxTiles(0)
+	, stBytes(0)
+	, dwRenders(0)
+	, dwHits(0)
+	, dwEvictions(0)
+	{
+	}
+
+	size_t			stTiles;
+	size_t			stMaxTiles;
+	size_t			stBytes;
+
+	unsigned long	dwRenders;
+	unsigned long	dwHits;
+	unsigned long	dwEvictions;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Background spanning the whole virtual screen, stored as square tiles that
+// are rendered only when a window shows them. Tiles nobody has painted
+// recently are dropped once there are more than the maximum.
+//
+// Tiles are filled with the background color, the placements are painted
+// over it in the order they were added, then the tint goes over everything.
+//
+// Not thread safe. No Win32 dependency, it can be built and benchmarked on
+// its own.
+
+class BackgroundTiles
+{
+	public:
+
+		enum
+		{
+			TILE_SIZE = 256
+		};
+
+		struct Tile
+		{
+			int							nLeft;
+			int							nTop;
+			// TILE_SIZE x TILE_SIZE BGRA pixels, rows top-down
+			std::vector<unsigned char>	pixels;
+			unsigned long				dwLastUse;
+		};
+
+		// paints a tile, the caller clips to the rectangle passed to Paint
+		typedef std::function<void(const Tile& tile)>	PaintCallback;
+
+	public:
+
+		// colors are 0xAARRGGBB
+		BackgroundTiles(int nWidth, int nHeight, unsigned int dwBackground, unsigned int dwTint, unsigned char byTintOpacity, size_t stMaxTiles);
+		~BackgroundTiles();
+
+	public:
+
+		int GetWidth() const { return m_nWidth; }
+		int GetHeight() const { return m_nHeight; }
+
+		size_t AddSource(const TileSource& source);
+		void AddPlacement(const TilePlacement& placement);
+
+		// renders the missing tiles under the rectangle and paints all of them
+		void Paint(int nLeft, int nTop, int nRight, int nBottom, const PaintCallback& paint);
+
+		// drops all tiles, e.g. when a source has changed
+		void Clear();
+
+		BackgroundTilesStats GetStats() const;
+
+	private:
+
+		void RenderTile(Tile& tile);
+		void PaintPlacement(size_t stPlacement, Tile& tile);
+		void Trim();
+
+	private:
+
+		int										m_nWidth;
+		int										m_nHeight;
+		int										m_nColumns;
+		int										m_nRows;
+
+		unsigned int							m_dwBackground;
+		unsigned int							m_dwTint;
+		unsigned char							m_byTintOpacity;
+
+		std::vector<TileSource>					m_sources;
+		std::vector<TilePlacement>				m_placements;
+		// created on first use of a scaled placement
+		std::vector<std::shared_ptr<Resampler::Filters> >	m_filters;
+
+		// column by row, empty where the tile isn't rendered
+		std::vector<std::unique_ptr<Tile> >		m_tiles;
+		size_t									m_stMaxTiles;
+
+		// bumped on every Paint, tiles in use by the current one aren't evicted
+		unsigned long							m_dwPaint;
+
+		BackgroundTilesStats					m_stats;
+};
+
+//////////////////////////////////////////////////////////////////////////////
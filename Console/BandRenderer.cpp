@@ -0,0 +1,437 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "BandRenderer.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+//////////////////////////////////////////////////////////////////////////////
+
+// x/255 rounded to nearest, exact for x <= 255*255
+
+inline unsigned int Div255(unsigned int x)
+{
+	x += 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// draws dwColor through the coverage mask, like GDI text on a DIB
+
+void BlendGlyph(unsigned int* pPixels, const unsigned char* pCoverage, int nCount, unsigned int dwColor, bool bPremultiplied)
+{
+	for (int i = 0; i < nCount; ++i)
+	{
+		unsigned int dwCoverage = pCoverage[i];
+
+		if (dwCoverage == 0) continue;
+
+		unsigned int dwPixel = pPixels[i];
+
+		if (dwCoverage == 255)
+		{
+			pPixels[i] = bPremultiplied ? (dwColor | 0xFF000000) : ((dwPixel & 0xFF000000) | dwColor);
+			continue;
+		}
+
+		unsigned int dwInvCoverage	= 255 - dwCoverage;
+		unsigned int dwResult		= 0;
+
+		for (int nShift = 0; nShift < 24; nShift += 8)
+		{
+			dwResult |= Div255(((dwColor >> nShift) & 0xFF) * dwCoverage + ((dwPixel >> nShift) & 0xFF) * dwInvCoverage) << nShift;
+		}
+
+		unsigned int dwAlpha = dwPixel >> 24;
+
+		if (bPremultiplied) dwAlpha = dwCoverage + Div255(dwAlpha * dwInvCoverage);
+
+		pPixels[i] = dwResult | (dwAlpha << 24);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+GlyphAtlas::GlyphAtlas()
+: m_nCellWidth(0)
+, m_nCellHeight(0)
+, m_index()
+, m_coverage()
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void GlyphAtlas::SetCellSize(int nCellWidth, int nCellHeight)
+{
+	if ((nCellWidth == m_nCellWidth) && (nCellHeight == m_nCellHeight)) return;
+
+	Clear();
+
+	m_nCellWidth	= nCellWidth;
+	m_nCellHeight	= nCellHeight;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void GlyphAtlas::Clear()
+{
+	m_index.clear();
+	m_coverage.clear();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void GlyphAtlas::Add(wchar_t ch, bool bHigh, const Rasterizer& rasterizer)
+{
+	unsigned int dwKey = MakeKey(ch, bHigh);
+
+	if (m_index.find(dwKey) != m_index.end()) return;
+
+	size_t stSize	= static_cast<size_t>(GetGlyphWidth()) * m_nCellHeight;
+	size_t stOffset	= m_coverage.size();
+
+	m_coverage.resize(stOffset + stSize, 0);
+	rasterizer(ch, bHigh, &m_coverage[stOffset]);
+
+	// spaces and the like aren't kept
+	if (std::find_if(m_coverage.begin() + stOffset, m_coverage.end(), [](unsigned char by) { return by != 0; }) == m_coverage.end())
+	{
+		m_coverage.resize(stOffset);
+		stOffset = NO_GLYPH;
+	}
+
+	m_index[dwKey] = stOffset;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+const unsigned char* GlyphAtlas::Find(wchar_t ch, bool bHigh) const
+{
+	std::unordered_map<unsigned int, size_t>::const_iterator it = m_index.find(MakeKey(ch, bHigh));
+
+	if ((it == m_index.end()) || (it->second == NO_GLYPH)) return NULL;
+
+	return &m_coverage[it->second];
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+BandRenderer::Frame::Frame()
+: pCells(NULL)
+, nColumns(0)
+, nRows(0)
+, pRows(NULL)
+, nX(0)
+, nY(0)
+, bUseFontColor(false)
+, dwFontColor(0)
+, bIntensified(false)
+, bPremultiplied(false)
+, byBackgroundOpacity(255)
+{
+	::memset(palette, 0, sizeof(palette));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+BandRenderer::BandRenderer(size_t stThreads, size_t stCores)
+: m_mutex()
+, m_frameCondition()
+, m_doneCondition()
+, m_pFrame(NULL)
+, m_pAtlas(NULL)
+, m_pSurface(NULL)
+, m_nBandRows(0)
+, m_nBands(0)
+, m_nNextBand(0)
+, m_nBandsLeft(0)
+, m_dwFrames(0)
+, m_dwBands(0)
+, m_bStop(false)
+, m_stThreads(stThreads)
+, m_threads()
+{
+	if (stCores > 0) stThreads = std::min(stThreads, stCores);
+
+	for (size_t i = 1; i < stThreads; ++i)
+	{
+		m_threads.push_back(std::thread(&BandRenderer::Process, this));
+	}
+}
+
+BandRenderer::~BandRenderer()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_bStop = true;
+	}
+
+	m_frameCondition.notify_all();
+
+	for (size_t i = 0; i < m_threads.size(); ++i) m_threads[i].join();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void BandRenderer::PrepareGlyphs(const Frame& frame, GlyphAtlas& atlas, const GlyphAtlas::Rasterizer& rasterizer)
+{
+	if (atlas.GetGlyphCount() > GlyphAtlas::MAX_GLYPHS) atlas.Clear();
+
+	for (int nRow = 0; nRow < frame.nRows; ++nRow)
+	{
+		if ((frame.pRows != NULL) && !frame.pRows[nRow]) continue;
+
+		const Cell* pCell = frame.pCells + nRow * frame.nColumns;
+
+		for (int nColumn = 0; nColumn < frame.nColumns; ++nColumn, ++pCell)
+		{
+			if (pCell->wAttributes & ATTR_TRAILING_BYTE) continue;
+
+			atlas.Add(pCell->ch, frame.bIntensified && (pCell->wAttributes & ATTR_INTENSITY), rasterizer);
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void BandRenderer::Render(const Frame& frame, const GlyphAtlas& atlas, const PixelSurface& surface)
+{
+	if (frame.nRows <= 0) return;
+
+	int nBands = static_cast<int>(GetRunningThreads()) * BANDS_PER_THREAD;
+
+	nBands = std::min(nBands, (frame.nRows + MIN_BAND_ROWS - 1) / MIN_BAND_ROWS);
+
+	// rows that are drawn, a frame of a few changed rows is a small one too
+	int nDrawnRows = frame.nRows;
+
+	if (frame.pRows != NULL) nDrawnRows = static_cast<int>(std::count(frame.pRows, frame.pRows + frame.nRows, true));
+
+	if (m_threads.empty() || (nDrawnRows * frame.nColumns < MIN_PARALLEL_CELLS)) nBands = 1;
+
+	if (nBands <= 1)
+	{
+		RenderRows(frame, atlas, surface, 0, frame.nRows);
+
+		++m_dwFrames;
+		++m_dwBands;
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	m_pFrame		= &frame;
+	m_pAtlas		= &atlas;
+	m_pSurface		= &surface;
+	m_nBandRows		= (frame.nRows + nBands - 1) / nBands;
+	m_nBands		= (frame.nRows + m_nBandRows - 1) / m_nBandRows;
+	m_nNextBand		= 0;
+	m_nBandsLeft	= m_nBands;
+
+	++m_dwFrames;
+	m_dwBands += m_nBands;
+
+	m_frameCondition.notify_all();
+
+	RenderBands(lock);
+
+	while (m_nBandsLeft > 0) m_doneCondition.wait(lock);
+
+	m_pFrame	= NULL;
+	m_pAtlas	= NULL;
+	m_pSurface	= NULL;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void BandRenderer::RenderRows(const Frame& frame, const GlyphAtlas& atlas, const PixelSurface& surface, int nFirstRow, int nRows)
+{
+	int	nCellWidth	= atlas.GetCellWidth();
+	int	nCellHeight	= atlas.GetCellHeight();
+	int	nGlyphWidth	= atlas.GetGlyphWidth();
+	// text is clipped to the cells, not the inside border
+	int	nRight		= std::min(frame.nX + frame.nColumns * nCellWidth, surface.nWidth);
+
+	for (int nRow = nFirstRow; nRow < nFirstRow + nRows; ++nRow)
+	{
+		if ((frame.pRows != NULL) && !frame.pRows[nRow]) continue;
+
+		const Cell*	pRowCells	= frame.pCells + nRow * frame.nColumns;
+		int			nY			= frame.nY + nRow * nCellHeight;
+
+		// first pass: backgrounds, a fill per run of the same color
+		for (int nColumn = 0; nColumn < frame.nColumns; )
+		{
+			unsigned short	wBackground	= (pRowCells[nColumn].wAttributes & 0xFF) >> 4;
+			int				nRunStart	= nColumn;
+
+			while ((nColumn < frame.nColumns) && (((pRowCells[nColumn].wAttributes & 0xFF) >> 4) == wBackground)) ++nColumn;
+
+			// 0 is the view's background, already there
+			if (wBackground == 0) continue;
+
+			int nX		= frame.nX + nRunStart * nCellWidth;
+			int nFillY	= nY;
+			int nWidth	= (nColumn - nRunStart) * nCellWidth;
+			int nHeight	= nCellHeight;
+
+			if (!surface.Clip(nX, nFillY, nWidth, nHeight)) continue;
+
+			if (frame.bPremultiplied)
+			{
+				PixelKernels::BlendFill(surface.GetPixel(nX, nFillY), surface.nPitch, nWidth, nHeight, frame.palette[wBackground], frame.byBackgroundOpacity);
+			}
+			else
+			{
+				PixelKernels::Fill(surface.GetPixel(nX, nFillY), surface.nPitch, nWidth, nHeight, frame.palette[wBackground]);
+			}
+		}
+
+		// second pass: glyphs, overhang goes over the next cell's background
+		int nTop	= std::max(nY, 0);
+		int nBottom	= std::min(nY + nCellHeight, surface.nHeight);
+
+		if (nTop >= nBottom) continue;
+
+		for (int nColumn = 0; nColumn < frame.nColumns; ++nColumn)
+		{
+			const Cell& cell = pRowCells[nColumn];
+
+			if (cell.wAttributes & ATTR_TRAILING_BYTE) continue;
+
+			const unsigned char* pGlyph = atlas.Find(cell.ch, frame.bIntensified && (cell.wAttributes & ATTR_INTENSITY));
+
+			if (pGlyph == NULL) continue;
+
+			int nLeft	= frame.nX + nColumn * nCellWidth;
+			int nStart	= std::max(0, -nLeft);
+			int nEnd	= std::min(nGlyphWidth, nRight - nLeft);
+
+			if (nStart >= nEnd) continue;
+
+			unsigned int dwColor = (frame.bUseFontColor ? frame.dwFontColor : frame.palette[cell.wAttributes & 0xF]) & 0x00FFFFFF;
+
+			for (int y = nTop; y < nBottom; ++y)
+			{
+				BlendGlyph(
+					reinterpret_cast<unsigned int*>(surface.GetPixel(nLeft + nStart, y)),
+					pGlyph + (y - nY) * nGlyphWidth + nStart,
+					nEnd - nStart,
+					dwColor,
+					frame.bPremultiplied);
+			}
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void BandRenderer::Process()
+{
+	TRACE_THREAD_NAME("BandRenderer");
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	for (;;)
+	{
+		while (!m_bStop && (m_nNextBand >= m_nBands)) m_frameCondition.wait(lock);
+
+		if (m_bStop) break;
+
+		RenderBands(lock);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void BandRenderer::RenderBands(std::unique_lock<std::mutex>& lock)
+{
+	while (m_nNextBand < m_nBands)
+	{
+		int nFirstRow	= m_nNextBand * m_nBandRows;
+		int nRows		= std::min(m_nBandRows, m_pFrame->nRows - nFirstRow);
+
+		++m_nNextBand;
+
+		const Frame&		frame	= *m_pFrame;
+		const GlyphAtlas&	atlas	= *m_pAtlas;
+		const PixelSurface&	surface	= *m_pSurface;
+
+		lock.unlock();
+		RenderRows(frame, atlas, surface, nFirstRow, nRows);
+		lock.lock();
+
+		if (--m_nBandsLeft == 0) m_doneCondition.notify_one();
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
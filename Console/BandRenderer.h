@@ -0,0 +1,209 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "PixelKernels.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// 8 bit coverage bitmaps of the glyphs drawn by the band renderer, one per
+// character and font (normal or intensified). A glyph is two cells wide, so
+// wide characters and italic overhang into the next cell fit.
+//
+// Glyphs are added on the UI thread, by a rasterizer that knows the fonts;
+// while bands render, the atlas is only read.
+
+class GlyphAtlas
+{
+	public:
+
+		// fills a top-down GetGlyphWidth() x cell height coverage bitmap
+		typedef std::function<void(wchar_t ch, bool bHigh, unsigned char* pCoverage)> Rasterizer;
+
+		enum
+		{
+			// dropped all at once when a frame starts with more than this
+			MAX_GLYPHS	= 4096
+		};
+
+	public:
+
+		GlyphAtlas();
+
+	public:
+
+		// glyphs of another cell size are dropped
+		void SetCellSize(int nCellWidth, int nCellHeight);
+		// the fonts changed
+		void Clear();
+
+		int GetCellWidth() const { return m_nCellWidth; }
+		int GetCellHeight() const { return m_nCellHeight; }
+		int GetGlyphWidth() const { return m_nCellWidth * 2; }
+
+		// rasterizes the glyph if it's not in the atlas yet; pointers from
+		// Find are invalid after it
+		void Add(wchar_t ch, bool bHigh, const Rasterizer& rasterizer);
+
+		// NULL for a blank glyph (or a missing one)
+		const unsigned char* Find(wchar_t ch, bool bHigh) const;
+
+		size_t GetGlyphCount() const { return m_index.size(); }
+		size_t GetBytes() const { return m_coverage.size(); }
+
+	private:
+
+		static unsigned int MakeKey(wchar_t ch, bool bHigh) { return (static_cast<unsigned int>(ch) << 1) | (bHigh ? 1 : 0); }
+
+	private:
+
+		int				m_nCellWidth;
+		int				m_nCellHeight;
+
+		// glyph offsets in m_coverage, NO_GLYPH for blank ones
+		std::unordered_map<unsigned int, size_t>	m_index;
+		vector<unsigned char>						m_coverage;
+
+		static const size_t NO_GLYPH = static_cast<size_t>(-1);
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Draws console text into a 32 bpp DIB section from a pool of worker
+// threads. The rows are split into horizontal bands; each band's cell
+// backgrounds and glyphs are written by one thread only, so bands never
+// touch the same pixels and need no locking. The calling thread renders
+// bands too, and Render returns when the frame is done.
+//
+// Handing bands to other threads only pays off when there's a core for each
+// and the frame is big enough to cover the wake-ups; otherwise the frame is
+// drawn as one band on the calling thread.
+//
+// Cells are a copy of the screen buffer, taken under the buffer lock so the
+// console can go on while the bands render. Glyphs come from a GlyphAtlas
+// filled before rendering starts.
+//
+// No Win32 dependency, it can be built and tested on its own.
+
+class BandRenderer
+{
+	public:
+
+		enum
+		{
+			// console attribute bits used
+			ATTR_INTENSITY		= 0x0008,
+			ATTR_TRAILING_BYTE	= 0x0200,
+
+			// smaller bands cost more to schedule than they save
+			MIN_BAND_ROWS		= 2,
+			// bands per thread, so a slow band doesn't hold the frame up
+			BANDS_PER_THREAD	= 2,
+			// frames drawing fewer cells (the default 80x25 console fits)
+			// render on the calling thread
+			MIN_PARALLEL_CELLS	= 2048
+		};
+
+		struct Cell
+		{
+			wchar_t			ch;
+			unsigned short	wAttributes;
+		};
+
+		struct Frame
+		{
+			Frame();
+
+			const Cell*		pCells;
+			int				nColumns;
+			int				nRows;
+
+			// rows to draw, NULL for all
+			const bool*		pRows;
+
+			// top left of the first cell on the surface
+			int				nX;
+			int				nY;
+
+			// 0x00RRGGBB
+			unsigned int	palette[16];
+
+			bool			bUseFontColor;
+			unsigned int	dwFontColor;
+
+			// intensified cells use the high font glyphs
+			bool			bIntensified;
+
+			// premultiplied surface (glass): backgrounds are blended with
+			// byBackgroundOpacity and text updates alpha; otherwise
+			// backgrounds are opaque and alpha is left alone, like GDI
+			bool			bPremultiplied;
+			unsigned char	byBackgroundOpacity;
+		};
+
+	public:
+
+		// stThreads includes the calling thread, 1 renders on it alone; no
+		// more threads than stCores are started (0 if it's not known)
+		explicit BandRenderer(size_t stThreads, size_t stCores = std::thread::hardware_concurrency());
+		// waits for the running frame
+		~BandRenderer();
+
+	public:
+
+		// threads asked for, and the ones rendering
+		size_t GetThreads() const { return m_stThreads; }
+		size_t GetRunningThreads() const { return m_threads.size() + 1; }
+
+		// adds the glyphs the frame needs to the atlas, on the calling thread
+		static void PrepareGlyphs(const Frame& frame, GlyphAtlas& atlas, const GlyphAtlas::Rasterizer& rasterizer);
+
+		void Render(const Frame& frame, const GlyphAtlas& atlas, const PixelSurface& surface);
+
+		// draws rows [nFirstRow, nFirstRow + nRows) on the calling thread
+		static void RenderRows(const Frame& frame, const GlyphAtlas& atlas, const PixelSurface& surface, int nFirstRow, int nRows);
+
+		// frames and bands rendered so far
+		unsigned long GetFrames() const { return m_dwFrames; }
+		unsigned long GetBands() const { return m_dwBands; }
+
+	private:
+
+		void Process();
+		// renders bands until there are none left; called with the lock held
+		void RenderBands(std::unique_lock<std::mutex>& lock);
+
+	private:
+
+		std::mutex					m_mutex;
+		std::condition_variable		m_frameCondition;
+		std::condition_variable		m_doneCondition;
+
+		// the frame being rendered
+		const Frame*				m_pFrame;
+		const GlyphAtlas*			m_pAtlas;
+		const PixelSurface*			m_pSurface;
+		int							m_nBandRows;
+		int							m_nBands;
+		int							m_nNextBand;
+		int							m_nBandsLeft;
+		unsigned long				m_dwFrames;
+		unsigned long				m_dwBands;
+
+		bool						m_bStop;
+
+		size_t						m_stThreads;
+		vector<std::thread>			m_threads;
+};
+
+//////////////////////////////////////////////////////////////////////////////
@@ -10,6 +10,8 @@
 #include "MainFrame.h"
 #include "Console.h"
 #include "WallPaper.h"
+#include "ShellPool.h"
+#include "IconCache.h"
 
 //////////////////////////////////////////////////////////////////////////////
 
@@ -26,6 +28,8 @@ CAppModule					_Module;
 
 std::shared_ptr<SettingsHandler>	g_settingsHandler;
 std::shared_ptr<ImageHandler>	g_imageHandler;
+std::shared_ptr<ShellPool>		g_shellPool;
+std::shared_ptr<IconCache>		g_iconCache;
 
 //////////////////////////////////////////////////////////////////////////////
 
@@ -65,7 +69,8 @@ void ParseCommandLine
 (
 	LPTSTR lptstrCmdLine, 
 	wstring& strConfigFile, 
-	bool &bReuse
+	bool &bReuse,
+	wstring& strTraceFile
 )
 {
 	int argc = 0;
@@ -86,6 +91,13 @@ void ParseCommandLine
 		{
 			bReuse = true;
 		}
+		else if (wstring(argv[i]) == wstring(L"-trace"))
+		{
+			// dump trace events on exit
+			++i;
+			if (i == argc) break;
+			strTraceFile = argv[i];
+		}
 	}
 }
 
@@ -133,11 +145,13 @@ int Run(LPTSTR lpstrCmdLine = NULL, int nCmdShow = SW_SHOWDEFAULT)
 
     wstring strConfigFile(L"");
     bool    bReuse = false;
+    wstring strTraceFile(L"");
 
     ParseCommandLine(
       lpstrCmdLine, 
       strConfigFile,
-      bReuse);
+      bReuse,
+      strTraceFile);
 
     if (strConfigFile.length() == 0)
     {
@@ -151,9 +165,16 @@ int Run(LPTSTR lpstrCmdLine = NULL, int nCmdShow = SW_SHOWDEFAULT)
       throw std::exception("enable to load settings!");
     }
 
+    g_imageHandler->SetCacheBudget(g_settingsHandler->GetTabSettings().dwImageCacheSize * 1024 * 1024);
+
     if (bReuse && HandleReuse(lpstrCmdLine))
       return 0;
 
+    // tab icons are extracted in the background while the window is created
+    g_iconCache.reset(new IconCache());
+    g_iconCache->Start();
+    g_iconCache->Prewarm();
+
     // create main window
     NoTaskbarParent noTaskbarParent;
     MainFrame wndMain(lpstrCmdLine);
@@ -215,8 +236,29 @@ int Run(LPTSTR lpstrCmdLine = NULL, int nCmdShow = SW_SHOWDEFAULT)
       wallPaperThread.Start();
     }
 
+    // pre-spawned consoles for tabs with warm shells enabled
+    g_shellPool.reset(new ShellPool());
+    g_shellPool->Start();
+    g_shellPool->Refresh();
+
+    // background images are rescaled off the UI thread while resizing
+    g_imageHandler->StartRescaler(wndMain.m_hWnd);
+
     int nRet = theLoop.Run();
 
+    g_imageHandler->StopRescaler();
+    g_imageHandler->StopDecoder();
+    ConsoleView::StopBandRenderer();
+    g_shellPool.reset();
+    g_iconCache.reset();
+
+    // don't keep logon tokens around longer than needed
+    ConsoleHandler::ClearLogonCache();
+
+#ifdef _TRACE_EVENTS
+    if (strTraceFile.length() > 0) Helpers::DumpTrace(strTraceFile);
+#endif
+
     if (noTaskbarParent.m_hWnd != NULL) noTaskbarParent.DestroyWindow();
 
     _Module.RemoveMessageLoop();
@@ -250,6 +292,11 @@ int WINAPI _tWinMain(HINSTANCE hInstance, HINSTANCE /*hPrevInstance*/, LPTSTR lp
   Gdiplus::GdiplusStartup(&gdiplusToken, &gdiplusStartupInput, NULL);
 #endif
 
+#ifdef _TRACE_EVENTS
+	Tracer::Init();
+	TRACE_THREAD_NAME("UI");
+#endif
+
 	g_settingsHandler.reset(new SettingsHandler());
 	g_imageHandler.reset(new ImageHandler());
 
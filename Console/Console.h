@@ -2,4 +2,10 @@
 #include "SettingsHandler.h"
 
 extern std::shared_ptr<SettingsHandler>	g_settingsHandler;
-extern std::shared_ptr<ImageHandler>		g_imageHandler;
\ No newline at end of file
+extern std::shared_ptr<ImageHandler>		g_imageHandler;
+
+class ShellPool;
+extern std::shared_ptr<ShellPool>		g_shellPool;
+
+class IconCache;
+extern std::shared_ptr<IconCache>		g_iconCache;
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include "../shared/SharedMemNames.h"
 #include "ConsoleException.h"
 #include "ConsoleHandler.h"
+#include "Win32LogonProvider.h"
 
 //////////////////////////////////////////////////////////////////////////////
 
@@ -24,7 +25,16 @@
 //////////////////////////////////////////////////////////////////////////////
 
 std::shared_ptr<Mutex>	ConsoleHandler::s_parentProcessWatchdog;
+CriticalSection			ConsoleHandler::s_environmentCritSec;
 std::shared_ptr<void>	ConsoleHandler::s_environmentBlock;
+std::shared_ptr<LogonCache>	ConsoleHandler::s_logonCache(new LogonCache(std::shared_ptr<LogonProvider>(new Win32LogonProvider())));
+
+#ifdef _WIN64
+CriticalSection			ConsoleHandler::s_wow64CritSec;
+DWORD					ConsoleHandler::s_dwWow64LoadLibrary(0);
+DWORD					ConsoleHandler::s_dwWow64Kernel32Base(0);
+DWORD					ConsoleHandler::s_dwWow64Kernel32TimeStamp(0);
+#endif
 
 //////////////////////////////////////////////////////////////////////////////
 
@@ -42,6 +52,10 @@ ConsoleHandler::ConsoleHandler()
 , m_hMonitorThreadExit(std::shared_ptr<void>(::CreateEvent(NULL, FALSE, FALSE, NULL), ::CloseHandle))
 , m_bufferMutex(NULL, FALSE, NULL)
 , m_dwConsolePid(0)
+#ifdef _WIN64
+, m_dwWow64LoadLibrary(0)
+, m_bWow64LoadLibraryCached(false)
+#endif
 {
 }
 
@@ -84,15 +98,48 @@ bool ConsoleHandler::StartShellProcess
 	const wstring& strInitialCmd,
 	const wstring& strConsoleTitle,
 	DWORD dwStartupRows,
-	DWORD dwStartupColumns
+	DWORD dwStartupColumns,
+	const ShellStartup& shellStartup
 )
 {
+	return StartShellProcess(
+				strCustomShell,
+				strInitialDir,
+				userCredentials,
+				strInitialCmd,
+				strConsoleTitle,
+				dwStartupRows,
+				dwStartupColumns,
+				shellStartup,
+				true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool ConsoleHandler::StartShellProcess
+(
+	const wstring& strCustomShell,
+	const wstring& strInitialDir,
+	const UserCredentials& userCredentials,
+	const wstring& strInitialCmd,
+	const wstring& strConsoleTitle,
+	DWORD dwStartupRows,
+	DWORD dwStartupColumns,
+	const ShellStartup& shellStartup,
+	bool bWow64Retry
+)
+{
+	TRACE_SCOPE("ConsoleHandler::StartShellProcess");
+
   wstring strUsername(userCredentials.user);
 	wstring strDomain;
 
 	//std::shared_ptr<void> userProfileKey;
-	std::unique_ptr<void, DestroyEnvironmentBlockHelper> userEnvironment;
-	std::unique_ptr<void, CloseHandleHelper>             userToken;
+	std::shared_ptr<void> userEnvironment;
+	std::shared_ptr<void> userToken;
 
 	if (strUsername.length() > 0)
 	{
@@ -119,20 +166,25 @@ bool ConsoleHandler::StartShellProcess
 
     if (!userCredentials.netOnly)
     {
-      // logon user
-      HANDLE hUserToken = NULL;
-      if( !::LogonUser(
-        strUsername.c_str(), 
-        strDomain.length() > 0 ? strDomain.c_str() : NULL, 
-        userCredentials.password.c_str(), 
-        LOGON32_LOGON_INTERACTIVE, 
-        LOGON32_PROVIDER_DEFAULT, 
-        &hUserToken) || !::ImpersonateLoggedOnUser(hUserToken) )
+      // logon user and load user's environment, both are cached for further tabs
+      std::shared_ptr<LogonSession> logonSession;
+      try
+      {
+        logonSession = s_logonCache->GetSession(strDomain, strUsername, userCredentials.password, userCredentials.netOnly, ::GetTickCount64());
+      }
+      catch(Win32Exception& err)
+      {
+        throw ConsoleException(boost::str(boost::wformat(Helpers::LoadStringW(IDS_ERR_CANT_START_SHELL_AS_USER)) % L"?" % userCredentials.user % err.what()));
+      }
+
+      if( !::ImpersonateLoggedOnUser(logonSession->token.get()) )
       {
         Win32Exception err(::GetLastError());
         throw ConsoleException(boost::str(boost::wformat(Helpers::LoadStringW(IDS_ERR_CANT_START_SHELL_AS_USER)) % L"?" % userCredentials.user % err.what()));
       }
-      userToken.reset(hUserToken);
+
+      userToken       = logonSession->token;
+      userEnvironment = logonSession->environment;
 
       /*
       // load user's profile
@@ -145,16 +197,6 @@ bool ConsoleHandler::StartShellProcess
       ::LoadUserProfile(userToken.get(), &userProfile);
       userProfileKey.reset(userProfile.hProfile, bind<BOOL>(::UnloadUserProfile, userToken.get(), _1));
       */
-
-      // load user's environment
-      void*	pEnvironment = nullptr;
-      if( !::CreateEnvironmentBlock(&pEnvironment, userToken.get(), FALSE) )
-      {
-        Win32Exception err(::GetLastError());
-        ::RevertToSelf();
-        throw ConsoleException(boost::str(boost::wformat(Helpers::LoadStringW(IDS_ERR_CANT_START_SHELL_AS_USER)) % L"?" % userCredentials.user % err.what()));
-      }
-      userEnvironment.reset(pEnvironment);
     }
   }
 
@@ -250,7 +292,7 @@ bool ConsoleHandler::StartShellProcess
 	si.cb			= sizeof(STARTUPINFO);
 	si.lpTitle		= const_cast<wchar_t*>(strStartupTitle.c_str());
 
-	if (g_settingsHandler->GetConsoleSettings().bStartHidden)
+	if (shellStartup.bStartHidden)
 	{
 		// Starting Windows console window hidden causes problems with 
 		// some GUI apps started from Console that use SW_SHOWDEFAULT to 
@@ -273,7 +315,7 @@ bool ConsoleHandler::StartShellProcess
 	}
 
 	PROCESS_INFORMATION pi;
-	// we must use CREATE_UNICODE_ENVIRONMENT here, since s_environmentBlock contains Unicode strings
+	// we must use CREATE_UNICODE_ENVIRONMENT here, since the environment block contains Unicode strings
 	DWORD dwStartupFlags = CREATE_NEW_CONSOLE|CREATE_SUSPENDED|CREATE_UNICODE_ENVIRONMENT;
 
 	// TODO: not supported yet
@@ -286,20 +328,52 @@ bool ConsoleHandler::StartShellProcess
 
 	si.cb			= sizeof(STARTUPINFO);
 
-		if( !::CreateProcessWithLogonW(
-			strUsername.c_str(), 
-			strDomain.length() > 0 ? strDomain.c_str() : NULL,
-			userCredentials.password.c_str(), 
-			userCredentials.netOnly? LOGON_NETCREDENTIALS_ONLY : LOGON_WITH_PROFILE,
-			NULL,
-			const_cast<wchar_t*>(strCmdLine.c_str()),
-			dwStartupFlags,
-			s_environmentBlock.get(),
-			(strStartupDir.length() > 0) ? const_cast<wchar_t*>(strStartupDir.c_str()) : NULL,
-			&si,
-			&pi))
+		BOOL  bCreated = FALSE;
+		DWORD dwError  = ERROR_SUCCESS;
+
+		if (userToken.get())
 		{
-      Win32Exception err(::GetLastError());
+			// start the shell with the cached token and environment, so the
+			// user isn't logged on again for every tab
+			bCreated = ::CreateProcessWithTokenW(
+				userToken.get(),
+				LOGON_WITH_PROFILE,
+				NULL,
+				const_cast<wchar_t*>(strCmdLine.c_str()),
+				dwStartupFlags,
+				userEnvironment.get(),
+				(strStartupDir.length() > 0) ? const_cast<wchar_t*>(strStartupDir.c_str()) : NULL,
+				&si,
+				&pi);
+
+			if (!bCreated) dwError = ::GetLastError();
+		}
+
+		// net only logons have no token; CreateProcessWithTokenW also needs
+		// SeImpersonatePrivilege, which a non-elevated Console doesn't have.
+		// CreateProcessWithLogonW logs the user on again, the cached session
+		// saves nothing there
+		if (!userToken.get() || (dwError == ERROR_PRIVILEGE_NOT_HELD))
+		{
+			bCreated = ::CreateProcessWithLogonW(
+				strUsername.c_str(), 
+				strDomain.length() > 0 ? strDomain.c_str() : NULL,
+				userCredentials.password.c_str(), 
+				userCredentials.netOnly? LOGON_NETCREDENTIALS_ONLY : LOGON_WITH_PROFILE,
+				NULL,
+				const_cast<wchar_t*>(strCmdLine.c_str()),
+				dwStartupFlags,
+				shellStartup.environmentBlock.get(),
+				(strStartupDir.length() > 0) ? const_cast<wchar_t*>(strStartupDir.c_str()) : NULL,
+				&si,
+				&pi);
+
+			if (!bCreated) dwError = ::GetLastError();
+		}
+
+		if (!bCreated)
+		{
+      Win32Exception err(dwError);
 			throw ConsoleException(boost::str(boost::wformat(Helpers::LoadStringW(IDS_ERR_CANT_START_SHELL_AS_USER)) % strShellCmdLine % userCredentials.user % err.what()));
 		}
 	}
@@ -312,7 +386,7 @@ bool ConsoleHandler::StartShellProcess
 				NULL,
 				FALSE,
 				dwStartupFlags,
-				s_environmentBlock.get(),
+				shellStartup.environmentBlock.get(),
 				(strStartupDir.length() > 0) ? const_cast<wchar_t*>(strStartupDir.c_str()) : NULL,
 				&si,
 				&pi))
@@ -343,18 +417,18 @@ bool ConsoleHandler::StartShellProcess
 	// write startup params
 	m_consoleParams->dwConsoleMainThreadId	= pi.dwThreadId;
 	m_consoleParams->dwParentProcessId		= ::GetCurrentProcessId();
-	m_consoleParams->dwNotificationTimeout	= g_settingsHandler->GetConsoleSettings().dwChangeRefreshInterval;
-	m_consoleParams->dwRefreshInterval		= g_settingsHandler->GetConsoleSettings().dwRefreshInterval;
+	m_consoleParams->dwNotificationTimeout	= shellStartup.dwNotificationTimeout;
+	m_consoleParams->dwRefreshInterval		= shellStartup.dwRefreshInterval;
 	m_consoleParams->dwRows					= dwStartupRows;
 	m_consoleParams->dwColumns				= dwStartupColumns;
-	m_consoleParams->dwBufferRows			= g_settingsHandler->GetConsoleSettings().dwBufferRows;
-	m_consoleParams->dwBufferColumns		= g_settingsHandler->GetConsoleSettings().dwBufferColumns;
+	m_consoleParams->dwBufferRows			= shellStartup.dwBufferRows;
+	m_consoleParams->dwBufferColumns		= shellStartup.dwBufferColumns;
 
 	m_hConsoleProcess = std::shared_ptr<void>(pi.hProcess, ::CloseHandle);
   m_dwConsolePid    = pi.dwProcessId;
 
 	// inject our hook DLL into console process
-	if (!InjectHookDLL(pi))
+	if (!InjectHookDLL(pi, bWow64Retry))
     throw ConsoleException(boost::str(boost::wformat(Helpers::LoadString(IDS_ERR_DLL_INJECTION_FAILED)) % L"?"));
 
 	// resume the console process
@@ -362,17 +436,87 @@ bool ConsoleHandler::StartShellProcess
 	::CloseHandle(pi.hThread);
 
 	// wait for hook DLL to set console handle
-	if (::WaitForSingleObject(m_consoleParams.GetReqEvent(), 10000) == WAIT_TIMEOUT)
-    throw ConsoleException(boost::str(boost::wformat(Helpers::LoadString(IDS_ERR_DLL_INJECTION_FAILED)) % L"timeout"));
+	{
+		TRACE_SCOPE("ConsoleHandler::WaitForHook");
+
+		// a shell that crashed before the hook loaded won't signal either
+		HANDLE arrWaitHandles[] = { m_consoleParams.GetReqEvent(), m_hConsoleProcess.get() };
+
+		if (::WaitForMultipleObjects(sizeof(arrWaitHandles)/sizeof(arrWaitHandles[0]), arrWaitHandles, FALSE, 10000) != WAIT_OBJECT_0)
+		{
+#ifdef _WIN64
+			if (m_dwWow64LoadLibrary != 0)
+			{
+				// the 32-bit LoadLibraryW address might be stale (kernel32
+				// updated or rebased), no tab should use it again
+				InvalidateWow64LoadLibrary(m_dwWow64LoadLibrary);
+
+				if (m_bWow64LoadLibraryCached && bWow64Retry)
+				{
+					TRACE(L"Hook handshake failed with the cached 32-bit LoadLibraryW, retrying\n");
+
+					::TerminateProcess(m_hConsoleProcess.get(), 1);
+					m_hConsoleProcess.reset();
+					m_dwConsolePid = 0;
+
+					return StartShellProcess(
+								strCustomShell,
+								strInitialDir,
+								userCredentials,
+								strInitialCmd,
+								strConsoleTitle,
+								dwStartupRows,
+								dwStartupColumns,
+								shellStartup,
+								false);
+				}
+			}
+#endif
+
+			throw ConsoleException(boost::str(boost::wformat(Helpers::LoadString(IDS_ERR_DLL_INJECTION_FAILED)) % L"timeout"));
+		}
+	}
 
 	::ShowWindow(m_consoleParams->hwndConsoleWindow, SW_HIDE);
 
+#ifdef _WIN64
+	BOOL isWow64Process = FALSE;
+	::IsWow64Process(m_hConsoleProcess.get(), &isWow64Process);
+	if (isWow64Process) ValidateWow64LoadLibrary(m_consoleParams->dwKernel32Base, m_consoleParams->dwKernel32TimeStamp);
+#endif
+
 	return true;
 }
 
 //////////////////////////////////////////////////////////////////////////////
 
 
+//////////////////////////////////////////////////////////////////////////////
+
+void ConsoleHandler::AdoptShellProcess(ConsoleHandler& other)
+{
+	m_hConsoleProcess	= other.m_hConsoleProcess;
+	m_dwConsolePid		= other.m_dwConsolePid;
+
+	m_consoleParams		= other.m_consoleParams;
+	m_consoleInfo		= other.m_consoleInfo;
+	m_cursorInfo		= other.m_cursorInfo;
+	m_consoleBuffer		= other.m_consoleBuffer;
+	m_consoleCopyInfo	= other.m_consoleCopyInfo;
+	m_consoleTextInfo	= other.m_consoleTextInfo;
+	m_consoleMouseEvent	= other.m_consoleMouseEvent;
+	m_newConsoleSize	= other.m_newConsoleSize;
+	m_newScrollPos		= other.m_newScrollPos;
+
+	// the other handler must not close the console window when destroyed
+	other.m_hConsoleProcess.reset();
+	other.m_dwConsolePid	= 0;
+	other.m_consoleParams	= SharedMemory<ConsoleParams>();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
 //////////////////////////////////////////////////////////////////////////////
 
 DWORD ConsoleHandler::StartMonitorThread()
@@ -409,19 +553,22 @@ void ConsoleHandler::StopMonitorThread()
 
 void ConsoleHandler::SendMouseEvent(const COORD& mousePos, DWORD dwMouseButtonState, DWORD dwControlKeyState, DWORD dwEventFlags)
 {
-	{
-		SharedMemoryLock	memLock(m_consoleMouseEvent);
+	MOUSE_EVENT_RECORD	mouseEvent;
+
+	mouseEvent.dwMousePosition		= mousePos;
+	mouseEvent.dwButtonState		= dwMouseButtonState;
+	mouseEvent.dwControlKeyState	= dwControlKeyState;
+	mouseEvent.dwEventFlags			= dwEventFlags;
 
-		// TODO: implement
-		m_consoleMouseEvent->dwMousePosition	= mousePos;
-		m_consoleMouseEvent->dwButtonState		= dwMouseButtonState;
-		m_consoleMouseEvent->dwControlKeyState	= dwControlKeyState;
-		m_consoleMouseEvent->dwEventFlags		= dwEventFlags;
+	// queued for the hook, we don't wait for it to be written to the console
+	SharedMemoryLock	memLock(m_consoleMouseEvent);
 
-		m_consoleMouseEvent.SetReqEvent();
+	if (!m_consoleMouseEvent->Push(mouseEvent))
+	{
+		TRACE(L"Mouse event queue full, event dropped (%u dropped)\n", m_consoleMouseEvent->nDropped);
 	}
 
-	::WaitForSingleObject(m_consoleMouseEvent.GetRespEvent(), INFINITE);
+	m_consoleMouseEvent.SetReqEvent();
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -465,7 +612,48 @@ void ConsoleHandler::UpdateEnvironmentBlock()
 	::CreateEnvironmentBlock(&pEnvironment, hProcessToken, FALSE);
 	::CloseHandle(hProcessToken);
 
-	s_environmentBlock.reset(pEnvironment, ::DestroyEnvironmentBlock);
+	{
+		// shells being started keep their copy of the old block alive
+		CriticalSectionLock	lock(s_environmentCritSec);
+		s_environmentBlock.reset(pEnvironment, ::DestroyEnvironmentBlock);
+	}
+
+	// cached user environments are stale now
+	s_logonCache->Clear();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+ShellStartup ConsoleHandler::GetShellStartup()
+{
+	ConsoleSettings&	consoleSettings = g_settingsHandler->GetConsoleSettings();
+	ShellStartup		shellStartup;
+
+	shellStartup.bStartHidden			= consoleSettings.bStartHidden;
+	shellStartup.dwNotificationTimeout	= consoleSettings.dwChangeRefreshInterval;
+	shellStartup.dwRefreshInterval		= consoleSettings.dwRefreshInterval;
+	shellStartup.dwBufferRows			= consoleSettings.dwBufferRows;
+	shellStartup.dwBufferColumns		= consoleSettings.dwBufferColumns;
+
+	{
+		CriticalSectionLock	lock(s_environmentCritSec);
+		shellStartup.environmentBlock = s_environmentBlock;
+	}
+
+	return shellStartup;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ConsoleHandler::ClearLogonCache()
+{
+	s_logonCache->Clear();
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -504,7 +692,7 @@ bool ConsoleHandler::CreateSharedObjects(DWORD dwConsoleProcessId, const wstring
 	m_consoleTextInfo.Create((SharedMemNames::formatTextInfo % dwConsoleProcessId).str(), 1, syncObjBoth, strUser);
 
 	// mouse event
-	m_consoleMouseEvent.Create((SharedMemNames::formatMouseEvent % dwConsoleProcessId).str(), 1, syncObjBoth, strUser);
+	m_consoleMouseEvent.Create((SharedMemNames::formatMouseEvent % dwConsoleProcessId).str(), 1, syncObjRequest, strUser);
 
 	// new console size
 	m_newConsoleSize.Create((SharedMemNames::formatNewConsoleSize % dwConsoleProcessId).str(), 1, syncObjRequest, strUser);
@@ -526,6 +714,9 @@ bool ConsoleHandler::CreateSharedObjects(DWORD dwConsoleProcessId, const wstring
 
 void ConsoleHandler::CreateWatchdog()
 {
+	// the shell pool thread starts consoles too
+	CriticalSectionLock	lock(s_environmentCritSec);
+
 	if (!s_parentProcessWatchdog)
 	{
 		std::shared_ptr<void>	sd;	// PSECURITY_DESCRIPTOR
@@ -556,8 +747,10 @@ void ConsoleHandler::CreateWatchdog()
 
 //////////////////////////////////////////////////////////////////////////////
 
-bool ConsoleHandler::InjectHookDLL(PROCESS_INFORMATION& pi)
+bool ConsoleHandler::InjectHookDLL(PROCESS_INFORMATION& pi, bool bUseWow64Cache)
 {
+	TRACE_SCOPE("ConsoleHandler::InjectHookDLL");
+
 	// allocate memory for parameter in the remote process
 	wstring				strHookDllPath(GetModulePath(NULL));
 
@@ -577,7 +770,11 @@ bool ConsoleHandler::InjectHookDLL(PROCESS_INFORMATION& pi)
 	::ZeroMemory(&wow64Context, sizeof(WOW64_CONTEXT));
 	::IsWow64Process(pi.hProcess, &isWow64Process);
 	codeSize = isWow64Process ? 20 : 91;
+
+	m_dwWow64LoadLibrary		= 0;
+	m_bWow64LoadLibraryCached	= false;
 #else
+	UNREFERENCED_PARAMETER(bUseWow64Cache);
 	codeSize = 20;
 #endif
 
@@ -613,42 +810,8 @@ bool ConsoleHandler::InjectHookDLL(PROCESS_INFORMATION& pi)
 		mem = ::VirtualAllocEx(pi.hProcess, NULL, memLen, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
 
 		// get 32-bit kernel32
-		wstring strConsoleWowPath(GetModulePath(NULL) + wstring(L"\\ConsoleWow.exe"));
-
-		STARTUPINFO siWow;
-		::ZeroMemory(&siWow, sizeof(STARTUPINFO));
-
-		siWow.cb			= sizeof(STARTUPINFO);
-		siWow.dwFlags		= STARTF_USESHOWWINDOW;
-		siWow.wShowWindow	= SW_HIDE;
-		
-		PROCESS_INFORMATION piWow;
-
-		if (!::CreateProcess(
-				NULL,
-				const_cast<wchar_t*>(strConsoleWowPath.c_str()),
-				NULL,
-				NULL,
-				FALSE,
-				0,
-				NULL,
-				NULL,
-				&siWow,
-				&piWow))
-		{
-      Win32Exception err(::GetLastError());
-			throw ConsoleException(boost::str(boost::wformat(Helpers::LoadString(IDS_ERR_CANT_START_SHELL)) % strConsoleWowPath.c_str() % err.what()));
-		}
-
-		std::shared_ptr<void> wowProcess(piWow.hProcess, ::CloseHandle);
-		std::shared_ptr<void> wowThread(piWow.hThread, ::CloseHandle);
-
-		if (::WaitForSingleObject(wowProcess.get(), 5000) == WAIT_TIMEOUT)
-		{
-			throw ConsoleException(boost::str(boost::wformat(Helpers::LoadString(IDS_ERR_DLL_INJECTION_FAILED)) % L"timeout"));
-		}
-
-		::GetExitCodeProcess(wowProcess.get(), reinterpret_cast<DWORD*>(&fnWow64LoadLibrary));
+		fnWow64LoadLibrary = GetWow64LoadLibrary(bUseWow64Cache, m_bWow64LoadLibraryCached);
+		m_dwWow64LoadLibrary = fnWow64LoadLibrary;
 	}
 	else
 	{
@@ -789,6 +952,132 @@ bool ConsoleHandler::InjectHookDLL(PROCESS_INFORMATION& pi)
 //////////////////////////////////////////////////////////////////////////////
 
 
+#ifdef _WIN64
+
+//////////////////////////////////////////////////////////////////////////////
+
+DWORD ConsoleHandler::GetWow64LoadLibrary(bool bUseCache, bool& bCached)
+{
+	bCached = false;
+
+	if (bUseCache)
+	{
+		CriticalSectionLock	lock(s_wow64CritSec);
+
+		// only trust the cached address once a hook has confirmed the kernel32 it was resolved for
+		if ((s_dwWow64LoadLibrary != 0) && (s_dwWow64Kernel32Base != 0))
+		{
+			TRACE(L"32-bit LoadLibraryW: 0x%08X (cached)\n", s_dwWow64LoadLibrary);
+			bCached = true;
+			return s_dwWow64LoadLibrary;
+		}
+	}
+
+	DWORD dwStartTicks = ::GetTickCount();
+
+	wstring strConsoleWowPath(Helpers::GetModulePath(NULL) + wstring(L"ConsoleWow.exe"));
+
+	STARTUPINFO siWow;
+	::ZeroMemory(&siWow, sizeof(STARTUPINFO));
+
+	siWow.cb			= sizeof(STARTUPINFO);
+	siWow.dwFlags		= STARTF_USESHOWWINDOW;
+	siWow.wShowWindow	= SW_HIDE;
+	
+	PROCESS_INFORMATION piWow;
+
+	if (!::CreateProcess(
+			NULL,
+			const_cast<wchar_t*>(strConsoleWowPath.c_str()),
+			NULL,
+			NULL,
+			FALSE,
+			0,
+			NULL,
+			NULL,
+			&siWow,
+			&piWow))
+	{
+		Win32Exception err(::GetLastError());
+		throw ConsoleException(boost::str(boost::wformat(Helpers::LoadString(IDS_ERR_CANT_START_SHELL)) % strConsoleWowPath.c_str() % err.what()));
+	}
+
+	std::shared_ptr<void> wowProcess(piWow.hProcess, ::CloseHandle);
+	std::shared_ptr<void> wowThread(piWow.hThread, ::CloseHandle);
+
+	if (::WaitForSingleObject(wowProcess.get(), 5000) == WAIT_TIMEOUT)
+	{
+		throw ConsoleException(boost::str(boost::wformat(Helpers::LoadString(IDS_ERR_DLL_INJECTION_FAILED)) % L"timeout"));
+	}
+
+	DWORD dwWow64LoadLibrary = 0;
+	::GetExitCodeProcess(wowProcess.get(), &dwWow64LoadLibrary);
+
+	TRACE(L"32-bit LoadLibraryW: 0x%08X (ConsoleWow.exe, %i ms)\n", dwWow64LoadLibrary, ::GetTickCount() - dwStartTicks);
+
+	CriticalSectionLock	lock(s_wow64CritSec);
+
+	if (s_dwWow64LoadLibrary != dwWow64LoadLibrary)
+	{
+		// new address, needs to be confirmed again
+		s_dwWow64LoadLibrary		= dwWow64LoadLibrary;
+		s_dwWow64Kernel32Base		= 0;
+		s_dwWow64Kernel32TimeStamp	= 0;
+	}
+
+	return dwWow64LoadLibrary;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ConsoleHandler::ValidateWow64LoadLibrary(DWORD dwKernel32Base, DWORD dwKernel32TimeStamp)
+{
+	CriticalSectionLock	lock(s_wow64CritSec);
+
+	if (s_dwWow64LoadLibrary == 0) return;
+
+	if (s_dwWow64Kernel32Base == 0)
+	{
+		// first hook loaded with the resolved address, remember its kernel32
+		s_dwWow64Kernel32Base		= dwKernel32Base;
+		s_dwWow64Kernel32TimeStamp	= dwKernel32TimeStamp;
+	}
+	else if ((s_dwWow64Kernel32Base != dwKernel32Base) || (s_dwWow64Kernel32TimeStamp != dwKernel32TimeStamp))
+	{
+		// kernel32 changed under us, go back to ConsoleWow.exe
+		TRACE(L"32-bit kernel32 changed (0x%08X/%08X -> 0x%08X/%08X)\n", s_dwWow64Kernel32Base, s_dwWow64Kernel32TimeStamp, dwKernel32Base, dwKernel32TimeStamp);
+
+		s_dwWow64LoadLibrary		= 0;
+		s_dwWow64Kernel32Base		= 0;
+		s_dwWow64Kernel32TimeStamp	= 0;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ConsoleHandler::InvalidateWow64LoadLibrary(DWORD dwLoadLibrary)
+{
+	CriticalSectionLock	lock(s_wow64CritSec);
+
+	// another tab might have resolved a new address meanwhile
+	if (s_dwWow64LoadLibrary != dwLoadLibrary) return;
+
+	s_dwWow64LoadLibrary		= 0;
+	s_dwWow64Kernel32Base		= 0;
+	s_dwWow64Kernel32TimeStamp	= 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+#endif
+
+
 //////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
@@ -809,8 +1098,11 @@ DWORD WINAPI ConsoleHandler::MonitorThreadStatic(LPVOID lpParameter)
 
 DWORD ConsoleHandler::MonitorThread()
 {
+	TRACE_THREAD_NAME("ConsoleHandler::MonitorThread");
+
 	// resume ConsoleHook's thread
 	m_consoleParams.SetRespEvent();
+	TRACE_INSTANT("ConsoleHandler::ResumeHook");
 
 	HANDLE arrWaitHandles[] = { m_hConsoleProcess.get(), m_hMonitorThreadExit.get(), m_consoleBuffer.GetReqEvent() };
 	while (::WaitForMultipleObjects(sizeof(arrWaitHandles)/sizeof(arrWaitHandles[0]), arrWaitHandles, FALSE, INFINITE) > WAIT_OBJECT_0 + 1)
@@ -5,6 +5,8 @@
 #include "FastDelegate.h"
 #pragma warning(pop)
 
+#include "LogonCache.h"
+
 
 //////////////////////////////////////////////////////////////////////////////
 
@@ -41,6 +43,36 @@ struct UserCredentials
 //////////////////////////////////////////////////////////////////////////////
 
 
+//////////////////////////////////////////////////////////////////////////////
+
+// what a shell is started with besides its command line: a copy of the
+// console settings and the environment block, taken on the UI thread so
+// shells can be started on other threads (see ShellPool)
+
+struct ShellStartup
+{
+	ShellStartup()
+	: bStartHidden(false)
+	, dwNotificationTimeout(0)
+	, dwRefreshInterval(0)
+	, dwBufferRows(0)
+	, dwBufferColumns(0)
+	, environmentBlock()
+	{
+	}
+
+	bool					bStartHidden;
+	DWORD					dwNotificationTimeout;
+	DWORD					dwRefreshInterval;
+	DWORD					dwBufferRows;
+	DWORD					dwBufferColumns;
+
+	std::shared_ptr<void>	environmentBlock;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+
 //////////////////////////////////////////////////////////////////////////////
 
 class ConsoleHandler
@@ -62,9 +94,13 @@ class ConsoleHandler
 			const wstring& strInitialCmd,
 			const wstring& strConsoleTitle,
 			DWORD dwStartupRows,
-			DWORD dwStartupColumns
+			DWORD dwStartupColumns,
+			const ShellStartup& shellStartup
 		);
 
+		// takes over a console started by another handler (see ShellPool)
+		void AdoptShellProcess(ConsoleHandler& other);
+
 		DWORD StartMonitorThread();
 		void StopMonitorThread();
 
@@ -77,7 +113,7 @@ class ConsoleHandler
 		SharedMemory<ConsoleCopy>& GetCopyInfo()					{ return m_consoleCopyInfo; }
 		SharedMemory<TextInfo>& GetTextInfo()						{ return m_consoleTextInfo; }
 		SharedMemory<ConsoleSize>& GetNewConsoleSize()				{ return m_newConsoleSize; }
-		SharedMemory<SIZE>& GetNewScrollPos()						{ return m_newScrollPos; }
+		SharedMemory<ConsoleScroll>& GetNewScrollPos()				{ return m_newScrollPos; }
 
 		void SendMouseEvent(const COORD& mousePos, DWORD dwMouseButtonState, DWORD dwControlKeyState, DWORD dwEventFlags);
 
@@ -85,15 +121,41 @@ class ConsoleHandler
 		void ResumeScrolling();
 
 		static void UpdateEnvironmentBlock();
+		// must be called on the UI thread, settings aren't locked
+		static ShellStartup GetShellStartup();
+		// closes cached logon tokens and wipes user environments
+		static void ClearLogonCache();
+		static void CreateWatchdog();
 
     inline DWORD GetConsolePid(void) const { return m_dwConsolePid; }
 
 	private:
 
+		// with bWow64Retry, a hook handshake that fails with the cached
+		// 32-bit LoadLibraryW address is retried once with a fresh one
+		bool StartShellProcess
+		(
+			const wstring& strCustomShell,
+			const wstring& strInitialDir,
+			const UserCredentials& userCredentials,
+			const wstring& strInitialCmd,
+			const wstring& strConsoleTitle,
+			DWORD dwStartupRows,
+			DWORD dwStartupColumns,
+			const ShellStartup& shellStartup,
+			bool bWow64Retry
+		);
+
 		bool CreateSharedObjects(DWORD dwConsoleProcessId, const wstring& strUser);
-		void CreateWatchdog();
 
-		bool InjectHookDLL(PROCESS_INFORMATION& pi);
+		bool InjectHookDLL(PROCESS_INFORMATION& pi, bool bUseWow64Cache);
+
+#ifdef _WIN64
+		static DWORD GetWow64LoadLibrary(bool bUseCache, bool& bCached);
+		static void ValidateWow64LoadLibrary(DWORD dwKernel32Base, DWORD dwKernel32TimeStamp);
+		// drops the cached address if it's still dwLoadLibrary
+		static void InvalidateWow64LoadLibrary(DWORD dwLoadLibrary);
+#endif
 
 	private:
 
@@ -119,19 +181,39 @@ class ConsoleHandler
     SharedMemory<CHAR_INFO>           m_consoleBuffer;
     SharedMemory<ConsoleCopy>         m_consoleCopyInfo;
     SharedMemory<TextInfo>            m_consoleTextInfo;
-    SharedMemory<MOUSE_EVENT_RECORD>  m_consoleMouseEvent;
+    SharedMemory<MouseEventQueue>     m_consoleMouseEvent;
 
     SharedMemory<ConsoleSize>         m_newConsoleSize;
-    SharedMemory<SIZE>                m_newScrollPos;
+    SharedMemory<ConsoleScroll>       m_newScrollPos;
 
     std::shared_ptr<void>             m_hMonitorThread;
     std::shared_ptr<void>             m_hMonitorThreadExit;
 
+    // replaced on the UI thread, read by GetShellStartup; the watchdog is
+    // created and checked under the same lock
+    static CriticalSection            s_environmentCritSec;
     static std::shared_ptr<void>      s_environmentBlock;
     static std::shared_ptr<Mutex>     s_parentProcessWatchdog;
+    static std::shared_ptr<LogonCache> s_logonCache;
+
+#ifdef _WIN64
+    // 32-bit LoadLibraryW address is the same for all WOW64 processes
+    // until reboot, resolve it once through ConsoleWow.exe
+    static CriticalSection            s_wow64CritSec;
+    static DWORD                      s_dwWow64LoadLibrary;
+    static DWORD                      s_dwWow64Kernel32Base;
+    static DWORD                      s_dwWow64Kernel32TimeStamp;
+#endif
 
     DWORD                             m_dwConsolePid;
 
+#ifdef _WIN64
+    // the 32-bit LoadLibraryW address the hook was injected with, 0 for
+    // 64-bit shells
+    DWORD                             m_dwWow64LoadLibrary;
+    bool                              m_bWow64LoadLibraryCached;
+#endif
+
 };
 
 //////////////////////////////////////////////////////////////////////////////
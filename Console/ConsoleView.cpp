@@ -7,6 +7,8 @@
 #include "ConsoleException.h"
 #include "ConsoleView.h"
 #include "MainFrame.h"
+#include "PixelKernels.h"
+#include "ShellPool.h"
 
 //////////////////////////////////////////////////////////////////////////////
 
@@ -21,8 +23,15 @@
 //CBitmap	ConsoleView::m_bmpOffscreen;
 //CBitmap	ConsoleView::m_bmpText;
 
-CFont ConsoleView::m_fontText;
-CFont ConsoleView::m_fontTextHigh;
+CFontHandle ConsoleView::m_fontText;
+CFontHandle ConsoleView::m_fontTextHigh;
+FontCache ConsoleView::m_fontCache(&ConsoleView::CreateCachedFont, FontCache::MAX_FONTS);
+std::shared_ptr<FontCache::Font> ConsoleView::m_cachedFontText;
+std::shared_ptr<FontCache::Font> ConsoleView::m_cachedFontTextHigh;
+FontFallback ConsoleView::m_fallbackText;
+FontFallback ConsoleView::m_fallbackTextHigh;
+FontFallback::Runs ConsoleView::m_fallbackRuns;
+vector<unsigned short> ConsoleView::m_fallbackGlyphs;
 DWORD ConsoleView::m_dwFontSize(0);
 DWORD ConsoleView::m_dwFontZoom(100); // 100 %
 
@@ -33,10 +42,53 @@ int ConsoleView::m_nHScrollWidth(0);
 int ConsoleView::m_nVInsideBorder(0);
 int ConsoleView::m_nHInsideBorder(0);
 
+bool ConsoleView::m_bShowLatency(false);
+
+std::unique_ptr<BandRenderer>	ConsoleView::m_bandRenderer;
+GlyphAtlas						ConsoleView::m_glyphAtlas;
+vector<BandRenderer::Cell>		ConsoleView::m_bandCells;
+TextBatch						ConsoleView::m_textBatch;
+
 bool _boolMenuSysKeyCancelled = false;
 
 //////////////////////////////////////////////////////////////////////////////
 
+
+//////////////////////////////////////////////////////////////////////////////
+
+// text batch runs' font: the index in the fallback list, with this bit set
+// for the intensified font's list
+const DWORD BATCH_FONT_HIGH = 0x100;
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// screen buffer characters, for PredictiveEcho::OnScreen
+class ScreenChars
+{
+	public:
+
+		ScreenChars(const CharInfo* pScreenBuffer, DWORD dwColumns)
+		: m_pScreenBuffer(pScreenBuffer)
+		, m_dwColumns(dwColumns)
+		{
+		}
+
+		wchar_t operator()(int nX, int nY) const
+		{
+			return m_pScreenBuffer[nY*m_dwColumns + nX].charInfo.Char.UnicodeChar;
+		}
+
+	private:
+
+		const CharInfo*	m_pScreenBuffer;
+		DWORD			m_dwColumns;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
 ConsoleView::ConsoleView(MainFrame& mainFrame, HWND hwndTabView, std::shared_ptr<TabData> tabData, const CString& strTitle, DWORD dwRows, DWORD dwColumns, const wstring& strCmdLineInitialDir /*= wstring(L"")*/, const wstring& strCmdLineInitialCmd /*= wstring(L"")*/)
 : m_mainFrame(mainFrame)
 , m_hwndTabView(hwndTabView)
@@ -44,6 +96,7 @@ ConsoleView::ConsoleView(MainFrame& mainFrame, HWND hwndTabView, std::shared_ptr
 , m_bResizing(false)
 , m_bAppActive(true)
 , m_bActive(true)
+, m_bHibernated(false)
 , m_bNeedFullRepaint(true) // first OnPaint will do a full repaint
 , m_bUseTextAlphaBlend(false)
 , m_bConsoleWindowVisible(false)
@@ -56,6 +109,8 @@ ConsoleView::ConsoleView(MainFrame& mainFrame, HWND hwndTabView, std::shared_ptr
 , m_strTitle(strTitle)
 , m_strUser()
 , m_boolNetOnly(false)
+, m_strConsoleTitle()
+, m_dwTitleSeq(0)
 , m_consoleHandler()
 , m_screenBuffer()
 , m_dwScreenRows(0)
@@ -71,8 +126,23 @@ ConsoleView::ConsoleView(MainFrame& mainFrame, HWND hwndTabView, std::shared_ptr
 , m_mouseCommand(MouseSettings::cmdNone)
 , m_bFlashTimerRunning(false)
 , m_dwFlashes(0)
-, m_dcOffscreen(::CreateCompatibleDC(NULL))
-, m_dcText(::CreateCompatibleDC(NULL))
+, m_pendingSize()
+, m_resizeThrottle()
+, m_latencyStats()
+, m_rectLatencyOverlay(0, 0, 0, 0)
+, m_predictiveEcho()
+, m_bPredictionTimerRunning(false)
+, m_rectPredictions(0, 0, 0, 0)
+, m_floodDetector()
+, m_bFloodFramePending(false)
+, m_dwFloodFramesSkipped(0)
+, m_batchStatsUnsorted()
+, m_batchStatsSorted()
+, m_bCatchUpPending(false)
+, m_dcOffscreen()
+, m_dcText()
+, m_surfaceOffscreen()
+, m_surfaceText()
 , m_boolIsGrouped(false)
 , m_strCmdLineInitialDir(strCmdLineInitialDir)
 , m_strCmdLineInitialCmd(strCmdLineInitialCmd)
@@ -81,6 +151,7 @@ ConsoleView::ConsoleView(MainFrame& mainFrame, HWND hwndTabView, std::shared_ptr
 
 ConsoleView::~ConsoleView()
 {
+	ReleaseOffscreenSurfaces();
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -164,14 +235,26 @@ LRESULT ConsoleView::OnCreate(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM lParam, B
 		CREATESTRUCT* createStruct = reinterpret_cast<CREATESTRUCT*>(lParam);
 		UserCredentials* userCredentials = reinterpret_cast<UserCredentials*>(createStruct->lpCreateParams);
 
-		m_consoleHandler.StartShellProcess(
-									strShell,
-									strInitialDir,
-									*userCredentials,
-									m_strCmdLineInitialCmd,
-									g_settingsHandler->GetAppearanceSettings().windowSettings.bUseConsoleTitle ? m_tabData->strTitle : wstring(L""),
-									m_dwStartupRows,
-									m_dwStartupColumns);
+		// take a pre-spawned console if there's one for this tab
+		bool bAdopted =
+			g_shellPool &&
+			(userCredentials->user.length() == 0) &&
+			(m_strCmdLineInitialDir.length() == 0) &&
+			(m_strCmdLineInitialCmd.length() == 0) &&
+			g_shellPool->Adopt(m_tabData, m_consoleHandler, m_dwStartupRows, m_dwStartupColumns);
+
+		if (!bAdopted)
+		{
+			m_consoleHandler.StartShellProcess(
+										strShell,
+										strInitialDir,
+										*userCredentials,
+										m_strCmdLineInitialCmd,
+										g_settingsHandler->GetAppearanceSettings().windowSettings.bUseConsoleTitle ? m_tabData->strTitle : wstring(L""),
+										m_dwStartupRows,
+										m_dwStartupColumns,
+										ConsoleHandler::GetShellStartup());
+		}
 
 		m_strUser = userCredentials->user.c_str();
 		m_boolNetOnly = userCredentials->netOnly;
@@ -223,6 +306,10 @@ LRESULT ConsoleView::OnCreate(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM lParam, B
 LRESULT ConsoleView::OnClose(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/)
 {
 	if (m_bFlashTimerRunning) KillTimer(FLASH_TAB_TIMER);
+	if (m_resizeThrottle.IsTicking()) KillTimer(RESIZE_TIMER);
+	if (m_bPredictionTimerRunning) KillTimer(PREDICTION_TIMER);
+	if (m_floodDetector.IsFlooded()) KillTimer(FLOOD_TIMER);
+	KillTimer(HIBERNATE_TIMER);
 	return 0;
 }
 
@@ -274,6 +361,13 @@ LRESULT ConsoleView::OnPaint(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/
 		dc.m_ps.rcPaint.top, 
 		SRCCOPY);
 
+	DrawPredictions(dc);
+
+	if (m_bShowLatency) DrawLatencyOverlay(dc);
+
+	// a new sample changes the overlay text
+	if (m_latencyStats.OnPainted() && m_bShowLatency) InvalidateRect(&m_rectLatencyOverlay, FALSE);
+
 	return 0;
 }
 
@@ -356,9 +450,15 @@ LRESULT ConsoleView::OnConsoleFwdMsg(UINT uMsg, WPARAM wParam, LPARAM lParam, BO
 	{
     //TRACE(L"Msg: 0x%04X, wParam: 0x%08X, lParam: 0x%08X\n", uMsg, wParam, lParam);
     if( this->IsGrouped() )
+    {
       m_mainFrame.PostMessageToConsoles(uMsg, wParam, lParam);
+    }
     else
+    {
+      if (uMsg == WM_KEYDOWN) m_latencyStats.OnInput(::InterlockedIncrement(&m_consoleHandler.GetConsoleInfo()->lInputSeq));
+      if ((uMsg == WM_KEYDOWN) || (uMsg == WM_SYSKEYDOWN)) PredictKey(uMsg, wParam);
       ::PostMessage(m_consoleHandler.GetConsoleParams()->hwndConsoleWindow, uMsg, wParam, lParam);
+    }
 	}
 
 	return 0;
@@ -409,7 +509,7 @@ LRESULT ConsoleView::OnMouseWheel(UINT /*uMsg*/, WPARAM wParam, LPARAM /*lParam*
           uScrollAmount = 3;
         nScrollDelta *= static_cast<int>(uScrollAmount);
       }
-      DoScroll(SB_VERT, SB_THUMBPOSITION, ::FlatSB_GetScrollPos(m_hWnd, SB_VERT) - nScrollDelta);
+      RequestScroll(SB_VERT, false, -nScrollDelta);
     }
   }
 
@@ -787,7 +887,57 @@ LRESULT ConsoleView::OnTimer(UINT /*uMsg*/, WPARAM wParam, LPARAM /*lParam*/, BO
 		return 0;
 	}
 
-	if (!m_bActive) return 0;
+	if (wParam == HIBERNATE_TIMER)
+	{
+		KillTimer(HIBERNATE_TIMER);
+		if (!m_bActive) Hibernate();
+		return 0;
+	}
+
+	if (wParam == RESIZE_TIMER)
+	{
+		if (m_resizeThrottle.OnTick(m_bActive))
+		{
+			SendPendingResize();
+		}
+		else
+		{
+			KillTimer(RESIZE_TIMER);
+		}
+
+		return 0;
+	}
+
+	if (wParam == FLOOD_TIMER)
+	{
+		// output may have stopped, there's no update to tell
+		UpdateFlood(0);
+
+		if (m_bActive && m_bFloodFramePending && m_mainFrame.IsRendering() && m_floodDetector.IsFrameDue(::GetTickCount()))
+		{
+			Repaint(false);
+			m_floodDetector.OnFrame(::GetTickCount());
+			m_bFloodFramePending = false;
+		}
+
+		return 0;
+	}
+
+	if (wParam == PREDICTION_TIMER)
+	{
+		if (m_predictiveEcho.Expire(::GetTickCount())) InvalidatePredictions();
+
+		if (!m_predictiveEcho.HasPredictions())
+		{
+			KillTimer(PREDICTION_TIMER);
+			m_bPredictionTimerRunning = false;
+		}
+
+		return 0;
+	}
+
+	// no cursor animation while nothing is seen
+	if (!m_bActive || !m_mainFrame.IsRendering()) return 0;
 
 	if ((wParam == CURSOR_TIMER) && (m_cursor.get() != NULL))
 	{
@@ -866,12 +1016,13 @@ LRESULT ConsoleView::OnDropFiles(UINT /*uMsg*/, WPARAM wParam, LPARAM /*lParam*/
 
 //////////////////////////////////////////////////////////////////////////////
 
-LRESULT ConsoleView::OnUpdateConsoleView(UINT /*uMsg*/, WPARAM wParam, LPARAM /*lParam*/, BOOL& /*bHandled*/)
+LRESULT ConsoleView::OnUpdateConsoleView(UINT /*uMsg*/, WPARAM wParam, LPARAM lParam, BOOL& /*bHandled*/)
 {
 	if (m_bInitializing) return false;
 
 	bool bResize	= ((wParam & UPDATE_CONSOLE_RESIZE) > 0);
 	bool textChanged= ((wParam & UPDATE_CONSOLE_TEXT_CHANGED) > 0);
+	bool titleChanged= ((wParam & UPDATE_CONSOLE_TITLE_CHANGED) > 0);
 
 	// console size changed, resize offscreen buffers
 	if (bResize)
@@ -886,7 +1037,10 @@ LRESULT ConsoleView::OnUpdateConsoleView(UINT /*uMsg*/, WPARAM wParam, LPARAM /*
 		m_mainFrame.SendMessage(UM_CONSOLE_RESIZED, 0, 0);
 	}
 
-	UpdateTitle();
+	if (titleChanged) UpdateTitle();
+
+	// resizes change most cells, they aren't output
+	if (textChanged && !bResize) UpdateFlood(static_cast<DWORD>(lParam));
 	
 	// if the view is not visible, don't repaint
 	if (!m_bActive)
@@ -903,10 +1057,22 @@ LRESULT ConsoleView::OnUpdateConsoleView(UINT /*uMsg*/, WPARAM wParam, LPARAM /*
 			m_bFlashTimerRunning = true;
 			SetTimer(FLASH_TAB_TIMER, 500);
 		}
-		
+
+		m_latencyStats.Discard();
+		return 0;
+	}
+
+	// minimized, hidden, covered or the display is off; changed cells stay
+	// marked until the catch-up
+	if (!m_mainFrame.IsRendering())
+	{
+		m_bCatchUpPending = true;
+		m_latencyStats.Discard();
 		return 0;
 	}
 
+	m_latencyStats.OnViewUpdated();
+
 	SharedMemory<ConsoleInfo>& consoleInfo = m_consoleHandler.GetConsoleInfo();
 
 	m_dwVScrollMax = max(m_dwVScrollMax, static_cast<DWORD>(consoleInfo->csbi.srWindow.Bottom));
@@ -951,7 +1117,20 @@ LRESULT ConsoleView::OnUpdateConsoleView(UINT /*uMsg*/, WPARAM wParam, LPARAM /*
 		m_selectionHandler->UpdateSelection();
 	}
 
+	if (m_consoleSettings.localEcho != localEchoOff) UpdatePredictions();
+
+	// flooded views paint the latest state once per frame, on a later update
+	// or on the FLOOD_TIMER tick
+	if (!m_floodDetector.IsFrameDue(::GetTickCount()))
+	{
+		m_bFloodFramePending = true;
+		++m_dwFloodFramesSkipped;
+		return 0;
+	}
+
 	Repaint(false);
+	m_floodDetector.OnFrame(::GetTickCount());
+	m_bFloodFramePending = false;
 
 	return 0;
 }
@@ -1052,20 +1231,13 @@ void ConsoleView::AdjustRectAndResize(ADJUSTSIZE as, CRect& clientRect, DWORD dw
   if (m_bShowVScroll) clientRect.right  += m_nVScrollWidth;
   if (m_bShowHScroll) clientRect.bottom += m_nHScrollWidth;
 
-  SharedMemory<ConsoleSize>& newConsoleSize = m_consoleHandler.GetNewConsoleSize();
-  SharedMemoryLock memLock(newConsoleSize);
-
-  newConsoleSize->dwColumns          = dwColumns;
-  newConsoleSize->dwRows             = dwRows;
-  newConsoleSize->dwResizeWindowEdge = dwResizeWindowEdge;
-
   //TRACE(L"console view: 0x%08X, adjusted: %ix%i\n", m_hWnd, dwRows, dwColumns);
   //TRACE(L"================================================================\n");
 
   RecreateOffscreenBuffers(as);
   Repaint(true);
 
-  m_consoleHandler.GetNewConsoleSize().SetReqEvent();
+  RequestResize(dwColumns, dwRows, dwResizeWindowEdge);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -1095,6 +1267,7 @@ void ConsoleView::SetConsoleWindowVisible(bool bVisible)
 void ConsoleView::SetAppActiveStatus(bool bAppActive)
 {
 	m_bAppActive = bAppActive;
+	if (m_bHibernated) return;
 	if (m_cursor.get() != NULL) m_cursor->Draw(m_bAppActive);
 	BitBltOffscreen();
 }
@@ -1122,8 +1295,10 @@ bool ConsoleView::RecreateFont(DWORD dwNewFontSize, bool boolZooming)
 	m_dwFontSize = size;
 	m_dwFontZoom = zoom;
 
-	if (!m_fontText.IsNull()) m_fontText.DeleteObject();
-	if (!m_fontTextHigh.IsNull()) m_fontTextHigh.DeleteObject();
+	// the fonts stay in the cache
+	m_fontText		= static_cast<HFONT>(NULL);
+	m_fontTextHigh	= static_cast<HFONT>(NULL);
+	m_glyphAtlas.Clear();
 	if (!CreateFont(g_settingsHandler->GetAppearanceSettings().fontSettings.strName))
 	{
 		CreateFont(wstring(L"Courier New"));
@@ -1132,14 +1307,13 @@ bool ConsoleView::RecreateFont(DWORD dwNewFontSize, bool boolZooming)
 	return true;
 }
 
-void ConsoleView::RecreateOffscreenBuffers(ADJUSTSIZE as)
+void ConsoleView::RecreateOffscreenBuffers(ADJUSTSIZE /*as*/)
 {
+  // Wake creates them for the current size
+  if (m_bHibernated) return;
+
   if (!m_backgroundBrush.IsNull())m_backgroundBrush.DeleteObject();
-  if( as == ADJUSTSIZE_WINDOW )
-  {
-    if (!m_bmpOffscreen.IsNull())	m_bmpOffscreen.DeleteObject();
-    if (!m_bmpText.IsNull())		m_bmpText.DeleteObject();
-  }
+  // surfaces grow as needed, they're shrunk in SetResizing once it's done
   CreateOffscreenBuffers();
   m_bNeedFullRepaint = true;
 }
@@ -1152,6 +1326,8 @@ void ConsoleView::RecreateOffscreenBuffers(ADJUSTSIZE as)
 void ConsoleView::Repaint(bool bFullRepaint)
 {
   //TRACE(L"ConsoleView::Repaint\n");
+	if (!m_surfaceText) return;
+
 	// OnPaint will do the work for a full repaint
 	if (!m_bNeedFullRepaint)
 	{
@@ -1191,6 +1367,14 @@ void ConsoleView::MainframeMoving()
 void ConsoleView::SetResizing(bool bResizing)
 {
 	m_bResizing = bResizing;
+
+	if (m_bResizing || !m_surfaceOffscreen) return;
+
+	// done resizing, give back what the surfaces grew too much
+	CRect rectView;
+	GetRect(rectView);
+
+	if (AcquireOffscreenSurfaces(rectView, true)) Repaint(true);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -1201,7 +1385,45 @@ void ConsoleView::SetResizing(bool bResizing)
 void ConsoleView::SetActive(bool bActive)
 {
 	m_bActive = bActive;
-	if (!m_bActive) return;
+
+	if (!m_bActive)
+	{
+		ReleaseOffscreenSurfaces();
+
+		// the console goes on without us, predictions are made again from
+		// the next update we see
+		m_predictiveEcho.Reset();
+		m_rectPredictions.SetRectEmpty();
+		if (m_bPredictionTimerRunning)
+		{
+			KillTimer(PREDICTION_TIMER);
+			m_bPredictionTimerRunning = false;
+		}
+
+		DWORD dwHibernateTime = g_settingsHandler->GetTabSettings().dwHibernateTime;
+
+		if ((dwHibernateTime > 0) && !m_bHibernated) SetTimer(HIBERNATE_TIMER, dwHibernateTime * 1000);
+		return;
+	}
+
+	KillTimer(HIBERNATE_TIMER);
+
+	if (m_bHibernated)
+	{
+		Wake();
+	}
+	else
+	{
+		CRect rectView;
+		GetRect(rectView);
+		AcquireOffscreenSurfaces(rectView, false);
+	}
+
+	// decode our background before the other tabs'
+	if (m_background) g_imageHandler->SetVisibleImage(m_background);
+
+	// the console is resized only now if the window was while we were hidden
+	if (m_resizeThrottle.OnShow()) SendPendingResize();
 
 	Repaint(true);
 	UpdateTitle();
@@ -1235,12 +1457,22 @@ void ConsoleView::SetTitle(const CString& strTitle)
 
 /////////////////////////////////////////////////////////////////////////////
 
-CString ConsoleView::GetConsoleCommand()
+void ConsoleView::ApplyTitleSettings()
 {
-	CWindow consoleWnd(m_consoleHandler.GetConsoleParams()->hwndConsoleWindow);
-	CString strConsoleTitle(L"");
+	if (g_settingsHandler->GetAppearanceSettings().windowSettings.bUseConsoleTitle)
+	{
+		SetTitle(m_strConsoleTitle);
+	}
+}
 
-	consoleWnd.GetWindowText(strConsoleTitle);
+/////////////////////////////////////////////////////////////////////////////
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+CString ConsoleView::GetConsoleCommand()
+{
+	const CString& strConsoleTitle = m_strConsoleTitle;
 
 	int nPos = strConsoleTitle.Find(L"Console2 command window");
 
@@ -1369,6 +1601,8 @@ void ConsoleView::DumpBuffer()
 	DWORD       dwOffset = 0;
 	MutexLock	bufferLock(m_consoleHandler.m_bufferMutex);
 
+	if (m_bHibernated) return;
+
 	for (DWORD i = 0; i < m_dwScreenRows; ++i)
 	{
 		for (DWORD j = 0; j < m_dwScreenColumns; ++j)
@@ -1386,6 +1620,70 @@ void ConsoleView::DumpBuffer()
 //////////////////////////////////////////////////////////////////////////////
 
 
+//////////////////////////////////////////////////////////////////////////////
+
+void ConsoleView::DumpLatency(wostream& os)
+{
+	os << static_cast<const wchar_t*>(m_strTitle) << L" (pid " << m_consoleHandler.GetConsolePid() << L")" << endl;
+	m_latencyStats.Dump(os);
+	os << endl;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ConsoleView::DumpResources(wostream& os)
+{
+	DWORD dwSurfaceBytes	= 0;
+	DWORD dwBufferBytes		= 0;
+
+	if (m_surfaceOffscreen) dwSurfaceBytes += m_surfaceOffscreen->GetWidth() * m_surfaceOffscreen->GetHeight() * 4;
+	if (m_surfaceText) dwSurfaceBytes += m_surfaceText->GetWidth() * m_surfaceText->GetHeight() * 4;
+
+	{
+		MutexLock bufferLock(m_consoleHandler.m_bufferMutex);
+		if (m_screenBuffer) dwBufferBytes = m_dwScreenRows * m_dwScreenColumns * sizeof(CharInfo);
+	}
+
+	// surfaces are a DC and a bitmap; cursors hold a DC, a bitmap and two
+	// brushes, so does the selection handler without Aero
+	DWORD dwGdiObjects = 0;
+
+	if (m_surfaceOffscreen)				dwGdiObjects += 2;
+	if (m_surfaceText)					dwGdiObjects += 2;
+	if (!m_backgroundBrush.IsNull())	++dwGdiObjects;
+	if (m_cursor)						dwGdiObjects += 4;
+#ifndef _USE_AERO
+	if (m_selectionHandler)				dwGdiObjects += 4;
+#endif //_USE_AERO
+
+	os << static_cast<const wchar_t*>(m_strTitle) << L" (pid " << m_consoleHandler.GetConsolePid() << L")" << endl;
+	os << L"  state:         " << (m_bHibernated ? L"hibernated" : (m_bActive ? L"active" : L"background")) << endl;
+	os << L"  surfaces:      " << dwSurfaceBytes / 1024 << L" KB" << endl;
+	os << L"  screen buffer: " << dwBufferBytes / 1024 << L" KB" << endl;
+	os << L"  GDI objects:   " << dwGdiObjects << endl;
+	os << L"  resizes:       " << m_resizeThrottle.GetRequests() << L" requested, " << m_resizeThrottle.GetSent() << L" sent to the console" << endl;
+	os << L"  flood mode:    " << (m_floodDetector.IsFlooded() ? L"on" : L"off") << L", entered " << m_floodDetector.GetFloods() << L" times, " << m_dwFloodFramesSkipped << L" frames skipped" << endl;
+	os << L"  text renderer: ";
+	if (m_bandRenderer)
+	{
+		os << m_bandRenderer->GetRunningThreads() << L" of " << m_bandRenderer->GetThreads() << L" threads running (all views), " << m_bandRenderer->GetFrames() << L" frames in " << m_bandRenderer->GetBands() << L" bands, " << m_glyphAtlas.GetGlyphCount() << L" glyphs in " << m_glyphAtlas.GetBytes() / 1024 << L" KB" << endl;
+	}
+	else
+	{
+		os << L"GDI" << endl;
+	}
+	os << L"  text batch:    " << m_batchStatsSorted.stFills << L" fills, " << m_batchStatsSorted.stRuns << L" runs last frame, " << m_batchStatsUnsorted.stFontChanges << L"/" << m_batchStatsUnsorted.stColorChanges << L"/" << m_batchStatsUnsorted.stBrushChanges << L" font/color/brush changes in row order, " << m_batchStatsSorted.stFontChanges << L"/" << m_batchStatsSorted.stColorChanges << L"/" << m_batchStatsSorted.stBrushChanges << L" sorted" << endl;
+	os << L"  fonts:         " << m_fallbackText.GetFontCount() << L" in fallback order, " << m_fontCache.GetSize() << L" cached (all views), " << m_fontCache.GetHits() << L" hits, " << m_fontCache.GetMisses() << L" misses, " << m_fontCache.GetEvictions() << L" dropped" << endl;
+	os << L"  local echo:    " << m_predictiveEcho.GetConfirmed() << L" confirmed, " << m_predictiveEcho.GetMispredicted() << L" mispredicted, " << m_predictiveEcho.GetExpired() << L" expired, echo latency " << m_predictiveEcho.GetLatency() << L" ms" << endl;
+	os << endl;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
 //////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
@@ -1395,6 +1693,8 @@ void ConsoleView::DumpBuffer()
 
 void ConsoleView::OnConsoleChange(bool bResize)
 {
+	TRACE_SCOPE("ConsoleView::OnConsoleChange");
+
 	SharedMemory<ConsoleParams>&	consoleParams	= m_consoleHandler.GetConsoleParams();
 	SharedMemory<ConsoleInfo>&	consoleInfo = m_consoleHandler.GetConsoleInfo();
 	SharedMemory<CHAR_INFO>&	consoleBuffer = m_consoleHandler.GetConsoleBuffer();
@@ -1408,14 +1708,22 @@ void ConsoleView::OnConsoleChange(bool bResize)
 	{
 		m_dwScreenRows    = consoleParams->dwRows;
 		m_dwScreenColumns = consoleParams->dwColumns;
-		m_screenBuffer.reset(new CharInfo[m_dwScreenRows * m_dwScreenColumns]);
+		if (!m_bHibernated) m_screenBuffer.reset(new CharInfo[m_dwScreenRows * m_dwScreenColumns]);
 	}
-	DWORD dwBufferSize = m_dwScreenRows * m_dwScreenColumns;
 
-	// copy changed data
-	for (DWORD dwOffset = 0; dwOffset < dwBufferSize; ++dwOffset)
+	// cells changed, for flood detection
+	DWORD dwChangedCells = 0;
+
+	// hibernated views copy the shared buffer when they wake up
+	if (!m_bHibernated)
 	{
-		m_screenBuffer[dwOffset].copy(consoleBuffer.Get() + dwOffset);
+		DWORD dwBufferSize = m_dwScreenRows * m_dwScreenColumns;
+
+		// copy changed data
+		for (DWORD dwOffset = 0; dwOffset < dwBufferSize; ++dwOffset)
+		{
+			if (m_screenBuffer[dwOffset].copy(consoleBuffer.Get() + dwOffset)) ++dwChangedCells;
+		}
 	}
 
 	WPARAM wParam = 0;
@@ -1428,7 +1736,15 @@ void ConsoleView::OnConsoleChange(bool bResize)
 		consoleInfo->textChanged = false;
 	}
 
-	PostMessage(UM_UPDATE_CONSOLE_VIEW, wParam);
+	if (consoleInfo->dwTitleSeq != m_dwTitleSeq)
+	{
+		wParam |= UPDATE_CONSOLE_TITLE_CHANGED;
+		m_dwTitleSeq = consoleInfo->dwTitleSeq;
+	}
+
+	m_latencyStats.OnBufferChanged(consoleInfo->lReadSeq, consoleInfo->llWakeTime, consoleInfo->llReadTime);
+
+	PostMessage(UM_UPDATE_CONSOLE_VIEW, wParam, dwChangedCells);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -1482,20 +1798,18 @@ void ConsoleView::CreateOffscreenBuffers()
 	// get window rect based on font and console size
 	GetRect(rectWindowMax);
 
-	// create offscreen bitmaps if needed
-	if (m_bmpOffscreen.IsNull()) CreateOffscreenBitmap(m_dcOffscreen, rectWindowMax, m_bmpOffscreen);
-	if (m_bmpText.IsNull()) CreateOffscreenBitmap(m_dcText, rectWindowMax, m_bmpText);
-	m_dcText.SelectFont(m_fontText);
+	// take offscreen surfaces, inactive views don't hold any
+	if (m_bActive) AcquireOffscreenSurfaces(rectWindowMax, false);
 
 	// create background brush
 	m_backgroundBrush.CreateSolidBrush(m_tabData->crBackgroundColor);
 
-	// initial offscreen paint
-	m_dcOffscreen.FillRect(&rectWindowMax, m_backgroundBrush);
-
-	// set text DC stuff
-	m_dcText.SetBkMode(OPAQUE);
-	m_dcText.FillRect(&rectWindowMax, m_backgroundBrush);
+	if (m_surfaceOffscreen)
+	{
+		// initial offscreen paint
+		m_dcOffscreen.FillRect(&rectWindowMax, m_backgroundBrush);
+		m_dcText.FillRect(&rectWindowMax, m_backgroundBrush);
+	}
 
 	// create selection handler
 	m_selectionHandler.reset(new SelectionHandler(
@@ -1533,12 +1847,122 @@ void ConsoleView::CreateOffscreenBuffers()
 
 //////////////////////////////////////////////////////////////////////////////
 
-void ConsoleView::CreateOffscreenBitmap(CDC& cdc, const CRect& rect, CBitmap& bitmap)
+bool ConsoleView::AcquireOffscreenSurfaces(const CRect& rect, bool bShrink)
+{
+	bool bOffscreen	= AcquireOffscreenSurface(rect, bShrink, m_surfaceOffscreen, m_dcOffscreen);
+	bool bText		= AcquireOffscreenSurface(rect, bShrink, m_surfaceText, m_dcText);
+
+	// set text DC stuff
+	m_dcText.SelectFont(m_fontText);
+	m_dcText.SetBkMode(OPAQUE);
+
+	if (!bOffscreen && !bText) return false;
+
+	// clear what the previous owner left
+	if (!m_backgroundBrush.IsNull())
+	{
+		m_dcOffscreen.FillRect(&rect, m_backgroundBrush);
+		m_dcText.FillRect(&rect, m_backgroundBrush);
+	}
+
+	m_bNeedFullRepaint = true;
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool ConsoleView::AcquireOffscreenSurface(const CRect& rect, bool bShrink, std::shared_ptr<OffscreenSurface>& surface, CDC& dc)
+{
+	if (!m_mainFrame.GetSurfacePool().Resize(surface, rect.Width(), rect.Height(), bShrink)) return false;
+
+	// the handle we had went with the old surface
+	dc.Detach();
+	dc.Attach(surface->GetDC());
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ConsoleView::ReleaseOffscreenSurfaces()
+{
+	OffscreenSurfacePool& surfacePool = m_mainFrame.GetSurfacePool();
+
+	// DCs belong to the surfaces
+	m_dcOffscreen.Detach();
+	m_dcText.Detach();
+
+	surfacePool.Release(m_surfaceOffscreen);
+	surfacePool.Release(m_surfaceText);
+
+	m_bNeedFullRepaint = true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ConsoleView::Hibernate()
+{
+	if (m_bActive || m_bHibernated) return;
+
+	TRACE(L"Hibernating view 0x%08X\n", m_hWnd);
+
+	// surfaces went back to the pool when the view was deactivated, the
+	// cursor timer goes with the cursor
+	m_cursor.reset();
+	m_selectionHandler.reset();
+	m_backgroundBrush.DeleteObject();
+
+	MutexLock bufferLock(m_consoleHandler.m_bufferMutex);
+
+	m_screenBuffer.reset();
+	m_bHibernated = true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ConsoleView::Wake()
 {
-	if (!bitmap.IsNull()) return;// bitmap.DeleteObject();
+	if (!m_bHibernated) return;
+
+	TRACE(L"Waking view 0x%08X\n", m_hWnd);
+
+	CreateOffscreenBuffers();
+
+	{
+		// same lock order as OnConsoleChange
+		SharedMemory<ConsoleInfo>&	consoleInfo		= m_consoleHandler.GetConsoleInfo();
+		SharedMemory<CHAR_INFO>&	consoleBuffer	= m_consoleHandler.GetConsoleBuffer();
+
+		SharedMemoryLock	consoleInfoLock(consoleInfo);
+		SharedMemoryLock	sharedBufferLock(consoleBuffer);
+		MutexLock			localBufferLock(m_consoleHandler.m_bufferMutex);
+
+		DWORD dwBufferSize = m_dwScreenRows * m_dwScreenColumns;
+
+		m_screenBuffer.reset(new CharInfo[dwBufferSize]);
+
+		for (DWORD dwOffset = 0; dwOffset < dwBufferSize; ++dwOffset)
+		{
+			m_screenBuffer[dwOffset].copy(consoleBuffer.Get() + dwOffset);
+		}
+
+		m_bHibernated = false;
+	}
 
-	Helpers::CreateBitmap(cdc, rect.Width(), rect.Height(), bitmap);
-	cdc.SelectBitmap(bitmap);
+	m_bNeedFullRepaint = true;
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -1551,6 +1975,8 @@ bool ConsoleView::CreateFont(const wstring& strFontName)
 	if (!m_fontText.IsNull()) return true;// m_fontText.DeleteObject();
 	if (!m_fontTextHigh.IsNull()) return true;// m_fontTextHigh.DeleteObject();
 
+	TRACE_SCOPE("ConsoleView::CreateFont");
+
   CDC dcText(::CreateCompatibleDC(NULL));
 
 	BYTE	byFontQuality = DEFAULT_QUALITY;
@@ -1566,57 +1992,51 @@ bool ConsoleView::CreateFont(const wstring& strFontName)
 	bool bBold   = g_settingsHandler->GetAppearanceSettings().fontSettings.bBold;
 	bool bItalic = g_settingsHandler->GetAppearanceSettings().fontSettings.bItalic;
 
-	m_fontText.CreateFont(
-		-::MulDiv(m_dwFontSize, dcText.GetDeviceCaps(LOGPIXELSY), 72),
-		0,
-		0,
-		0,
-		bBold ? FW_BOLD : 0,
-		bItalic,
-		FALSE,
-		FALSE,
- 		DEFAULT_CHARSET,
-		OUT_DEFAULT_PRECIS,
-		CLIP_DEFAULT_PRECIS,
-		byFontQuality,
-		DEFAULT_PITCH,
-		strFontName.c_str());
+	FontCache::Key key;
+
+	key.strFace		= strFontName;
+	key.dwSize		= m_dwFontSize;
+	key.dwWeight	= bBold ? FW_BOLD : 0;
+	key.bItalic		= bItalic;
+	key.dwDpi		= dcText.GetDeviceCaps(LOGPIXELSY);
+	key.dwQuality	= byFontQuality;
+
+	FontCache::Key keyHigh = key;
+
+	std::shared_ptr<FontCache::Font> fontText = m_fontCache.Get(key);
 
 	if( g_settingsHandler->GetAppearanceSettings().fontSettings.bBoldIntensified )
 		bBold = !bBold;
 	if( g_settingsHandler->GetAppearanceSettings().fontSettings.bItalicIntensified )
 		bItalic = !bItalic;
 
-	m_fontTextHigh.CreateFont(
-		-::MulDiv(m_dwFontSize, dcText.GetDeviceCaps(LOGPIXELSY), 72),
-		0,
-		0,
-		0,
-		bBold ? FW_BOLD : 0,
-		bItalic,
-		FALSE,
-		FALSE,
-		DEFAULT_CHARSET,
-		OUT_DEFAULT_PRECIS,
-		CLIP_DEFAULT_PRECIS,
-		byFontQuality,
-		DEFAULT_PITCH,
-		strFontName.c_str());
+	keyHigh.dwWeight	= bBold ? FW_BOLD : 0;
+	keyHigh.bItalic		= bItalic;
+
+	std::shared_ptr<FontCache::Font> fontTextHigh = m_fontCache.Get(keyHigh);
 
+	// fallback fonts may be proportional, the text font can't
+	// (TMPF_FIXED_PITCH is cleared for fixed pitch fonts!!!)
 	TEXTMETRIC	textMetric;
 
-	dcText.SelectFont(m_fontText);
-	if( !dcText.GetTextMetrics(&textMetric) || (textMetric.tmPitchAndFamily & TMPF_FIXED_PITCH) )
+	if (fontText) dcText.SelectFont(static_cast<HFONT>(fontText->GetHandle()));
+	if (!fontText || !fontTextHigh || !dcText.GetTextMetrics(&textMetric) || (textMetric.tmPitchAndFamily & TMPF_FIXED_PITCH))
 	{
 		TRACE(L"/!\\ can't use %s font\n", strFontName.c_str());
-		if (!m_fontText.IsNull()) m_fontText.DeleteObject();
-		if (!m_fontTextHigh.IsNull()) m_fontTextHigh.DeleteObject();
 		return false;
 	}
 
-	// fixed pitch font (TMPF_FIXED_PITCH is cleared!!!)
-	m_nCharWidth  = textMetric.tmAveCharWidth;
-	m_nCharHeight = textMetric.tmHeight;
+	CreateFallback(m_fallbackText, key, fontText);
+	CreateFallback(m_fallbackTextHigh, keyHigh, fontTextHigh);
+
+	m_cachedFontText		= fontText;
+	m_cachedFontTextHigh	= fontTextHigh;
+
+	m_fontText		= static_cast<HFONT>(fontText->GetHandle());
+	m_fontTextHigh	= static_cast<HFONT>(fontTextHigh->GetHandle());
+
+	m_nCharWidth  = fontText->GetCharWidth();
+	m_nCharHeight = fontText->GetCharHeight();
 
 	m_nVScrollWidth = ::GetSystemMetrics(SM_CXVSCROLL);
 	m_nHScrollWidth = ::GetSystemMetrics(SM_CXHSCROLL);
@@ -1632,24 +2052,148 @@ bool ConsoleView::CreateFont(const wstring& strFontName)
 
 //////////////////////////////////////////////////////////////////////////////
 
-void ConsoleView::InitializeScrollbars()
+std::shared_ptr<FontCache::Font> ConsoleView::CreateCachedFont(const FontCache::Key& key)
 {
-	SharedMemory<ConsoleParams>& consoleParams = m_consoleHandler.GetConsoleParams();
+	TRACE_SCOPE("ConsoleView::CreateCachedFont");
+
+	CDC dcText(::CreateCompatibleDC(NULL));
+
+	std::shared_ptr<void> font(
+		::CreateFont(
+			-::MulDiv(key.dwSize * key.dwScale, key.dwDpi, 72 * FontCache::SCALE_NONE),
+			0,
+			0,
+			0,
+			key.dwWeight,
+			key.bItalic,
+			FALSE,
+			FALSE,
+			DEFAULT_CHARSET,
+			OUT_DEFAULT_PRECIS,
+			CLIP_DEFAULT_PRECIS,
+			static_cast<BYTE>(key.dwQuality),
+			DEFAULT_PITCH,
+			key.strFace.c_str()),
+		::DeleteObject);
+
+	if (font.get() == NULL) return std::shared_ptr<FontCache::Font>();
 
-	m_bShowVScroll = m_appearanceSettings.controlsSettings.bShowScrollbars && (consoleParams->dwBufferRows > consoleParams->dwRows);
-	m_bShowHScroll = m_appearanceSettings.controlsSettings.bShowScrollbars && (consoleParams->dwBufferColumns > consoleParams->dwColumns);
+	TEXTMETRIC	textMetric;
 
-//	if (m_nScrollbarStyle != FSB_REGULAR_MODE)
+	dcText.SelectFont(static_cast<HFONT>(font.get()));
+	if (!dcText.GetTextMetrics(&textMetric)) return std::shared_ptr<FontCache::Font>();
 
-	if (m_appearanceSettings.controlsSettings.bFlatScrollbars)
-	{
-		::InitializeFlatSB(m_hWnd);
-		::FlatSB_SetScrollProp(m_hWnd, WSB_PROP_VSTYLE, FSB_ENCARTA_MODE, TRUE);
-	}
-	else
-	{
-		::UninitializeFlatSB(m_hWnd);
-	}
+	return std::make_shared<FontCache::Font>(font, textMetric.tmAveCharWidth, textMetric.tmHeight, textMetric.tmAscent);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ConsoleView::CreateFallback(FontFallback& fallback, const FontCache::Key& key, const std::shared_ptr<FontCache::Font>& font)
+{
+	fallback.Clear();
+	AddFallbackFont(fallback, font);
+
+	// the fonts GDI would link to for missing glyphs, as "file,face[,scaling,scaling]"
+	CRegKey keyLinks;
+
+	if (keyLinks.Open(HKEY_LOCAL_MACHINE, L"SOFTWARE\\Microsoft\\Windows NT\\CurrentVersion\\FontLink\\SystemLink", KEY_READ) != ERROR_SUCCESS) return;
+
+	ULONG ulChars = 0;
+
+	if ((keyLinks.QueryMultiStringValue(key.strFace.c_str(), NULL, &ulChars) != ERROR_SUCCESS) || (ulChars == 0)) return;
+
+	vector<wchar_t> links(ulChars + 2, L'\0');
+
+	if (keyLinks.QueryMultiStringValue(key.strFace.c_str(), &links[0], &ulChars) != ERROR_SUCCESS) return;
+
+	for (const wchar_t* pszLink = &links[0]; *pszLink != L'\0'; pszLink += wcslen(pszLink) + 1)
+	{
+		FontCache::Key keyLink = key;
+
+		// a file without a face name
+		if (!FontFallback::ParseLink(pszLink, keyLink.strFace, keyLink.dwScale)) continue;
+
+		std::shared_ptr<FontCache::Font> fontLink = m_fontCache.Get(keyLink);
+
+		if (fontLink) AddFallbackFont(fallback, fontLink);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ConsoleView::AddFallbackFont(FontFallback& fallback, const std::shared_ptr<FontCache::Font>& font)
+{
+	HFONT		hFont		= static_cast<HFONT>(font->GetHandle());
+	CoverageMap	coverage;
+	CDC			dc(::CreateCompatibleDC(NULL));
+	HFONT		hOldFont	= dc.SelectFont(hFont);
+	DWORD		dwSize		= ::GetFontUnicodeRanges(dc, NULL);
+
+	if (dwSize > 0)
+	{
+		std::unique_ptr<BYTE[]>	glyphSet(new BYTE[dwSize]);
+		GLYPHSET*				pGlyphSet = reinterpret_cast<GLYPHSET*>(glyphSet.get());
+
+		if (::GetFontUnicodeRanges(dc, pGlyphSet) > 0)
+		{
+			for (DWORD i = 0; i < pGlyphSet->cRanges; ++i)
+			{
+				coverage.AddRange(pGlyphSet->ranges[i].wcLow, pGlyphSet->ranges[i].cGlyphs);
+			}
+		}
+	}
+
+	dc.SelectFont(hOldFont);
+
+	fallback.AddFont(
+		font,
+		coverage,
+		[hFont](wchar_t chFirst, int nCount, unsigned short* pwGlyphs)
+		{
+			CDC				dc(::CreateCompatibleDC(NULL));
+			HFONT			hOldFont = dc.SelectFont(hFont);
+			vector<wchar_t>	chars(nCount);
+
+			for (int i = 0; i < nCount; ++i) chars[i] = static_cast<wchar_t>(chFirst + i);
+
+			if (::GetGlyphIndices(dc, &chars[0], nCount, pwGlyphs, GGI_MARK_NONEXISTING_GLYPHS) == GDI_ERROR)
+			{
+				for (int i = 0; i < nCount; ++i) pwGlyphs[i] = 0xFFFF;
+			}
+
+			dc.SelectFont(hOldFont);
+		});
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ConsoleView::InitializeScrollbars()
+{
+	SharedMemory<ConsoleParams>& consoleParams = m_consoleHandler.GetConsoleParams();
+
+	m_bShowVScroll = m_appearanceSettings.controlsSettings.bShowScrollbars && (consoleParams->dwBufferRows > consoleParams->dwRows);
+	m_bShowHScroll = m_appearanceSettings.controlsSettings.bShowScrollbars && (consoleParams->dwBufferColumns > consoleParams->dwColumns);
+
+//	if (m_nScrollbarStyle != FSB_REGULAR_MODE)
+
+	if (m_appearanceSettings.controlsSettings.bFlatScrollbars)
+	{
+		::InitializeFlatSB(m_hWnd);
+		::FlatSB_SetScrollProp(m_hWnd, WSB_PROP_VSTYLE, FSB_ENCARTA_MODE, TRUE);
+	}
+	else
+	{
+		::UninitializeFlatSB(m_hWnd);
+	}
 
 	::FlatSB_ShowScrollBar(m_hWnd, SB_VERT, m_bShowVScroll);
 	::FlatSB_ShowScrollBar(m_hWnd, SB_HORZ, m_bShowHScroll);
@@ -1700,7 +2244,6 @@ void ConsoleView::InitializeScrollbars()
 
 void ConsoleView::DoScroll(int nType, int nScrollCode, int nThumbPos)
 {
-	int nCurrentPos = ::FlatSB_GetScrollPos(m_hWnd, nType);
 	int nDelta = 0;
 
 	ScrollSettings& scrollSettings = g_settingsHandler->GetBehaviorSettings().scrollSettings;
@@ -1740,8 +2283,9 @@ void ConsoleView::DoScroll(int nType, int nScrollCode, int nThumbPos)
 
 		case SB_THUMBTRACK:
 		case SB_THUMBPOSITION:
-			nDelta = nThumbPos - nCurrentPos;
-			break;
+			// absolute, a thumb drag replaces whatever was pending
+			RequestScroll(nType, true, nThumbPos);
+			return;
 
 		case SB_ENDSCROLL:
 			return;
@@ -1750,35 +2294,261 @@ void ConsoleView::DoScroll(int nType, int nScrollCode, int nThumbPos)
 			return;
 	}
 
-  if( nType == SB_VERT )
-  {
-    int nVScrollMaxTop = static_cast<int>(m_dwVScrollMax - m_consoleHandler.GetConsoleParams()->dwRows + 1);
-    if( nCurrentPos + nDelta > nVScrollMaxTop )
-      nDelta = nVScrollMaxTop - nCurrentPos;
-  }
+	RequestScroll(nType, false, nDelta);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+void ConsoleView::RequestScroll(int nType, bool bPosition, int nValue)
+{
+	SharedMemory<ConsoleScroll>& newScrollPos = m_consoleHandler.GetNewScrollPos();
+
+	{
+		// requests the hook hasn't got to yet add up, the scroll bar
+		// position doesn't include them
+		SharedMemoryLock	memLock(newScrollPos);
+
+		ScrollAxis&	scrollAxis	= (nType == SB_VERT) ? newScrollPos->y : newScrollPos->x;
+		int			nPendingPos	= scrollAxis.GetPosition(::FlatSB_GetScrollPos(m_hWnd, nType));
+		int			nNewPos		= bPosition ? nValue : nPendingPos + nValue;
+
+		// clamped here, not only by the hook: deltas past either end would
+		// otherwise swallow a scroll back in the same burst
+		SharedMemory<ConsoleParams>& consoleParams = m_consoleHandler.GetConsoleParams();
+
+		int nMaxPos = (nType == SB_VERT)
+			? static_cast<int>(m_dwVScrollMax) - static_cast<int>(consoleParams->dwRows) + 1
+			: static_cast<int>(consoleParams->dwBufferColumns) - static_cast<int>(consoleParams->dwColumns);
+
+		if (nNewPos > nMaxPos) nNewPos = nMaxPos;
+		if (nNewPos < 0) nNewPos = 0;
+
+		if (nNewPos == nPendingPos) return;
+
+		if (bPosition)
+		{
+			scrollAxis.SetPosition(nNewPos);
+		}
+		else
+		{
+			scrollAxis.AddDelta(nNewPos - nPendingPos);
+		}
+	}
+
+	newScrollPos.SetReqEvent();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+void ConsoleView::CatchUp()
+{
+	if (!m_bCatchUpPending) return;
+
+	m_bCatchUpPending = false;
+
+	// the same update the console would have sent, views made active in the
+	// meantime have repainted already
+	if (m_bActive) PostMessage(UM_UPDATE_CONSOLE_VIEW, 0, 0);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+void ConsoleView::UpdateFlood(DWORD dwChangedCells)
+{
+	bool bFlooded = m_floodDetector.IsFlooded();
+
+	if (dwChangedCells > 0)
+	{
+		SharedMemory<ConsoleParams>& consoleParams = m_consoleHandler.GetConsoleParams();
+
+		m_floodDetector.OnUpdate(dwChangedCells, consoleParams->dwRows * consoleParams->dwColumns, ::GetTickCount());
+	}
+	else
+	{
+		m_floodDetector.OnTick(::GetTickCount());
+	}
+
+	if (m_floodDetector.IsFlooded() == bFlooded) return;
+
+	TRACE(L"ConsoleView 0x%08X: flood mode %s\n", m_hWnd, m_floodDetector.IsFlooded() ? L"on" : L"off");
+
+	if (m_floodDetector.IsFlooded())
+	{
+		// ticks while flooded, so it ends when output stops
+		SetTimer(FLOOD_TIMER, FloodDetector::FRAME_TIME);
+	}
+	else
+	{
+		KillTimer(FLOOD_TIMER);
+
+		if (m_bActive && m_bFloodFramePending) Repaint(false);
+		m_bFloodFramePending = false;
+	}
+
+	// the tab shows flood mode
+	m_mainFrame.PostMessage(
+					UM_UPDATE_TITLES,
+					reinterpret_cast<WPARAM>(m_hwndTabView),
+					0);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+void ConsoleView::PredictKey(UINT uMsg, WPARAM wParam)
+{
+	if (m_consoleSettings.localEcho == localEchoOff) return;
+
+	switch (wParam)
+	{
+		case VK_SHIFT :
+		case VK_CONTROL :
+		case VK_MENU :
+		case VK_CAPITAL :
+		case VK_LWIN :
+		case VK_RWIN :
+			return;
+	}
+
+	// only characters we can tell from the layout without going through
+	// ToUnicode, which would take dead keys away from the console; shifted
+	// keys other than letters aren't predicted
+	wchar_t	ch		= 0;
+	bool	bShift	= (::GetKeyState(VK_SHIFT) < 0);
+
+	if ((uMsg == WM_KEYDOWN) && (::GetKeyState(VK_CONTROL) >= 0) && (::GetKeyState(VK_MENU) >= 0))
+	{
+		// dead keys have the high bit set
+		UINT uChar = ::MapVirtualKey(static_cast<UINT>(wParam), MAPVK_VK_TO_CHAR);
+
+		if ((uChar >= L' ') && ((uChar & 0x80000000) == 0))
+		{
+			wchar_t chKey = static_cast<wchar_t>(uChar);
+
+			if (::IsCharAlpha(chKey))
+			{
+				ch = chKey;
+
+				if (bShift != ((::GetKeyState(VK_CAPITAL) & 1) != 0))
+				{
+					::CharUpperBuff(&ch, 1);
+				}
+				else
+				{
+					::CharLowerBuff(&ch, 1);
+				}
+			}
+			else if (!bShift)
+			{
+				ch = chKey;
+			}
+		}
+	}
+
+	m_predictiveEcho.SetAlwaysShow(m_consoleSettings.localEcho == localEchoAlways);
+
+	if (ch != 0)
+	{
+		m_predictiveEcho.OnPrintable(ch, ::GetTickCount());
+	}
+	else
+	{
+		m_predictiveEcho.OnOtherKey(::GetTickCount());
+	}
+
+	InvalidatePredictions();
+
+	if (m_predictiveEcho.HasPredictions() && !m_bPredictionTimerRunning)
+	{
+		m_bPredictionTimerRunning = true;
+		SetTimer(PREDICTION_TIMER, PREDICTION_TIMER_INTERVAL);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+void ConsoleView::UpdatePredictions()
+{
+	SharedMemory<ConsoleInfo>& consoleInfo = m_consoleHandler.GetConsoleInfo();
+
+	int nCursorX = consoleInfo->csbi.dwCursorPosition.X - consoleInfo->csbi.srWindow.Left;
+	int nCursorY = consoleInfo->csbi.dwCursorPosition.Y - consoleInfo->csbi.srWindow.Top;
 
-	if (nDelta != 0)
 	{
-		SharedMemory<SIZE>& newScrollPos = m_consoleHandler.GetNewScrollPos();
+		MutexLock bufferLock(m_consoleHandler.m_bufferMutex);
 
-		if (nType == SB_VERT)
+		if (!m_screenBuffer ||
+			(nCursorX < 0) || (nCursorX >= static_cast<int>(m_dwScreenColumns)) ||
+			(nCursorY < 0) || (nCursorY >= static_cast<int>(m_dwScreenRows)))
 		{
-			newScrollPos->cx = 0;
-			newScrollPos->cy = nDelta;
+			// scrolled away from the cursor
+			m_predictiveEcho.Reset();
 		}
 		else
 		{
-			newScrollPos->cx = nDelta;
-			newScrollPos->cy = 0;
+			m_predictiveEcho.OnScreen(
+								nCursorX, 
+								nCursorY, 
+								static_cast<int>(m_dwScreenColumns), 
+								static_cast<int>(m_dwScreenRows), 
+								ScreenChars(m_screenBuffer.get(), m_dwScreenColumns), 
+								::GetTickCount());
 		}
+	}
+
+	InvalidatePredictions();
+}
+
+/////////////////////////////////////////////////////////////////////////////
 
-		newScrollPos.SetReqEvent();
+
+/////////////////////////////////////////////////////////////////////////////
+
+void ConsoleView::InvalidatePredictions()
+{
+	// cells drawn last and the ones to draw now
+	if (!m_rectPredictions.IsRectEmpty()) InvalidateRect(&m_rectPredictions, FALSE);
+
+	const std::vector<PredictiveEcho::Prediction>& predictions = m_predictiveEcho.GetShownPredictions();
+
+	for (auto it = predictions.begin(); it != predictions.end(); ++it)
+	{
+		CRect rectCell;
+		GetCellRect(it->nX, it->nY, rectCell);
+		InvalidateRect(&rectCell, FALSE);
 	}
 }
 
 /////////////////////////////////////////////////////////////////////////////
 
 
+/////////////////////////////////////////////////////////////////////////////
+
+void ConsoleView::GetCellRect(int nX, int nY, CRect& rect)
+{
+	rect.left	= nX * m_nCharWidth + m_nVInsideBorder;
+	rect.top	= nY * m_nCharHeight + m_nHInsideBorder;
+	rect.right	= rect.left + m_nCharWidth;
+	rect.bottom	= rect.top + m_nCharHeight;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+
 /////////////////////////////////////////////////////////////////////////////
 
 DWORD ConsoleView::GetBufferDifference()
@@ -1800,16 +2570,49 @@ DWORD ConsoleView::GetBufferDifference()
 
 /////////////////////////////////////////////////////////////////////////////
 
-void ConsoleView::UpdateTitle()
+void ConsoleView::RequestResize(DWORD dwColumns, DWORD dwRows, DWORD dwResizeWindowEdge)
 {
-	if (g_settingsHandler->GetAppearanceSettings().windowSettings.bUseConsoleTitle)
+	m_pendingSize.dwColumns				= dwColumns;
+	m_pendingSize.dwRows				= dwRows;
+	m_pendingSize.dwResizeWindowEdge	= dwResizeWindowEdge;
+
+	if (!m_resizeThrottle.OnRequest(m_bActive)) return;
+
+	SendPendingResize();
+	SetTimer(RESIZE_TIMER, RESIZE_TIMER_INTERVAL);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+void ConsoleView::SendPendingResize()
+{
+	SharedMemory<ConsoleSize>& newConsoleSize = m_consoleHandler.GetNewConsoleSize();
+
 	{
-		CWindow consoleWnd(m_consoleHandler.GetConsoleParams()->hwndConsoleWindow);
-		CString strConsoleTitle(L"");
+		SharedMemoryLock memLock(newConsoleSize);
+		newConsoleSize = m_pendingSize;
+	}
+
+	newConsoleSize.SetReqEvent();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+void ConsoleView::UpdateTitle()
+{
+	CWindow consoleWnd(m_consoleHandler.GetConsoleParams()->hwndConsoleWindow);
 
-		consoleWnd.GetWindowText(strConsoleTitle);
+	consoleWnd.GetWindowText(m_strConsoleTitle);
 
-		SetTitle(strConsoleTitle);
+	if (g_settingsHandler->GetAppearanceSettings().windowSettings.bUseConsoleTitle)
+	{
+		SetTitle(m_strConsoleTitle);
 	}
 
 	m_mainFrame.PostMessage(
@@ -1825,6 +2628,8 @@ void ConsoleView::UpdateTitle()
 
 void ConsoleView::RepaintText(CDC& dc)
 {
+	TRACE_SCOPE("ConsoleView::RepaintText");
+
 	SIZE	bitmapSize;
 	CRect	bitmapRect;
 
@@ -1845,16 +2650,7 @@ void ConsoleView::RepaintText(CDC& dc)
     TransparencySettings& transparencySettings = g_settingsHandler->GetAppearanceSettings().transparencySettings;
     if (transparencySettings.transType == transGlass)
     {
-      Gdiplus::Graphics gr(dc);
-
-      COLORREF backgroundColor = m_tabData->crBackgroundColor;
-
-      gr.Clear(
-        Gdiplus::Color(
-          this->m_mainFrame.GetAppActiveStatus()? transparencySettings.byActiveAlpha : transparencySettings.byInactiveAlpha,
-          GetRValue(backgroundColor),
-          GetGValue(backgroundColor),
-          GetBValue(backgroundColor)));
+      FillGlassBackground(dc, bitmapRect);
     }
     else
     {
@@ -1882,15 +2678,12 @@ void ConsoleView::RepaintText(CDC& dc)
 
 		if (m_tabData->imageData.bRelative)
 		{
-			dc.BitBlt(
-				rectView.left,
-				rectView.top,
-				rectView.right,
-				rectView.bottom,
-				m_background->dcImage,
+			ImageHandler::PaintRelativeImage(
+				dc,
+				rectView,
 				rectView.left + pointView.x - ::GetSystemMetrics(SM_XVIRTUALSCREEN),
 				rectView.top  + pointView.y - ::GetSystemMetrics(SM_YVIRTUALSCREEN),
-				SRCCOPY);
+				m_background);
 		}
 		else
 		{
@@ -1906,13 +2699,17 @@ void ConsoleView::RepaintText(CDC& dc)
 		}
 	}
 
+  if (BandTextOut(dc, NULL)) return;
+
   MutexLock bufferLock(m_consoleHandler.m_bufferMutex);
 
   for (DWORD i = 0; i < m_dwScreenRows; ++i)
   {
-    this->RowTextOut(dc, i);
+    this->RowTextOut(i);
   }
 
+  DrawTextBatch(dc);
+
 #if 0
 	DWORD dwX			= m_nVInsideBorder;
 	DWORD dwY			= m_nHInsideBorder;
@@ -2108,12 +2905,17 @@ void ConsoleView::RepaintTextChanges(CDC& dc)
     g_imageHandler->UpdateImageBitmap(dc, rectTab, m_background);
   }
 
+  // text goes over all the changed rows' backgrounds at once
+  std::unique_ptr<bool[]> rowsChanged(new bool[m_dwScreenRows]);
+
   for (DWORD i = 0; i < m_dwScreenRows; ++i, dwY += m_nCharHeight)
   {
     DWORD dwX = m_nVInsideBorder;
 
     bool rowHasChanged = false;
 
+    rowsChanged[i] = false;
+
     for (DWORD j = 0; j < m_dwScreenColumns; ++j, ++dwOffset, dwX += m_nCharWidth)
     {
       if (m_screenBuffer[dwOffset].changed)
@@ -2138,22 +2940,7 @@ void ConsoleView::RepaintTextChanges(CDC& dc)
         TransparencySettings& transparencySettings = g_settingsHandler->GetAppearanceSettings().transparencySettings;
         if (transparencySettings.transType == transGlass)
         {
-          Gdiplus::Graphics gr(dc);
-
-          gr.SetClip(
-            Gdiplus::Rect(
-              rect.left, rect.top,
-              rect.Width(), rect.Height()),
-            Gdiplus::CombineModeReplace);
-
-          COLORREF backgroundColor = m_tabData->crBackgroundColor;
-
-          gr.Clear(
-            Gdiplus::Color(
-              this->m_mainFrame.GetAppActiveStatus()? transparencySettings.byActiveAlpha : transparencySettings.byInactiveAlpha,
-              GetRValue(backgroundColor),
-              GetGValue(backgroundColor),
-              GetBValue(backgroundColor)));
+          FillGlassBackground(dc, rect);
         }
 #endif
       }
@@ -2161,15 +2948,12 @@ void ConsoleView::RepaintTextChanges(CDC& dc)
       {
         if (m_tabData->imageData.bRelative)
         {
-          dc.BitBlt(
-            rect.left,
-            rect.top,
-            rect.Width(),
-            rect.Height(),
-            m_background->dcImage,
+          ImageHandler::PaintRelativeImage(
+            dc,
+            rect,
             rect.left + pointView.x - ::GetSystemMetrics(SM_XVIRTUALSCREEN),
             rect.top  + pointView.y - ::GetSystemMetrics(SM_YVIRTUALSCREEN),
-            SRCCOPY);
+            m_background);
         }
         else
         {
@@ -2185,28 +2969,32 @@ void ConsoleView::RepaintTextChanges(CDC& dc)
         }
       }
 
-      this->RowTextOut(dc, i);
+      rowsChanged[i] = true;
     }
   }
-}
 
+  if (BandTextOut(dc, rowsChanged.get())) return;
 
-void ConsoleView::RowTextOut(CDC& dc, DWORD dwRow)
-{
-  //TRACE(L"ConsoleView::RepaintRow %lu\n", dwRow);
-  DWORD dwX      = m_nVInsideBorder;
+  for (DWORD i = 0; i < m_dwScreenRows; ++i)
+  {
+    if (rowsChanged[i]) this->RowTextOut(i);
+  }
+
+  DrawTextBatch(dc);
+}
+
+
+void ConsoleView::RowTextOut(DWORD dwRow)
+{
+  //TRACE(L"ConsoleView::RepaintRow %lu\n", dwRow);
+  DWORD dwX      = m_nVInsideBorder;
   DWORD dwY      = m_nHInsideBorder + m_nCharHeight * dwRow;
   DWORD dwOffset = m_dwScreenColumns * dwRow;
 
   COLORREF * consoleColors = m_tabData->consoleColors;
 
-#ifdef _USE_AERO
-  Gdiplus::Graphics gr(dc);
-#endif //_USE_AERO
-
+  // advance of each char in a text run, wide chars take their trailing cells
   std::unique_ptr<INT[]> dxWidths(new INT[m_dwScreenColumns]);
-  for(size_t i = 0; i < m_dwScreenColumns; ++i)
-    dxWidths[i] = m_nCharWidth;
 
   // first pass : text background color
   WORD    attrBG    = 0;
@@ -2232,35 +3020,17 @@ void ConsoleView::RowTextOut(CDC& dc, DWORD dwRow)
       }
       else
       {
-        // draw background and reset
+        // add background and reset
 
         if (attrBG != 0)
         {
-#ifdef _USE_AERO
-          COLORREF backgroundColor = consoleColors[attrBG];
-          Gdiplus::SolidBrush backgroundBrush(
-            Gdiplus::Color(
-              m_consoleSettings.backgroundTextOpacity,
-              GetRValue(backgroundColor),
-              GetGValue(backgroundColor),
-              GetBValue(backgroundColor)));
-
-          gr.FillRectangle(
-            &backgroundBrush,
-            dwX, dwY,
-            dwBGWidth, m_nCharHeight);
-#else //_USE_AERO
-          CBrush backgroundBrush;
-          backgroundBrush.CreateSolidBrush(consoleColors[attrBG]);
-
-          CRect rect;
-          rect.top    = dwY;
-          rect.left   = dwX;
-          rect.bottom = dwY + m_nCharHeight;
-          rect.right  = dwX + dwBGWidth;
+          TextBatch::Rect rect;
+          rect.nTop    = dwY;
+          rect.nLeft   = dwX;
+          rect.nBottom = dwY + m_nCharHeight;
+          rect.nRight  = dwX + dwBGWidth;
 
-          dc.FillRect(&rect, (HBRUSH)backgroundBrush);
-#endif //_USE_AERO
+          m_textBatch.AddFill(rect, consoleColors[attrBG]);
         }
 
         attrBG    = attrBG2;
@@ -2274,30 +3044,13 @@ void ConsoleView::RowTextOut(CDC& dc, DWORD dwRow)
   {
     if (attrBG != 0)
     {
-#ifdef _USE_AERO
-      COLORREF backgroundColor = consoleColors[attrBG];
-      Gdiplus::SolidBrush backgroundBrush(
-        Gdiplus::Color(
-          m_consoleSettings.backgroundTextOpacity,
-          GetRValue(backgroundColor),
-          GetGValue(backgroundColor),
-          GetBValue(backgroundColor)));
-
-      gr.FillRectangle(
-        &backgroundBrush,
-        dwX, dwY,
-        dwBGWidth, m_nCharHeight);
-#else //_USE_AERO
-      CBrush backgroundBrush;
-      backgroundBrush.CreateSolidBrush(consoleColors[attrBG]);
+      TextBatch::Rect rect;
+      rect.nTop    = dwY;
+      rect.nLeft   = dwX;
+      rect.nBottom = dwY + m_nCharHeight;
+      rect.nRight  = dwX + dwBGWidth;
 
-      CRect rect;
-      rect.top    = dwY;
-      rect.left   = dwX;
-      rect.bottom = dwY + m_nCharHeight;
-      rect.right  = dwX + dwBGWidth;
-      dc.FillRect(&rect, backgroundBrush);
-#endif //_USE_AERO
+      m_textBatch.AddFill(rect, consoleColors[attrBG]);
 
       dwX       += dwBGWidth;
     }
@@ -2317,8 +3070,15 @@ void ConsoleView::RowTextOut(CDC& dc, DWORD dwRow)
 
   for (DWORD j = 0; j < m_dwScreenColumns; ++j, ++dwOffset)
   {
-    if (m_screenBuffer[dwOffset].charInfo.Attributes & COMMON_LVB_TRAILING_BYTE) continue;
-
+    if (m_screenBuffer[dwOffset].charInfo.Attributes & COMMON_LVB_TRAILING_BYTE)
+    {
+      if (!strText.empty())
+      {
+        dxWidths[strText.length() - 1] += m_nCharWidth;
+        dwFGWidth += m_nCharWidth;
+      }
+      continue;
+    }
 
     // compare foreground color
     COLORREF colorFG2  = m_appearanceSettings.fontSettings.bUseColor ? m_appearanceSettings.fontSettings.crFontColor : consoleColors[m_screenBuffer[dwOffset].charInfo.Attributes & 0xF];
@@ -2329,8 +3089,6 @@ void ConsoleView::RowTextOut(CDC& dc, DWORD dwRow)
       colorFG   = colorFG2;
       dwFGWidth = m_nCharWidth;
       fontHigh  = fontHigh2;
-
-      dc.SelectFont(fontHigh? m_fontTextHigh : m_fontText);
     }
     else
     {
@@ -2340,10 +3098,7 @@ void ConsoleView::RowTextOut(CDC& dc, DWORD dwRow)
       }
       else
       {
-        // draw text and reset
-
-        dc.SetBkMode(TRANSPARENT);
-        dc.SetTextColor(colorFG);
+        // add text and reset
 
         CRect rect;
         rect.top    = dwY;
@@ -2353,47 +3108,429 @@ void ConsoleView::RowTextOut(CDC& dc, DWORD dwRow)
         // in italic a part of the previous char is drawn in the following char space
         rect.right  = dwX + dwFGWidth + m_nCharWidth;
 
-        dc.ExtTextOut(dwX, dwY, ETO_CLIPPED, &rect, strText.c_str(), static_cast<UINT>(strText.length()), dxWidths.get());
+        AddTextRun(dwX, dwY, rect, strText, dxWidths.get(), fontHigh, colorFG);
 
         strText.clear();
         colorFG   = colorFG2;
+        fontHigh  = fontHigh2;
         dwX       += dwFGWidth;
         dwFGWidth = m_nCharWidth;
-
-        // change font
-        if( fontHigh != fontHigh2 )
-        {
-          fontHigh = fontHigh2;
-          dc.SelectFont(fontHigh? m_fontTextHigh : m_fontText);
-        }
       }
     }
 
+    dxWidths[strText.length()] = m_nCharWidth;
     strText += m_screenBuffer[dwOffset].charInfo.Char.UnicodeChar;
   }
 
   if( dwBGWidth > 0 )
   {
-    dc.SetBkMode(TRANSPARENT);
-    dc.SetTextColor(colorFG);
-
     CRect rect;
     rect.top    = dwY;
     rect.left   = dwX;
     rect.bottom = dwY + m_nCharHeight;
     rect.right  = dwX + dwFGWidth;
 
-    dc.ExtTextOut(dwX, dwY, ETO_CLIPPED, &rect, strText.c_str(), static_cast<UINT>(strText.length()), dxWidths.get());
+    AddTextRun(dwX, dwY, rect, strText, dxWidths.get(), fontHigh, colorFG);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+void ConsoleView::AddTextRun(int nX, int nY, const CRect& rect, const wstring& strText, INT* pnWidths, bool bHigh, COLORREF crText)
+{
+  FontFallback& fallback = bHigh ? m_fallbackTextHigh : m_fallbackText;
+
+  TextBatch::Rect clip;
+  clip.nLeft   = rect.left;
+  clip.nTop    = rect.top;
+  clip.nRight  = rect.right;
+  clip.nBottom = rect.bottom;
+
+  fallback.SplitRuns(strText.c_str(), static_cast<int>(strText.length()), m_fallbackRuns);
+
+  for (size_t i = 0; i < m_fallbackRuns.size(); ++i)
+  {
+    const FontFallback::Run& run = m_fallbackRuns[i];
+
+    DWORD dwFont = (bHigh ? BATCH_FONT_HIGH : 0) | static_cast<DWORD>(run.nFont);
+
+    if (run.nFont == FontFallback::NO_FONT)
+    {
+      // no font has these, GDI's font linking may find them
+      m_textBatch.AddRun(nX, nY, clip, dwFont, crText, strText.c_str() + run.nStart, pnWidths + run.nStart, run.nCount);
+    }
+    else
+    {
+      m_fallbackGlyphs.resize(run.nCount);
+      fallback.GetGlyphs(run.nFont, strText.c_str() + run.nStart, run.nCount, &m_fallbackGlyphs[0]);
+
+      // on the text font's baseline, GDI draws from the top of the font
+      m_textBatch.AddRun(nX, nY + fallback.GetBaselineOffset(run.nFont), clip, dwFont, crText, reinterpret_cast<const wchar_t*>(&m_fallbackGlyphs[0]), pnWidths + run.nStart, run.nCount);
+    }
+
+    for (int j = 0; j < run.nCount; ++j) nX += pnWidths[run.nStart + j];
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+void ConsoleView::DrawTextBatch(CDC& dc)
+{
+  if (m_textBatch.IsEmpty()) return;
+
+  m_batchStatsUnsorted = m_textBatch.GetStats();
+  m_textBatch.Sort();
+  m_batchStatsSorted = m_textBatch.GetStats();
+
+  // backgrounds first, a brush per color
+
+  const vector<TextBatch::Fill>& fills = m_textBatch.GetFills();
+
+  PixelSurface surface;
+  Helpers::GetBitmapSurface(dc.GetCurrentBitmap(), surface);
+
+  if (surface.pPixels != NULL)
+  {
+    // painted straight into the offscreen DIB, there are no brushes
+    for (size_t i = 0; i < fills.size(); ++i)
+    {
+      const TextBatch::Rect& rect = fills[i].rect;
+
+      FillTextBackground(surface, CRect(rect.nLeft, rect.nTop, rect.nRight, rect.nBottom), fills[i].dwColor);
+    }
+  }
+  else
+  {
+    // not a DIB section
+#ifdef _USE_AERO
+    Gdiplus::Graphics gr(dc);
+#endif //_USE_AERO
+
+    for (size_t i = 0; i < fills.size(); )
+    {
+      COLORREF crBackground = fills[i].dwColor;
+
+#ifdef _USE_AERO
+      Gdiplus::SolidBrush backgroundBrush(
+        Gdiplus::Color(
+          m_consoleSettings.backgroundTextOpacity,
+          GetRValue(crBackground),
+          GetGValue(crBackground),
+          GetBValue(crBackground)));
+#else //_USE_AERO
+      CBrush backgroundBrush;
+      backgroundBrush.CreateSolidBrush(crBackground);
+#endif //_USE_AERO
+
+      for (; (i < fills.size()) && (fills[i].dwColor == crBackground); ++i)
+      {
+        const TextBatch::Rect& rect = fills[i].rect;
+
+#ifdef _USE_AERO
+        gr.FillRectangle(
+          &backgroundBrush,
+          rect.nLeft, rect.nTop,
+          rect.nRight - rect.nLeft, rect.nBottom - rect.nTop);
+#else //_USE_AERO
+        CRect rectFill(rect.nLeft, rect.nTop, rect.nRight, rect.nBottom);
+        dc.FillRect(&rectFill, backgroundBrush);
+#endif //_USE_AERO
+      }
+    }
+  }
+
+  // then text, selecting fonts and colors only when they change
+
+  const vector<TextBatch::Run>& runs = m_textBatch.GetRuns();
+
+  dc.SetBkMode(TRANSPARENT);
+
+  for (size_t i = 0; i < runs.size(); ++i)
+  {
+    const TextBatch::Run& run = runs[i];
+
+    bool  bHigh = (run.dwFont & BATCH_FONT_HIGH) != 0;
+    int   nFont = static_cast<int>(run.dwFont & ~BATCH_FONT_HIGH);
+
+    if ((i == 0) || (run.dwFont != runs[i - 1].dwFont))
+    {
+      if (nFont == FontFallback::NO_FONT)
+        dc.SelectFont(bHigh ? m_fontTextHigh : m_fontText);
+      else
+        dc.SelectFont(static_cast<HFONT>((bHigh ? m_fallbackTextHigh : m_fallbackText).GetFont(nFont)->GetHandle()));
+    }
+
+    if ((i == 0) || (run.dwColor != runs[i - 1].dwColor))
+    {
+      dc.SetTextColor(run.dwColor);
+    }
+
+    CRect rect(run.clip.nLeft, run.clip.nTop, run.clip.nRight, run.clip.nBottom);
+
+    dc.ExtTextOut(
+      run.nX, run.nY,
+      (nFont == FontFallback::NO_FONT) ? ETO_CLIPPED : ETO_CLIPPED | ETO_GLYPH_INDEX,
+      &rect,
+      m_textBatch.GetText(run), static_cast<UINT>(run.nCount),
+      m_textBatch.GetAdvances(run));
   }
+
+  dc.SelectFont(m_fontText);
+
+  m_textBatch.Clear();
 }
 
 /////////////////////////////////////////////////////////////////////////////
 
 
+/////////////////////////////////////////////////////////////////////////////
+
+void ConsoleView::FillTextBackground(const PixelSurface& surface, const CRect& rect, COLORREF crBackground)
+{
+  int nX      = rect.left;
+  int nY      = rect.top;
+  int nWidth  = rect.Width();
+  int nHeight = rect.Height();
+
+  if (!surface.Clip(nX, nY, nWidth, nHeight)) return;
+
+#ifdef _USE_AERO
+  PixelKernels::BlendFill(
+    surface.GetPixel(nX, nY), surface.nPitch,
+    nWidth, nHeight,
+    PixelKernels::MakeColor(GetRValue(crBackground), GetGValue(crBackground), GetBValue(crBackground), 0),
+    m_consoleSettings.backgroundTextOpacity);
+#else //_USE_AERO
+  // alpha stays 0, like FillRect leaves it
+  PixelKernels::Fill(
+    surface.GetPixel(nX, nY), surface.nPitch,
+    nWidth, nHeight,
+    PixelKernels::MakeColor(GetRValue(crBackground), GetGValue(crBackground), GetBValue(crBackground), 0));
+#endif //_USE_AERO
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool ConsoleView::BandTextOut(CDC& dc, const bool* pRows)
+{
+	DWORD dwThreads = m_appearanceSettings.fontSettings.dwRenderThreads;
+
+	if (dwThreads == 0) return false;
+
+	PixelSurface surface;
+
+	if (!Helpers::GetBitmapSurface(dc.GetCurrentBitmap(), surface)) return false;
+
+	TRACE_SCOPE("ConsoleView::BandTextOut");
+
+	if (!m_bandRenderer || (m_bandRenderer->GetThreads() != dwThreads))
+	{
+		m_bandRenderer.reset(new BandRenderer(dwThreads));
+	}
+
+	m_glyphAtlas.SetCellSize(m_nCharWidth, m_nCharHeight);
+
+	// the bands work on a copy, the console can go on meanwhile
+	{
+		MutexLock bufferLock(m_consoleHandler.m_bufferMutex);
+
+		DWORD dwCells = m_dwScreenRows * m_dwScreenColumns;
+
+		m_bandCells.resize(dwCells);
+
+		for (DWORD i = 0; i < dwCells; ++i)
+		{
+			if ((pRows != NULL) && !pRows[i / m_dwScreenColumns]) continue;
+
+			m_bandCells[i].ch			= m_screenBuffer[i].charInfo.Char.UnicodeChar;
+			m_bandCells[i].wAttributes	= m_screenBuffer[i].charInfo.Attributes;
+
+			m_screenBuffer[i].changed = false;
+		}
+	}
+
+	if (m_bandCells.empty()) return true;
+
+	const FontSettings&	fontSettings	= m_appearanceSettings.fontSettings;
+	COLORREF*			consoleColors	= m_tabData->consoleColors;
+
+	BandRenderer::Frame frame;
+
+	frame.pCells		= &m_bandCells[0];
+	frame.nColumns		= static_cast<int>(m_dwScreenColumns);
+	frame.nRows			= static_cast<int>(m_dwScreenRows);
+	frame.pRows			= pRows;
+	frame.nX			= m_nVInsideBorder;
+	frame.nY			= m_nHInsideBorder;
+
+	for (int i = 0; i < 16; ++i)
+	{
+		frame.palette[i] = PixelKernels::MakeColor(GetRValue(consoleColors[i]), GetGValue(consoleColors[i]), GetBValue(consoleColors[i]), 0);
+	}
+
+	frame.bUseFontColor	= fontSettings.bUseColor;
+	frame.dwFontColor	= PixelKernels::MakeColor(GetRValue(fontSettings.crFontColor), GetGValue(fontSettings.crFontColor), GetBValue(fontSettings.crFontColor), 0);
+	frame.bIntensified	= fontSettings.bBoldIntensified || fontSettings.bItalicIntensified;
+
+	// same blending as FillTextBackground
+#ifdef _USE_AERO
+	frame.bPremultiplied		= true;
+	frame.byBackgroundOpacity	= m_consoleSettings.backgroundTextOpacity;
+#endif //_USE_AERO
+
+	BandRenderer::PrepareGlyphs(frame, m_glyphAtlas, &ConsoleView::RasterizeGlyph);
+
+	// backgrounds may still be queued in GDI
+	::GdiFlush();
+
+	m_bandRenderer->Render(frame, m_glyphAtlas, surface);
+
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+void ConsoleView::RasterizeGlyph(wchar_t ch, bool bHigh, unsigned char* pCoverage)
+{
+	int nWidth	= m_glyphAtlas.GetGlyphWidth();
+	int nHeight	= m_glyphAtlas.GetCellHeight();
+
+	BITMAPINFO bmi;
+	::ZeroMemory(&bmi, sizeof(BITMAPINFO));
+
+	bmi.bmiHeader.biSize		= sizeof(BITMAPINFOHEADER);
+	bmi.bmiHeader.biWidth		= nWidth;
+	// top-down, like the coverage
+	bmi.bmiHeader.biHeight		= -nHeight;
+	bmi.bmiHeader.biPlanes		= 1;
+	bmi.bmiHeader.biBitCount	= 32;
+	bmi.bmiHeader.biCompression	= BI_RGB;
+
+	void*	pBits = NULL;
+	CDC		dc(::CreateCompatibleDC(NULL));
+	CBitmap	bitmap(::CreateDIBSection(dc, &bmi, DIB_RGB_COLORS, &pBits, NULL, 0));
+
+	if (bitmap.IsNull())
+	{
+		// a blank glyph rather than whatever the atlas has there
+		::ZeroMemory(pCoverage, nWidth * nHeight);
+		return;
+	}
+
+	HBITMAP	hOldBitmap	= dc.SelectBitmap(bitmap);
+	HFONT	hOldFont	= dc.SelectFont(bHigh ? m_fontTextHigh : m_fontText);
+	CRect	rect(0, 0, nWidth, nHeight);
+
+	// white on black, ClearType's color fringes are averaged into gray
+	dc.SetBkColor(RGB(0, 0, 0));
+	dc.SetTextColor(RGB(255, 255, 255));
+
+	FontFallback&	fallback	= bHigh ? m_fallbackTextHigh : m_fallbackText;
+	int				nFont		= fallback.Resolve(ch);
+
+	if (nFont == FontFallback::NO_FONT)
+	{
+		dc.ExtTextOut(0, 0, ETO_CLIPPED | ETO_OPAQUE, &rect, &ch, 1, NULL);
+	}
+	else
+	{
+		unsigned short wGlyph = 0;
+
+		fallback.GetGlyphs(nFont, &ch, 1, &wGlyph);
+
+		dc.SelectFont(static_cast<HFONT>(fallback.GetFont(nFont)->GetHandle()));
+		dc.ExtTextOut(0, fallback.GetBaselineOffset(nFont), ETO_CLIPPED | ETO_OPAQUE | ETO_GLYPH_INDEX, &rect, reinterpret_cast<LPCWSTR>(&wGlyph), 1, NULL);
+	}
+
+	::GdiFlush();
+
+	const BYTE* pPixel = static_cast<const BYTE*>(pBits);
+
+	for (int i = 0; i < nWidth * nHeight; ++i, pPixel += 4)
+	{
+		pCoverage[i] = static_cast<unsigned char>((pPixel[0] + 2 * pPixel[1] + pPixel[2] + 2) / 4);
+	}
+
+	dc.SelectFont(hOldFont);
+	dc.SelectBitmap(hOldBitmap);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+#ifdef _USE_AERO
+
+void ConsoleView::FillGlassBackground(CDC& dc, const CRect& rect)
+{
+  TransparencySettings& transparencySettings = g_settingsHandler->GetAppearanceSettings().transparencySettings;
+
+  COLORREF backgroundColor = m_tabData->crBackgroundColor;
+  BYTE     byAlpha         = this->m_mainFrame.GetAppActiveStatus()? transparencySettings.byActiveAlpha : transparencySettings.byInactiveAlpha;
+
+  PixelSurface surface;
+
+  if (Helpers::GetBitmapSurface(dc.GetCurrentBitmap(), surface))
+  {
+    int nX      = rect.left;
+    int nY      = rect.top;
+    int nWidth  = rect.Width();
+    int nHeight = rect.Height();
+
+    // DWM composes the glass from premultiplied pixels
+    if (surface.Clip(nX, nY, nWidth, nHeight))
+    {
+      PixelKernels::Fill(
+        surface.GetPixel(nX, nY), surface.nPitch,
+        nWidth, nHeight,
+        PixelKernels::PremultiplyColor(PixelKernels::MakeColor(GetRValue(backgroundColor), GetGValue(backgroundColor), GetBValue(backgroundColor), byAlpha)));
+    }
+
+    return;
+  }
+
+  Gdiplus::Graphics gr(dc);
+
+  gr.SetClip(
+    Gdiplus::Rect(
+      rect.left, rect.top,
+      rect.Width(), rect.Height()),
+    Gdiplus::CombineModeReplace);
+
+  gr.Clear(
+    Gdiplus::Color(
+      byAlpha,
+      GetRValue(backgroundColor),
+      GetGValue(backgroundColor),
+      GetBValue(backgroundColor)));
+}
+
+#endif //_USE_AERO
+
+/////////////////////////////////////////////////////////////////////////////
+
+
 /////////////////////////////////////////////////////////////////////////////
 
 void ConsoleView::BitBltOffscreen(bool bOnlyCursor /*= false*/)
 {
+	TRACE_SCOPE("ConsoleView::BitBltOffscreen");
+
+	if (!m_surfaceOffscreen) return;
+
 	CRect			rectBlit;
 
 	if (bOnlyCursor)
@@ -2429,6 +3566,71 @@ void ConsoleView::BitBltOffscreen(bool bOnlyCursor /*= false*/)
 /////////////////////////////////////////////////////////////////////////////
 
 
+/////////////////////////////////////////////////////////////////////////////
+
+void ConsoleView::DrawLatencyOverlay(CDC& dc)
+{
+	wstring	strSummary(m_latencyStats.GetSummary());
+	CRect	rectClient;
+
+	GetClientRect(&rectClient);
+
+	HFONT hOldFont = dc.SelectFont(AtlGetDefaultGuiFont());
+
+	m_rectLatencyOverlay = rectClient;
+	dc.DrawText(strSummary.c_str(), -1, &m_rectLatencyOverlay, DT_SINGLELINE | DT_NOPREFIX | DT_CALCRECT);
+	m_rectLatencyOverlay.MoveToXY(rectClient.right - m_rectLatencyOverlay.Width() - m_nVInsideBorder, rectClient.top + m_nHInsideBorder);
+
+	dc.SetBkMode(OPAQUE);
+	dc.SetBkColor(RGB(0, 0, 0));
+	dc.SetTextColor(RGB(255, 255, 0));
+	dc.DrawText(strSummary.c_str(), -1, &m_rectLatencyOverlay, DT_SINGLELINE | DT_NOPREFIX);
+
+	dc.SelectFont(hOldFont);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+void ConsoleView::DrawPredictions(CDC& dc)
+{
+	m_rectPredictions.SetRectEmpty();
+
+	if (m_consoleSettings.localEcho == localEchoOff) return;
+
+	const std::vector<PredictiveEcho::Prediction>& predictions = m_predictiveEcho.GetShownPredictions();
+
+	if (predictions.empty()) return;
+
+	// drawn in the console's current text color and underlined, so they
+	// can be told apart from what the console wrote
+	WORD		wAttributes	= m_consoleHandler.GetConsoleInfo()->csbi.wAttributes;
+	COLORREF	crText		= m_appearanceSettings.fontSettings.bUseColor ? m_appearanceSettings.fontSettings.crFontColor : m_tabData->consoleColors[wAttributes & 0xF];
+
+	HFONT hOldFont = dc.SelectFont(m_fontText);
+
+	dc.SetBkMode(TRANSPARENT);
+	dc.SetTextColor(crText);
+
+	for (auto it = predictions.begin(); it != predictions.end(); ++it)
+	{
+		CRect rectCell;
+		GetCellRect(it->nX, it->nY, rectCell);
+
+		dc.ExtTextOut(rectCell.left, rectCell.top, ETO_CLIPPED, &rectCell, &it->ch, 1, NULL);
+		dc.FillSolidRect(rectCell.left, rectCell.bottom - 1, rectCell.Width(), 1, crText);
+
+		m_rectPredictions.UnionRect(&m_rectPredictions, &rectCell);
+	}
+
+	dc.SelectFont(hOldFont);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+
 /////////////////////////////////////////////////////////////////////////////
 
 void ConsoleView::UpdateOffscreen(const CRect& rectBlit)
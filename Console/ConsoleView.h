@@ -1,11 +1,28 @@
 #pragma once
 
+#include "BandRenderer.h"
 #include "Cursors.h"
 #include "SelectionHandler.h"
+#include "FloodDetector.h"
+#include "FontCache.h"
+#include "FontFallback.h"
+#include "LatencyStats.h"
+#include "PredictiveEcho.h"
+#include "ResizeThrottle.h"
+#include "SurfacePool.h"
+#include "TextBatch.h"
 
 //////////////////////////////////////////////////////////////////////////////
 
 #define	FLASH_TAB_TIMER		444
+#define	HIBERNATE_TIMER		445
+#define	RESIZE_TIMER		446
+#define	PREDICTION_TIMER	447
+#define	FLOOD_TIMER			448
+
+// one frame
+#define	RESIZE_TIMER_INTERVAL	16
+#define	PREDICTION_TIMER_INTERVAL	100
 
 //////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
@@ -19,6 +36,55 @@ class MainFrame;
 //////////////////////////////////////////////////////////////////////////////
 
 
+//////////////////////////////////////////////////////////////////////////////
+
+// 32 bpp DIB section selected into its own memory DC, views take these from
+// the main frame's pool while they're shown
+
+class OffscreenSurface
+{
+	public:
+		OffscreenSurface(int nWidth, int nHeight)
+		: m_bitmap()
+		, m_dc(::CreateCompatibleDC(NULL))
+		, m_nWidth(nWidth)
+		, m_nHeight(nHeight)
+		{
+			BITMAPINFO	bmpInfo;
+			void*		pBits = NULL;
+
+			::ZeroMemory(&bmpInfo, sizeof(BITMAPINFO));
+
+			bmpInfo.bmiHeader.biSize		= sizeof(BITMAPINFOHEADER);
+			bmpInfo.bmiHeader.biWidth		= nWidth;
+			bmpInfo.bmiHeader.biHeight		= nHeight;
+			bmpInfo.bmiHeader.biPlanes		= 1;
+			bmpInfo.bmiHeader.biBitCount	= 32;
+			bmpInfo.bmiHeader.biCompression	= BI_RGB;
+
+			m_bitmap.CreateDIBSection(m_dc, &bmpInfo, DIB_RGB_COLORS, &pBits, NULL, 0);
+			m_dc.SelectBitmap(m_bitmap);
+		}
+
+		HDC GetDC() const { return m_dc; }
+		int GetWidth() const { return m_nWidth; }
+		int GetHeight() const { return m_nHeight; }
+
+	private:
+
+		// the DC is deleted first, the bitmap can't be while it's selected
+		CBitmap		m_bitmap;
+		CDC			m_dc;
+
+		int			m_nWidth;
+		int			m_nHeight;
+};
+
+typedef SurfacePool<OffscreenSurface>	OffscreenSurfacePool;
+
+//////////////////////////////////////////////////////////////////////////////
+
+
 //////////////////////////////////////////////////////////////////////////////
 
 class ConsoleView
@@ -92,7 +158,7 @@ class ConsoleView
 		LRESULT OnInputLangChangeRequest(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
 		LRESULT OnInputLangChange(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
 		LRESULT OnDropFiles(UINT /*uMsg*/, WPARAM wParam, LPARAM /*lParam*/, BOOL& /*bHandled*/);
-		LRESULT OnUpdateConsoleView(UINT /*uMsg*/, WPARAM wParam, LPARAM /*lParam*/, BOOL& /*bHandled*/);
+		LRESULT OnUpdateConsoleView(UINT /*uMsg*/, WPARAM wParam, LPARAM lParam, BOOL& /*bHandled*/);
 
 		virtual void RedrawCharOnCursor(CDC& dc);
 
@@ -121,6 +187,9 @@ class ConsoleView
 		void SetActive(bool bActive);
 		void SetTitle(const CString& strTitle);
 		const CString& GetTitle() const { return m_strTitle; }
+		// shows the console's title again, titles are only read when the
+		// console changes them
+		void ApplyTitleSettings();
 
 		CString GetConsoleCommand();
 
@@ -137,8 +206,13 @@ class ConsoleView
 		bool CanPaste() const { return (m_selectionHandler->GetState() == SelectionHandler::selstateNoSelection) && (::IsClipboardFormatAvailable(CF_UNICODETEXT) || ::IsClipboardFormatAvailable(CF_TEXT) || ::IsClipboardFormatAvailable(CF_OEMTEXT)) ; }
 
 		void DumpBuffer();
+		void DumpLatency(wostream& os);
+		void DumpResources(wostream& os);
 		void InitializeScrollbars();
 
+		// console resizes asked for and sent to the hook so far
+		const ResizeThrottle& GetResizeThrottle() const { return m_resizeThrottle; }
+
 		const CString& GetExceptionMessage() const { return m_exceptionMessage; }
 
     inline bool IsGrouped() const { return m_boolIsGrouped; }
@@ -146,26 +220,91 @@ class ConsoleView
 
     void DoScroll(int nType, int nScrollCode, int nThumbPos);
 
+		static void ToggleLatencyOverlay() { m_bShowLatency = !m_bShowLatency; }
+
+		// joins the band renderer's threads, before the app exits
+		static void StopBandRenderer() { m_bandRenderer.reset(); }
+
+		bool IsFlooded() const { return m_floodDetector.IsFlooded(); }
+
+		// paints the updates left while MainFrame wasn't rendering
+		void CatchUp();
+
 	private:
 
 		void OnConsoleChange(bool bResize);
 		void OnConsoleClose();
 
 		void CreateOffscreenBuffers();
-		void CreateOffscreenBitmap(CDC& cdc, const CRect& rect, CBitmap& bitmap);
+
+		// offscreen and text surfaces are held only while the view is active;
+		// returns true when new ones had to be taken
+		bool AcquireOffscreenSurfaces(const CRect& rect, bool bShrink);
+		bool AcquireOffscreenSurface(const CRect& rect, bool bShrink, std::shared_ptr<OffscreenSurface>& surface, CDC& dc);
+		void ReleaseOffscreenSurfaces();
+
+		// background views drop their cursor, selection, brush and screen
+		// buffer after a while; they're rebuilt from the console's shared
+		// buffer when the view is activated
+		void Hibernate();
+		void Wake();
 		static bool CreateFont(const wstring& strFontName);
+		static std::shared_ptr<FontCache::Font> CreateCachedFont(const FontCache::Key& key);
+		// the text font and the fonts Windows links to it for missing glyphs
+		static void CreateFallback(FontFallback& fallback, const FontCache::Key& key, const std::shared_ptr<FontCache::Font>& font);
+		static void AddFallbackFont(FontFallback& fallback, const std::shared_ptr<FontCache::Font>& font);
 
 		DWORD GetBufferDifference();
 
+		// console resizes go to the hook at most once per RESIZE_TIMER tick,
+		// with the latest size; background views send theirs when they're
+		// shown (see ResizeThrottle)
+		void RequestResize(DWORD dwColumns, DWORD dwRows, DWORD dwResizeWindowEdge);
+		void SendPendingResize();
+
+		// adds a scroll to the one pending for the hook, or replaces it with
+		// a position (nType is SB_VERT or SB_HORZ)
+		void RequestScroll(int nType, bool bPosition, int nValue);
+
+		// feeds the flood detector with an update's changed cells, or a tick
+		// when dwChangedCells is 0
+		void UpdateFlood(DWORD dwChangedCells);
+
+		// local echo: keys going to the console are predicted, and the
+		// predictions checked against each console update
+		void PredictKey(UINT uMsg, WPARAM wParam);
+		void UpdatePredictions();
+		void InvalidatePredictions();
+		void DrawPredictions(CDC& dc);
+		void GetCellRect(int nX, int nY, CRect& rect);
+
 		void UpdateTitle();
 
 		void RepaintText(CDC& dc);
 		void RepaintTextChanges(CDC& dc);
-		void RowTextOut(CDC& dc, DWORD dwRow);
+		// adds the row's backgrounds and text to the text batch
+		void RowTextOut(DWORD dwRow);
+		// adds a run of text split by fallback font, by glyph index
+		void AddTextRun(int nX, int nY, const CRect& rect, const wstring& strText, INT* pnWidths, bool bHigh, COLORREF crText);
+		// draws the text batch sorted by brush, font and color, and clears it
+		void DrawTextBatch(CDC& dc);
+		void FillTextBackground(const PixelSurface& surface, const CRect& rect, COLORREF crBackground);
+
+		// draws the text of the rows (all rows for NULL) on worker threads
+		// when the experimental font render_threads is set; returns false
+		// when GDI has to, the setting is off or dc doesn't hold a DIB
+		// section
+		bool BandTextOut(CDC& dc, const bool* pRows);
+		static void RasterizeGlyph(wchar_t ch, bool bHigh, unsigned char* pCoverage);
+#ifdef _USE_AERO
+		void FillGlassBackground(CDC& dc, const CRect& rect);
+#endif
 
 		void BitBltOffscreen(bool bOnlyCursor = false);
 		void UpdateOffscreen(const CRect& rectBlit);
 
+		void DrawLatencyOverlay(CDC& dc);
+
 		bool TranslateKeyDown(UINT uMsg, WPARAM wParam, LPARAM /*lParam*/);
 		void ForwardMouseClick(UINT uMsg, WPARAM wParam, const CPoint& point);
 
@@ -184,6 +323,9 @@ class ConsoleView
 		bool	m_bResizing;
 		bool	m_bAppActive;
 		bool	m_bActive;
+		// set under m_consoleHandler.m_bufferMutex, OnConsoleChange doesn't
+		// copy the buffer while it's set
+		bool	m_bHibernated;
 		bool	m_bNeedFullRepaint;
 		bool	m_bUseTextAlphaBlend;
 		bool	m_bConsoleWindowVisible;
@@ -201,6 +343,10 @@ class ConsoleView
 		CString	m_strUser;
 		bool	m_boolNetOnly;
 
+		// console window title, read again only when the hook's title
+		// sequence moves (m_dwTitleSeq is used on the monitor thread)
+		CString	m_strConsoleTitle;
+		DWORD	m_dwTitleSeq;
 
 		ConsoleHandler	m_consoleHandler;
 
@@ -225,6 +371,29 @@ class ConsoleView
 		bool							m_bFlashTimerRunning;
 		DWORD							m_dwFlashes;
 
+		ConsoleSize						m_pendingSize;
+		ResizeThrottle					m_resizeThrottle;
+
+		LatencyStats					m_latencyStats;
+		CRect							m_rectLatencyOverlay;
+
+		PredictiveEcho					m_predictiveEcho;
+		bool							m_bPredictionTimerRunning;
+		// cells predictions were last drawn in
+		CRect							m_rectPredictions;
+
+		FloodDetector					m_floodDetector;
+		// an update wasn't painted, the next frame paints it
+		bool							m_bFloodFramePending;
+		DWORD							m_dwFloodFramesSkipped;
+
+		// the last text batch drawn, in row order and sorted
+		TextBatch::Stats				m_batchStatsUnsorted;
+		TextBatch::Stats				m_batchStatsSorted;
+
+		// an update came in while MainFrame wasn't rendering
+		bool							m_bCatchUpPending;
+
 		// since message handlers are not exception-safe,
 		// we'll store error messages thrown during OnCreate
 		// handler here...
@@ -233,14 +402,23 @@ class ConsoleView
 // static members
 private:
 
+  // attached to the surfaces' DCs while they're held
   /*static*/ CDC        m_dcOffscreen;
   /*static*/ CDC        m_dcText;
 
-  /*static*/ CBitmap    m_bmpOffscreen;
-  /*static*/ CBitmap    m_bmpText;
+  std::shared_ptr<OffscreenSurface> m_surfaceOffscreen;
+  std::shared_ptr<OffscreenSurface> m_surfaceText;
 
-  static CFont          m_fontText;
-  static CFont			m_fontTextHigh;
+  // fonts in use, m_fontCache owns them
+  static CFontHandle    m_fontText;
+  static CFontHandle    m_fontTextHigh;
+  static FontCache      m_fontCache;
+  static std::shared_ptr<FontCache::Font> m_cachedFontText;
+  static std::shared_ptr<FontCache::Font> m_cachedFontTextHigh;
+  static FontFallback   m_fallbackText;
+  static FontFallback   m_fallbackTextHigh;
+  static FontFallback::Runs      m_fallbackRuns;
+  static vector<unsigned short>  m_fallbackGlyphs;
 
   static int            m_nCharHeight;
   static int            m_nCharWidth;
@@ -250,6 +428,16 @@ private:
   static int            m_nHInsideBorder;
   static DWORD          m_dwFontSize;
   static DWORD          m_dwFontZoom;
+
+  static bool           m_bShowLatency;
+
+  // CPU text rendering, shared by the views like the fonts
+  static std::unique_ptr<BandRenderer>	m_bandRenderer;
+  static GlyphAtlas                     m_glyphAtlas;
+  static vector<BandRenderer::Cell>     m_bandCells;
+
+  // the rows' text before it's drawn, shared like the fonts
+  static TextBatch                      m_textBatch;
 };
 
 //////////////////////////////////////////////////////////////////////////////
@@ -35,10 +35,15 @@ DlgSettingsConsole::DlgSettingsConsole(CComPtr<IXMLDOMElement>& pOptionsRoot)
 
 LRESULT DlgSettingsConsole::OnInitDialog(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/)
 {
+	ExecuteDlgInit(IDD);
+
 	m_consoleSettings.Load(m_pOptionsRoot);
 	m_strShell		= m_consoleSettings.strShell.c_str();
 	m_strInitialDir	= m_consoleSettings.strInitialDir.c_str();
 
+	m_comboLocalEcho.Attach(GetDlgItem(IDC_COMBO_LOCAL_ECHO));
+	m_comboLocalEcho.SetCurSel(static_cast<int>(m_consoleSettings.localEcho));
+
 	CUpDownCtrl	spin;
 	UDACCEL udAccel;
 
@@ -150,6 +155,7 @@ LRESULT DlgSettingsConsole::OnCloseCmd(WORD /*wNotifyCode*/, WORD wID, HWND /*hW
 
 		m_consoleSettings.strShell		= m_strShell;
 		m_consoleSettings.strInitialDir	= m_strInitialDir;
+		m_consoleSettings.localEcho		= static_cast<LocalEcho>(m_comboLocalEcho.GetCurSel());
 
 		// set immediate settings
 		ConsoleSettings& consoleSettings = g_settingsHandler->GetConsoleSettings();
@@ -77,6 +77,8 @@ class DlgSettingsConsole
 		CString         m_strShell;
 		CString         m_strInitialDir;
 
+		CComboBox       m_comboLocalEcho;
+
 #ifdef _USE_AERO
 		CTrackBarCtrl   m_sliderBGTextOpacity;
 		CStatic         m_staticBGTextOpacity;
@@ -135,6 +135,10 @@ LRESULT DlgSettingsTabs::OnCloseCmd(WORD /*wNotifyCode*/, WORD wID, HWND /*hWndC
 
 		TabSettings& tabSettings = g_settingsHandler->GetTabSettings();
 
+		// no controls for these, they're set in the XML file only
+		tabSettings.dwShellPoolSize = m_tabSettings.dwShellPoolSize;
+		tabSettings.dwImageCacheSize = m_tabSettings.dwImageCacheSize;
+		tabSettings.dwHibernateTime = m_tabSettings.dwHibernateTime;
 		tabSettings.tabDataVector.clear();
 		tabSettings.tabDataVector.insert(
 									tabSettings.tabDataVector.begin(), 
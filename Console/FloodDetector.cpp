@@ -0,0 +1,118 @@
+#include "stdafx.h"
+
+#include "FloodDetector.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+FloodDetector::FloodDetector()
+: m_bFlooded(false)
+, m_nWindowStart(0)
+, m_dwWindowChanges(0)
+, m_dwRate(0)
+, m_bCrossed(false)
+, m_nCrossedTime(0)
+, m_bFramePainted(false)
+, m_nFrameTime(0)
+, m_dwFloods(0)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void FloodDetector::OnUpdate(unsigned long dwChangedCells, unsigned long dwCells, unsigned int nNow)
+{
+	// in thousandths of a percent, so single cells count on big screens; 64
+	// bits, a full 300x150 screen times 100000 doesn't fit in a long
+	if (dwCells > 0) m_dwWindowChanges += static_cast<unsigned long>(static_cast<unsigned long long>(dwChangedCells) * 100000 / dwCells);
+
+	CheckRate(nNow);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void FloodDetector::OnTick(unsigned int nNow)
+{
+	CheckRate(nNow);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool FloodDetector::IsFrameDue(unsigned int nNow) const
+{
+	return !m_bFlooded || !m_bFramePainted || (nNow - m_nFrameTime >= FRAME_TIME);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void FloodDetector::OnFrame(unsigned int nNow)
+{
+	m_bFramePainted	= true;
+	m_nFrameTime	= nNow;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void FloodDetector::CheckRate(unsigned int nNow)
+{
+	unsigned int nElapsed = nNow - m_nWindowStart;
+
+	if (nElapsed < RATE_WINDOW) return;
+
+	m_dwRate = m_dwWindowChanges / nElapsed;
+
+	bool bCrossing = m_bFlooded ? (m_dwRate < EXIT_RATE) : (m_dwRate >= ENTER_RATE);
+
+	if (!bCrossing)
+	{
+		m_bCrossed = false;
+	}
+	else
+	{
+		if (!m_bCrossed)
+		{
+			m_bCrossed		= true;
+			m_nCrossedTime	= m_nWindowStart;
+		}
+
+		if (nNow - m_nCrossedTime >= static_cast<unsigned int>(m_bFlooded ? EXIT_TIME : ENTER_TIME))
+		{
+			m_bFlooded = !m_bFlooded;
+			m_bCrossed = false;
+
+			if (m_bFlooded) ++m_dwFloods;
+		}
+	}
+
+	m_nWindowStart		= nNow;
+	m_dwWindowChanges	= 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,88 @@
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Tells a console flooding its view with output (a build, dir /s, a log
+// tail) from one being used, and paces the view's frames while it does.
+//
+// Console updates add the cells they changed; every RATE_WINDOW the change
+// rate, in percent of the screen per second, is checked against the
+// thresholds. Flood mode starts when the rate stays at ENTER_RATE or above
+// for ENTER_TIME and ends when it stays under EXIT_RATE for EXIT_TIME, so a
+// short burst doesn't start it and a short pause doesn't end it. While it's
+// on, the view paints at most once per FRAME_TIME, the latest state only.
+//
+// Times are milliseconds from a wrapping counter (GetTickCount). No Win32
+// dependency, it can be built and tested on its own.
+
+class FloodDetector
+{
+	public:
+
+		enum
+		{
+			// 5 screens per second start flood mode, 1 ends it
+			ENTER_RATE	= 500,
+			EXIT_RATE	= 100,
+
+			ENTER_TIME	= 300,
+			EXIT_TIME	= 1000,
+
+			RATE_WINDOW	= 100,
+
+			FRAME_TIME	= 250
+		};
+
+	public:
+
+		FloodDetector();
+
+	public:
+
+		// console update that changed dwChangedCells out of dwCells
+		void OnUpdate(unsigned long dwChangedCells, unsigned long dwCells, unsigned int nNow);
+
+		// checks the rate without an update, output may have stopped
+		void OnTick(unsigned int nNow);
+
+		bool IsFlooded() const { return m_bFlooded; }
+
+		// false while flooded and the last frame was painted less than
+		// FRAME_TIME ago
+		bool IsFrameDue(unsigned int nNow) const;
+		void OnFrame(unsigned int nNow);
+
+		// times flood mode started
+		unsigned long GetFloods() const { return m_dwFloods; }
+
+		// last change rate, percent of the screen per second
+		unsigned long GetRate() const { return m_dwRate; }
+
+	private:
+
+		void CheckRate(unsigned int nNow);
+
+	private:
+
+		bool			m_bFlooded;
+
+		// changes in the current rate window
+		unsigned int	m_nWindowStart;
+		unsigned long	m_dwWindowChanges;
+		unsigned long	m_dwRate;
+
+		// the rate has been on the other side of the threshold since
+		// m_nCrossedTime
+		bool			m_bCrossed;
+		unsigned int	m_nCrossedTime;
+
+		bool			m_bFramePainted;
+		unsigned int	m_nFrameTime;
+
+		unsigned long	m_dwFloods;
+};
+
+//////////////////////////////////////////////////////////////////////////////
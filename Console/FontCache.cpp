@@ -0,0 +1,125 @@
+#include "stdafx.h"
+
+#include "FontCache.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+FontCache::Key::Key()
+: strFace()
+, dwSize(0)
+, dwWeight(0)
+, bItalic(false)
+, dwDpi(0)
+, dwQuality(0)
+, dwScale(SCALE_NONE)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool FontCache::Key::operator<(const Key& other) const
+{
+	if (strFace != other.strFace) return strFace < other.strFace;
+	if (dwSize != other.dwSize) return dwSize < other.dwSize;
+	if (dwWeight != other.dwWeight) return dwWeight < other.dwWeight;
+	if (bItalic != other.bItalic) return !bItalic;
+	if (dwDpi != other.dwDpi) return dwDpi < other.dwDpi;
+	if (dwQuality != other.dwQuality) return dwQuality < other.dwQuality;
+
+	return dwScale < other.dwScale;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+FontCache::Font::Font(const std::shared_ptr<void>& handle, int nCharWidth, int nCharHeight, int nAscent)
+: m_handle(handle)
+, m_nCharWidth(nCharWidth)
+, m_nCharHeight(nCharHeight)
+, m_nAscent(nAscent)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+FontCache::FontCache(const Creator& creator, size_t stMaxFonts)
+: m_creator(creator)
+, m_stMaxFonts(stMaxFonts)
+, m_fonts()
+, m_index()
+, m_dwHits(0)
+, m_dwMisses(0)
+, m_dwEvictions(0)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+std::shared_ptr<FontCache::Font> FontCache::Get(const Key& key)
+{
+	FontIndex::iterator itIndex = m_index.find(key);
+
+	if (itIndex != m_index.end())
+	{
+		++m_dwHits;
+
+		m_fonts.splice(m_fonts.begin(), m_fonts, itIndex->second);
+		return itIndex->second->second;
+	}
+
+	++m_dwMisses;
+
+	std::shared_ptr<Font> font = m_creator(key);
+
+	if (!font) return font;
+
+	m_fonts.push_front(std::make_pair(key, font));
+	m_index[key] = m_fonts.begin();
+
+	while (m_fonts.size() > m_stMaxFonts)
+	{
+		m_index.erase(m_fonts.back().first);
+		m_fonts.pop_back();
+
+		++m_dwEvictions;
+	}
+
+	return font;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void FontCache::Clear()
+{
+	m_index.clear();
+	m_fonts.clear();
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <functional>
+#include <list>
+#include <map>
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Fonts the views draw text with, with their cell metrics, so zooming back
+// to a size or switching between fonts is a lookup instead of creating and
+// measuring GDI fonts again. The least recently used font is dropped when
+// there are more than the cache holds; views still using it keep it alive.
+//
+// Fonts are made by a creator callback; the font handle is kept in a
+// shared_ptr with its delete function. No Win32 dependency, it can be built
+// and tested on its own.
+
+class FontCache
+{
+	public:
+
+		enum
+		{
+			// the normal and intensified fonts and their linked fallback
+			// fonts, for a few sizes
+			MAX_FONTS	= 64,
+
+			// Key::dwScale of an unscaled font
+			SCALE_NONE	= 128
+		};
+
+		struct Key
+		{
+			Key();
+
+			bool operator<(const Key& other) const;
+
+			wstring			strFace;
+			// points
+			unsigned long	dwSize;
+			unsigned long	dwWeight;
+			bool			bItalic;
+			unsigned long	dwDpi;
+			unsigned long	dwQuality;
+			// height in 128ths of dwSize, linked fonts are scaled
+			unsigned long	dwScale;
+		};
+
+		class Font
+		{
+			public:
+
+				Font(const std::shared_ptr<void>& handle, int nCharWidth, int nCharHeight, int nAscent);
+
+			public:
+
+				void* GetHandle() const { return m_handle.get(); }
+
+				int GetCharWidth() const { return m_nCharWidth; }
+				int GetCharHeight() const { return m_nCharHeight; }
+				// pixels from the top of the cell to the baseline
+				int GetAscent() const { return m_nAscent; }
+
+			private:
+
+				std::shared_ptr<void>	m_handle;
+				int						m_nCharWidth;
+				int						m_nCharHeight;
+				int						m_nAscent;
+		};
+
+		// returns an empty pointer if the font can't be used
+		typedef std::function<std::shared_ptr<Font>(const Key& key)> Creator;
+
+	public:
+
+		FontCache(const Creator& creator, size_t stMaxFonts);
+
+	public:
+
+		// creates the font on a miss; failures aren't cached
+		std::shared_ptr<Font> Get(const Key& key);
+
+		void Clear();
+
+		size_t GetSize() const { return m_fonts.size(); }
+		unsigned long GetHits() const { return m_dwHits; }
+		unsigned long GetMisses() const { return m_dwMisses; }
+		unsigned long GetEvictions() const { return m_dwEvictions; }
+
+	private:
+
+		typedef std::list<std::pair<Key, std::shared_ptr<Font>>>	FontList;
+		typedef std::map<Key, FontList::iterator>					FontIndex;
+
+	private:
+
+		Creator			m_creator;
+		size_t			m_stMaxFonts;
+
+		// most recently used first
+		FontList		m_fonts;
+		FontIndex		m_index;
+
+		unsigned long	m_dwHits;
+		unsigned long	m_dwMisses;
+		unsigned long	m_dwEvictions;
+};
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,252 @@
+#include "stdafx.h"
+
+#include <cstring>
+#include <cwchar>
+
+#include "FontFallback.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+CoverageMap::CoverageMap()
+: m_bits()
+{
+	::memset(m_pageTypes, pageEmpty, sizeof(m_pageTypes));
+	::memset(m_pageOffsets, 0, sizeof(m_pageOffsets));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void CoverageMap::AddRange(unsigned long dwFirst, unsigned long dwCount)
+{
+	if (dwFirst >= 0x10000) return;
+	if (dwCount > 0x10000 - dwFirst) dwCount = 0x10000 - dwFirst;
+
+	unsigned long dwEnd = dwFirst + dwCount;
+
+	while (dwFirst < dwEnd)
+	{
+		unsigned long dwPage		= dwFirst / PAGE_SIZE;
+		unsigned long dwPageEnd		= (dwPage + 1) * PAGE_SIZE;
+		unsigned long dwRangeEnd	= (dwEnd < dwPageEnd) ? dwEnd : dwPageEnd;
+
+		if (m_pageTypes[dwPage] != pageFull)
+		{
+			if (dwRangeEnd - dwFirst == PAGE_SIZE)
+			{
+				m_pageTypes[dwPage] = pageFull;
+			}
+			else
+			{
+				if (m_pageTypes[dwPage] == pageEmpty)
+				{
+					m_pageTypes[dwPage]		= pagePartial;
+					m_pageOffsets[dwPage]	= static_cast<unsigned short>(m_bits.size());
+
+					m_bits.resize(m_bits.size() + PAGE_WORDS, 0);
+				}
+
+				unsigned int* pBits = &m_bits[m_pageOffsets[dwPage]];
+
+				for (unsigned long dwChar = dwFirst; dwChar < dwRangeEnd; ++dwChar)
+				{
+					unsigned long dwBit = dwChar % PAGE_SIZE;
+
+					pBits[dwBit / 32] |= 1u << (dwBit % 32);
+				}
+			}
+		}
+
+		dwFirst = dwRangeEnd;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+FontFallback::FontFallback()
+: m_fonts()
+, m_fontPages(CoverageMap::PAGES)
+, m_dwResolvedPages(0)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void FontFallback::Clear()
+{
+	m_fonts.clear();
+
+	for (size_t i = 0; i < m_fontPages.size(); ++i) m_fontPages[i].clear();
+	m_dwResolvedPages = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void FontFallback::AddFont(const std::shared_ptr<FontCache::Font>& font, const CoverageMap& coverage, const GlyphLoader& loader)
+{
+	if (m_fonts.size() >= MAX_FONTS) return;
+
+	FallbackFont fallbackFont;
+
+	fallbackFont.font		= font;
+	fallbackFont.coverage	= coverage;
+	fallbackFont.loader		= loader;
+	fallbackFont.glyphPages.resize(CoverageMap::PAGES);
+
+	m_fonts.push_back(fallbackFont);
+
+	// resolved pages may have another font now
+	for (size_t i = 0; i < m_fontPages.size(); ++i) m_fontPages[i].clear();
+	m_dwResolvedPages = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+int FontFallback::Resolve(wchar_t ch)
+{
+	unsigned long dwChar = static_cast<unsigned long>(ch);
+
+	if (dwChar >= 0x10000) return NO_FONT;
+
+	vector<unsigned char>& page = m_fontPages[dwChar / CoverageMap::PAGE_SIZE];
+
+	if (page.empty())
+	{
+		page.resize(CoverageMap::PAGE_SIZE, NO_FONT);
+
+		wchar_t chFirst = static_cast<wchar_t>(dwChar & ~(CoverageMap::PAGE_SIZE - 1));
+
+		for (int i = 0; i < CoverageMap::PAGE_SIZE; ++i)
+		{
+			for (size_t nFont = 0; nFont < m_fonts.size(); ++nFont)
+			{
+				if (m_fonts[nFont].coverage.Contains(static_cast<wchar_t>(chFirst + i)))
+				{
+					page[i] = static_cast<unsigned char>(nFont);
+					break;
+				}
+			}
+		}
+
+		++m_dwResolvedPages;
+	}
+
+	return page[dwChar % CoverageMap::PAGE_SIZE];
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void FontFallback::SplitRuns(const wchar_t* pszText, int nCount, Runs& runs)
+{
+	runs.clear();
+
+	for (int i = 0; i < nCount; ++i)
+	{
+		int nFont = Resolve(pszText[i]);
+
+		if (runs.empty() || (runs.back().nFont != nFont))
+		{
+			Run run;
+
+			run.nStart	= i;
+			run.nCount	= 0;
+			run.nFont	= nFont;
+
+			runs.push_back(run);
+		}
+
+		++runs.back().nCount;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool FontFallback::ParseLink(const wstring& strLink, wstring& strFace, unsigned long& dwScale)
+{
+	size_t stFace = strLink.find(L',');
+
+	if (stFace == wstring::npos) return false;
+
+	size_t stScale = strLink.find(L',', stFace + 1);
+
+	strFace = strLink.substr(stFace + 1, (stScale == wstring::npos) ? wstring::npos : stScale - stFace - 1);
+	dwScale = FontCache::SCALE_NONE;
+
+	if (strFace.empty()) return false;
+
+	if (stScale != wstring::npos)
+	{
+		unsigned long dwValue = ::wcstoul(strLink.c_str() + stScale + 1, NULL, 10);
+
+		// anything far off is taken for a broken entry
+		if ((dwValue >= FontCache::SCALE_NONE / 4) && (dwValue <= FontCache::SCALE_NONE * 4)) dwScale = dwValue;
+	}
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void FontFallback::GetGlyphs(int nFont, const wchar_t* pszText, int nCount, unsigned short* pwGlyphs)
+{
+	FallbackFont& fallbackFont = m_fonts[nFont];
+
+	for (int i = 0; i < nCount; ++i)
+	{
+		unsigned long dwChar = static_cast<unsigned long>(pszText[i]);
+
+		if (dwChar >= 0x10000)
+		{
+			pwGlyphs[i] = 0;
+			continue;
+		}
+
+		vector<unsigned short>& page = fallbackFont.glyphPages[dwChar / CoverageMap::PAGE_SIZE];
+
+		if (page.empty())
+		{
+			page.resize(CoverageMap::PAGE_SIZE, 0);
+			fallbackFont.loader(static_cast<wchar_t>(dwChar & ~(CoverageMap::PAGE_SIZE - 1)), CoverageMap::PAGE_SIZE, &page[0]);
+		}
+
+		pwGlyphs[i] = page[dwChar % CoverageMap::PAGE_SIZE];
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <functional>
+
+#include "FontCache.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// The characters of the BMP a font has glyphs for, as a two level bitmap:
+// 256 pages of 256 characters, with only the partly covered pages stored.
+
+class CoverageMap
+{
+	public:
+
+		enum
+		{
+			PAGE_SIZE	= 256,
+			PAGES		= 0x10000 / PAGE_SIZE
+		};
+
+	public:
+
+		CoverageMap();
+
+	public:
+
+		// characters past the BMP are left out
+		void AddRange(unsigned long dwFirst, unsigned long dwCount);
+
+		bool Contains(wchar_t ch) const
+		{
+			unsigned long dwChar = static_cast<unsigned long>(ch);
+
+			if (dwChar >= 0x10000) return false;
+
+			unsigned long dwPage = dwChar / PAGE_SIZE;
+
+			if (m_pageTypes[dwPage] != pagePartial) return m_pageTypes[dwPage] == pageFull;
+
+			unsigned long dwBit = dwChar % PAGE_SIZE;
+
+			return ((m_bits[m_pageOffsets[dwPage] + dwBit / 32] >> (dwBit % 32)) & 1) != 0;
+		}
+
+		size_t GetBytes() const { return sizeof(m_pageTypes) + sizeof(m_pageOffsets) + m_bits.size() * sizeof(unsigned int); }
+
+	private:
+
+		enum PageType
+		{
+			pageEmpty	= 0,
+			pageFull	= 1,
+			pagePartial	= 2
+		};
+
+		enum
+		{
+			PAGE_WORDS	= PAGE_SIZE / 32
+		};
+
+	private:
+
+		unsigned char			m_pageTypes[PAGES];
+		// where partial pages' bits start in m_bits
+		unsigned short			m_pageOffsets[PAGES];
+		vector<unsigned int>	m_bits;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Picks the font each character is drawn with: the text font if it has a
+// glyph for it, else the first fallback font that does (Windows' font link
+// list for the text font). Text is split into runs of the same font up
+// front and each run is drawn by glyph index, so GDI doesn't look for
+// missing glyphs on every call. Fallback runs are moved down by the
+// difference in ascent, so their glyphs sit on the text font's baseline.
+//
+// Fonts are picked from a table built a page at a time, and glyph indices
+// are loaded a page at a time per font. No Win32 dependency, it can be
+// built and tested on its own.
+
+class FontFallback
+{
+	public:
+
+		// glyph indices of nCount characters starting at chFirst
+		typedef std::function<void(wchar_t chFirst, int nCount, unsigned short* pwGlyphs)> GlyphLoader;
+
+		enum
+		{
+			// no font has the character, it's left to GDI
+			NO_FONT		= 0xFF,
+			MAX_FONTS	= 16
+		};
+
+		struct Run
+		{
+			int		nStart;
+			int		nCount;
+			// NO_FONT for characters no font has
+			int		nFont;
+		};
+
+		typedef vector<Run>	Runs;
+
+	public:
+
+		FontFallback();
+
+	public:
+
+		void Clear();
+
+		// fonts are tried in the order they're added, the text font first;
+		// past MAX_FONTS they're ignored
+		void AddFont(const std::shared_ptr<FontCache::Font>& font, const CoverageMap& coverage, const GlyphLoader& loader);
+
+		size_t GetFontCount() const { return m_fonts.size(); }
+		const std::shared_ptr<FontCache::Font>& GetFont(int nFont) const { return m_fonts[nFont].font; }
+
+		// pixels to add to the text font's y to draw font nFont on the same
+		// baseline
+		int GetBaselineOffset(int nFont) const { return m_fonts[0].font->GetAscent() - m_fonts[nFont].font->GetAscent(); }
+
+		// splits a font link entry, "file,face[,scaling,scaling]"; the
+		// scaling factors are in 128ths of the font's height, the first one
+		// is GDI's. Returns false for a file without a face name
+		static bool ParseLink(const wstring& strLink, wstring& strFace, unsigned long& dwScale);
+
+		// the font to draw the character with, or NO_FONT
+		int Resolve(wchar_t ch);
+
+		void SplitRuns(const wchar_t* pszText, int nCount, Runs& runs);
+
+		// glyph indices of the characters in font nFont
+		void GetGlyphs(int nFont, const wchar_t* pszText, int nCount, unsigned short* pwGlyphs);
+
+		unsigned long GetResolvedPages() const { return m_dwResolvedPages; }
+
+	private:
+
+		struct FallbackFont
+		{
+			std::shared_ptr<FontCache::Font>	font;
+			CoverageMap							coverage;
+			GlyphLoader							loader;
+			// empty until loaded
+			vector<vector<unsigned short>>		glyphPages;
+		};
+
+	private:
+
+		vector<FallbackFont>			m_fonts;
+
+		// a font index per character, empty until resolved
+		vector<vector<unsigned char>>	m_fontPages;
+		unsigned long					m_dwResolvedPages;
+};
+
+//////////////////////////////////////////////////////////////////////////////
@@ -1,5 +1,10 @@
 #include "StdAfx.h"
 #include "Helpers.h"
+#include "PixelKernels.h"
+#include "Console.h"
+#include "IconCache.h"
+
+#include <fstream>
 
 //////////////////////////////////////////////////////////////////////////////
 
@@ -161,6 +166,37 @@ HBITMAP Helpers::CreateBitmap(HDC dc, DWORD dwWidth, DWORD dwHeight, CBitmap& bi
 //////////////////////////////////////////////////////////////////////////////
 
 
+//////////////////////////////////////////////////////////////////////////////
+
+bool Helpers::GetBitmapSurface(HBITMAP hBitmap, PixelSurface& surface)
+{
+	DIBSECTION	dibSection;
+
+	if (hBitmap == NULL) return false;
+	if (::GetObject(hBitmap, sizeof(DIBSECTION), &dibSection) != sizeof(DIBSECTION)) return false;
+	if ((dibSection.dsBm.bmBits == NULL) || (dibSection.dsBm.bmBitsPixel != 32)) return false;
+
+	// GDI may still be drawing into the bitmap
+	::GdiFlush();
+
+	surface.nWidth	= dibSection.dsBm.bmWidth;
+	surface.nHeight	= dibSection.dsBm.bmHeight;
+	surface.pPixels	= static_cast<unsigned char*>(dibSection.dsBm.bmBits);
+	surface.nPitch	= dibSection.dsBm.bmWidthBytes;
+
+	// bottom-up DIB, start at the top row
+	if (dibSection.dsBmih.biHeight > 0)
+	{
+		surface.pPixels	+= (surface.nHeight - 1) * surface.nPitch;
+		surface.nPitch	= -surface.nPitch;
+	}
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
 //////////////////////////////////////////////////////////////////////////////
 
 wstring Helpers::LoadString(UINT uID)
@@ -180,6 +216,9 @@ wstring Helpers::LoadString(UINT uID)
 
 HICON Helpers::LoadTabIcon(bool bBigIcon, bool bUseDefaultIcon, const wstring& strIcon, const wstring& strShell)
 {
+  if (g_iconCache)
+    return g_iconCache->LoadTabIcon(bBigIcon, bUseDefaultIcon, strIcon, strShell);
+
   if (bUseDefaultIcon)
   {
     if ( !strShell.empty() )
@@ -285,3 +324,18 @@ HICON Helpers::LoadTabIcon(bool bBigIcon, bool bUseDefaultIcon, const wstring& s
 
 //////////////////////////////////////////////////////////////////////////////
 
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void Helpers::DumpTrace(const wstring& strFileName)
+{
+	ofstream of;
+	of.open(ExpandEnvironmentStrings(strFileName).c_str());
+
+	Tracer::Dump(of);
+
+	of.close();
+}
+
+//////////////////////////////////////////////////////////////////////////////
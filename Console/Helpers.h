@@ -8,6 +8,10 @@
 //////////////////////////////////////////////////////////////////////////////
 
 
+//////////////////////////////////////////////////////////////////////////////
+
+struct PixelSurface;
+
 //////////////////////////////////////////////////////////////////////////////
 
 class Helpers
@@ -25,10 +29,16 @@ class Helpers
 		static bool GetDesktopRect(const CPoint& point, CRect& rectDesktop);
 
 		static HBITMAP CreateBitmap(HDC dc, DWORD dwWidth, DWORD dwHeight, CBitmap& bitmap);
+		// pixel memory of a 32 bpp DIB section, for PixelKernels; flushes
+		// pending GDI drawing first. Returns false for other bitmaps.
+		static bool GetBitmapSurface(HBITMAP hBitmap, PixelSurface& surface);
 
 		static wstring LoadString(UINT uID);
 		static HICON LoadTabIcon(bool bBigIcon, bool bUseDefaultIcon, const wstring& strIcon, const wstring& strShell);
 
+		// writes recorded trace events as Chrome trace JSON
+		static void DumpTrace(const wstring& strFileName);
+
 	private:
 
 		static bool GetMonitorRect(HMONITOR hMonitor, bool bIgnoreTaskbar, CRect& rectDesktop);
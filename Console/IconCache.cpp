@@ -0,0 +1,355 @@
+#include "stdafx.h"
+
+#include "resource.h"
+#include "Console.h"
+#include "IconCache.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+IconCache::IconCache()
+: m_cacheCritSec()
+, m_icons()
+, m_prewarmKeys()
+, m_dwHits(0)
+, m_dwMisses(0)
+, m_dwPrewarmed(0)
+, m_hPrewarmEvent(::CreateEvent(NULL, FALSE, FALSE, NULL))
+{
+}
+
+IconCache::~IconCache()
+{
+	try
+	{
+		Stop(INFINITE);
+	}
+	catch(std::exception&)
+	{
+	}
+
+	Clear();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+HICON IconCache::LoadTabIcon(bool bBigIcon, bool bUseDefaultIcon, const wstring& strIcon, const wstring& strShell)
+{
+	IconKey	key;
+
+	if (GetIconKey(bBigIcon, bUseDefaultIcon, strIcon, strShell, key))
+	{
+		HICON hIcon = GetIcon(key);
+
+		if (hIcon) return ::CopyIcon(hIcon);
+	}
+
+	return LoadDefaultIcon(bBigIcon);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void IconCache::Prewarm()
+{
+	TabSettings&	tabSettings		= g_settingsHandler->GetTabSettings();
+	WindowSettings&	windowSettings	= g_settingsHandler->GetAppearanceSettings().windowSettings;
+
+	{
+		CriticalSectionLock	lock(m_cacheCritSec);
+
+		m_prewarmKeys.clear();
+
+		AddPrewarmKeys(false, windowSettings.strIcon, L"");
+
+		for (TabDataVector::iterator it = tabSettings.tabDataVector.begin(); it != tabSettings.tabDataVector.end(); ++it)
+		{
+			AddPrewarmKeys((*it)->bUseDefaultIcon, (*it)->strIcon, (*it)->strShell);
+		}
+	}
+
+	::SetEvent(m_hPrewarmEvent.get());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void IconCache::Clear()
+{
+	Icons	icons;
+
+	{
+		CriticalSectionLock	lock(m_cacheCritSec);
+
+		icons.swap(m_icons);
+		m_prewarmKeys.clear();
+	}
+
+	for (Icons::iterator it = icons.begin(); it != icons.end(); ++it)
+	{
+		if (it->second) ::DestroyIcon(it->second);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void IconCache::DumpStats(wostream& os)
+{
+	CriticalSectionLock	lock(m_cacheCritSec);
+
+	os << L"icons: " << m_icons.size() << L" cached, " << m_dwHits << L" hits, " << m_dwMisses << L" misses, "
+	   << m_dwPrewarmed << L" prewarmed" << endl;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+DWORD IconCache::Process(HANDLE hStopSignal)
+{
+	TRACE_THREAD_NAME("IconCache");
+
+	// SHGetFileInfo needs COM
+	::CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
+
+	HANDLE arrWaitHandles[] = { hStopSignal, m_hPrewarmEvent.get() };
+
+	while (::WaitForMultipleObjects(sizeof(arrWaitHandles)/sizeof(arrWaitHandles[0]), arrWaitHandles, FALSE, INFINITE) == WAIT_OBJECT_0 + 1)
+	{
+		// one icon at a time, the critical section is never held while the
+		// shell is extracting
+		for (;;)
+		{
+			if (::WaitForSingleObject(hStopSignal, 0) == WAIT_OBJECT_0) break;
+
+			IconKey	key;
+
+			{
+				CriticalSectionLock	lock(m_cacheCritSec);
+
+				if (m_prewarmKeys.empty()) break;
+
+				key = m_prewarmKeys.back();
+				m_prewarmKeys.pop_back();
+
+				if (m_icons.find(key) != m_icons.end()) continue;
+			}
+
+			HICON hIcon = ExtractTabIcon(key);
+
+			{
+				CriticalSectionLock	lock(m_cacheCritSec);
+
+				if (m_icons.insert(Icons::value_type(key, hIcon)).second)
+				{
+					++m_dwPrewarmed;
+					hIcon = NULL;
+				}
+			}
+
+			// the UI thread got to it first
+			if (hIcon) ::DestroyIcon(hIcon);
+		}
+	}
+
+	::CoUninitialize();
+
+	return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool IconCache::GetIconKey(bool bBigIcon, bool bUseDefaultIcon, const wstring& strIcon, const wstring& strShell, IconKey& key)
+{
+	key.bBigIcon = bBigIcon;
+
+	if (bUseDefaultIcon)
+	{
+		if (strShell.empty()) return false;
+
+		wstring strCommandLine = Helpers::ExpandEnvironmentStrings(strShell);
+		int argc = 0;
+		std::unique_ptr<LPWSTR[], LocalFreeHelper> argv(::CommandLineToArgvW(strCommandLine.c_str(), &argc));
+
+		if (!argv || (argc == 0)) return false;
+
+		key.strFile		= argv[0];
+		key.nIndex		= 0;
+		key.bFileIcon	= true;
+
+		return true;
+	}
+
+	if (strIcon.empty()) return false;
+
+	int index = 0;
+
+	// check strIcon ends with ,<integer>
+	bool ok = false;
+
+	size_t pos = strIcon.find_last_of(L',');
+	if( pos != wstring::npos )
+	{
+		for(size_t i = pos + 1; i < strIcon.length(); ++i)
+		{
+			if( strIcon.at(i) >= L'0' && strIcon.at(i) <= L'9' )
+			{
+				ok = true;
+				index = index * 10 + (strIcon.at(i) - L'0');
+			}
+			else
+			{
+				ok = false;
+				break;
+			}
+		}
+	}
+
+	key.strFile		= Helpers::ExpandEnvironmentStrings(ok ? strIcon.substr(0, pos) : strIcon);
+	key.nIndex		= index;
+	key.bFileIcon	= false;
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+HICON IconCache::ExtractTabIcon(const IconKey& key)
+{
+	TRACE_SCOPE("IconCache::ExtractTabIcon");
+
+	if (key.bFileIcon)
+	{
+		SHFILEINFO info;
+		memset(&info, 0, sizeof(info));
+
+		if (::SHGetFileInfo(
+				key.strFile.c_str(),
+				0,
+				&info,
+				sizeof(info),
+				SHGFI_ICON | (key.bBigIcon ? SHGFI_LARGEICON : SHGFI_SMALLICON)) != 0)
+		{
+			return info.hIcon;
+		}
+
+		return NULL;
+	}
+
+	HICON hIcon = NULL;
+
+	::ExtractIconEx(
+		key.strFile.c_str(),
+		key.nIndex,
+		key.bBigIcon ? &hIcon : NULL,
+		key.bBigIcon ? NULL : &hIcon,
+		1);
+
+	return hIcon;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+HICON IconCache::LoadDefaultIcon(bool bBigIcon)
+{
+	if (bBigIcon)
+	{
+		return static_cast<HICON>(
+			::LoadImage(
+				::GetModuleHandle(NULL),
+				MAKEINTRESOURCE(IDR_MAINFRAME),
+				IMAGE_ICON,
+				0,
+				0,
+				LR_DEFAULTCOLOR | LR_DEFAULTSIZE));
+	}
+	else
+	{
+		return static_cast<HICON>(
+			::LoadImage(
+				::GetModuleHandle(NULL),
+				MAKEINTRESOURCE(IDR_MAINFRAME),
+				IMAGE_ICON,
+				16,
+				16,
+				LR_DEFAULTCOLOR));
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void IconCache::AddPrewarmKeys(bool bUseDefaultIcon, const wstring& strIcon, const wstring& strShell)
+{
+	IconKey	key;
+
+	if (GetIconKey(true, bUseDefaultIcon, strIcon, strShell, key)) m_prewarmKeys.push_back(key);
+	if (GetIconKey(false, bUseDefaultIcon, strIcon, strShell, key)) m_prewarmKeys.push_back(key);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+HICON IconCache::GetIcon(const IconKey& key)
+{
+	{
+		CriticalSectionLock	lock(m_cacheCritSec);
+
+		Icons::iterator it = m_icons.find(key);
+
+		if (it != m_icons.end())
+		{
+			++m_dwHits;
+			TRACE_COUNTER("IconCache::Hits", m_dwHits);
+
+			return it->second;
+		}
+	}
+
+	HICON hIcon = ExtractTabIcon(key);
+
+	CriticalSectionLock	lock(m_cacheCritSec);
+
+	std::pair<Icons::iterator, bool> result = m_icons.insert(Icons::value_type(key, hIcon));
+
+	// the cache thread got to it first
+	if (!result.second && hIcon) ::DestroyIcon(hIcon);
+
+	++m_dwMisses;
+	TRACE_COUNTER("IconCache::Misses", m_dwMisses);
+
+	return result.first->second;
+}
+
+//////////////////////////////////////////////////////////////////////////////
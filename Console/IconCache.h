@@ -0,0 +1,115 @@
+#pragma once
+
+#include <unordered_map>
+
+#include "Wallpaper.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Tab and window icons, keyed by the expanded file they come from, the icon
+// index and the size. Getting an icon from the shell can take tens of
+// milliseconds (much more on network paths), so each one is extracted once
+// and copies are handed out. Icons of all tabs are extracted on the cache's
+// own thread at startup and after settings change.
+
+class IconCache : public MyThread
+{
+	public:
+
+		IconCache();
+		virtual ~IconCache();
+
+	public:
+
+		// same as Helpers::LoadTabIcon, the caller owns the returned icon
+		HICON LoadTabIcon(bool bBigIcon, bool bUseDefaultIcon, const wstring& strIcon, const wstring& strShell);
+
+		// queues the icons of every tab (and the window) for the cache thread
+		void Prewarm();
+
+		// drops all icons, the files they came from may have changed
+		void Clear();
+
+		void DumpStats(wostream& os);
+
+		virtual DWORD Process(HANDLE hStopSignal);
+
+	private:
+
+		struct IconKey
+		{
+			IconKey()
+			: strFile()
+			, nIndex(0)
+			, bBigIcon(false)
+			, bFileIcon(false)
+			{
+			}
+
+			bool operator==(const IconKey& other) const
+			{
+				return
+					(strFile == other.strFile) &&
+					(nIndex == other.nIndex) &&
+					(bBigIcon == other.bBigIcon) &&
+					(bFileIcon == other.bFileIcon);
+			}
+
+			wstring	strFile;
+			int		nIndex;
+			bool	bBigIcon;
+
+			// the icon the shell shows for strFile, rather than one of its
+			// icon resources
+			bool	bFileIcon;
+		};
+
+		struct IconKeyHash
+		{
+			size_t operator()(const IconKey& key) const
+			{
+				size_t stHash = std::hash<wstring>()(key.strFile);
+
+				stHash = stHash * 31 + static_cast<size_t>(key.nIndex);
+				stHash = stHash * 31 + static_cast<size_t>(key.bBigIcon);
+				stHash = stHash * 31 + static_cast<size_t>(key.bFileIcon);
+
+				return stHash;
+			}
+		};
+
+		// extracted icons, NULL if extraction failed
+		typedef std::unordered_map<IconKey, HICON, IconKeyHash>	Icons;
+
+	private:
+
+		// false if the tab uses Console's own icon
+		static bool GetIconKey(bool bBigIcon, bool bUseDefaultIcon, const wstring& strIcon, const wstring& strShell, IconKey& key);
+		static HICON ExtractTabIcon(const IconKey& key);
+		static HICON LoadDefaultIcon(bool bBigIcon);
+
+		void AddPrewarmKeys(bool bUseDefaultIcon, const wstring& strIcon, const wstring& strShell);
+
+		// cached icon, extracted if it isn't there yet
+		HICON GetIcon(const IconKey& key);
+
+	private:
+
+		CriticalSection		m_cacheCritSec;
+
+		Icons				m_icons;
+
+		// icons the cache thread extracts next
+		vector<IconKey>		m_prewarmKeys;
+
+		DWORD				m_dwHits;
+		DWORD				m_dwMisses;
+		DWORD				m_dwPrewarmed;
+
+		std::unique_ptr<void, CloseHandleHelper>	m_hPrewarmEvent;
+};
+
+//////////////////////////////////////////////////////////////////////////////
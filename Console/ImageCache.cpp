@@ -0,0 +1,201 @@
+#include "stdafx.h"
+
+#include "ImageCache.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+ImageCache::ImageCache(const Loader& loader, size_t stBudget)
+: m_loader(loader)
+, m_entries()
+, m_stats()
+{
+	m_stats.stBudget = stBudget;
+}
+
+ImageCache::~ImageCache()
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+std::shared_ptr<ImageCacheEntry> ImageCache::GetEntry(const wstring& strFilename)
+{
+	EntryFilenameIndex&				index	= m_entries.get<filename>();
+	EntryFilenameIndex::iterator	it		= index.find(strFilename);
+
+	if (it != index.end()) return *it;
+
+	std::shared_ptr<ImageCacheEntry> entry(new ImageCacheEntry(strFilename));
+	m_entries.push_front(entry);
+
+	return entry;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+std::shared_ptr<fipImage> ImageCache::GetImage(const std::shared_ptr<ImageCacheEntry>& entry)
+{
+	if (!entry) return std::shared_ptr<fipImage>();
+
+	EntryFilenameIndex&				index	= m_entries.get<filename>();
+	EntryFilenameIndex::iterator	it		= index.find(entry->strFilename);
+
+	// mark as most recently used
+	if (it != index.end()) m_entries.relocate(m_entries.begin(), m_entries.project<0>(it));
+
+	if (entry->image)
+	{
+		++entry->dwHits;
+		++m_stats.dwHits;
+
+		return entry->image;
+	}
+
+	if (entry->bFailed) return std::shared_ptr<fipImage>();
+
+	size_t						stBytes	= 0;
+	std::shared_ptr<fipImage>	image(m_loader(entry->strFilename, stBytes));
+
+	SetImage(entry, image, stBytes);
+
+	return image;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ImageCache::SetImage(const std::shared_ptr<ImageCacheEntry>& entry, const std::shared_ptr<fipImage>& image, size_t stBytes)
+{
+	if (entry->image) Evict(*entry);
+
+	++entry->dwLoads;
+	++m_stats.dwLoads;
+
+	entry->bFailed = !image;
+
+	if (!image) return;
+
+	EntryFilenameIndex&				index	= m_entries.get<filename>();
+	EntryFilenameIndex::iterator	it		= index.find(entry->strFilename);
+
+	if (it != index.end()) m_entries.relocate(m_entries.begin(), m_entries.project<0>(it));
+
+	entry->image	= image;
+	entry->stBytes	= stBytes;
+
+	m_stats.stBytes += stBytes;
+	++m_stats.stDecoded;
+
+	Trim();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ImageCache::Invalidate(const std::shared_ptr<ImageCacheEntry>& entry)
+{
+	if (!entry) return;
+
+	entry->bFailed = false;
+
+	if (entry->image) Evict(*entry);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ImageCache::Trim()
+{
+	EntriesSequence::iterator it = m_entries.begin();
+
+	// entries are referenced by the cache and their users
+	while (it != m_entries.end())
+	{
+		if (it->use_count() > 1)
+		{
+			++it;
+			continue;
+		}
+
+		if ((*it)->image) Evict(**it);
+		it = m_entries.erase(it);
+	}
+
+	// least recently used first, skip the ones in use; the most recent one is
+	// kept even if it's over the budget on its own, it's about to be painted
+	EntriesSequence::reverse_iterator itLru = m_entries.rbegin();
+
+	for (; (itLru != m_entries.rend()) && (m_stats.stBytes > m_stats.stBudget); ++itLru)
+	{
+		ImageCacheEntry& entry = **itLru;
+
+		if (&entry == m_entries.front().get()) break;
+		if (!entry.image || (entry.image.use_count() > 1)) continue;
+
+		Evict(entry);
+		++m_stats.dwEvictions;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ImageCache::SetBudget(size_t stBudget)
+{
+	m_stats.stBudget = stBudget;
+	Trim();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+ImageCacheStats ImageCache::GetStats() const
+{
+	ImageCacheStats stats(m_stats);
+
+	stats.stEntries = m_entries.size();
+
+	return stats;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ImageCache::Evict(ImageCacheEntry& entry)
+{
+	// anyone still using the image keeps their copy
+	entry.image.reset();
+
+	m_stats.stBytes -= entry.stBytes;
+	--m_stats.stDecoded;
+
+	entry.stBytes = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <functional>
+#include <boost/multi_index/hashed_index.hpp>
+
+class fipImage;
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Decoded image file, shared by all background images using the same file.
+// The decode can be dropped by the cache at any time it's not in use and
+// is reloaded from disk on the next access.
+
+struct ImageCacheEntry
+{
+	explicit ImageCacheEntry(const wstring& filename)
+	: strFilename(filename)
+	, image()
+	, stBytes(0)
+	, bFailed(false)
+	, dwLoads(0)
+	, dwHits(0)
+	{
+	}
+
+	wstring						strFilename;
+
+	std::shared_ptr<fipImage>	image;
+	size_t						stBytes;
+
+	// the last load failed, not retried until invalidated
+	bool						bFailed;
+
+	// number of decodes and cache hits
+	unsigned long				dwLoads;
+	unsigned long				dwHits;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+struct ImageCacheStats
+{
+	ImageCacheStats()
+	: stBudget(0)
+	, stBytes(0)
+	, stEntries(0)
+	, stDecoded(0)
+	, dwLoads(0)
+	, dwHits(0)
+	, dwEvictions(0)
+	{
+	}
+
+	size_t			stBudget;
+	size_t			stBytes;
+	size_t			stEntries;
+	size_t			stDecoded;
+
+	unsigned long	dwLoads;
+	unsigned long	dwHits;
+	unsigned long	dwEvictions;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Decoded image files, keyed by file name.
+//
+// Entries are reference counted through the shared pointers handed out by
+// GetEntry; an entry nobody holds anymore is removed on the next Trim.
+// When decoded images take more than the budget, the least recently used
+// ones are dropped, except those currently in use (someone else holds the
+// fipImage pointer) and the most recently used one.
+//
+// Not thread safe, it's used by the UI thread only.
+
+class ImageCache
+{
+	public:
+
+		// decodes a file, sets stBytes to the decoded size; returns an empty
+		// pointer on failure
+		typedef std::function<std::shared_ptr<fipImage>(const wstring& strFilename, size_t& stBytes)>	Loader;
+
+	public:
+
+		ImageCache(const Loader& loader, size_t stBudget);
+		~ImageCache();
+
+	public:
+
+		std::shared_ptr<ImageCacheEntry> GetEntry(const wstring& strFilename);
+
+		// returns the decoded image, loading it if needed; the caller holds it
+		// for as long as it's in use
+		std::shared_ptr<fipImage> GetImage(const std::shared_ptr<ImageCacheEntry>& entry);
+
+		// stores an image decoded elsewhere; an empty image marks the entry failed
+		void SetImage(const std::shared_ptr<ImageCacheEntry>& entry, const std::shared_ptr<fipImage>& image, size_t stBytes);
+
+		// drops the decode, e.g. when the file has changed
+		void Invalidate(const std::shared_ptr<ImageCacheEntry>& entry);
+
+		// removes unused entries and evicts decodes until within budget
+		void Trim();
+
+		void SetBudget(size_t stBudget);
+
+		ImageCacheStats GetStats() const;
+
+	private:
+
+		void Evict(ImageCacheEntry& entry);
+
+	private:
+
+		struct filename{};
+
+		typedef multi_index_container<
+					std::shared_ptr<ImageCacheEntry>,
+					indexed_by
+					<
+						// most recently used first
+						sequenced<>,
+						hashed_unique<tag<filename>, member<ImageCacheEntry, wstring, &ImageCacheEntry::strFilename> >
+					> >										Entries;
+
+		typedef nth_index<Entries,0>::type					EntriesSequence;
+		typedef Entries::index<filename>::type				EntryFilenameIndex;
+
+	private:
+
+		Loader			m_loader;
+		Entries			m_entries;
+
+		ImageCacheStats	m_stats;
+};
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,180 @@
+#include "stdafx.h"
+
+#include <algorithm>
+
+#include "ImageDecoder.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+ImageDecoder::ImageDecoder(const Decoder& decoder, const NotifyCallback& notify, size_t stThreads)
+: m_decoder(decoder)
+, m_notify(notify)
+, m_mutex()
+, m_requestCondition()
+, m_requests()
+, m_running()
+, m_results()
+, m_dwSequence(0)
+, m_bStop(false)
+, m_threads()
+{
+	if (stThreads == 0) stThreads = 1;
+
+	for (size_t i = 0; i < stThreads; ++i)
+	{
+		m_threads.push_back(std::thread(&ImageDecoder::Process, this));
+	}
+}
+
+ImageDecoder::~ImageDecoder()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_bStop = true;
+		m_requests.clear();
+	}
+
+	m_requestCondition.notify_all();
+
+	for (size_t i = 0; i < m_threads.size(); ++i) m_threads[i].join();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ImageDecoder::Request(const wstring& strFilename, Priority priority)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (std::find(m_running.begin(), m_running.end(), strFilename) != m_running.end()) return;
+
+		for (Results::iterator it = m_results.begin(); it != m_results.end(); ++it)
+		{
+			if (it->strFilename == strFilename) return;
+		}
+
+		DecodeRequests::iterator it = m_requests.begin();
+		for (; it != m_requests.end(); ++it) if (it->strFilename == strFilename) break;
+
+		if (it != m_requests.end())
+		{
+			if (priority > it->priority) it->priority = priority;
+			return;
+		}
+
+		DecodeRequest request;
+
+		request.strFilename	= strFilename;
+		request.priority	= priority;
+		request.dwSequence	= m_dwSequence++;
+
+		m_requests.push_back(request);
+	}
+
+	m_requestCondition.notify_one();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool ImageDecoder::IsPending(const wstring& strFilename)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (std::find(m_running.begin(), m_running.end(), strFilename) != m_running.end()) return true;
+
+	for (DecodeRequests::iterator it = m_requests.begin(); it != m_requests.end(); ++it)
+	{
+		if (it->strFilename == strFilename) return true;
+	}
+
+	for (Results::iterator it = m_results.begin(); it != m_results.end(); ++it)
+	{
+		if (it->strFilename == strFilename) return true;
+	}
+
+	return false;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ImageDecoder::GetResults(Results& results)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	results.swap(m_results);
+	m_results.clear();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ImageDecoder::Process()
+{
+	TRACE_THREAD_NAME("ImageDecoder");
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	for (;;)
+	{
+		while (!m_bStop && m_requests.empty()) m_requestCondition.wait(lock);
+
+		if (m_bStop) break;
+
+		// highest priority, then oldest
+		DecodeRequests::iterator itNext = m_requests.begin();
+
+		for (DecodeRequests::iterator it = m_requests.begin(); it != m_requests.end(); ++it)
+		{
+			if ((it->priority > itNext->priority) ||
+				((it->priority == itNext->priority) && (it->dwSequence < itNext->dwSequence)))
+			{
+				itNext = it;
+			}
+		}
+
+		Result result;
+
+		result.strFilename	= itNext->strFilename;
+		result.stBytes		= 0;
+
+		m_requests.erase(itNext);
+		m_running.push_back(result.strFilename);
+
+		lock.unlock();
+		result.image = m_decoder(result.strFilename, result.stBytes);
+		lock.lock();
+
+		m_running.erase(std::find(m_running.begin(), m_running.end(), result.strFilename));
+		m_results.push_back(result);
+
+		// one notification per batch, the UI thread takes them all at once
+		if (m_results.size() == 1)
+		{
+			lock.unlock();
+			m_notify();
+			lock.lock();
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
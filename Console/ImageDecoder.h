@@ -0,0 +1,97 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "ImageCache.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Decodes image files on a pool of worker threads. Requests for visible
+// images are taken before the others, oldest first within a priority.
+//
+// Finished decodes are collected until GetResults is called; the notify
+// callback runs on a worker thread when the first one is ready, and again
+// only after the results have been taken.
+//
+// Uses standard threads only, so it can be built and tested on its own.
+
+class ImageDecoder
+{
+	public:
+
+		enum Priority
+		{
+			priorityBackground	= 0,
+			priorityVisible		= 1
+		};
+
+		typedef ImageCache::Loader		Decoder;
+		typedef std::function<void()>	NotifyCallback;
+
+		struct Result
+		{
+			wstring						strFilename;
+			// empty if the file couldn't be decoded
+			std::shared_ptr<fipImage>	image;
+			size_t						stBytes;
+		};
+
+		typedef vector<Result>	Results;
+
+	public:
+
+		ImageDecoder(const Decoder& decoder, const NotifyCallback& notify, size_t stThreads);
+		// waits for running decodes, pending ones are dropped
+		~ImageDecoder();
+
+	public:
+
+		// queues a decode, or raises the priority of a queued one; files
+		// being decoded or with results not taken yet aren't queued again
+		void Request(const wstring& strFilename, Priority priority);
+
+		// queued, running or finished but not taken
+		bool IsPending(const wstring& strFilename);
+
+		// takes the decodes finished so far
+		void GetResults(Results& results);
+
+	private:
+
+		void Process();
+
+	private:
+
+		struct DecodeRequest
+		{
+			wstring			strFilename;
+			Priority		priority;
+			unsigned long	dwSequence;
+		};
+
+		typedef vector<DecodeRequest>	DecodeRequests;
+
+	private:
+
+		Decoder						m_decoder;
+		NotifyCallback				m_notify;
+
+		std::mutex					m_mutex;
+		std::condition_variable		m_requestCondition;
+
+		DecodeRequests				m_requests;
+		vector<wstring>				m_running;
+		Results						m_results;
+
+		unsigned long				m_dwSequence;
+		bool						m_bStop;
+
+		vector<std::thread>			m_threads;
+};
+
+//////////////////////////////////////////////////////////////////////////////
@@ -1,5 +1,8 @@
 #include "StdAfx.h"
 #include "ImageHandler.h"
+#include "ImageDecoder.h"
+#include "ImageRescaler.h"
+#include "PixelKernels.h"
 
 //////////////////////////////////////////////////////////////////////////////
 
@@ -39,13 +42,32 @@ bool ImageHandler::CheckWin8()
   }
 }
 
+// bitmaps kept per image for earlier client sizes, besides the current one
+static const size_t	IMAGE_CACHE_SIZE = 4;
+
+// decoded images kept when not in use, until settings are loaded
+static const size_t	IMAGE_CACHE_BUDGET = 128 * 1024 * 1024;
+
+// decoding is mostly bound by memory and disk, a couple of threads will do
+static const size_t	DECODER_THREADS = 2;
+
+// rendered tiles kept per relative image (64 MB), enough to move a maximized
+// window around a 4K monitor
+static const size_t	RELATIVE_IMAGE_TILES = 256;
+
 ImageHandler::ImageHandler()
 : m_images()
+, m_imageCache(&ImageHandler::DecodeImage, IMAGE_CACHE_BUDGET)
+, m_decoder()
+, m_visibleImage()
+, m_rescaler()
 {
 }
 
 ImageHandler::~ImageHandler()
 {
+	StopRescaler();
+	StopDecoder();
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -58,38 +80,38 @@ ImageHandler::~ImageHandler()
 
 //////////////////////////////////////////////////////////////////////////////
 
-void ImageHandler::CalcRescale(DWORD& dwNewWidth, DWORD& dwNewHeight, std::shared_ptr<BackgroundImage>& bkImage)
+void ImageHandler::CalcRescale(DWORD& dwNewWidth, DWORD& dwNewHeight, ImagePosition imagePosition, DWORD dwOriginalWidth, DWORD dwOriginalHeight)
 {
-  switch( bkImage->imageData.imagePosition )
+  switch( imagePosition )
   {
   case imagePositionFit:
     {
-      double dXRatio = (double)dwNewWidth  / (double)bkImage->originalImage->getWidth ();
-      double dYRatio = (double)dwNewHeight / (double)bkImage->originalImage->getHeight();
+      double dXRatio = (double)dwNewWidth  / (double)dwOriginalWidth;
+      double dYRatio = (double)dwNewHeight / (double)dwOriginalHeight;
 
       if( dXRatio < dYRatio )
       {
-        dwNewHeight = ::MulDiv(bkImage->originalImage->getHeight(), dwNewWidth, bkImage->originalImage->getWidth());
+        dwNewHeight = ::MulDiv(dwOriginalHeight, dwNewWidth, dwOriginalWidth);
       }
       else
       {
-        dwNewWidth  = ::MulDiv(bkImage->originalImage->getWidth(), dwNewHeight, bkImage->originalImage->getHeight());
+        dwNewWidth  = ::MulDiv(dwOriginalWidth, dwNewHeight, dwOriginalHeight);
       }
     }
     break;
 
   case imagePositionFill:
     {
-      double dXRatio = (double)dwNewWidth  / (double)bkImage->originalImage->getWidth ();
-      double dYRatio = (double)dwNewHeight / (double)bkImage->originalImage->getHeight();
+      double dXRatio = (double)dwNewWidth  / (double)dwOriginalWidth;
+      double dYRatio = (double)dwNewHeight / (double)dwOriginalHeight;
 
       if( dXRatio > dYRatio )
       {
-        dwNewHeight = ::MulDiv(bkImage->originalImage->getHeight(), dwNewWidth, bkImage->originalImage->getWidth());
+        dwNewHeight = ::MulDiv(dwOriginalHeight, dwNewWidth, dwOriginalWidth);
       }
       else
       {
-        dwNewWidth  = ::MulDiv(bkImage->originalImage->getWidth(), dwNewHeight, bkImage->originalImage->getHeight());
+        dwNewWidth  = ::MulDiv(dwOriginalWidth, dwNewHeight, dwOriginalHeight);
       }
     }
     break;
@@ -103,19 +125,26 @@ void ImageHandler::CalcRescale(DWORD& dwNewWidth, DWORD& dwNewHeight, std::share
 
 std::shared_ptr<BackgroundImage> ImageHandler::GetImage(const ImageData& imageData)
 {
-	std::shared_ptr<BackgroundImage>	bkImage(new BackgroundImage(imageData));
-
-	Images::iterator		itImage = m_images.begin();
-
-	for (; itImage != m_images.end(); ++itImage) if ((*itImage)->imageData == bkImage->imageData) break;
+	Images::iterator	itImage = m_images.find(imageData);
 
 	// found image, return
-	if (itImage != m_images.end()) return *itImage;
+	if (itImage != m_images.end())
+	{
+		std::shared_ptr<BackgroundImage> bkImage(itImage->second.lock());
+		if (bkImage) return bkImage;
+	}
+
+	std::shared_ptr<BackgroundImage>	bkImage(new BackgroundImage(imageData));
 
 	// else, try to load image
-	if (!LoadImage(bkImage)) return std::shared_ptr<BackgroundImage>();
+	if (!LoadImage(bkImage))
+	{
+		bkImage.reset();
+		m_imageCache.Trim();
+		return bkImage;
+	}
 
-	m_images.push_back(bkImage);
+	AddImage(bkImage);
 
 	return bkImage;
 }
@@ -130,12 +159,14 @@ std::shared_ptr<BackgroundImage> ImageHandler::GetDesktopImage(ImageData& imageD
 	if (!GetDesktopImageData(imageData)) return std::shared_ptr<BackgroundImage>();
 
 	// now, find the image
-	Images::iterator itImage = m_images.begin();
-
-	for (; itImage != m_images.end(); ++itImage) if ((*itImage)->imageData == imageData) break;
+	Images::iterator itImage = m_images.find(imageData);
 
 	// found image, return
-	if (itImage != m_images.end()) return *itImage;
+	if (itImage != m_images.end())
+	{
+		std::shared_ptr<BackgroundImage> bkImage(itImage->second.lock());
+		if (bkImage) return bkImage;
+	}
 
 	// else, try to load image
 	std::shared_ptr<BackgroundImage>	bkImage(new BackgroundImage(imageData));
@@ -146,7 +177,7 @@ std::shared_ptr<BackgroundImage> ImageHandler::GetDesktopImage(ImageData& imageD
 	// we always return background image, even if there's no wallpaper selected
 	LoadImage(bkImage);
 
-	m_images.push_back(bkImage);
+	AddImage(bkImage);
 
 	return bkImage;
 }
@@ -158,16 +189,59 @@ std::shared_ptr<BackgroundImage> ImageHandler::GetDesktopImage(ImageData& imageD
 
 void ImageHandler::ReloadDesktopImages()
 {
-	Images::iterator itImage = m_images.begin();
+	vector<std::shared_ptr<BackgroundImage> >	wallpapers;
+	Images::iterator							itImage = m_images.begin();
 
-	for (; itImage != m_images.end(); ++itImage)
+	// image data changes with the wallpaper, take them out and re-add them
+	while (itImage != m_images.end())
 	{
-		if (!(*itImage)->bWallpaper) continue;
+		std::shared_ptr<BackgroundImage> bkImage(itImage->second.lock());
+
+		if (bkImage && !bkImage->bWallpaper)
+		{
+			++itImage;
+			continue;
+		}
+
+		if (bkImage) wallpapers.push_back(bkImage);
+		itImage = m_images.erase(itImage);
+	}
+
+	for (size_t i = 0; i < wallpapers.size(); ++i)
+	{
+		std::shared_ptr<BackgroundImage>&	bkImage = wallpapers[i];
+		ImageData							imageData(bkImage->imageData);
 
 		// TODO: how to handle these two?
-		if (!GetDesktopImageData((*itImage)->imageData)) continue;
-		if (!LoadImage(*itImage)) continue;
+		if (GetDesktopImageData(imageData))
+		{
+			std::shared_ptr<ImageCacheEntry> entry(m_imageCache.GetEntry(GetImageFilename(imageData.strFilename)));
+
+			// the wallpaper file might have been replaced in place
+			m_imageCache.Invalidate(entry);
+
+			if (m_decoder)
+			{
+				// keep showing the current wallpaper until the new one is
+				// decoded, UpdateDecodedImages swaps them
+				CriticalSectionLock	lock(bkImage->updateCritSec);
+
+				bkImage->pendingImageData	= imageData;
+				bkImage->pendingEntry		= entry;
+			}
+			else
+			{
+				bkImage->imageData = imageData;
+				LoadImage(bkImage);
+			}
+		}
+
+		m_images[imageData] = bkImage;
+
+		if (bkImage->pendingEntry) RequestDecode(bkImage->pendingEntry);
 	}
+
+	m_imageCache.Trim();
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -179,14 +253,16 @@ void ImageHandler::UpdateImageBitmap(const CDC& dc, const CRect& clientRect, std
 {
 	if (bkImage->imageData.bRelative)
 	{
-		if (!bkImage->image.IsNull()) return;
-		// first access to relative image, create it
-		CreateRelativeImage(dc, bkImage);
+		if (bkImage->tiles) return;
+		// first access to relative image, lay it out; tiles are rendered
+		// when they're painted
+		CreateRelativeImage(bkImage);
 	}
 	else
 	{
 		if ((bkImage->dwImageWidth == static_cast<DWORD>(clientRect.Width())) &&
-			(bkImage->dwImageHeight == static_cast<DWORD>(clientRect.Height())))
+			(bkImage->dwImageHeight == static_cast<DWORD>(clientRect.Height())) &&
+			!bkImage->bPlaceholder)
 		{
 			// no client size change, nothing to do
 			return;
@@ -199,6 +275,257 @@ void ImageHandler::UpdateImageBitmap(const CDC& dc, const CRect& clientRect, std
 //////////////////////////////////////////////////////////////////////////////
 
 
+//////////////////////////////////////////////////////////////////////////////
+
+void ImageHandler::PaintRelativeImage(CDC& dc, const CRect& rect, int nImageX, int nImageY, std::shared_ptr<BackgroundImage>& bkImage)
+{
+	CriticalSectionLock	lock(bkImage->updateCritSec);
+
+	if (!bkImage->tiles) return;
+
+	// tiles are top-down 32 bpp DIBs
+	BITMAPINFO bmi;
+
+	::ZeroMemory(&bmi, sizeof(BITMAPINFO));
+	bmi.bmiHeader.biSize		= sizeof(BITMAPINFOHEADER);
+	bmi.bmiHeader.biWidth		= BackgroundTiles::TILE_SIZE;
+	bmi.bmiHeader.biHeight		= -BackgroundTiles::TILE_SIZE;
+	bmi.bmiHeader.biPlanes		= 1;
+	bmi.bmiHeader.biBitCount	= 32;
+	bmi.bmiHeader.biCompression	= BI_RGB;
+
+	// tiles are blitted whole, clipped to the rectangle
+	int nSavedDC = dc.SaveDC();
+	dc.IntersectClipRect(&rect);
+
+	HDC	hdc			= dc;
+	int	nOffsetX	= rect.left - nImageX;
+	int	nOffsetY	= rect.top  - nImageY;
+
+	bkImage->tiles->Paint(
+		nImageX,
+		nImageY,
+		nImageX + rect.Width(),
+		nImageY + rect.Height(),
+		[hdc, &bmi, nOffsetX, nOffsetY](const BackgroundTiles::Tile& tile)
+		{
+			::SetDIBitsToDevice(
+				hdc,
+				tile.nLeft + nOffsetX,
+				tile.nTop  + nOffsetY,
+				BackgroundTiles::TILE_SIZE,
+				BackgroundTiles::TILE_SIZE,
+				0,
+				0,
+				0,
+				BackgroundTiles::TILE_SIZE,
+				&tile.pixels[0],
+				&bmi,
+				DIB_RGB_COLORS);
+		});
+
+	dc.RestoreDC(nSavedDC);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ImageHandler::StartRescaler(HWND hwndNotify)
+{
+	m_rescaler.reset(new ImageRescaler(hwndNotify));
+	m_rescaler->Start();
+}
+
+void ImageHandler::StopRescaler()
+{
+	m_rescaler.reset();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ImageHandler::StartDecoder(HWND hwndNotify)
+{
+	m_decoder.reset(new ImageDecoder(
+							&ImageHandler::DecodeImage,
+							[hwndNotify]()
+							{
+								::PostMessage(hwndNotify, UM_IMAGE_DECODED, 0, 0);
+							},
+							DECODER_THREADS));
+}
+
+void ImageHandler::StopDecoder()
+{
+	m_decoder.reset();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ImageHandler::UpdateDecodedImages()
+{
+	if (!m_decoder) return;
+
+	ImageDecoder::Results results;
+	m_decoder->GetResults(results);
+
+	for (ImageDecoder::Results::iterator itResult = results.begin(); itResult != results.end(); ++itResult)
+	{
+		std::shared_ptr<ImageCacheEntry> entry(m_imageCache.GetEntry(itResult->strFilename));
+
+		m_imageCache.SetImage(entry, itResult->image, itResult->stBytes);
+
+		for (Images::iterator itImage = m_images.begin(); itImage != m_images.end(); ++itImage)
+		{
+			std::shared_ptr<BackgroundImage> bkImage(itImage->second.lock());
+			if (!bkImage) continue;
+
+			CriticalSectionLock	lock(bkImage->updateCritSec);
+
+			if (bkImage->pendingEntry == entry)
+			{
+				bkImage->imageData	= bkImage->pendingImageData;
+				bkImage->cacheEntry	= entry;
+				bkImage->pendingEntry.reset();
+			}
+			else if ((bkImage->cacheEntry != entry) || !bkImage->bDecoding)
+			{
+				// not waiting for this one
+				continue;
+			}
+
+			// swap the new image in, bitmaps are recreated on the next paint
+			DeleteImage(bkImage);
+			bkImage->bDecoding = false;
+
+			if (itResult->image)
+			{
+				bkImage->dwOriginalImageWidth	= itResult->image->getWidth();
+				bkImage->dwOriginalImageHeight	= itResult->image->getHeight();
+			}
+			else
+			{
+				bkImage->dwOriginalImageWidth	= 0;
+				bkImage->dwOriginalImageHeight	= 0;
+			}
+		}
+	}
+
+	m_imageCache.Trim();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ImageHandler::SetVisibleImage(const std::shared_ptr<BackgroundImage>& bkImage)
+{
+	m_visibleImage = bkImage;
+
+	if (!bkImage || !m_decoder) return;
+
+	// raises the priority if it's queued
+	if (bkImage->pendingEntry) RequestDecode(bkImage->pendingEntry);
+	if (bkImage->cacheEntry && !bkImage->cacheEntry->image && !bkImage->cacheEntry->bFailed) RequestDecode(bkImage->cacheEntry);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ImageHandler::SetCacheBudget(size_t stBudget)
+{
+	m_imageCache.SetBudget(stBudget);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ImageHandler::DumpImageStats(wostream& os)
+{
+	ImageCacheStats	stats(m_imageCache.GetStats());
+
+	os << boost::str(boost::wformat(L"decoded: %u of %u files, %u KB of %u KB budget, %u loads, %u hits, %u evictions")
+		% stats.stDecoded
+		% stats.stEntries
+		% (stats.stBytes / 1024)
+		% (stats.stBudget / 1024)
+		% stats.dwLoads
+		% stats.dwHits
+		% stats.dwEvictions)
+		<< endl << endl;
+
+	for (Images::iterator itImage = m_images.begin(); itImage != m_images.end(); ++itImage)
+	{
+		std::shared_ptr<BackgroundImage> bkImage(itImage->second.lock());
+		if (!bkImage) continue;
+
+		CriticalSectionLock	lock(bkImage->updateCritSec);
+
+		size_t stCachedBytes = 0;
+
+		for (CachedImages::iterator it = bkImage->cachedImages.begin(); it != bkImage->cachedImages.end(); ++it)
+		{
+			stCachedBytes += it->dwWidth * it->dwHeight * 4;
+		}
+
+		os << bkImage->imageData.strFilename << endl;
+
+		if (bkImage->cacheEntry)
+		{
+			// the cache holds one reference itself
+			os << boost::str(boost::wformat(L"  original  %ux%u, %u KB decoded, %u loads, %u hits, shared by %u images")
+				% bkImage->dwOriginalImageWidth
+				% bkImage->dwOriginalImageHeight
+				% (bkImage->cacheEntry->stBytes / 1024)
+				% bkImage->cacheEntry->dwLoads
+				% bkImage->cacheEntry->dwHits
+				% (bkImage->cacheEntry.use_count() - 1))
+				<< endl;
+		}
+
+		if (bkImage->tiles)
+		{
+			BackgroundTilesStats tileStats(bkImage->tiles->GetStats());
+
+			os << boost::str(boost::wformat(L"  tiles     %ux%u, %u of %u tiles in %u KB, %u renders, %u hits, %u evictions")
+				% bkImage->dwImageWidth
+				% bkImage->dwImageHeight
+				% tileStats.stTiles
+				% tileStats.stMaxTiles
+				% (tileStats.stBytes / 1024)
+				% tileStats.dwRenders
+				% tileStats.dwHits
+				% tileStats.dwEvictions)
+				<< endl;
+
+			continue;
+		}
+
+		os << boost::str(boost::wformat(L"  bitmap    %ux%u, %u KB, %u earlier sizes cached in %u KB")
+			% bkImage->dwImageWidth
+			% bkImage->dwImageHeight
+			% (bkImage->dwImageWidth * bkImage->dwImageHeight * 4 / 1024)
+			% bkImage->cachedImages.size()
+			% (stCachedBytes / 1024))
+			<< endl;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
 //////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
@@ -295,13 +622,84 @@ bool ImageHandler::GetDesktopImageData(ImageData& imageData)
 
 bool ImageHandler::LoadImage(std::shared_ptr<BackgroundImage>& bkImage)
 {
-	USES_CONVERSION;
+	TRACE_SCOPE("ImageHandler::LoadImage");
 
 	CriticalSectionLock	lock(bkImage->updateCritSec);
 
 	if (!bkImage) return false;
 
-		// if we're reloading, delete old bitmap and DC
+	// if we're reloading, delete old bitmap and DC
+	DeleteImage(bkImage);
+
+	bkImage->dwOriginalImageWidth	= 0;
+	bkImage->dwOriginalImageHeight	= 0;
+
+	// images using the same file share the decode
+	bkImage->cacheEntry = m_imageCache.GetEntry(GetImageFilename(bkImage->imageData.strFilename));
+	bkImage->bDecoding	= false;
+
+	if (m_decoder && !bkImage->cacheEntry->image && !bkImage->cacheEntry->bFailed)
+	{
+		DWORD dwAttributes = ::GetFileAttributes(bkImage->cacheEntry->strFilename.c_str());
+
+		if ((dwAttributes == INVALID_FILE_ATTRIBUTES) || (dwAttributes & FILE_ATTRIBUTE_DIRECTORY))
+		{
+			m_imageCache.SetImage(bkImage->cacheEntry, std::shared_ptr<fipImage>(), 0);
+			return false;
+		}
+
+		// the background color is painted until it's decoded
+		bkImage->bDecoding = true;
+		RequestDecode(bkImage->cacheEntry);
+
+		return true;
+	}
+
+	// load background image
+	std::shared_ptr<fipImage> originalImage(m_imageCache.GetImage(bkImage->cacheEntry));
+
+	if (!originalImage) return false;
+
+	bkImage->dwOriginalImageWidth	= originalImage->getWidth();
+	bkImage->dwOriginalImageHeight	= originalImage->getHeight();
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ImageHandler::AddImage(const std::shared_ptr<BackgroundImage>& bkImage)
+{
+	// images of closed tabs are gone
+	Images::iterator itImage = m_images.begin();
+
+	while (itImage != m_images.end())
+	{
+		if (itImage->second.expired())
+		{
+			itImage = m_images.erase(itImage);
+		}
+		else
+		{
+			++itImage;
+		}
+	}
+
+	m_images[bkImage->imageData] = bkImage;
+
+	m_imageCache.Trim();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ImageHandler::DeleteImage(std::shared_ptr<BackgroundImage>& bkImage)
+{
 	if (!bkImage->dcImage.IsNull())
 	{
 		bkImage->dcImage.SelectBitmap(NULL);
@@ -310,22 +708,76 @@ bool ImageHandler::LoadImage(std::shared_ptr<BackgroundImage>& bkImage)
 
 	if (!bkImage->image.IsNull()) bkImage->image.DeleteObject();
 
-	// create new original image
-	bkImage->originalImage.reset(new fipImage());
+	ClearCachedImages(bkImage);
+	bkImage->tiles.reset();
 
-	// load background image
-	if (!bkImage->originalImage->load(W2A(Helpers::ExpandEnvironmentStrings(bkImage->imageData.strFilename).c_str())))
+	// force the bitmap to be recreated
+	bkImage->dwImageWidth	= 0;
+	bkImage->dwImageHeight	= 0;
+
+	bkImage->originalImage.reset();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ImageHandler::RequestDecode(const std::shared_ptr<ImageCacheEntry>& entry)
+{
+	std::shared_ptr<BackgroundImage>	visibleImage(m_visibleImage.lock());
+	ImageDecoder::Priority				priority = ImageDecoder::priorityBackground;
+
+	if (visibleImage && ((visibleImage->cacheEntry == entry) || (visibleImage->pendingEntry == entry)))
 	{
-		bkImage->originalImage.reset();
-		return false;
+		priority = ImageDecoder::priorityVisible;
 	}
 
-	bkImage->dwOriginalImageWidth	= bkImage->originalImage->getWidth();
-	bkImage->dwOriginalImageHeight	= bkImage->originalImage->getHeight();
+	m_decoder->Request(entry->strFilename, priority);
+}
 
-	bkImage->originalImage->convertTo32Bits();
+//////////////////////////////////////////////////////////////////////////////
 
-	return true;
+
+//////////////////////////////////////////////////////////////////////////////
+
+wstring ImageHandler::GetImageFilename(const wstring& strFilename)
+{
+	wstring	strPath(Helpers::ExpandEnvironmentStrings(strFilename));
+
+	if (strPath.length() == 0) return strPath;
+
+	wchar_t	szFullPath[MAX_PATH];
+	DWORD	dwLength = ::GetFullPathName(strPath.c_str(), MAX_PATH, szFullPath, NULL);
+
+	if ((dwLength == 0) || (dwLength >= MAX_PATH)) return strPath;
+
+	// file names are case insensitive
+	::CharLowerBuff(szFullPath, dwLength);
+
+	return wstring(szFullPath, dwLength);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+std::shared_ptr<fipImage> ImageHandler::DecodeImage(const wstring& strFilename, size_t& stBytes)
+{
+	TRACE_SCOPE("ImageHandler::DecodeImage");
+
+	USES_CONVERSION;
+
+	std::shared_ptr<fipImage> image(new fipImage());
+
+	if (!image->load(W2A(strFilename.c_str()))) return std::shared_ptr<fipImage>();
+
+	image->convertTo32Bits();
+
+	stBytes = image->getScanWidth() * image->getHeight();
+
+	return image;
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -333,11 +785,42 @@ bool ImageHandler::LoadImage(std::shared_ptr<BackgroundImage>& bkImage)
 
 //////////////////////////////////////////////////////////////////////////////
 
-void ImageHandler::PaintRelativeImage(const CDC& dc, CBitmap&	bmpTemplate, std::shared_ptr<BackgroundImage>& bkImage, DWORD& dwDisplayWidth, DWORD& dwDisplayHeight)
+std::shared_ptr<fipImage> ImageHandler::AcquireOriginalImage(std::shared_ptr<BackgroundImage>& bkImage)
+{
+	if (bkImage->originalImage || !bkImage->cacheEntry) return bkImage->originalImage;
+
+	if (m_decoder && !bkImage->cacheEntry->image && !bkImage->cacheEntry->bFailed)
+	{
+		// the cache has dropped it, the background color is painted until
+		// it's decoded again
+		bkImage->bDecoding = true;
+		RequestDecode(bkImage->cacheEntry);
+
+		return bkImage->originalImage;
+	}
+
+	bkImage->originalImage = m_imageCache.GetImage(bkImage->cacheEntry);
+
+	return bkImage->originalImage;
+}
+
+void ImageHandler::ReleaseOriginalImage(std::shared_ptr<BackgroundImage>& bkImage)
+{
+	bkImage->originalImage.reset();
+
+	m_imageCache.Trim();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ImageHandler::CalcRelativeSize(const fipImage& image, std::shared_ptr<BackgroundImage>& bkImage, DWORD& dwDisplayWidth, DWORD& dwDisplayHeight)
 {
   // set template bitmap dimensions
-  DWORD	dwTemplateWidth  = bkImage->originalImage->getWidth();
-  DWORD	dwTemplateHeight = bkImage->originalImage->getHeight();
+  DWORD	dwTemplateWidth  = image.getWidth();
+  DWORD	dwTemplateHeight = image.getHeight();
 
   if (bkImage->imageData.imagePosition == imagePositionStretch ||
       bkImage->imageData.imagePosition == imagePositionFit     ||
@@ -358,94 +841,126 @@ void ImageHandler::PaintRelativeImage(const CDC& dc, CBitmap&	bmpTemplate, std::
   DWORD dwNewWidth  = dwTemplateWidth;
   DWORD dwNewHeight = dwTemplateHeight;
 
-  if ( bkImage->originalImage->getWidth()  != dwNewWidth ||
-       bkImage->originalImage->getHeight() != dwNewHeight )
-  {
-    // resize background image
-    ImageHandler::CalcRescale(dwNewWidth, dwNewHeight, bkImage);
-    fipImage tempImage(*(bkImage->originalImage));
-
-#ifdef _DEBUG
-    DWORD dwGetTickCount = ::GetTickCount();
-#endif
-    tempImage.rescale(dwNewWidth, dwNewHeight, FILTER_BILINEAR);
-#ifdef _DEBUG
-    TRACE(L"rescale in %lu ms\n", ::GetTickCount() - dwGetTickCount);
-#endif
-
-    bmpTemplate.CreateDIBitmap(
-      dc,
-      tempImage.getInfoHeader(),
-      CBM_INIT,
-      tempImage.accessPixels(),
-      tempImage.getInfo(),
-      DIB_RGB_COLORS);
-  }
-  else
+  if ( image.getWidth()  != dwNewWidth ||
+       image.getHeight() != dwNewHeight )
   {
-    bmpTemplate.CreateDIBitmap(
-      dc,
-      bkImage->originalImage->getInfoHeader(),
-      CBM_INIT,
-      bkImage->originalImage->accessPixels(),
-      bkImage->originalImage->getInfo(),
-      DIB_RGB_COLORS);
+    // the tiles resample the image to this size
+    ImageHandler::CalcRescale(dwNewWidth, dwNewHeight, bkImage->imageData.imagePosition, image.getWidth(), image.getHeight());
   }
 
   dwDisplayWidth  = dwNewWidth;
   dwDisplayHeight = dwNewHeight;
 }
 
-void ImageHandler::CreateRelativeImage(const CDC& dc, std::shared_ptr<BackgroundImage>& bkImage)
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+size_t ImageHandler::AddTileSource(const std::shared_ptr<fipImage>& image, std::shared_ptr<BackgroundImage>& bkImage)
+{
+	TileSource source;
+
+	// the tiles keep the decode alive; fipImage rows are bottom-up
+	source.owner	= image;
+	source.nWidth	= image->getWidth();
+	source.nHeight	= image->getHeight();
+	source.nPitch	= -static_cast<int>(image->getScanWidth());
+	source.pPixels	= image->accessPixels() + (source.nHeight - 1) * image->getScanWidth();
+
+	return bkImage->tiles->AddSource(source);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ImageHandler::AddTilePlacement(size_t stSource, int nOffsetX, int nOffsetY, DWORD dwSrcWidth, DWORD dwSrcHeight, DWORD dwDstWidth, DWORD dwDstHeight, std::shared_ptr<BackgroundImage>& bkImage)
+{
+	// the image is centered on the destination and cropped to it
+	DWORD dwDivY = 2;
+
+	// Windows 8 filled wallpaper:
+	// when image height is greater than screen height
+	// top is not shifted with half but 1/3
+	if (bkImage->imageData.imagePosition == imagePositionFill && ImageHandler::IsWin8()) dwDivY = 3;
+
+	TilePlacement placement;
+
+	placement.stSource		= stSource;
+	placement.nClipLeft		= nOffsetX;
+	placement.nClipTop		= nOffsetY;
+	placement.nClipRight	= nOffsetX + dwDstWidth;
+	placement.nClipBottom	= nOffsetY + dwDstHeight;
+	placement.nLeft			= (dwDstWidth <= dwSrcWidth) ? nOffsetX - static_cast<int>((dwSrcWidth - dwDstWidth)/2) : nOffsetX + static_cast<int>((dwDstWidth - dwSrcWidth)/2);
+	placement.nTop			= (dwDstHeight <= dwSrcHeight) ? nOffsetY - static_cast<int>((dwSrcHeight - dwDstHeight)/dwDivY) : nOffsetY + static_cast<int>((dwDstHeight - dwSrcHeight)/dwDivY);
+	placement.nWidth		= dwSrcWidth;
+	placement.nHeight		= dwSrcHeight;
+
+	bkImage->tiles->AddPlacement(placement);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ImageHandler::CreateRelativeImage(std::shared_ptr<BackgroundImage>& bkImage)
 {
   CriticalSectionLock	lock(bkImage->updateCritSec);
 
   bkImage->dwImageWidth	= ::GetSystemMetrics(SM_CXVIRTUALSCREEN);
   bkImage->dwImageHeight	= ::GetSystemMetrics(SM_CYVIRTUALSCREEN);
 
-  // create background DC
-  bkImage->dcImage.CreateCompatibleDC(NULL);
+  // the image is only laid out here, tiles are rendered when windows show them
+  COLORREF crBackground	= bkImage->imageData.crBackground;
+  COLORREF crTint		= bkImage->imageData.crTint;
 
-  // create background bitmap
-  Helpers::CreateBitmap(dc, bkImage->dwImageWidth, bkImage->dwImageHeight, bkImage->image);
-  bkImage->dcImage.SelectBitmap(bkImage->image);
+  bkImage->tiles.reset(new BackgroundTiles(
+    bkImage->dwImageWidth,
+    bkImage->dwImageHeight,
+    PixelKernels::MakeColor(GetRValue(crBackground), GetGValue(crBackground), GetBValue(crBackground), 0),
+    PixelKernels::MakeColor(GetRValue(crTint), GetGValue(crTint), GetBValue(crTint), 0),
+    bkImage->imageData.byTintOpacity,
+    RELATIVE_IMAGE_TILES));
 
-  // paint background
-  CBrush	backgroundBrush(::CreateSolidBrush(bkImage->imageData.crBackground));
-  CRect	rect(0, 0, bkImage->dwImageWidth, bkImage->dwImageHeight);
-  bkImage->dcImage.FillRect(&rect, backgroundBrush);
+  // this can be empty only for desktop backgrounds with no wallpaper image
+  std::shared_ptr<fipImage> originalImage(AcquireOriginalImage(bkImage));
 
-  // this can be false only for desktop backgrounds with no wallpaper image
-  if (bkImage->originalImage.get() != NULL)
+  if (originalImage)
   {
+    size_t stSource = AddTileSource(originalImage, bkImage);
+
     if (bkImage->imageData.imagePosition == imagePositionTile ||
         bkImage->imageData.bExtend ||
         !ImageHandler::IsWin8())
     {
-      // create template image
-      CDC     dcTemplate;
-      CBitmap	bmpTemplate;
-      dcTemplate.CreateCompatibleDC(NULL);
-
       // Windows 7 or older wallpaper (Stretch, Fit & Fill) use the primary monitor to rescale picture for each monitor
       DWORD dwNewWidth  = ::GetSystemMetrics(SM_CXSCREEN);
       DWORD dwNewHeight = ::GetSystemMetrics(SM_CYSCREEN);
-      PaintRelativeImage(dc, bmpTemplate, bkImage, dwNewWidth, dwNewHeight);
-
-      dcTemplate.SelectBitmap(bmpTemplate);
+      CalcRelativeSize(*originalImage, bkImage, dwNewWidth, dwNewHeight);
 
       if (bkImage->imageData.imagePosition == imagePositionTile)
       {
-        ImageHandler::TileTemplateImage(
-          dcTemplate,
-          ImageHandler::IsWin8() ? 0 : ::GetSystemMetrics(SM_XVIRTUALSCREEN), // Windows 8 wallpaper tiles starts
-          ImageHandler::IsWin8() ? 0 : ::GetSystemMetrics(SM_YVIRTUALSCREEN), // in the top left corner of virtual screen
-          bkImage);
+        TilePlacement placement;
+
+        // Windows 8 wallpaper tiles starts in the top left corner of virtual screen
+        placement.stSource		= stSource;
+        placement.nClipRight	= bkImage->dwImageWidth;
+        placement.nClipBottom	= bkImage->dwImageHeight;
+        placement.nLeft			= ImageHandler::IsWin8() ? 0 : -::GetSystemMetrics(SM_XVIRTUALSCREEN);
+        placement.nTop			= ImageHandler::IsWin8() ? 0 : -::GetSystemMetrics(SM_YVIRTUALSCREEN);
+        placement.nWidth		= originalImage->getWidth();
+        placement.nHeight		= originalImage->getHeight();
+        placement.bTile			= true;
+
+        bkImage->tiles->AddPlacement(placement);
       }
       else if (bkImage->imageData.bExtend)
       {
-        ImageHandler::PaintTemplateImage(
-          dcTemplate,
+        ImageHandler::AddTilePlacement(
+          stSource,
           0,
           0,
           dwNewWidth,
@@ -456,19 +971,20 @@ void ImageHandler::CreateRelativeImage(const CDC& dc, std::shared_ptr<Background
       }
       else
       {
-        MonitorEnumData	enumData(dcTemplate, bkImage);
+        MonitorEnumData	enumData(this, bkImage, stSource, dwNewWidth, dwNewHeight);
         ::EnumDisplayMonitors(NULL, NULL, ImageHandler::MonitorEnumProc, reinterpret_cast<LPARAM>(&enumData));
       }
     }
     else
     {
       // Windows 8 wallpaper (Stretch, Fit & Fill) is handled separately for each monitor
-      MonitorEnumData	enumData(dc, bkImage);
+      MonitorEnumData	enumData(this, bkImage, stSource, originalImage->getWidth(), originalImage->getHeight());
       ::EnumDisplayMonitors(NULL, NULL, ImageHandler::MonitorEnumProcWin8, reinterpret_cast<LPARAM>(&enumData));
     }
   }
 
-  if (bkImage->imageData.byTintOpacity > 0) TintImage(dc, bkImage);
+  originalImage.reset();
+  ReleaseOriginalImage(bkImage);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -480,23 +996,75 @@ void ImageHandler::CreateImage(const CDC& dc, const CRect& clientRect, std::shar
 {
 	CriticalSectionLock	lock(bkImage->updateCritSec);
 
-	bkImage->dwImageWidth = clientRect.Width();
-	bkImage->dwImageHeight= clientRect.Height();
+	DWORD dwWidth  = clientRect.Width();
+	DWORD dwHeight = clientRect.Height();
 
-	// create background DC
-	if (bkImage->dcImage.IsNull()) bkImage->dcImage.CreateCompatibleDC(NULL);
+	// toggling between recently used sizes doesn't repaint anything
+	if (SelectCachedImage(dwWidth, dwHeight, bkImage))
+	{
+		ImageRescaler::Cancel(bkImage);
+		bkImage->rescaledImage.reset();
+		ReleaseOriginalImage(bkImage);
+		return;
+	}
+
+	// this can be empty only for desktop backgrounds with no wallpaper image;
+	// it stays acquired while the rescaler works on it
+	std::shared_ptr<fipImage> templateImage(AcquireOriginalImage(bkImage));
+
+	DWORD dwNewWidth  = dwWidth;
+	DWORD dwNewHeight = dwHeight;
+
+	if ( templateImage
+	     &&
+	     (bkImage->imageData.imagePosition == imagePositionStretch ||
+	      bkImage->imageData.imagePosition == imagePositionFit     ||
+	      bkImage->imageData.imagePosition == imagePositionFill)
+	     &&
+	     (templateImage->getWidth()  != dwNewWidth        ||
+	      templateImage->getHeight() != dwNewHeight) )
+	{
+		// resize background image
+		ImageHandler::CalcRescale(dwNewWidth, dwNewHeight, bkImage->imageData.imagePosition, templateImage->getWidth(), templateImage->getHeight());
+
+		if (bkImage->rescaledImage &&
+			(bkImage->rescaledImage->getWidth() == dwNewWidth) &&
+			(bkImage->rescaledImage->getHeight() == dwNewHeight))
+		{
+			templateImage = bkImage->rescaledImage;
+		}
+		else if (m_rescaler && (!bkImage->image.IsNull() || !bkImage->cachedImages.empty()))
+		{
+			// large images take too long to rescale while the window is being
+			// resized; stretch the last good bitmap until the rescaler is done
+			if (!bkImage->bPlaceholder || (bkImage->dwImageWidth != dwWidth) || (bkImage->dwImageHeight != dwHeight))
+			{
+				m_rescaler->Request(bkImage, dwNewWidth, dwNewHeight);
+				PaintPlaceholderImage(dc, dwWidth, dwHeight, bkImage);
+			}
+
+			return;
+		}
+		else
+		{
+			// first paint, there's nothing to stretch
+			templateImage = ImageRescaler::Rescale(*templateImage, dwNewWidth, dwNewHeight, Resampler::CancelCallback());
+		}
+	}
+
+	ImageRescaler::Cancel(bkImage);
+	bkImage->rescaledImage.reset();
 
 	// create background bitmap
-	if (!bkImage->image.IsNull()) bkImage->image.DeleteObject();
-	Helpers::CreateBitmap(dc, bkImage->dwImageWidth, bkImage->dwImageHeight, bkImage->image);
-	bkImage->dcImage.SelectBitmap(bkImage->image);
+	CBitmap image;
+	Helpers::CreateBitmap(dc, dwWidth, dwHeight, image);
+	SetImage(image, dwWidth, dwHeight, false, bkImage);
 
 	// paint background
 	CBrush backgroundBrush(::CreateSolidBrush(bkImage->imageData.crBackground));
 	bkImage->dcImage.FillRect(&clientRect, backgroundBrush);
 
-	// this can be false only for desktop backgrounds with no wallpaper image
-	if (bkImage->originalImage.get() != NULL)
+	if (templateImage)
 	{
 		// create template image
 		CDC		dcTemplate;
@@ -504,39 +1072,13 @@ void ImageHandler::CreateImage(const CDC& dc, const CRect& clientRect, std::shar
 
 		dcTemplate.CreateCompatibleDC(NULL);
 
-    DWORD dwNewWidth  = bkImage->dwImageWidth;
-    DWORD dwNewHeight = bkImage->dwImageHeight;
-
-		if ( (bkImage->imageData.imagePosition == imagePositionStretch ||
-          bkImage->imageData.imagePosition == imagePositionFit     ||
-          bkImage->imageData.imagePosition == imagePositionFill)
-         &&
-         (bkImage->originalImage->getWidth()  != dwNewWidth        ||
-          bkImage->originalImage->getHeight() != dwNewHeight) )
-		{
-			// resize background image
-			ImageHandler::CalcRescale(dwNewWidth, dwNewHeight, bkImage);
-			fipImage tempImage(*(bkImage->originalImage));
-			tempImage.rescale(dwNewWidth, dwNewHeight, FILTER_BILINEAR);
-
-			bmpTemplate.CreateDIBitmap(
-							dc,
-							tempImage.getInfoHeader(),
-							CBM_INIT,
-							tempImage.accessPixels(),
-							tempImage.getInfo(),
-							DIB_RGB_COLORS);
-		}
-		else
-		{
-			bmpTemplate.CreateDIBitmap(
-							dc,
-							bkImage->originalImage->getInfoHeader(),
-							CBM_INIT,
-							bkImage->originalImage->accessPixels(),
-							bkImage->originalImage->getInfo(),
-							DIB_RGB_COLORS);
-		}
+		bmpTemplate.CreateDIBitmap(
+						dc,
+						templateImage->getInfoHeader(),
+						CBM_INIT,
+						templateImage->accessPixels(),
+						templateImage->getInfo(),
+						DIB_RGB_COLORS);
 
 		dcTemplate.SelectBitmap(bmpTemplate);
 
@@ -563,12 +1105,129 @@ void ImageHandler::CreateImage(const CDC& dc, const CRect& clientRect, std::shar
 		}
 	}
 
+	templateImage.reset();
+	ReleaseOriginalImage(bkImage);
+
 	if (bkImage->imageData.byTintOpacity > 0) TintImage(dc, bkImage);
 }
 
 //////////////////////////////////////////////////////////////////////////////
 
 
+//////////////////////////////////////////////////////////////////////////////
+
+bool ImageHandler::SelectCachedImage(DWORD dwWidth, DWORD dwHeight, std::shared_ptr<BackgroundImage>& bkImage)
+{
+	CachedImages::iterator it = bkImage->cachedImages.begin();
+
+	for (; it != bkImage->cachedImages.end(); ++it) if ((it->dwWidth == dwWidth) && (it->dwHeight == dwHeight)) break;
+
+	if (it == bkImage->cachedImages.end()) return false;
+
+	std::shared_ptr<CBitmap> image(it->image);
+	bkImage->cachedImages.erase(it);
+
+	SetImage(*image, dwWidth, dwHeight, false, bkImage);
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ImageHandler::SetImage(CBitmap& image, DWORD dwWidth, DWORD dwHeight, bool bPlaceholder, std::shared_ptr<BackgroundImage>& bkImage)
+{
+	// create background DC
+	if (bkImage->dcImage.IsNull()) bkImage->dcImage.CreateCompatibleDC(NULL);
+
+	// this deselects the current bitmap
+	bkImage->dcImage.SelectBitmap(image);
+
+	if (!bkImage->image.IsNull())
+	{
+		if (bkImage->bPlaceholder)
+		{
+			bkImage->image.DeleteObject();
+		}
+		else
+		{
+			// keep the current bitmap for when the window is sized back
+			CachedImage	cachedImage;
+
+			cachedImage.dwWidth		= bkImage->dwImageWidth;
+			cachedImage.dwHeight	= bkImage->dwImageHeight;
+			cachedImage.image.reset(new CBitmap(bkImage->image.Detach()));
+
+			bkImage->cachedImages.insert(bkImage->cachedImages.begin(), cachedImage);
+
+			if (bkImage->cachedImages.size() > IMAGE_CACHE_SIZE) bkImage->cachedImages.pop_back();
+		}
+	}
+
+	bkImage->image.Attach(image.Detach());
+
+	bkImage->dwImageWidth	= dwWidth;
+	bkImage->dwImageHeight	= dwHeight;
+	bkImage->bPlaceholder	= bPlaceholder;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ImageHandler::PaintPlaceholderImage(const CDC& dc, DWORD dwWidth, DWORD dwHeight, std::shared_ptr<BackgroundImage>& bkImage)
+{
+	CBitmap image;
+	Helpers::CreateBitmap(dc, dwWidth, dwHeight, image);
+
+	// after this, the last good bitmap is the first cached one
+	SetImage(image, dwWidth, dwHeight, true, bkImage);
+
+	if (bkImage->cachedImages.empty()) return;
+
+	const CachedImage&	cachedImage = bkImage->cachedImages.front();
+	CDC					dcCached;
+
+	dcCached.CreateCompatibleDC(NULL);
+	HBITMAP hOldBitmap = dcCached.SelectBitmap(*cachedImage.image);
+
+	// it's only shown until the rescaler is done, speed over quality
+	bkImage->dcImage.SetStretchBltMode(COLORONCOLOR);
+	bkImage->dcImage.StretchBlt(
+						0,
+						0,
+						dwWidth,
+						dwHeight,
+						dcCached,
+						0,
+						0,
+						cachedImage.dwWidth,
+						cachedImage.dwHeight,
+						SRCCOPY);
+
+	dcCached.SelectBitmap(hOldBitmap);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ImageHandler::ClearCachedImages(std::shared_ptr<BackgroundImage>& bkImage)
+{
+	ImageRescaler::Cancel(bkImage);
+
+	bkImage->cachedImages.clear();
+	bkImage->rescaledImage.reset();
+	bkImage->bPlaceholder = false;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
 //////////////////////////////////////////////////////////////////////////////
 
 void ImageHandler::PaintTemplateImage(const CDC& dcTemplate, int nOffsetX, int nOffsetY, DWORD dwSrcWidth, DWORD dwSrcHeight, DWORD dwDstWidth, DWORD dwDstHeight, std::shared_ptr<BackgroundImage>& bkImage)
@@ -661,6 +1320,31 @@ void ImageHandler::TileTemplateImage(const CDC& dcTemplate, int nOffsetX, int nO
 
 void ImageHandler::TintImage(const CDC& dc, std::shared_ptr<BackgroundImage>& bkImage)
 {
+	PixelSurface	surface;
+
+	if (Helpers::GetBitmapSurface(bkImage->image, surface))
+	{
+		int		nX		= 0;
+		int		nY		= 0;
+		int		nWidth	= bkImage->dwImageWidth;
+		int		nHeight	= bkImage->dwImageHeight;
+		COLORREF crTint	= bkImage->imageData.crTint;
+
+		if (surface.Clip(nX, nY, nWidth, nHeight))
+		{
+			PixelKernels::Tint(
+							surface.GetPixel(nX, nY),
+							surface.nPitch,
+							nWidth,
+							nHeight,
+							PixelKernels::MakeColor(GetRValue(crTint), GetGValue(crTint), GetBValue(crTint), 0),
+							bkImage->imageData.byTintOpacity);
+		}
+
+		return;
+	}
+
+	// not a 32 bpp DIB section, let GDI blend it
 	CDC				dcTint;
 	CBitmap			bmpTint;
 	CBrush			tintBrush(::CreateSolidBrush(bkImage->imageData.crTint));
@@ -707,17 +1391,12 @@ BOOL CALLBACK ImageHandler::MonitorEnumProc(HMONITOR /*hMonitor*/, HDC /*hdcMoni
 
 	CRect rectMonitor(lprcMonitor);
 
-	DWORD dwNewWidth  = ::GetSystemMetrics(SM_CXSCREEN);
-	DWORD dwNewHeight = ::GetSystemMetrics(SM_CYSCREEN);
-
-	ImageHandler::CalcRescale(dwNewWidth, dwNewHeight, pEnumData->bkImage);
-
-	ImageHandler::PaintTemplateImage(
-					pEnumData->dcTemplate, 
+	ImageHandler::AddTilePlacement(
+					pEnumData->stSource,
 					rectMonitor.left - ::GetSystemMetrics(SM_XVIRTUALSCREEN), 
 					rectMonitor.top  - ::GetSystemMetrics(SM_YVIRTUALSCREEN), 
-					dwNewWidth,
-					dwNewHeight,
+					pEnumData->dwSrcWidth,
+					pEnumData->dwSrcHeight,
 					rectMonitor.Width(), 
 					rectMonitor.Height(), 
 					pEnumData->bkImage);
@@ -839,7 +1518,8 @@ BOOL CALLBACK ImageHandler::MonitorEnumProcWin8(HMONITOR hMonitor, HDC /*hdcMoni
 
   MonitorEnumData* pEnumData = reinterpret_cast<MonitorEnumData*>(lpData);
 
-  std::shared_ptr<BackgroundImage> bkImage;
+  size_t                    stSource = pEnumData->stSource;
+  std::shared_ptr<fipImage> image;
 
   if( szTranscodedImage[0] )
   {
@@ -849,31 +1529,26 @@ BOOL CALLBACK ImageHandler::MonitorEnumProcWin8(HMONITOR hMonitor, HDC /*hdcMoni
       dd.DeviceID,
       szTranscodedImage);
 
-    bkImage.reset(new BackgroundImage (pEnumData->bkImage->imageData));
-    bkImage->imageData.strFilename = szTranscodedImage;
-    bkImage->bWallpaper = true;
-    ImageHandler::LoadImageW(bkImage);
-  }
-  else
-  {
-    bkImage = pEnumData->bkImage;
+    // decoded right away, the tiles keep it
+    ImageCache& imageCache = pEnumData->pImageHandler->m_imageCache;
+
+    image = imageCache.GetImage(imageCache.GetEntry(ImageHandler::GetImageFilename(szTranscodedImage)));
+
+    if (image) stSource = ImageHandler::AddTileSource(image, pEnumData->bkImage);
   }
 
   CRect   rectMonitor(lprcMonitor);
 
-  // create template image
-  CDC     dcTemplate;
-  CBitmap	bmpTemplate;
-  dcTemplate.CreateCompatibleDC(NULL);
-
   DWORD dwNewWidth  = rectMonitor.Width();
   DWORD dwNewHeight = rectMonitor.Height();
-  ImageHandler::PaintRelativeImage(pEnumData->dcTemplate, bmpTemplate, bkImage, dwNewWidth, dwNewHeight);
 
-  dcTemplate.SelectBitmap(bmpTemplate);
+  // the original is held while the image is laid out
+  const fipImage& sourceImage = image ? *image : *(pEnumData->bkImage->originalImage);
+
+  ImageHandler::CalcRelativeSize(sourceImage, pEnumData->bkImage, dwNewWidth, dwNewHeight);
 
-  ImageHandler::PaintTemplateImage(
-    dcTemplate, 
+  ImageHandler::AddTilePlacement(
+    stSource,
     rectMonitor.left - ::GetSystemMetrics(SM_XVIRTUALSCREEN), 
     rectMonitor.top  - ::GetSystemMetrics(SM_YVIRTUALSCREEN), 
     dwNewWidth,
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <unordered_map>
+
 #include "../FreeImage/FreeImagePlus.h"
+#include "ImageCache.h"
 
 //////////////////////////////////////////////////////////////////////////////
 
@@ -101,6 +104,39 @@ struct ImageData
 
 };
 
+struct ImageDataHash
+{
+	size_t operator()(const ImageData& imageData) const
+	{
+		size_t stHash = std::hash<wstring>()(imageData.strFilename);
+
+		stHash = stHash * 31 + static_cast<size_t>(imageData.bRelative);
+		stHash = stHash * 31 + static_cast<size_t>(imageData.bExtend);
+		stHash = stHash * 31 + static_cast<size_t>(imageData.imagePosition);
+		stHash = stHash * 31 + static_cast<size_t>(imageData.crBackground);
+		stHash = stHash * 31 + static_cast<size_t>(imageData.crTint);
+		stHash = stHash * 31 + static_cast<size_t>(imageData.byTintOpacity);
+
+		return stHash;
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// bitmap painted for an earlier client size
+
+struct CachedImage
+{
+	DWORD						dwWidth;
+	DWORD						dwHeight;
+	std::shared_ptr<CBitmap>	image;
+};
+
+typedef vector<CachedImage>	CachedImages;
+
 //////////////////////////////////////////////////////////////////////////////
 
 
@@ -115,9 +151,18 @@ struct BackgroundImage
 	, dwImageWidth(0)
 	, dwImageHeight(0)
 	, bWallpaper(false)
+	, pendingImageData()
+	, pendingEntry()
+	, cacheEntry()
+	, bDecoding(false)
 	, originalImage()
 	, image()
 	, dcImage()
+	, bPlaceholder(false)
+	, cachedImages()
+	, tiles()
+	, rescaledImage()
+	, lRescaleGeneration(0)
 	, updateCritSec()
 	{
 	}
@@ -131,35 +176,78 @@ struct BackgroundImage
 
 	bool				bWallpaper;
 
+	// new wallpaper being decoded, the current one is shown until it's done
+	ImageData			pendingImageData;
+	std::shared_ptr<ImageCacheEntry> pendingEntry;
+
+	// decoded file, shared with other images using it
+	std::shared_ptr<ImageCacheEntry> cacheEntry;
+
+	// painted without the original, it's being decoded
+	bool				bDecoding;
+
+	// held only while the bitmap is being painted or rescaled, so the cache
+	// can drop the decode in between
 	std::shared_ptr<fipImage> originalImage;
 
 	CBitmap				image;
 	CDC					dcImage;
 
+	// image is a stretched copy of the last good bitmap, the exact size is
+	// still being rescaled
+	bool				bPlaceholder;
+
+	// recently used sizes, most recent first (non-relative images only)
+	CachedImages		cachedImages;
+
+	// relative images cover the whole virtual screen; they're rendered a
+	// tile at a time, under the windows showing them
+	std::unique_ptr<BackgroundTiles> tiles;
+
+	// set by ImageRescaler
+	std::shared_ptr<fipImage> rescaledImage;
+	volatile LONG		lRescaleGeneration;
+
 	CriticalSection		updateCritSec;
 };
 
+class ImageHandler;
+
 struct MonitorEnumData
 {
-	MonitorEnumData(const CDC& dcTempl, std::shared_ptr<BackgroundImage>& img)
-	: bkImage(img)
-	, dcTemplate(dcTempl)
+	MonitorEnumData(ImageHandler* handler, std::shared_ptr<BackgroundImage>& img, size_t source, DWORD width, DWORD height)
+	: pImageHandler(handler)
+	, bkImage(img)
+	, stSource(source)
+	, dwSrcWidth(width)
+	, dwSrcHeight(height)
 	{
 	}
 
+	ImageHandler*						pImageHandler;
 	std::shared_ptr<BackgroundImage>&	bkImage;
-	const CDC&                        dcTemplate;
+
+	// the image's tile source and its size on each monitor
+	size_t								stSource;
+	DWORD								dwSrcWidth;
+	DWORD								dwSrcHeight;
 };
 
 //////////////////////////////////////////////////////////////////////////////
 
-typedef vector<std::shared_ptr<BackgroundImage> >	Images;
+// images are owned by the views using them
+typedef std::unordered_map<ImageData, std::weak_ptr<BackgroundImage>, ImageDataHash>	Images;
 
 //////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
 
 
+//////////////////////////////////////////////////////////////////////////////
+
+class ImageDecoder;
+class ImageRescaler;
+
 //////////////////////////////////////////////////////////////////////////////
 
 class ImageHandler
@@ -176,17 +264,58 @@ class ImageHandler
 		void ReloadDesktopImages();
 
 		void UpdateImageBitmap(const CDC& dc, const CRect& clientRect, std::shared_ptr<BackgroundImage>& bkImage);
+
+		// paints a relative image to rect, (nImageX, nImageY) is rect's top
+		// left corner relative to the virtual screen
+		static void PaintRelativeImage(CDC& dc, const CRect& rect, int nImageX, int nImageY, std::shared_ptr<BackgroundImage>& bkImage);
+
+		// rescaled images are ready when UM_IMAGE_RESCALED is posted to hwndNotify;
+		// until the rescaler is started, images are rescaled synchronously
+		void StartRescaler(HWND hwndNotify);
+		void StopRescaler();
+
+		// once the decoder is started, files are decoded on worker threads and
+		// UM_IMAGE_DECODED is posted to hwndNotify when some are done; images
+		// are painted with their background color until then
+		void StartDecoder(HWND hwndNotify);
+		void StopDecoder();
+		void UpdateDecodedImages();
+
+		// the active view's image is decoded first
+		void SetVisibleImage(const std::shared_ptr<BackgroundImage>& bkImage);
+
+		// memory allowed for decoded images that aren't in use
+		void SetCacheBudget(size_t stBudget);
+		void DumpImageStats(wostream& os);
+
     static inline bool IsWin8(void) { return m_win8; }
 
 	private:
 
 		static bool GetDesktopImageData(ImageData& imageData);
-		static bool LoadImage(std::shared_ptr<BackgroundImage>& bkImage);
+		bool LoadImage(std::shared_ptr<BackgroundImage>& bkImage);
+		void AddImage(const std::shared_ptr<BackgroundImage>& bkImage);
+		static void DeleteImage(std::shared_ptr<BackgroundImage>& bkImage);
+
+		void RequestDecode(const std::shared_ptr<ImageCacheEntry>& entry);
 
-		static void CalcRescale(DWORD& dwNewWidth, DWORD& dwNewHeight, std::shared_ptr<BackgroundImage>& bkImage);
-		static void PaintRelativeImage(const CDC& dc, CBitmap&	bmpTemplate, std::shared_ptr<BackgroundImage>& bkImage, DWORD& dwDisplayWidth, DWORD& dwDisplayHeight);
-		static void CreateRelativeImage(const CDC& dc, std::shared_ptr<BackgroundImage>& bkImage);
-		static void CreateImage(const CDC& dc, const CRect& clientRect, std::shared_ptr<BackgroundImage>& bkImage);
+		static wstring GetImageFilename(const wstring& strFilename);
+		static std::shared_ptr<fipImage> DecodeImage(const wstring& strFilename, size_t& stBytes);
+
+		std::shared_ptr<fipImage> AcquireOriginalImage(std::shared_ptr<BackgroundImage>& bkImage);
+		void ReleaseOriginalImage(std::shared_ptr<BackgroundImage>& bkImage);
+
+		static void CalcRescale(DWORD& dwNewWidth, DWORD& dwNewHeight, ImagePosition imagePosition, DWORD dwOriginalWidth, DWORD dwOriginalHeight);
+		static void CalcRelativeSize(const fipImage& image, std::shared_ptr<BackgroundImage>& bkImage, DWORD& dwDisplayWidth, DWORD& dwDisplayHeight);
+		static size_t AddTileSource(const std::shared_ptr<fipImage>& image, std::shared_ptr<BackgroundImage>& bkImage);
+		static void AddTilePlacement(size_t stSource, int nOffsetX, int nOffsetY, DWORD dwSrcWidth, DWORD dwSrcHeight, DWORD dwDstWidth, DWORD dwDstHeight, std::shared_ptr<BackgroundImage>& bkImage);
+		void CreateRelativeImage(std::shared_ptr<BackgroundImage>& bkImage);
+		void CreateImage(const CDC& dc, const CRect& clientRect, std::shared_ptr<BackgroundImage>& bkImage);
+
+		static bool SelectCachedImage(DWORD dwWidth, DWORD dwHeight, std::shared_ptr<BackgroundImage>& bkImage);
+		static void SetImage(CBitmap& image, DWORD dwWidth, DWORD dwHeight, bool bPlaceholder, std::shared_ptr<BackgroundImage>& bkImage);
+		static void PaintPlaceholderImage(const CDC& dc, DWORD dwWidth, DWORD dwHeight, std::shared_ptr<BackgroundImage>& bkImage);
+		static void ClearCachedImages(std::shared_ptr<BackgroundImage>& bkImage);
 
 		static void PaintTemplateImage(const CDC& dcTemplate, int nOffsetX, int nOffsetY, DWORD dwSrcWidth, DWORD dwSrcHeight, DWORD dwDstWidth, DWORD dwDstHeight, std::shared_ptr<BackgroundImage>& bkImage);
 		static void TileTemplateImage(const CDC& dcTemplate, int nOffsetX, int nOffsetY, std::shared_ptr<BackgroundImage>& bkImage);
@@ -200,8 +329,14 @@ class ImageHandler
 
 	private:
 
-		Images	m_images;
+		Images		m_images;
+		ImageCache	m_imageCache;
 		static bool	m_win8;
+
+		std::unique_ptr<ImageDecoder>	m_decoder;
+		std::weak_ptr<BackgroundImage>	m_visibleImage;
+
+		std::unique_ptr<ImageRescaler>	m_rescaler;
 };
 
 //////////////////////////////////////////////////////////////////////////////
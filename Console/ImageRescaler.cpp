@@ -0,0 +1,183 @@
+#include "stdafx.h"
+
+#include "ImageRescaler.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+ImageRescaler::ImageRescaler(HWND hwndNotify)
+: m_hwndNotify(hwndNotify)
+, m_requestsCritSec()
+, m_requests()
+, m_hRequestEvent(::CreateEvent(NULL, FALSE, FALSE, NULL))
+{
+}
+
+ImageRescaler::~ImageRescaler()
+{
+	try
+	{
+		Stop(INFINITE);
+	}
+	catch(std::exception&)
+	{
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ImageRescaler::Request(const std::shared_ptr<BackgroundImage>& bkImage, DWORD dwWidth, DWORD dwHeight)
+{
+	RescaleRequest	request;
+
+	request.bkImage		= bkImage;
+	request.lGeneration	= ::InterlockedIncrement(&bkImage->lRescaleGeneration);
+	request.dwWidth		= dwWidth;
+	request.dwHeight	= dwHeight;
+
+	{
+		CriticalSectionLock	lock(m_requestsCritSec);
+
+		// a newer size supersedes the pending one
+		RescaleRequests::iterator it = m_requests.begin();
+		for (; it != m_requests.end(); ++it) if (it->bkImage == bkImage) break;
+
+		if (it != m_requests.end())
+		{
+			*it = request;
+		}
+		else
+		{
+			m_requests.push_back(request);
+		}
+	}
+
+	::SetEvent(m_hRequestEvent.get());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ImageRescaler::Cancel(const std::shared_ptr<BackgroundImage>& bkImage)
+{
+	::InterlockedIncrement(&bkImage->lRescaleGeneration);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+std::shared_ptr<fipImage> ImageRescaler::Rescale(const fipImage& originalImage, DWORD dwWidth, DWORD dwHeight, const Resampler::CancelCallback& cancel)
+{
+	TRACE_SCOPE("ImageRescaler::Rescale");
+
+	// original images are converted to 32 bpp when they're loaded
+	std::shared_ptr<fipImage> rescaledImage(new fipImage(FIT_BITMAP, dwWidth, dwHeight, 32));
+
+	if (!rescaledImage->isValid()) return std::shared_ptr<fipImage>();
+
+	// both are bottom-up DIBs, no need to flip anything
+	if (!Resampler::Resample(
+			originalImage.accessPixels(),
+			originalImage.getWidth(),
+			originalImage.getHeight(),
+			originalImage.getScanWidth(),
+			rescaledImage->accessPixels(),
+			dwWidth,
+			dwHeight,
+			rescaledImage->getScanWidth(),
+			cancel))
+	{
+		return std::shared_ptr<fipImage>();
+	}
+
+	return rescaledImage;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+DWORD ImageRescaler::Process(HANDLE hStopSignal)
+{
+	TRACE_THREAD_NAME("ImageRescaler");
+
+	HANDLE	arrWaitHandles[] = { hStopSignal, m_hRequestEvent.get() };
+	// the stop signal is an auto-reset event, remember if we've consumed it
+	bool	bStop = false;
+
+	while (::WaitForMultipleObjects(sizeof(arrWaitHandles)/sizeof(arrWaitHandles[0]), arrWaitHandles, FALSE, INFINITE) != WAIT_OBJECT_0)
+	{
+		while (!bStop)
+		{
+			RescaleRequest	request;
+
+			{
+				CriticalSectionLock	lock(m_requestsCritSec);
+
+				if (m_requests.empty()) break;
+
+				request = m_requests.front();
+				m_requests.erase(m_requests.begin());
+			}
+
+			std::shared_ptr<BackgroundImage>&	bkImage		= request.bkImage;
+			LONG								lGeneration	= request.lGeneration;
+
+			if (bkImage->lRescaleGeneration != lGeneration) continue;
+
+			std::shared_ptr<fipImage>	originalImage;
+
+			{
+				CriticalSectionLock	lock(bkImage->updateCritSec);
+				originalImage = bkImage->originalImage;
+			}
+
+			if (!originalImage) continue;
+
+			std::shared_ptr<fipImage> rescaledImage(Rescale(
+				*originalImage,
+				request.dwWidth,
+				request.dwHeight,
+				[&bkImage, lGeneration, hStopSignal, &bStop]() -> bool
+				{
+					// the window has been resized again, or we're shutting down
+					if (::WaitForSingleObject(hStopSignal, 0) == WAIT_OBJECT_0) bStop = true;
+
+					return bStop || (bkImage->lRescaleGeneration != lGeneration);
+				}));
+
+			if (!rescaledImage) continue;
+
+			{
+				CriticalSectionLock	lock(bkImage->updateCritSec);
+
+				if (bkImage->lRescaleGeneration != lGeneration) continue;
+
+				bkImage->rescaledImage = rescaledImage;
+			}
+
+			::PostMessage(m_hwndNotify, UM_IMAGE_RESCALED, 0, 0);
+		}
+
+		if (bStop) break;
+	}
+
+	return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Resampler.h"
+#include "Wallpaper.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Rescales background images off the UI thread while the window is being
+// resized. A new request for an image cancels the one before it, even if
+// it's already running; finished images are stored in
+// BackgroundImage::rescaledImage and UM_IMAGE_RESCALED is posted to the
+// notify window.
+
+class ImageRescaler : public MyThread
+{
+	public:
+
+		explicit ImageRescaler(HWND hwndNotify);
+		virtual ~ImageRescaler();
+
+	public:
+
+		// UI thread
+		void Request(const std::shared_ptr<BackgroundImage>& bkImage, DWORD dwWidth, DWORD dwHeight);
+
+		// cancels pending and running requests for the image
+		static void Cancel(const std::shared_ptr<BackgroundImage>& bkImage);
+
+		// resamples the original image to dwWidth x dwHeight; returns an
+		// empty pointer if cancelled
+		static std::shared_ptr<fipImage> Rescale(const fipImage& originalImage, DWORD dwWidth, DWORD dwHeight, const Resampler::CancelCallback& cancel);
+
+		virtual DWORD Process(HANDLE hStopSignal);
+
+	private:
+
+		struct RescaleRequest
+		{
+			std::shared_ptr<BackgroundImage>	bkImage;
+			LONG								lGeneration;
+			DWORD								dwWidth;
+			DWORD								dwHeight;
+		};
+
+		typedef vector<RescaleRequest>	RescaleRequests;
+
+	private:
+
+		HWND					m_hwndNotify;
+
+		CriticalSection			m_requestsCritSec;
+		RescaleRequests			m_requests;
+
+		std::unique_ptr<void, CloseHandleHelper>	m_hRequestEvent;
+};
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,319 @@
+#include "stdafx.h"
+
+#include <math.h>
+
+#include "LatencyStats.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// lower bound of the first bucket
+static const double	HISTOGRAM_MIN_MS = 0.05;
+
+LatencyHistogram::LatencyHistogram()
+: m_dwCount(0)
+, m_dMax(0.0)
+{
+	::ZeroMemory(m_dwBuckets, sizeof(m_dwBuckets));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void LatencyHistogram::Add(double dMilliseconds)
+{
+	int nBucket = 0;
+
+	if (dMilliseconds > HISTOGRAM_MIN_MS)
+	{
+		nBucket = static_cast<int>(::log(dMilliseconds / HISTOGRAM_MIN_MS) / ::log(2.0) * BUCKETS_PER_OCTAVE);
+		if (nBucket >= BUCKET_COUNT) nBucket = BUCKET_COUNT - 1;
+	}
+
+	++m_dwBuckets[nBucket];
+	++m_dwCount;
+
+	if (dMilliseconds > m_dMax) m_dMax = dMilliseconds;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void LatencyHistogram::Reset()
+{
+	::ZeroMemory(m_dwBuckets, sizeof(m_dwBuckets));
+	m_dwCount	= 0;
+	m_dMax		= 0.0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+double LatencyHistogram::GetPercentile(double dPercentile) const
+{
+	if (m_dwCount == 0) return 0.0;
+
+	DWORD dwRank	= static_cast<DWORD>(::ceil(dPercentile / 100.0 * m_dwCount));
+	DWORD dwTotal	= 0;
+
+	if (dwRank == 0) dwRank = 1;
+
+	for (int i = 0; i < BUCKET_COUNT; ++i)
+	{
+		dwTotal += m_dwBuckets[i];
+
+		if (dwTotal >= dwRank)
+		{
+			// upper bound of the bucket, but never more than we've actually seen
+			double dUpper = HISTOGRAM_MIN_MS * ::pow(2.0, static_cast<double>(i + 1) / BUCKETS_PER_OCTAVE);
+			return min(dUpper, m_dMax);
+		}
+	}
+
+	return m_dMax;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+LatencyStats::LatencyStats()
+: m_critSec()
+, m_dTicksPerMs(1.0)
+, m_lCompletedSeq(0)
+, m_bPending(false)
+, m_bDispatched(false)
+, m_lFirstSeq(0)
+, m_lLastSeq(0)
+, m_llWakeTime(0)
+, m_llReadTime(0)
+, m_llNotifyTime(0)
+, m_llDispatchTime(0)
+{
+	LARGE_INTEGER liFrequency;
+	::QueryPerformanceFrequency(&liFrequency);
+	m_dTicksPerMs = static_cast<double>(liFrequency.QuadPart) / 1000.0;
+
+	::ZeroMemory(m_inputStamps, sizeof(m_inputStamps));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+LONGLONG LatencyStats::GetTime()
+{
+	LARGE_INTEGER liTime;
+	::QueryPerformanceCounter(&liTime);
+	return liTime.QuadPart;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void LatencyStats::OnInput(LONG lSeq)
+{
+	CriticalSectionLock lock(m_critSec);
+
+	InputStamp& inputStamp = m_inputStamps[static_cast<DWORD>(lSeq) % INPUT_STAMP_COUNT];
+
+	inputStamp.lSeq		= lSeq;
+	inputStamp.llTime	= GetTime();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void LatencyStats::OnBufferChanged(LONG lReadSeq, LONGLONG llWakeTime, LONGLONG llReadTime)
+{
+	CriticalSectionLock lock(m_critSec);
+
+	// nothing new typed since the last change
+	if (lReadSeq - m_lCompletedSeq <= 0) return;
+
+	if (m_bPending)
+	{
+		// previous change hasn't been painted yet, it will be painted
+		// together with this one
+		m_lLastSeq = lReadSeq;
+	}
+	else
+	{
+		m_bPending			= true;
+		m_bDispatched		= false;
+		m_lFirstSeq			= m_lCompletedSeq + 1;
+		m_lLastSeq			= lReadSeq;
+		m_llWakeTime		= llWakeTime;
+		m_llReadTime		= llReadTime;
+		m_llNotifyTime		= GetTime();
+	}
+
+	m_lCompletedSeq = lReadSeq;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void LatencyStats::OnViewUpdated()
+{
+	CriticalSectionLock lock(m_critSec);
+
+	if (!m_bPending || m_bDispatched) return;
+
+	m_bDispatched		= true;
+	m_llDispatchTime	= GetTime();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool LatencyStats::OnPainted()
+{
+	CriticalSectionLock lock(m_critSec);
+
+	if (!m_bPending || !m_bDispatched) return false;
+
+	LONGLONG	llPaintTime	= GetTime();
+	bool		bRecorded	= false;
+
+	for (LONG lSeq = m_lFirstSeq; lSeq - m_lLastSeq <= 0; ++lSeq)
+	{
+		const InputStamp& inputStamp = m_inputStamps[static_cast<DWORD>(lSeq) % INPUT_STAMP_COUNT];
+
+		// overwritten by newer input
+		if (inputStamp.lSeq != lSeq) continue;
+
+		m_histograms[stageWake].Add(ToMilliseconds(m_llWakeTime - inputStamp.llTime));
+		m_histograms[stageTotal].Add(ToMilliseconds(llPaintTime - inputStamp.llTime));
+		bRecorded = true;
+	}
+
+	if (bRecorded)
+	{
+		m_histograms[stageRead].Add(ToMilliseconds(m_llReadTime - m_llWakeTime));
+		m_histograms[stageNotify].Add(ToMilliseconds(m_llNotifyTime - m_llReadTime));
+		m_histograms[stageDispatch].Add(ToMilliseconds(m_llDispatchTime - m_llNotifyTime));
+		m_histograms[stagePaint].Add(ToMilliseconds(llPaintTime - m_llDispatchTime));
+	}
+
+	m_bPending = false;
+
+	return bRecorded;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void LatencyStats::Discard()
+{
+	CriticalSectionLock lock(m_critSec);
+
+	m_bPending = false;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void LatencyStats::Reset()
+{
+	CriticalSectionLock lock(m_critSec);
+
+	for (int i = 0; i < stageCount; ++i) m_histograms[i].Reset();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+wstring LatencyStats::GetSummary()
+{
+	CriticalSectionLock lock(m_critSec);
+
+	const LatencyHistogram& total = m_histograms[stageTotal];
+
+	return boost::str(boost::wformat(L"input latency p50 %.1f ms, p99 %.1f ms (%u)")
+		% total.GetPercentile(50.0)
+		% total.GetPercentile(99.0)
+		% total.GetCount());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void LatencyStats::Dump(wostream& os)
+{
+	static const wchar_t* arrStageNames[stageCount] =
+	{
+		L"key -> hook wake",
+		L"hook wake -> buffer read",
+		L"buffer read -> Console",
+		L"Console -> view update",
+		L"view update -> paint",
+		L"total",
+	};
+
+	CriticalSectionLock lock(m_critSec);
+
+	for (int i = 0; i < stageCount; ++i)
+	{
+		const LatencyHistogram& histogram = m_histograms[i];
+
+		os << boost::str(boost::wformat(L"  %-26s n=%-6u p50=%8.2f ms  p99=%8.2f ms  max=%8.2f ms")
+			% arrStageNames[i]
+			% histogram.GetCount()
+			% histogram.GetPercentile(50.0)
+			% histogram.GetPercentile(99.0)
+			% histogram.GetMax())
+			<< endl;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+double LatencyStats::ToMilliseconds(LONGLONG llTicks) const
+{
+	// stamps from another process can be slightly off
+	if (llTicks < 0) return 0.0;
+
+	return static_cast<double>(llTicks) / m_dTicksPerMs;
+}
+
+//////////////////////////////////////////////////////////////////////////////
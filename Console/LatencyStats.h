@@ -0,0 +1,134 @@
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Log-scale latency histogram, 8 buckets per octave from 50us to ~3s.
+
+class LatencyHistogram
+{
+	public:
+
+		LatencyHistogram();
+
+	public:
+
+		void Add(double dMilliseconds);
+		void Reset();
+
+		DWORD GetCount() const { return m_dwCount; }
+		double GetMax() const { return m_dMax; }
+
+		// approximate percentile (0-100) in milliseconds
+		double GetPercentile(double dPercentile) const;
+
+	private:
+
+		static const int	BUCKET_COUNT		= 128;
+		static const int	BUCKETS_PER_OCTAVE	= 8;
+
+		DWORD	m_dwBuckets[BUCKET_COUNT];
+		DWORD	m_dwCount;
+		double	m_dMax;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Input-to-pixel latency of a console view.
+//
+// Each key forwarded to the console gets a sequence number in ConsoleInfo.
+// The hook stamps the sequence it woke up with on the read that publishes
+// the next text change; Console then stamps the monitor thread pick-up,
+// UM_UPDATE_CONSOLE_VIEW and the end of WM_PAINT. All stamps are QPC values,
+// they're comparable across processes.
+
+class LatencyStats
+{
+	public:
+
+		enum Stage
+		{
+			// key posted -> hook woke up
+			stageWake		= 0,
+			// hook woke up -> changed buffer published (includes the shell's echo)
+			stageRead		= 1,
+			// published -> picked up by Console's monitor thread
+			stageNotify		= 2,
+			// monitor thread -> UM_UPDATE_CONSOLE_VIEW handled
+			stageDispatch	= 3,
+			// UM_UPDATE_CONSOLE_VIEW -> WM_PAINT done
+			stagePaint		= 4,
+			// key posted -> WM_PAINT done
+			stageTotal		= 5,
+
+			stageCount		= 6
+		};
+
+	public:
+
+		LatencyStats();
+
+	public:
+
+		static LONGLONG GetTime();
+
+		// UI thread, when a key is forwarded to the console
+		void OnInput(LONG lSeq);
+
+		// monitor thread, when a changed buffer has been copied
+		void OnBufferChanged(LONG lReadSeq, LONGLONG llWakeTime, LONGLONG llReadTime);
+
+		// UI thread
+		void OnViewUpdated();
+		// returns true if a sample was recorded
+		bool OnPainted();
+		// the view didn't paint the change (e.g. not active)
+		void Discard();
+
+		void Reset();
+
+		// one line, for the overlay
+		wstring GetSummary();
+		void Dump(wostream& os);
+
+	private:
+
+		double ToMilliseconds(LONGLONG llTicks) const;
+
+	private:
+
+		struct InputStamp
+		{
+			LONG		lSeq;
+			LONGLONG	llTime;
+		};
+
+		// inputs faster than this many keys per frame aren't all sampled
+		static const int	INPUT_STAMP_COUNT	= 64;
+
+		CriticalSection		m_critSec;
+
+		double				m_dTicksPerMs;
+
+		InputStamp			m_inputStamps[INPUT_STAMP_COUNT];
+		LONG				m_lCompletedSeq;
+
+		// change on its way to the screen
+		bool				m_bPending;
+		bool				m_bDispatched;
+		LONG				m_lFirstSeq;
+		LONG				m_lLastSeq;
+		LONGLONG			m_llWakeTime;
+		LONGLONG			m_llReadTime;
+		LONGLONG			m_llNotifyTime;
+		LONGLONG			m_llDispatchTime;
+
+		LatencyHistogram	m_histograms[stageCount];
+};
+
+//////////////////////////////////////////////////////////////////////////////
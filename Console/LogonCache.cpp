@@ -0,0 +1,186 @@
+#include "stdafx.h"
+
+#include "LogonCache.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+LogonCache::LogonCache(const std::shared_ptr<LogonProvider>& logonProvider)
+: m_logonProvider(logonProvider)
+, m_sessions()
+, m_sessionsCritSec()
+{
+}
+
+LogonCache::~LogonCache()
+{
+	Clear();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+std::shared_ptr<LogonSession> LogonCache::GetSession(const wstring& strDomain, const wstring& strUser, const wstring& strPassword, bool bNetOnly, unsigned long long qwNow)
+{
+	std::shared_ptr<LogonSession> logonSession(new LogonSession());
+
+	// net only logons are done by CreateProcessWithLogonW, nothing to cache
+	if (bNetOnly) return logonSession;
+
+	wstring strKey(GetKey(strDomain, strUser, bNetOnly));
+
+	{
+		CriticalSectionLock	lock(m_sessionsCritSec);
+
+		// expired sessions are dropped, shells being started keep theirs
+		for (LogonSessionMap::iterator it = m_sessions.begin(); it != m_sessions.end(); )
+		{
+			if (qwNow - it->second.qwLogonTime >= SESSION_TTL)
+			{
+				it = m_sessions.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+
+		LogonSessionMap::iterator it = m_sessions.find(strKey);
+		if ((it != m_sessions.end()) && IsValid(it->second, strPassword, qwNow)) return it->second.session;
+	}
+
+	// another password logs on again: a wrong one fails here, a changed one
+	// replaces the cached session
+	CachedSession cachedSession;
+
+	m_logonProvider->GenRandom(cachedSession.salt, sizeof(cachedSession.salt));
+	HashPassword(cachedSession.salt, strPassword, cachedSession.hash);
+
+	cachedSession.session		= logonSession;
+	cachedSession.qwLogonTime	= qwNow;
+
+	// the provider is captured by the deleters, sessions can outlive the cache
+	std::shared_ptr<LogonProvider> logonProvider(m_logonProvider);
+
+	logonSession->token.reset(
+		m_logonProvider->LogonUser(strUser, strDomain, strPassword),
+		[logonProvider](void* pToken) { logonProvider->CloseToken(pToken); });
+
+	logonSession->environment.reset(
+		m_logonProvider->CreateEnvironmentBlock(logonSession->token.get()),
+		[logonProvider](void* pEnvironment)
+		{
+			if (pEnvironment == nullptr) return;
+
+			// the block is a sequence of null-terminated strings, terminated by an empty one
+			wchar_t* pszVar = static_cast<wchar_t*>(pEnvironment);
+			while (*pszVar != L'\x00') pszVar += wcslen(pszVar) + 1;
+
+			::SecureZeroMemory(pEnvironment, (pszVar - static_cast<wchar_t*>(pEnvironment) + 1) * sizeof(wchar_t));
+			logonProvider->DestroyEnvironmentBlock(pEnvironment);
+		});
+
+	CriticalSectionLock	lock(m_sessionsCritSec);
+
+	// another thread might have logged on the same user in the meantime
+	LogonSessionMap::iterator it = m_sessions.find(strKey);
+	if ((it != m_sessions.end()) && IsValid(it->second, strPassword, qwNow)) return it->second.session;
+
+	m_sessions[strKey] = cachedSession;
+
+	return logonSession;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void LogonCache::Clear()
+{
+	LogonSessionMap	sessions;
+
+	{
+		CriticalSectionLock	lock(m_sessionsCritSec);
+		sessions.swap(m_sessions);
+	}
+
+	// tokens and environments are released here, unless a shell is being
+	// started with them right now
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+size_t LogonCache::GetSize()
+{
+	CriticalSectionLock	lock(m_sessionsCritSec);
+	return m_sessions.size();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+wstring LogonCache::GetKey(const wstring& strDomain, const wstring& strUser, bool bNetOnly)
+{
+	// account names are case insensitive
+	wstring strKey(strDomain + L"\\" + strUser + (bNetOnly ? L"|net" : L""));
+	std::transform(strKey.begin(), strKey.end(), strKey.begin(), ::towlower);
+
+	return strKey;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void LogonCache::HashPassword(const unsigned char* pSalt, const wstring& strPassword, unsigned char* pHash)
+{
+	vector<unsigned char> data(LogonProvider::SALT_SIZE + strPassword.length() * sizeof(wchar_t));
+
+	::memcpy(&data[0], pSalt, LogonProvider::SALT_SIZE);
+	if (strPassword.length() > 0) ::memcpy(&data[LogonProvider::SALT_SIZE], strPassword.c_str(), strPassword.length() * sizeof(wchar_t));
+
+	try
+	{
+		m_logonProvider->Hash(&data[0], data.size(), pHash);
+	}
+	catch (...)
+	{
+		::SecureZeroMemory(&data[0], data.size());
+		throw;
+	}
+
+	::SecureZeroMemory(&data[0], data.size());
+}
+
+bool LogonCache::IsValid(const CachedSession& cachedSession, const wstring& strPassword, unsigned long long qwNow)
+{
+	if (qwNow - cachedSession.qwLogonTime >= SESSION_TTL) return false;
+
+	unsigned char hash[LogonProvider::HASH_SIZE];
+	unsigned char byDiff = 0;
+
+	HashPassword(cachedSession.salt, strPassword, hash);
+
+	// compared in full, the time taken doesn't tell how much of it matched
+	for (size_t i = 0; i < sizeof(hash); ++i) byDiff |= hash[i] ^ cachedSession.hash[i];
+
+	return byDiff == 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
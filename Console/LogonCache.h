@@ -0,0 +1,111 @@
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Logon calls used by LogonCache, kept behind an interface so the cache
+// can be driven by a fake provider. Win32LogonProvider makes the real ones.
+
+class LogonProvider
+{
+	public:
+
+		virtual ~LogonProvider() {}
+
+		// throws Win32Exception on failure
+		virtual HANDLE LogonUser(const wstring& strUser, const wstring& strDomain, const wstring& strPassword) = 0;
+		virtual void* CreateEnvironmentBlock(HANDLE hToken) = 0;
+
+		virtual void CloseToken(HANDLE hToken) = 0;
+		virtual void DestroyEnvironmentBlock(void* pEnvironment) = 0;
+
+		// random bytes for the password salts, and a SHA-256 of the salted
+		// password (HASH_SIZE bytes); throw Win32Exception on failure
+		virtual void GenRandom(unsigned char* pBuffer, size_t stSize) = 0;
+		virtual void Hash(const unsigned char* pData, size_t stSize, unsigned char* pHash) = 0;
+
+	public:
+
+		enum
+		{
+			SALT_SIZE	= 16,
+			HASH_SIZE	= 32
+		};
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+struct LogonSession
+{
+	std::shared_ptr<void>	token;
+	std::shared_ptr<void>	environment;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Logon tokens and user environment blocks for "run as user" tabs, keyed
+// by (domain, user, net only). A session is only handed out for the
+// password it was logged on with (kept as a salted hash), and for
+// SESSION_TTL after the logon; otherwise the user is logged on again and
+// the session replaced. Environment blocks are wiped before they're
+// released. Times are milliseconds (GetTickCount64). Only needs the Win32
+// types and a critical section, it can be built and tested on its own.
+
+class LogonCache
+{
+	public:
+
+		explicit LogonCache(const std::shared_ptr<LogonProvider>& logonProvider);
+		~LogonCache();
+
+	public:
+
+		enum
+		{
+			SESSION_TTL	= 15 * 60 * 1000
+		};
+
+	public:
+
+		// returns a cached session or logs the user on; throws Win32Exception
+		std::shared_ptr<LogonSession> GetSession(const wstring& strDomain, const wstring& strUser, const wstring& strPassword, bool bNetOnly, unsigned long long qwNow);
+
+		void Clear();
+
+		size_t GetSize();
+
+	private:
+
+		struct CachedSession
+		{
+			std::shared_ptr<LogonSession>	session;
+			unsigned char					salt[LogonProvider::SALT_SIZE];
+			unsigned char					hash[LogonProvider::HASH_SIZE];
+			unsigned long long				qwLogonTime;
+		};
+
+	private:
+
+		static wstring GetKey(const wstring& strDomain, const wstring& strUser, bool bNetOnly);
+
+		void HashPassword(const unsigned char* pSalt, const wstring& strPassword, unsigned char* pHash);
+		bool IsValid(const CachedSession& cachedSession, const wstring& strPassword, unsigned long long qwNow);
+
+	private:
+
+		typedef map<wstring, CachedSession>	LogonSessionMap;
+
+		std::shared_ptr<LogonProvider>	m_logonProvider;
+		LogonSessionMap					m_sessions;
+		CriticalSection					m_sessionsCritSec;
+};
+
+//////////////////////////////////////////////////////////////////////////////
@@ -1,6 +1,8 @@
 #include "stdafx.h"
 #include "resource.h"
 
+#include <fstream>
+
 #include "aboutdlg.h"
 #include "Console.h"
 #include "TabView.h"
@@ -10,6 +12,8 @@
 #include "DlgSettingsMain.h"
 #include "MainFrame.h"
 #include "JumpList.h"
+#include "ShellPool.h"
+#include "IconCache.h"
 
 //////////////////////////////////////////////////////////////////////////////
 
@@ -19,6 +23,26 @@
 //////////////////////////////////////////////////////////////////////////////
 
 
+// GUID_MONITOR_POWER_ON, display on/off notifications
+static const GUID s_guidMonitorPowerOn = { 0x02731015, 0x4510, 0x4526, { 0x99, 0xE6, 0xE5, 0xA1, 0x7E, 0xBD, 0x1A, 0xEA } };
+
+typedef HRESULT (WINAPI *DwmGetWindowAttributeFn)(HWND, DWORD, PVOID, DWORD);
+
+// cloaked windows (other virtual desktops, suspended store apps) are
+// 'visible' without being seen; dwmapi isn't linked in all builds
+static bool IsWindowCloaked(HWND hwnd)
+{
+	static HMODULE					hDwmApi					= ::LoadLibrary(L"dwmapi.dll");
+	static DwmGetWindowAttributeFn	fnDwmGetWindowAttribute	= (hDwmApi != NULL) ? reinterpret_cast<DwmGetWindowAttributeFn>(::GetProcAddress(hDwmApi, "DwmGetWindowAttribute")) : NULL;
+
+	if (fnDwmGetWindowAttribute == NULL) return false;
+
+	// DWMWA_CLOAKED, Windows 8 and later
+	DWORD dwCloaked = 0;
+
+	return SUCCEEDED(fnDwmGetWindowAttribute(hwnd, 14, &dwCloaked, sizeof(dwCloaked))) && (dwCloaked != 0);
+}
+
 //////////////////////////////////////////////////////////////////////////////
 static void ParseCommandLine
 (
@@ -100,12 +124,19 @@ MainFrame::MainFrame
 , m_mousedragOffset(0, 0)
 , m_tabs()
 , m_tabsMutex(NULL, FALSE, NULL)
+, m_openedTabsMenuIcons()
 , m_dwWindowWidth(0)
 , m_dwWindowHeight(0)
 , m_dwResizeWindowEdge(WMSZ_BOTTOM)
+, m_bDragged(false)
+, m_dwDragResizeRequests(0)
+, m_dwDragResizesSent(0)
 , m_bRestoringWindow(false)
 , m_rectRestoredWnd(0, 0, 0, 0)
 , m_bAppActive(true)
+, m_visibility()
+, m_bOcclusionTimerRunning(false)
+, m_hDisplayPowerNotify(NULL)
 {
 	m_Margins.cxLeftWidth    = 0;
 	m_Margins.cxRightWidth   = 0;
@@ -297,6 +328,9 @@ LRESULT MainFrame::OnCreate(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/,
 
 	CreateTabWindow(m_hWnd, rcDefault, dwTabStyles);
 
+	// background images of the initial tabs are decoded while their shells start
+	g_imageHandler->StartDecoder(m_hWnd);
+
 	if (LRESULT created = CreateInitialTabs(m_startupTabs, m_startupCmds, m_startupDirs, m_nMultiStartSleep))
 		return created;
 
@@ -370,6 +404,10 @@ LRESULT MainFrame::OnCreate(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/,
 	CreateAcceleratorTable();
 	RegisterGlobalHotkeys();
 
+	// nothing is seen on a locked session or with the display off
+	::WTSRegisterSessionNotification(m_hWnd, NOTIFY_FOR_THIS_SESSION);
+	m_hDisplayPowerNotify = ::RegisterPowerSettingNotification(m_hWnd, &s_guidMonitorPowerOn, DEVICE_NOTIFY_WINDOW_HANDLE);
+
 	AdjustWindowSize(ADJUSTSIZE_NONE);
 
 	CRect rectWindow;
@@ -470,6 +508,10 @@ LRESULT MainFrame::OnClose(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/,
 
 	UnregisterGlobalHotkeys();
 
+	::WTSUnRegisterSessionNotification(m_hWnd);
+	if (m_hDisplayPowerNotify != NULL) ::UnregisterPowerSettingNotification(m_hDisplayPowerNotify);
+	if (m_bOcclusionTimerRunning) KillTimer(TIMER_OCCLUSION);
+
 	DestroyWindow();
 	PostQuitMessage(0);
 	return 0;
@@ -484,6 +526,10 @@ LRESULT MainFrame::OnActivateApp(UINT /*uMsg*/, WPARAM wParam, LPARAM /*lParam*/
 {
   m_bAppActive = static_cast<BOOL>(wParam)? true : false;
 
+  // an activated frame is in front; a deactivated one starts checking
+  // whether it's still seen
+  SetVisibility(VisibilityState::reasonOccluded, false);
+
 	if (!m_activeTabView) return 0;
 
   this->ActivateApp();
@@ -536,6 +582,72 @@ void MainFrame::ActivateApp(void)
 //////////////////////////////////////////////////////////////////////////////
 
 
+//////////////////////////////////////////////////////////////////////////////
+
+void MainFrame::SetVisibility(VisibilityState::Reason reason, bool bSet)
+{
+	if (m_visibility.Set(reason, bSet))
+	{
+		TRACE(L"MainFrame visibility: %s (0x%02X)\n", m_visibility.IsVisible() ? L"visible" : L"not visible", m_visibility.GetReasons());
+
+		// one paint of what the active views got while nothing was seen
+		if (m_visibility.IsVisible() && m_activeTabView) m_activeTabView->CatchUp();
+	}
+
+	// other windows are checked for while one of them is in front
+	bool bCheckOcclusion = m_visibility.CanBeOccluded() && !m_bAppActive;
+
+	if (bCheckOcclusion == m_bOcclusionTimerRunning) return;
+
+	if (bCheckOcclusion)
+	{
+		SetTimer(TIMER_OCCLUSION, TIMER_OCCLUSION_INTERVAL);
+	}
+	else
+	{
+		KillTimer(TIMER_OCCLUSION);
+	}
+
+	m_bOcclusionTimerRunning = bCheckOcclusion;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool MainFrame::IsOccluded()
+{
+	CRect rectWindow;
+	GetWindowRect(&rectWindow);
+
+	CRgn rgnUncovered;
+	CRgn rgnOther;
+
+	rgnUncovered.CreateRectRgnIndirect(&rectWindow);
+	rgnOther.CreateRectRgn(0, 0, 0, 0);
+
+	// windows in front of ours, nearest first
+	for (HWND hwnd = ::GetWindow(m_hWnd, GW_HWNDPREV); hwnd != NULL; hwnd = ::GetWindow(hwnd, GW_HWNDPREV))
+	{
+		if (!::IsWindowVisible(hwnd) || ::IsIconic(hwnd) || IsWindowCloaked(hwnd)) continue;
+
+		// see-through windows don't hide anything
+		if (::GetWindowLong(hwnd, GWL_EXSTYLE) & (WS_EX_LAYERED | WS_EX_TRANSPARENT)) continue;
+
+		CRect rectOther;
+		::GetWindowRect(hwnd, &rectOther);
+
+		rgnOther.SetRectRgn(&rectOther);
+		if (rgnUncovered.CombineRgn(rgnUncovered, rgnOther, RGN_DIFF) == NULLREGION) return true;
+	}
+
+	return false;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
 //////////////////////////////////////////////////////////////////////////////
 
 void MainFrame::ShowHideWindow(void)
@@ -843,6 +955,65 @@ LRESULT MainFrame::OnWindowPosChanging(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM
 //////////////////////////////////////////////////////////////////////////////
 
 
+//////////////////////////////////////////////////////////////////////////////
+
+LRESULT MainFrame::OnWindowPosChanged(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& bHandled)
+{
+	// minimized, hidden in quake mode or to the tray, or shown again
+	SetVisibility(VisibilityState::reasonMinimized, IsIconic() ? true : false);
+	SetVisibility(VisibilityState::reasonHidden, IsWindowVisible() ? false : true);
+
+	// DefWindowProc sends WM_SIZE and WM_MOVE
+	bHandled = FALSE;
+	return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+LRESULT MainFrame::OnSessionChange(UINT /*uMsg*/, WPARAM wParam, LPARAM /*lParam*/, BOOL& /*bHandled*/)
+{
+	if (wParam == WTS_SESSION_LOCK)
+	{
+		SetVisibility(VisibilityState::reasonLocked, true);
+	}
+	else if (wParam == WTS_SESSION_UNLOCK)
+	{
+		SetVisibility(VisibilityState::reasonLocked, false);
+	}
+
+	return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+LRESULT MainFrame::OnPowerBroadcast(UINT /*uMsg*/, WPARAM wParam, LPARAM lParam, BOOL& bHandled)
+{
+	if (wParam != PBT_POWERSETTINGCHANGE)
+	{
+		bHandled = FALSE;
+		return 0;
+	}
+
+	POWERBROADCAST_SETTING* pSetting = reinterpret_cast<POWERBROADCAST_SETTING*>(lParam);
+
+	// sent with the current state when registering too
+	if ((pSetting->PowerSetting == s_guidMonitorPowerOn) && (pSetting->DataLength == sizeof(DWORD)))
+	{
+		SetVisibility(VisibilityState::reasonDisplayOff, *reinterpret_cast<DWORD*>(pSetting->Data) == 0);
+	}
+
+	return TRUE;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
 //////////////////////////////////////////////////////////////////////////////
 
 LRESULT MainFrame::OnMouseButtonUp(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& bHandled)
@@ -889,6 +1060,19 @@ LRESULT MainFrame::OnMouseMove(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM lParam,
 //////////////////////////////////////////////////////////////////////////////
 
 
+//////////////////////////////////////////////////////////////////////////////
+
+LRESULT MainFrame::OnEnterSizeMove(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/)
+{
+	GetResizeCounts(m_dwDragResizeRequests, m_dwDragResizesSent);
+	m_bDragged = true;
+
+	return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
 //////////////////////////////////////////////////////////////////////////////
 
 LRESULT MainFrame::OnExitSizeMove(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/)
@@ -910,6 +1094,11 @@ LRESULT MainFrame::OnTimer(UINT /*uMsg*/, WPARAM wParam, LPARAM /*lParam*/, BOOL
 		ResizeWindow();
 	}
 
+	if (wParam == TIMER_OCCLUSION)
+	{
+		SetVisibility(VisibilityState::reasonOccluded, IsOccluded());
+	}
+
 	return 0;
 }
 
@@ -929,6 +1118,10 @@ LRESULT MainFrame::OnSettingChange(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM lPar
 	if (strArea == L"Environment")
 	{
 		ConsoleHandler::UpdateEnvironmentBlock();
+
+		// warm consoles were started with the old environment
+		g_shellPool->Clear();
+		g_shellPool->Refresh();
 	}
 	else
 	{
@@ -990,51 +1183,56 @@ LRESULT MainFrame::OnUpdateTitles(UINT /*uMsg*/, WPARAM wParam, LPARAM /*lParam*
 
 	WindowSettings&			windowSettings	= g_settingsHandler->GetAppearanceSettings().windowSettings;
 
+	// titles are only sent here when they might have changed, the tab
+	// control, window text and tray are touched only when they did
 	if (windowSettings.bUseConsoleTitle)
 	{
 		CString	strTabTitle(consoleView->GetTitle());
 
-		UpdateTabTitle(*tabView, strTabTitle);
-
 		if ((m_strCmdLineWindowTitle.GetLength() == 0) &&
 			(windowSettings.bUseTabTitles) && 
 			(tabView == m_activeTabView))
 		{
-			m_strWindowTitle = strTabTitle;
-			SetWindowText(m_strWindowTitle);
-			if (g_settingsHandler->GetAppearanceSettings().stylesSettings.bTrayIcon) SetTrayIcon(NIM_MODIFY);
+			UpdateWindowTitle(strTabTitle);
 		}
+
+		// flooding consoles are marked on their tab only
+		if (consoleView->IsFlooded()) strTabTitle.Insert(0, L"\x00BB ");
+
+		if (tabView->UpdateShownTitle(strTabTitle)) UpdateTabTitle(*tabView, strTabTitle);
 	}
 	else
 	{
 		CString	strCommandText(consoleView->GetConsoleCommand());
 		CString	strTabTitle(consoleView->GetTitle());
 
-		if (m_strCmdLineWindowTitle.GetLength() != 0)
-		{
-			m_strWindowTitle = m_strCmdLineWindowTitle;
-		}
-		else
-		{
-			m_strWindowTitle = windowSettings.strTitle.c_str();
-		}
-
 		if (tabView == m_activeTabView)
 		{
-			if ((m_strCmdLineWindowTitle.GetLength() == 0) && (windowSettings.bUseTabTitles))
+			CString strWindowTitle;
+
+			if (m_strCmdLineWindowTitle.GetLength() != 0)
+			{
+				strWindowTitle = m_strCmdLineWindowTitle;
+			}
+			else if (windowSettings.bUseTabTitles)
 			{
-				m_strWindowTitle = strTabTitle;
+				strWindowTitle = strTabTitle;
+			}
+			else
+			{
+				strWindowTitle = windowSettings.strTitle.c_str();
 			}
 
-			if (windowSettings.bShowCommand)	m_strWindowTitle += strCommandText;
+			if (windowSettings.bShowCommand)	strWindowTitle += strCommandText;
 
-			SetWindowText(m_strWindowTitle);
-			if (g_settingsHandler->GetAppearanceSettings().stylesSettings.bTrayIcon) SetTrayIcon(NIM_MODIFY);
+			UpdateWindowTitle(strWindowTitle);
 		}
 		
 		if (windowSettings.bShowCommandInTabs) strTabTitle += strCommandText;
 
-		UpdateTabTitle(*tabView, strTabTitle);
+		if (consoleView->IsFlooded()) strTabTitle.Insert(0, L"\x00BB ");
+
+		if (tabView->UpdateShownTitle(strTabTitle)) UpdateTabTitle(*tabView, strTabTitle);
 	}
 
 	return 0;
@@ -1173,6 +1371,34 @@ LRESULT MainFrame::OnDBLClickExtendedFrameToClientArea(int /*idCtrl*/, LPNMHDR p
 //////////////////////////////////////////////////////////////////////////////
 
 
+//////////////////////////////////////////////////////////////////////////////
+
+LRESULT MainFrame::OnImageRescaled(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/)
+{
+	// replace the placeholder background, full repaint is in order
+	if (m_activeTabView) m_activeTabView->Repaint(true);
+
+	return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+LRESULT MainFrame::OnImageDecoded(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/)
+{
+	// other views pick up their new images when they're activated
+	g_imageHandler->UpdateDecodedImages();
+
+	if (m_activeTabView) m_activeTabView->Repaint(true);
+
+	return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
 //////////////////////////////////////////////////////////////////////////////
 
 LRESULT MainFrame::OnTrayNotify(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM lParam, BOOL& /*bHandled*/)
@@ -1268,6 +1494,9 @@ LRESULT MainFrame::OnTabChanged(int /*idCtrl*/, LPNMHDR pnmh, BOOL& bHandled)
 		}
 	}
 
+	// the new tab's views took what they could from the old one's
+	m_surfacePool.Trim();
+
 	if (appearanceSettings.stylesSettings.bTrayIcon) SetTrayIcon(NIM_MODIFY);
 
 	if (appearanceSettings.windowSettings.bUseTabTitles && m_activeTabView)
@@ -1275,7 +1504,7 @@ LRESULT MainFrame::OnTabChanged(int /*idCtrl*/, LPNMHDR pnmh, BOOL& bHandled)
     std::shared_ptr<ConsoleView> activeConsoleView = m_activeTabView->GetActiveConsole(_T(__FUNCTION__));
     if( activeConsoleView )
     {
-		  SetWindowText(activeConsoleView->GetTitle());
+		  UpdateWindowTitle(activeConsoleView->GetTitle());
     }
 	}
 
@@ -1760,7 +1989,19 @@ LRESULT MainFrame::OnEditSettings(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWn
     {
       it->second->InitializeScrollbars();
       it->second->GetTabData()->SetColors(consoleColors, false);
+
+      // title settings may have changed, show the titles again; the
+      // console's own title too if it's turned on
+      it->second->ApplyTitleSettings();
+      PostMessage(UM_UPDATE_TITLES, reinterpret_cast<WPARAM>(it->first), 0);
+    }
+
+    // tab icons may have been reloaded
+    for (size_t i = 0; i < m_openedTabsMenuIcons.size(); ++i)
+    {
+      if (m_openedTabsMenuIcons[i]) m_CmdBar.RemoveImage(static_cast<int>(ID_SWITCH_TAB_1 + i));
     }
+    m_openedTabsMenuIcons.clear();
 
     TabDataVector& tabDataVector = g_settingsHandler->GetTabSettings().tabDataVector;
     for (auto it = tabDataVector.begin(); it != tabDataVector.end(); ++it)
@@ -1771,6 +2012,14 @@ LRESULT MainFrame::OnEditSettings(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWn
     ConsoleView::RecreateFont(g_settingsHandler->GetAppearanceSettings().fontSettings.dwSize, false);
     AdjustWindowSize(ADJUSTSIZE_WINDOW);
 
+    // console settings are baked into warm consoles, start over
+    g_shellPool->Clear();
+    g_shellPool->Refresh();
+
+    // icon files may have changed along with the settings
+    g_iconCache->Clear();
+    g_iconCache->Prewarm();
+
     if( g_settingsHandler->GetBehaviorSettings().closeSettings.bAllowClosingLastView )
     {
       UIEnable(ID_FILE_CLOSE_TAB, TRUE);
@@ -1950,6 +2199,123 @@ LRESULT MainFrame::OnDumpBuffer(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndC
 //////////////////////////////////////////////////////////////////////////////
 
 
+//////////////////////////////////////////////////////////////////////////////
+
+LRESULT MainFrame::OnDumpTrace(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/)
+{
+#ifdef _TRACE_EVENTS
+	Helpers::DumpTrace(L"%temp%\\console.trace.json");
+#endif
+
+	return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+LRESULT MainFrame::OnDumpLatency(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/)
+{
+	wofstream of;
+	of.open(Helpers::ExpandEnvironmentStrings(_T("%temp%\\console.latency.txt")).c_str());
+
+	MutexLock lock(m_tabsMutex);
+	for (TabViewMap::iterator it = m_tabs.begin(); it != m_tabs.end(); ++it)
+	{
+		it->second->DumpLatency(of);
+	}
+
+	of.close();
+
+	return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+LRESULT MainFrame::OnDumpImages(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/)
+{
+	wofstream of;
+	of.open(Helpers::ExpandEnvironmentStrings(_T("%temp%\\console.images.txt")).c_str());
+
+	g_imageHandler->DumpImageStats(of);
+
+	of.close();
+
+	return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+LRESULT MainFrame::OnDumpViews(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/)
+{
+	wofstream of;
+	of.open(Helpers::ExpandEnvironmentStrings(_T("%temp%\\console.views.txt")).c_str());
+
+	SurfacePoolStats surfaceStats = m_surfacePool.GetStats();
+
+	of << L"process: " << ::GetGuiResources(::GetCurrentProcess(), GR_GDIOBJECTS) << L" GDI objects, "
+	   << ::GetGuiResources(::GetCurrentProcess(), GR_USEROBJECTS) << L" USER objects" << endl;
+	of << L"frame: " << (m_visibility.IsVisible() ? L"visible" : L"not visible") << L", stopped rendering "
+	   << m_visibility.GetHiddenCount() << L" times" << endl;
+	of << L"surfaces: " << surfaceStats.stSurfaces << L" (" << surfaceStats.stInUse << L" in use), "
+	   << surfaceStats.stBytes / 1024 << L" KB, peak " << surfaceStats.stPeakBytes / 1024 << L" KB" << endl;
+	of << L"  " << surfaceStats.dwAllocations << L" allocations, " << surfaceStats.dwReuses << L" reuses, "
+	   << surfaceStats.dwGrows << L" grows, " << surfaceStats.dwShrinks << L" shrinks" << endl;
+	g_iconCache->DumpStats(of);
+
+	if (m_bDragged)
+	{
+		DWORD dwRequests	= 0;
+		DWORD dwSent		= 0;
+
+		GetResizeCounts(dwRequests, dwSent);
+
+		// each request went to the hook before resizes were throttled; tabs
+		// closed since would make these wrap
+		if ((dwRequests >= m_dwDragResizeRequests) && (dwSent >= m_dwDragResizesSent))
+		{
+			of << L"since the last window drag started: " << dwRequests - m_dwDragResizeRequests << L" console resizes requested, "
+			   << dwSent - m_dwDragResizesSent << L" sent to the consoles" << endl;
+		}
+	}
+
+	of << endl;
+
+	MutexLock lock(m_tabsMutex);
+	for (TabViewMap::iterator it = m_tabs.begin(); it != m_tabs.end(); ++it)
+	{
+		it->second->DumpResources(of);
+	}
+
+	of.close();
+
+	return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+LRESULT MainFrame::OnLatencyOverlay(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/)
+{
+	ConsoleView::ToggleLatencyOverlay();
+
+	if (m_activeTabView) m_activeTabView->Repaint(false);
+
+	return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
 //////////////////////////////////////////////////////////////////////////////
 
 LRESULT MainFrame::OnHelp(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/)
@@ -2074,6 +2440,7 @@ void MainFrame::CloseTab(HWND hwndTabView)
   if (m_activeTabView == it->second) m_activeTabView.reset();
   it->second->DestroyWindow();
   m_tabs.erase(it);
+  m_surfacePool.Trim();
 
   if( !g_settingsHandler->GetBehaviorSettings().closeSettings.bAllowClosingLastView )
   {
@@ -2126,6 +2493,21 @@ void MainFrame::UpdateTabTitle(HWND hwndTabView, CString& strTabTitle)
 //////////////////////////////////////////////////////////////////////////////
 
 
+//////////////////////////////////////////////////////////////////////////////
+
+void MainFrame::UpdateWindowTitle(const CString& strWindowTitle)
+{
+	if (strWindowTitle == m_strWindowTitle) return;
+
+	m_strWindowTitle = strWindowTitle;
+	SetWindowText(m_strWindowTitle);
+
+	if (g_settingsHandler->GetAppearanceSettings().stylesSettings.bTrayIcon) SetTrayIcon(NIM_MODIFY);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
 //////////////////////////////////////////////////////////////////////////////
 
 void MainFrame::UpdateTabsMenu(CMenuHandle mainMenu, CMenu& tabsMenu)
@@ -2233,10 +2615,17 @@ void MainFrame::UpdateOpenedTabsMenu(CMenu& tabsMenu)
 		if (m_activeTabView == it->second)
 			tabsMenu.EnableMenuItem(wId, MF_GRAYED | MF_BYCOMMAND);
 
-		m_CmdBar.RemoveImage(wId);
 		HICON hiconMenu = tabData->GetMenuIcon();
+		size_t stIcon = wId - ID_SWITCH_TAB_1;
+
+		if (stIcon >= m_openedTabsMenuIcons.size()) m_openedTabsMenuIcons.resize(stIcon + 1, NULL);
+		if (m_openedTabsMenuIcons[stIcon] == hiconMenu) continue;
+
+		m_CmdBar.RemoveImage(wId);
 		if( hiconMenu )
 			m_CmdBar.AddIcon(hiconMenu, wId);
+
+		m_openedTabsMenuIcons[stIcon] = hiconMenu;
 	}
 }
 
@@ -2735,6 +3124,25 @@ void MainFrame::ResizeWindow()
 	m_dwResizeWindowEdge = WMSZ_BOTTOM;
 
 	if (m_activeTabView) m_activeTabView->SetResizing(false);
+
+	m_surfacePool.Trim();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void MainFrame::GetResizeCounts(DWORD& dwRequests, DWORD& dwSent)
+{
+	dwRequests	= 0;
+	dwSent		= 0;
+
+	MutexLock lock(m_tabsMutex);
+	for (TabViewMap::iterator it = m_tabs.begin(); it != m_tabs.end(); ++it)
+	{
+		it->second->AddResizeCounts(dwRequests, dwSent);
+	}
 }
 
 //////////////////////////////////////////////////////////////////////////////
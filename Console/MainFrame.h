@@ -1,5 +1,6 @@
 #pragma once
 
+#include "VisibilityState.h"
 
 //////////////////////////////////////////////////////////////////////////////
 
@@ -12,6 +13,10 @@
 #define	TIMER_SIZING			42
 #define	TIMER_SIZING_INTERVAL	100
 
+// Checks whether other windows cover Console while it's in the background
+#define	TIMER_OCCLUSION				43
+#define	TIMER_OCCLUSION_INTERVAL	250
+
 //////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
@@ -86,11 +91,15 @@ class MainFrame
 			MESSAGE_HANDLER(WM_SIZE, OnSize)
 			MESSAGE_HANDLER(WM_SIZING, OnSizing)
 			MESSAGE_HANDLER(WM_WINDOWPOSCHANGING, OnWindowPosChanging)
+			MESSAGE_HANDLER(WM_WINDOWPOSCHANGED, OnWindowPosChanged)
+			MESSAGE_HANDLER(WM_WTSSESSION_CHANGE, OnSessionChange)
+			MESSAGE_HANDLER(WM_POWERBROADCAST, OnPowerBroadcast)
 			MESSAGE_HANDLER(WM_LBUTTONUP, OnMouseButtonUp)
 			MESSAGE_HANDLER(WM_RBUTTONUP, OnMouseButtonUp)
 			MESSAGE_HANDLER(WM_MBUTTONUP, OnMouseButtonUp)
 			MESSAGE_HANDLER(WM_XBUTTONUP, OnMouseButtonUp)
 			MESSAGE_HANDLER(WM_MOUSEMOVE, OnMouseMove)
+			MESSAGE_HANDLER(WM_ENTERSIZEMOVE, OnEnterSizeMove)
 			MESSAGE_HANDLER(WM_EXITSIZEMOVE, OnExitSizeMove)
 			MESSAGE_HANDLER(WM_TIMER, OnTimer)
 			MESSAGE_HANDLER(WM_SETTINGCHANGE, OnSettingChange)
@@ -101,6 +110,8 @@ class MainFrame
 			MESSAGE_HANDLER(UM_START_MOUSE_DRAG, OnStartMouseDrag)
 			MESSAGE_HANDLER(m_uTaskbarRestart, OnTaskbarCreated)
 			MESSAGE_HANDLER(UM_TRAY_NOTIFY, OnTrayNotify)
+			MESSAGE_HANDLER(UM_IMAGE_RESCALED, OnImageRescaled)
+			MESSAGE_HANDLER(UM_IMAGE_DECODED, OnImageDecoded)
 			MESSAGE_HANDLER(WM_COPYDATA, OnCopyData)
 
 			NOTIFY_CODE_HANDLER(CTCN_SELCHANGE, OnTabChanged)
@@ -152,6 +163,11 @@ class MainFrame
 			COMMAND_ID_HANDLER(ID_HELP, OnHelp)
 			COMMAND_ID_HANDLER(ID_APP_ABOUT, OnAppAbout)
 			COMMAND_ID_HANDLER(IDC_DUMP_BUFFER, OnDumpBuffer)
+			COMMAND_ID_HANDLER(IDC_DUMP_TRACE, OnDumpTrace)
+			COMMAND_ID_HANDLER(IDC_DUMP_LATENCY, OnDumpLatency)
+			COMMAND_ID_HANDLER(IDC_DUMP_IMAGES, OnDumpImages)
+			COMMAND_ID_HANDLER(IDC_DUMP_VIEWS, OnDumpViews)
+			COMMAND_ID_HANDLER(IDC_LATENCY_OVERLAY, OnLatencyOverlay)
 			COMMAND_ID_HANDLER(ID_VIEW_FULLSCREEN, OnFullScreen)
 			COMMAND_ID_HANDLER(ID_VIEW_ZOOM_100, OnZoom)
 			COMMAND_ID_HANDLER(ID_VIEW_ZOOM_INC, OnZoom)
@@ -179,8 +195,12 @@ class MainFrame
 		LRESULT OnSize(UINT /*uMsg*/, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
 		LRESULT OnSizing(UINT /*uMsg*/, WPARAM wParam, LPARAM /*lParam*/, BOOL& /*bHandled*/);
 		LRESULT OnWindowPosChanging(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM lParam, BOOL& bHandled);
+		LRESULT OnWindowPosChanged(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& bHandled);
+		LRESULT OnSessionChange(UINT /*uMsg*/, WPARAM wParam, LPARAM /*lParam*/, BOOL& /*bHandled*/);
+		LRESULT OnPowerBroadcast(UINT /*uMsg*/, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
 		LRESULT OnMouseButtonUp(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& bHandled);
 		LRESULT OnMouseMove(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM lParam, BOOL& /*bHandled*/);
+		LRESULT OnEnterSizeMove(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/);
 		LRESULT OnExitSizeMove(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/);
 		LRESULT OnTimer(UINT /*uMsg*/, WPARAM wParam, LPARAM /*lParam*/, BOOL& /*bHandled*/);
 
@@ -193,6 +213,8 @@ class MainFrame
 		LRESULT OnStartMouseDrag(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM lParam, BOOL& /*bHandled*/);
 		LRESULT OnTrayNotify(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM lParam, BOOL& /*bHandled*/);
 		LRESULT OnTaskbarCreated(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM lParam, BOOL& /*bHandled*/);
+		LRESULT OnImageRescaled(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/);
+		LRESULT OnImageDecoded(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/);
 
 		LRESULT OnTabChanged(int /*idCtrl*/, LPNMHDR pnmh, BOOL& bHandled);
 		LRESULT OnTabClose(int /*idCtrl*/, LPNMHDR pnmh, BOOL& /* bHandled */);
@@ -241,6 +263,11 @@ class MainFrame
 		LRESULT OnHelp(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/);
 		LRESULT OnAppAbout(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/);
 		LRESULT OnDumpBuffer(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/);
+		LRESULT OnDumpTrace(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/);
+		LRESULT OnDumpLatency(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/);
+		LRESULT OnDumpImages(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/);
+		LRESULT OnDumpViews(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/);
+		LRESULT OnLatencyOverlay(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/);
 
 	public:
 
@@ -252,14 +279,21 @@ class MainFrame
 		void PasteToConsoles();
 		void SendTextToConsoles(const wchar_t* pszText);
 		bool GetAppActiveStatus(void) const { return this->m_bAppActive; }
+		// false while nothing Console draws can be seen; views leave their
+		// updates to the catch-up when it can again
+		bool IsRendering() const { return m_visibility.IsVisible(); }
+		OffscreenSurfacePool& GetSurfacePool() { return m_surfacePool; }
 
 	private:
 
 		void ActivateApp(void);
+		void SetVisibility(VisibilityState::Reason reason, bool bSet);
+		bool IsOccluded();
 		bool CreateNewConsole(DWORD dwTabIndex, const wstring& strCmdLineInitialDir = wstring(L""), const wstring& strCmdLineInitialCmd = wstring(L""));
 		void CloseTab(CTabViewTabItem* pTabItem);
 
 		void UpdateTabTitle(HWND hwndTabView, CString& strTabTitle);
+		void UpdateWindowTitle(const CString& strWindowTitle);
 		void UpdateTabsMenu(CMenuHandle mainMenu, CMenu& tabsMenu);
 		void UpdateOpenedTabsMenu(CMenu& tabsMenu);
 		void UpdateMenuHotKeys(void);
@@ -278,6 +312,8 @@ class MainFrame
 		void ShowFullScreen(bool bShow);
 
 		void ResizeWindow();
+		// console resizes asked for and sent by the views of all tabs
+		void GetResizeCounts(DWORD& dwRequests, DWORD& dwSent);
 		void SetMargins();
 		void SetTransparency();
 		void CreateAcceleratorTable();
@@ -307,6 +343,10 @@ class MainFrame
 		vector<wstring>	m_startupCmds;
 		int						m_nMultiStartSleep;
 
+		// offscreen surfaces of the active views; declared before the views
+		// so it outlives them
+		OffscreenSurfacePool		m_surfacePool;
+
 		std::shared_ptr<TabView>	m_activeTabView;
 
 		bool m_bMenuVisible;
@@ -324,6 +364,10 @@ class MainFrame
 
 		CMenu			m_tabsMenu;
 
+		// icons the command bar has for the opened tabs menu, by position;
+		// they're only replaced when a tab's icon changes
+		vector<HICON>	m_openedTabsMenuIcons;
+
 		CIcon			m_icon;
 		CIcon			m_smallIcon;
 
@@ -334,7 +378,18 @@ class MainFrame
 		DWORD			m_dwWindowHeight;
 		DWORD			m_dwResizeWindowEdge;
 
+		// console resizes asked for and sent by all views when the last
+		// window drag started, for dumpviews
+		bool			m_bDragged;
+		DWORD			m_dwDragResizeRequests;
+		DWORD			m_dwDragResizesSent;
+
 		bool			m_bAppActive;
+
+		VisibilityState	m_visibility;
+		bool			m_bOcclusionTimerRunning;
+		HPOWERNOTIFY	m_hDisplayPowerNotify;
+
 		bool			m_bRestoringWindow;
 		CRect			m_rectRestoredWnd;
 		CRect			m_rectWndNotFS;
@@ -0,0 +1,552 @@
+#include "stdafx.h"
+
+#include "PixelKernels.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define PIXEL_KERNELS_X86
+#endif
+
+#ifdef PIXEL_KERNELS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// MSVC allows any intrinsics, gcc and clang have to be told per function
+#ifdef _MSC_VER
+#define PIXEL_KERNELS_TARGET(isa)
+#else
+#define PIXEL_KERNELS_TARGET(isa)	__attribute__((target(isa)))
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+//////////////////////////////////////////////////////////////////////////////
+
+// x/255 rounded to nearest, exact for x <= 255*255
+
+inline unsigned int Div255(unsigned int x)
+{
+	x += 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+inline unsigned int AddSaturate(unsigned int x, unsigned int y)
+{
+	return (x + y > 255) ? 255 : x + y;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+// scalar kernels, also the reference for the SIMD ones
+
+void FillScalar(unsigned int* pPixels, int nCount, unsigned int dwColor)
+{
+	for (int i = 0; i < nCount; ++i) pPixels[i] = dwColor;
+}
+
+void BlendColorScalar(unsigned int* pPixels, int nCount, unsigned int dwColor, unsigned char byAlpha, unsigned int dwMask)
+{
+	unsigned int dwInvAlpha = 255 - byAlpha;
+
+	for (int i = 0; i < nCount; ++i)
+	{
+		unsigned int dwPixel	= pPixels[i];
+		unsigned int dwResult	= 0;
+
+		for (int nShift = 0; nShift < 32; nShift += 8)
+		{
+			unsigned int dwChannel = Div255(((dwPixel >> nShift) & 0xFF) * dwInvAlpha);
+			dwResult |= AddSaturate((dwColor >> nShift) & 0xFF, dwChannel) << nShift;
+		}
+
+		pPixels[i] = (dwResult & dwMask) | (dwPixel & ~dwMask);
+	}
+}
+
+void PremultiplyScalar(unsigned int* pPixels, int nCount)
+{
+	for (int i = 0; i < nCount; ++i)
+	{
+		unsigned int dwPixel	= pPixels[i];
+		unsigned int dwAlpha	= dwPixel >> 24;
+		unsigned int dwResult	= dwPixel & 0xFF000000;
+
+		for (int nShift = 0; nShift < 24; nShift += 8)
+		{
+			dwResult |= Div255(((dwPixel >> nShift) & 0xFF) * dwAlpha) << nShift;
+		}
+
+		pPixels[i] = dwResult;
+	}
+}
+
+void AlphaBlendScalar(unsigned int* pDst, const unsigned int* pSrc, int nCount)
+{
+	for (int i = 0; i < nCount; ++i)
+	{
+		unsigned int dwSrc		= pSrc[i];
+		unsigned int dwDst		= pDst[i];
+		unsigned int dwInvAlpha	= 255 - (dwSrc >> 24);
+		unsigned int dwResult	= 0;
+
+		for (int nShift = 0; nShift < 32; nShift += 8)
+		{
+			unsigned int dwChannel = Div255(((dwDst >> nShift) & 0xFF) * dwInvAlpha);
+			dwResult |= AddSaturate((dwSrc >> nShift) & 0xFF, dwChannel) << nShift;
+		}
+
+		pDst[i] = dwResult;
+	}
+}
+
+const PixelKernels::RowKernels	s_scalarKernels =
+{
+	FillScalar,
+	BlendColorScalar,
+	PremultiplyScalar,
+	AlphaBlendScalar
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+#ifdef PIXEL_KERNELS_X86
+
+//////////////////////////////////////////////////////////////////////////////
+// SSE2 kernels, 4 pixels at a time
+
+PIXEL_KERNELS_TARGET("sse2")
+inline __m128i Div255SSE2(__m128i x)
+{
+	x = _mm_add_epi16(x, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+// alpha of each pixel in all four 16 bit channels
+PIXEL_KERNELS_TARGET("sse2")
+inline __m128i BroadcastAlphaSSE2(__m128i x)
+{
+	return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+PIXEL_KERNELS_TARGET("sse2")
+void FillSSE2(unsigned int* pPixels, int nCount, unsigned int dwColor)
+{
+	__m128i	color	= _mm_set1_epi32(static_cast<int>(dwColor));
+	int		i		= 0;
+
+	for (; i + 4 <= nCount; i += 4) _mm_storeu_si128(reinterpret_cast<__m128i*>(pPixels + i), color);
+
+	FillScalar(pPixels + i, nCount - i, dwColor);
+}
+
+PIXEL_KERNELS_TARGET("sse2")
+void BlendColorSSE2(unsigned int* pPixels, int nCount, unsigned int dwColor, unsigned char byAlpha, unsigned int dwMask)
+{
+	__m128i	zero		= _mm_setzero_si128();
+	__m128i	color		= _mm_set1_epi32(static_cast<int>(dwColor));
+	__m128i	mask		= _mm_set1_epi32(static_cast<int>(dwMask));
+	__m128i	invAlpha	= _mm_set1_epi16(static_cast<short>(255 - byAlpha));
+	int		i			= 0;
+
+	for (; i + 4 <= nCount; i += 4)
+	{
+		__m128i	pixels	= _mm_loadu_si128(reinterpret_cast<const __m128i*>(pPixels + i));
+		__m128i	lo		= Div255SSE2(_mm_mullo_epi16(_mm_unpacklo_epi8(pixels, zero), invAlpha));
+		__m128i	hi		= Div255SSE2(_mm_mullo_epi16(_mm_unpackhi_epi8(pixels, zero), invAlpha));
+		__m128i	result	= _mm_adds_epu8(_mm_packus_epi16(lo, hi), color);
+
+		result = _mm_or_si128(_mm_and_si128(result, mask), _mm_andnot_si128(mask, pixels));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pPixels + i), result);
+	}
+
+	BlendColorScalar(pPixels + i, nCount - i, dwColor, byAlpha, dwMask);
+}
+
+PIXEL_KERNELS_TARGET("sse2")
+void PremultiplySSE2(unsigned int* pPixels, int nCount)
+{
+	__m128i	zero		= _mm_setzero_si128();
+	__m128i	alphaMask	= _mm_set1_epi32(static_cast<int>(0xFF000000));
+	int		i			= 0;
+
+	for (; i + 4 <= nCount; i += 4)
+	{
+		__m128i	pixels	= _mm_loadu_si128(reinterpret_cast<const __m128i*>(pPixels + i));
+		__m128i	lo		= _mm_unpacklo_epi8(pixels, zero);
+		__m128i	hi		= _mm_unpackhi_epi8(pixels, zero);
+
+		lo = Div255SSE2(_mm_mullo_epi16(lo, BroadcastAlphaSSE2(lo)));
+		hi = Div255SSE2(_mm_mullo_epi16(hi, BroadcastAlphaSSE2(hi)));
+
+		__m128i	result	= _mm_packus_epi16(lo, hi);
+
+		result = _mm_or_si128(_mm_andnot_si128(alphaMask, result), _mm_and_si128(alphaMask, pixels));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pPixels + i), result);
+	}
+
+	PremultiplyScalar(pPixels + i, nCount - i);
+}
+
+PIXEL_KERNELS_TARGET("sse2")
+void AlphaBlendSSE2(unsigned int* pDst, const unsigned int* pSrc, int nCount)
+{
+	__m128i	zero	= _mm_setzero_si128();
+	__m128i	full	= _mm_set1_epi16(255);
+	int		i		= 0;
+
+	for (; i + 4 <= nCount; i += 4)
+	{
+		__m128i	src		= _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i));
+		__m128i	dst		= _mm_loadu_si128(reinterpret_cast<const __m128i*>(pDst + i));
+		__m128i	invLo	= _mm_sub_epi16(full, BroadcastAlphaSSE2(_mm_unpacklo_epi8(src, zero)));
+		__m128i	invHi	= _mm_sub_epi16(full, BroadcastAlphaSSE2(_mm_unpackhi_epi8(src, zero)));
+		__m128i	lo		= Div255SSE2(_mm_mullo_epi16(_mm_unpacklo_epi8(dst, zero), invLo));
+		__m128i	hi		= Div255SSE2(_mm_mullo_epi16(_mm_unpackhi_epi8(dst, zero), invHi));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i), _mm_adds_epu8(_mm_packus_epi16(lo, hi), src));
+	}
+
+	AlphaBlendScalar(pDst + i, pSrc + i, nCount - i);
+}
+
+const PixelKernels::RowKernels	s_sse2Kernels =
+{
+	FillSSE2,
+	BlendColorSSE2,
+	PremultiplySSE2,
+	AlphaBlendSSE2
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+// AVX2 kernels, 8 pixels at a time; unpack and pack work within 128 bit
+// lanes, so pixels come back in order
+
+PIXEL_KERNELS_TARGET("avx2")
+inline __m256i Div255AVX2(__m256i x)
+{
+	x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+	return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+PIXEL_KERNELS_TARGET("avx2")
+inline __m256i BroadcastAlphaAVX2(__m256i x)
+{
+	return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(x, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+PIXEL_KERNELS_TARGET("avx2")
+void FillAVX2(unsigned int* pPixels, int nCount, unsigned int dwColor)
+{
+	__m256i	color	= _mm256_set1_epi32(static_cast<int>(dwColor));
+	int		i		= 0;
+
+	for (; i + 8 <= nCount; i += 8) _mm256_storeu_si256(reinterpret_cast<__m256i*>(pPixels + i), color);
+
+	FillSSE2(pPixels + i, nCount - i, dwColor);
+}
+
+PIXEL_KERNELS_TARGET("avx2")
+void BlendColorAVX2(unsigned int* pPixels, int nCount, unsigned int dwColor, unsigned char byAlpha, unsigned int dwMask)
+{
+	__m256i	zero		= _mm256_setzero_si256();
+	__m256i	color		= _mm256_set1_epi32(static_cast<int>(dwColor));
+	__m256i	mask		= _mm256_set1_epi32(static_cast<int>(dwMask));
+	__m256i	invAlpha	= _mm256_set1_epi16(static_cast<short>(255 - byAlpha));
+	int		i			= 0;
+
+	for (; i + 8 <= nCount; i += 8)
+	{
+		__m256i	pixels	= _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pPixels + i));
+		__m256i	lo		= Div255AVX2(_mm256_mullo_epi16(_mm256_unpacklo_epi8(pixels, zero), invAlpha));
+		__m256i	hi		= Div255AVX2(_mm256_mullo_epi16(_mm256_unpackhi_epi8(pixels, zero), invAlpha));
+		__m256i	result	= _mm256_adds_epu8(_mm256_packus_epi16(lo, hi), color);
+
+		result = _mm256_or_si256(_mm256_and_si256(result, mask), _mm256_andnot_si256(mask, pixels));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(pPixels + i), result);
+	}
+
+	BlendColorSSE2(pPixels + i, nCount - i, dwColor, byAlpha, dwMask);
+}
+
+PIXEL_KERNELS_TARGET("avx2")
+void PremultiplyAVX2(unsigned int* pPixels, int nCount)
+{
+	__m256i	zero		= _mm256_setzero_si256();
+	__m256i	alphaMask	= _mm256_set1_epi32(static_cast<int>(0xFF000000));
+	int		i			= 0;
+
+	for (; i + 8 <= nCount; i += 8)
+	{
+		__m256i	pixels	= _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pPixels + i));
+		__m256i	lo		= _mm256_unpacklo_epi8(pixels, zero);
+		__m256i	hi		= _mm256_unpackhi_epi8(pixels, zero);
+
+		lo = Div255AVX2(_mm256_mullo_epi16(lo, BroadcastAlphaAVX2(lo)));
+		hi = Div255AVX2(_mm256_mullo_epi16(hi, BroadcastAlphaAVX2(hi)));
+
+		__m256i	result	= _mm256_packus_epi16(lo, hi);
+
+		result = _mm256_or_si256(_mm256_andnot_si256(alphaMask, result), _mm256_and_si256(alphaMask, pixels));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(pPixels + i), result);
+	}
+
+	PremultiplySSE2(pPixels + i, nCount - i);
+}
+
+PIXEL_KERNELS_TARGET("avx2")
+void AlphaBlendAVX2(unsigned int* pDst, const unsigned int* pSrc, int nCount)
+{
+	__m256i	zero	= _mm256_setzero_si256();
+	__m256i	full	= _mm256_set1_epi16(255);
+	int		i		= 0;
+
+	for (; i + 8 <= nCount; i += 8)
+	{
+		__m256i	src		= _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + i));
+		__m256i	dst		= _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pDst + i));
+		__m256i	invLo	= _mm256_sub_epi16(full, BroadcastAlphaAVX2(_mm256_unpacklo_epi8(src, zero)));
+		__m256i	invHi	= _mm256_sub_epi16(full, BroadcastAlphaAVX2(_mm256_unpackhi_epi8(src, zero)));
+		__m256i	lo		= Div255AVX2(_mm256_mullo_epi16(_mm256_unpacklo_epi8(dst, zero), invLo));
+		__m256i	hi		= Div255AVX2(_mm256_mullo_epi16(_mm256_unpackhi_epi8(dst, zero), invHi));
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + i), _mm256_adds_epu8(_mm256_packus_epi16(lo, hi), src));
+	}
+
+	AlphaBlendSSE2(pDst + i, pSrc + i, nCount - i);
+}
+
+const PixelKernels::RowKernels	s_avx2Kernels =
+{
+	FillAVX2,
+	BlendColorAVX2,
+	PremultiplyAVX2,
+	AlphaBlendAVX2
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+#endif // PIXEL_KERNELS_X86
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+PixelKernels::Isa DetectIsa()
+{
+#ifdef PIXEL_KERNELS_X86
+	unsigned int	arrInfo[4]	= { 0, 0, 0, 0 };
+	bool			bSSE2		= false;
+	bool			bAVX		= false;
+	bool			bAVX2		= false;
+
+#ifdef _MSC_VER
+	int arrRegs[4];
+
+	__cpuid(arrRegs, 0);
+	unsigned int dwMaxLeaf = static_cast<unsigned int>(arrRegs[0]);
+
+	__cpuid(arrRegs, 1);
+	for (int i = 0; i < 4; ++i) arrInfo[i] = static_cast<unsigned int>(arrRegs[i]);
+#else
+	unsigned int dwMaxLeaf = __get_cpuid_max(0, 0);
+
+	__get_cpuid(1, &arrInfo[0], &arrInfo[1], &arrInfo[2], &arrInfo[3]);
+#endif
+
+	bSSE2 = (arrInfo[3] & (1 << 26)) != 0;
+
+	// the OS has to save the YMM registers too
+	if ((arrInfo[2] & (1 << 27)) && (arrInfo[2] & (1 << 28)))
+	{
+#ifdef _MSC_VER
+		unsigned long long qwXcr0 = _xgetbv(0);
+#else
+		unsigned int dwXcr0Lo = 0;
+		unsigned int dwXcr0Hi = 0;
+		__asm__ ("xgetbv" : "=a"(dwXcr0Lo), "=d"(dwXcr0Hi) : "c"(0));
+		unsigned long long qwXcr0 = (static_cast<unsigned long long>(dwXcr0Hi) << 32) | dwXcr0Lo;
+#endif
+		bAVX = (qwXcr0 & 6) == 6;
+	}
+
+	if (bAVX && (dwMaxLeaf >= 7))
+	{
+#ifdef _MSC_VER
+		__cpuidex(arrRegs, 7, 0);
+		bAVX2 = (arrRegs[1] & (1 << 5)) != 0;
+#else
+		unsigned int arrInfo7[4] = { 0, 0, 0, 0 };
+		__cpuid_count(7, 0, arrInfo7[0], arrInfo7[1], arrInfo7[2], arrInfo7[3]);
+		bAVX2 = (arrInfo7[1] & (1 << 5)) != 0;
+#endif
+	}
+
+	if (bAVX2) return PixelKernels::isaAVX2;
+	if (bSSE2) return PixelKernels::isaSSE2;
+#endif
+
+	return PixelKernels::isaScalar;
+}
+
+const PixelKernels::Isa	s_supportedIsa	= DetectIsa();
+PixelKernels::Isa		s_isa			= s_supportedIsa;
+
+//////////////////////////////////////////////////////////////////////////////
+
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+unsigned int PixelKernels::PremultiplyColor(unsigned int dwColor)
+{
+	unsigned int dwPremultiplied = dwColor;
+	PremultiplyScalar(&dwPremultiplied, 1);
+
+	return dwPremultiplied;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+PixelKernels::Isa PixelKernels::GetSupportedIsa()
+{
+	return s_supportedIsa;
+}
+
+PixelKernels::Isa PixelKernels::GetIsa()
+{
+	return s_isa;
+}
+
+void PixelKernels::SetIsa(Isa isa)
+{
+	s_isa = (isa < s_supportedIsa) ? isa : s_supportedIsa;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+const PixelKernels::RowKernels& PixelKernels::GetRowKernels()
+{
+#ifdef PIXEL_KERNELS_X86
+	if (s_isa == isaAVX2) return s_avx2Kernels;
+	if (s_isa == isaSSE2) return s_sse2Kernels;
+#endif
+
+	return s_scalarKernels;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void PixelKernels::Fill(unsigned char* pPixels, int nPitch, int nWidth, int nHeight, unsigned int dwColor)
+{
+	const RowKernels& kernels = GetRowKernels();
+
+	for (int y = 0; y < nHeight; ++y, pPixels += nPitch)
+	{
+		kernels.pfnFill(reinterpret_cast<unsigned int*>(pPixels), nWidth, dwColor);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void PixelKernels::Tint(unsigned char* pPixels, int nPitch, int nWidth, int nHeight, unsigned int dwColor, unsigned char byOpacity)
+{
+	BlendColor(pPixels, nPitch, nWidth, nHeight, dwColor, byOpacity, 0x00FFFFFF);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void PixelKernels::BlendFill(unsigned char* pPixels, int nPitch, int nWidth, int nHeight, unsigned int dwColor, unsigned char byAlpha)
+{
+	BlendColor(pPixels, nPitch, nWidth, nHeight, (dwColor & 0x00FFFFFF) | (static_cast<unsigned int>(byAlpha) << 24), byAlpha, 0xFFFFFFFF);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void PixelKernels::Premultiply(unsigned char* pPixels, int nPitch, int nWidth, int nHeight)
+{
+	const RowKernels& kernels = GetRowKernels();
+
+	for (int y = 0; y < nHeight; ++y, pPixels += nPitch)
+	{
+		kernels.pfnPremultiply(reinterpret_cast<unsigned int*>(pPixels), nWidth);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void PixelKernels::AlphaBlend(unsigned char* pDst, int nDstPitch, const unsigned char* pSrc, int nSrcPitch, int nWidth, int nHeight)
+{
+	const RowKernels& kernels = GetRowKernels();
+
+	for (int y = 0; y < nHeight; ++y, pDst += nDstPitch, pSrc += nSrcPitch)
+	{
+		kernels.pfnAlphaBlend(reinterpret_cast<unsigned int*>(pDst), reinterpret_cast<const unsigned int*>(pSrc), nWidth);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void PixelKernels::BlendColor(unsigned char* pPixels, int nPitch, int nWidth, int nHeight, unsigned int dwColor, unsigned char byAlpha, unsigned int dwMask)
+{
+	const RowKernels& kernels = GetRowKernels();
+
+	// the color is premultiplied once, the kernels add it as is
+	unsigned int dwPremultiplied = PremultiplyColor((dwColor & 0x00FFFFFF) | (static_cast<unsigned int>(byAlpha) << 24));
+
+	dwPremultiplied = (dwPremultiplied & 0x00FFFFFF) | (dwColor & 0xFF000000);
+
+	for (int y = 0; y < nHeight; ++y, pPixels += nPitch)
+	{
+		kernels.pfnBlendColor(reinterpret_cast<unsigned int*>(pPixels), nWidth, dwPremultiplied, byAlpha, dwMask);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,121 @@
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// 32 bpp pixel memory, rows top-down. Bottom-up DIBs are described by
+// pointing at the last row with a negative pitch.
+
+struct PixelSurface
+{
+	PixelSurface()
+	: pPixels(0)
+	, nPitch(0)
+	, nWidth(0)
+	, nHeight(0)
+	{
+	}
+
+	unsigned char* GetPixel(int x, int y) const { return pPixels + y * nPitch + x * 4; }
+
+	// clips the rectangle to the surface; returns false if nothing's left
+	bool Clip(int& x, int& y, int& nRectWidth, int& nRectHeight) const
+	{
+		if (x < 0) { nRectWidth += x; x = 0; }
+		if (y < 0) { nRectHeight += y; y = 0; }
+		if (x + nRectWidth > nWidth) nRectWidth = nWidth - x;
+		if (y + nRectHeight > nHeight) nRectHeight = nHeight - y;
+
+		return (nRectWidth > 0) && (nRectHeight > 0);
+	}
+
+	unsigned char*	pPixels;
+	int				nPitch;
+	int				nWidth;
+	int				nHeight;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Pixel kernels for 32 bpp BGRA memory, with AVX2 and SSE2 paths picked at
+// run time and a scalar fallback. All paths give identical results.
+//
+// Colors are 0xAARRGGBB, as a BGRA pixel reads in little endian. Results
+// are rounded like AlphaBlend (x/255 rounded to nearest).
+//
+// No Win32 dependency, the kernels can be built and tested on their own.
+
+class PixelKernels
+{
+	public:
+
+		enum Isa
+		{
+			isaScalar	= 0,
+			isaSSE2		= 1,
+			isaAVX2		= 2
+		};
+
+	public:
+
+		static unsigned int MakeColor(unsigned char byRed, unsigned char byGreen, unsigned char byBlue, unsigned char byAlpha)
+		{
+			return
+				(static_cast<unsigned int>(byAlpha) << 24) |
+				(static_cast<unsigned int>(byRed) << 16) |
+				(static_cast<unsigned int>(byGreen) << 8) |
+				static_cast<unsigned int>(byBlue);
+		}
+
+		// multiplies RGB by the color's alpha
+		static unsigned int PremultiplyColor(unsigned int dwColor);
+
+		// best instruction set supported by the CPU, and the one in use
+		static Isa GetSupportedIsa();
+		static Isa GetIsa();
+		// for testing; can't go past the supported one
+		static void SetIsa(Isa isa);
+
+		// sets all pixels to dwColor
+		static void Fill(unsigned char* pPixels, int nPitch, int nWidth, int nHeight, unsigned int dwColor);
+
+		// blends the RGB of dwColor over the pixels with a constant opacity,
+		// alpha is left alone (AlphaBlend with SourceConstantAlpha)
+		static void Tint(unsigned char* pPixels, int nPitch, int nWidth, int nHeight, unsigned int dwColor, unsigned char byOpacity);
+
+		// composites dwColor with byAlpha over premultiplied pixels (source over),
+		// like a translucent brush
+		static void BlendFill(unsigned char* pPixels, int nPitch, int nWidth, int nHeight, unsigned int dwColor, unsigned char byAlpha);
+
+		// multiplies RGB by the pixel's alpha
+		static void Premultiply(unsigned char* pPixels, int nPitch, int nWidth, int nHeight);
+
+		// composites premultiplied source pixels over premultiplied destination
+		// pixels (AlphaBlend with AC_SRC_ALPHA)
+		static void AlphaBlend(unsigned char* pDst, int nDstPitch, const unsigned char* pSrc, int nSrcPitch, int nWidth, int nHeight);
+
+	public:
+
+		// row kernels; a set per instruction set
+		struct RowKernels
+		{
+			void (*pfnFill)(unsigned int* pPixels, int nCount, unsigned int dwColor);
+			// pixel = color + pixel * (255 - alpha) / 255, pixels outside dwMask are kept
+			void (*pfnBlendColor)(unsigned int* pPixels, int nCount, unsigned int dwColor, unsigned char byAlpha, unsigned int dwMask);
+			void (*pfnPremultiply)(unsigned int* pPixels, int nCount);
+			void (*pfnAlphaBlend)(unsigned int* pDst, const unsigned int* pSrc, int nCount);
+		};
+
+	private:
+
+		static const RowKernels& GetRowKernels();
+
+		static void BlendColor(unsigned char* pPixels, int nPitch, int nWidth, int nHeight, unsigned int dwColor, unsigned char byAlpha, unsigned int dwMask);
+};
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,238 @@
+#include "stdafx.h"
+
+#include "PredictiveEcho.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+const std::vector<PredictiveEcho::Prediction> PredictiveEcho::s_noPredictions;
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+PredictiveEcho::PredictiveEcho()
+: m_bAlwaysShow(false)
+, m_predictions()
+, m_nCursorX(0)
+, m_nCursorY(0)
+, m_nColumns(0)
+, m_nRows(0)
+, m_bTrusted(false)
+, m_bSlow(false)
+, m_bSuspended(false)
+, m_nSuspendX(0)
+, m_nSuspendY(0)
+, m_nSuspendTime(0)
+, m_nLatency(0)
+, m_dwConfirmed(0)
+, m_dwMispredicted(0)
+, m_dwExpired(0)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void PredictiveEcho::Reset()
+{
+	m_predictions.clear();
+
+	m_nColumns		= 0;
+	m_nRows			= 0;
+	m_bTrusted		= false;
+	m_bSuspended	= false;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void PredictiveEcho::OnPrintable(wchar_t ch, unsigned int nNow)
+{
+	if (m_nColumns == 0) return;
+
+	if (m_bSuspended)
+	{
+		if (nNow - m_nSuspendTime < SUSPEND_TIME) return;
+
+		m_bSuspended	= false;
+		m_bTrusted		= false;
+	}
+
+	int nX = m_nCursorX;
+	int nY = m_nCursorY;
+
+	if (!m_predictions.empty())
+	{
+		nX = m_predictions.back().nX + 1;
+		nY = m_predictions.back().nY;
+
+		if (nX >= m_nColumns)
+		{
+			nX = 0;
+			++nY;
+		}
+	}
+
+	// the console would scroll, we can't tell where the text ends up; this
+	// key moves the cursor past anything predicted from now on
+	if ((nX >= m_nColumns) || (nY >= m_nRows))
+	{
+		OnOtherKey(nNow);
+		return;
+	}
+
+	Prediction prediction;
+
+	prediction.nX		= nX;
+	prediction.nY		= nY;
+	prediction.ch		= ch;
+	prediction.nTime	= nNow;
+
+	m_predictions.push_back(prediction);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void PredictiveEcho::OnOtherKey(unsigned int nNow)
+{
+	// what's still pending may come out right, but there's no telling what
+	// the key does to it
+	m_predictions.clear();
+
+	m_bSuspended	= true;
+	m_nSuspendX		= m_nCursorX;
+	m_nSuspendY		= m_nCursorY;
+	m_nSuspendTime	= nNow;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool PredictiveEcho::Expire(unsigned int nNow)
+{
+	if (m_bSuspended && (nNow - m_nSuspendTime >= SUSPEND_TIME))
+	{
+		m_bSuspended	= false;
+		m_bTrusted		= false;
+	}
+
+	if (m_predictions.empty() || (nNow - m_predictions.front().nTime < EXPIRE_TIME)) return false;
+
+	Rollback();
+	++m_dwExpired;
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+const std::vector<PredictiveEcho::Prediction>& PredictiveEcho::GetShownPredictions() const
+{
+	if (!m_bTrusted || (!m_bAlwaysShow && !m_bSlow)) return s_noPredictions;
+
+	return m_predictions;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void PredictiveEcho::SetScreen(int nCursorX, int nCursorY, int nColumns, int nRows, unsigned int nNow)
+{
+	// predictions were made for another window size
+	if ((m_nColumns != 0) && ((nColumns != m_nColumns) || (nRows != m_nRows)))
+	{
+		m_predictions.clear();
+		m_bTrusted = false;
+	}
+
+	m_nCursorX	= nCursorX;
+	m_nCursorY	= nCursorY;
+	m_nColumns	= nColumns;
+	m_nRows		= nRows;
+
+	if (m_bSuspended && ((nCursorX != m_nSuspendX) || (nCursorY != m_nSuspendY)))
+	{
+		// keys typed in the meantime may still be on their way, predictions
+		// made from here aren't shown until one is confirmed
+		m_bSuspended	= false;
+		m_bTrusted		= false;
+	}
+
+	if (m_bSuspended) Expire(nNow);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool PredictiveEcho::IsCursorPast(const Prediction& prediction) const
+{
+	return (m_nCursorY > prediction.nY) || ((m_nCursorY == prediction.nY) && (m_nCursorX > prediction.nX));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void PredictiveEcho::Confirm(unsigned int nNow)
+{
+	unsigned int nSample = nNow - m_predictions.front().nTime;
+
+	m_nLatency = (m_dwConfirmed == 0) ? nSample : (m_nLatency*7 + nSample) / 8;
+
+	if (m_nLatency > SHOW_LATENCY)
+	{
+		m_bSlow = true;
+	}
+	else if (m_nLatency < HIDE_LATENCY)
+	{
+		m_bSlow = false;
+	}
+
+	m_predictions.erase(m_predictions.begin());
+	m_bTrusted = true;
+	++m_dwConfirmed;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void PredictiveEcho::Rollback()
+{
+	m_predictions.clear();
+	m_bTrusted = false;
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Local echo of typed characters ahead of the console, the way mosh does it.
+//
+// Each printable key is predicted to show up at the cursor, the next one a
+// cell to the right of it. Every screen update checks the predictions in
+// order: one is confirmed when the cursor has moved past its cell and the
+// cell holds the predicted character. All of them are dropped when a cell
+// the cursor moved past holds something else, or when nothing shows up for
+// EXPIRE_TIME (no echo, e.g. a password prompt).
+//
+// After a prediction was dropped, new ones aren't shown until one of them is
+// confirmed again. Unless they're always shown, they're also only shown while
+// the console takes longer than SHOW_LATENCY to echo. Keys that move the
+// cursor some way we can't tell (enter, backspace, arrows...) stop predicting
+// until the cursor moves or SUSPEND_TIME has passed.
+//
+// Cells are relative to the console window. Times are milliseconds from a
+// wrapping counter (GetTickCount). No Win32 dependency, it can be built and
+// tested on its own.
+
+class PredictiveEcho
+{
+	public:
+
+		enum
+		{
+			// smoothed echo latency that shows predictions, and the one that
+			// hides them again
+			SHOW_LATENCY	= 30,
+			HIDE_LATENCY	= 20,
+
+			EXPIRE_TIME		= 1000,
+			SUSPEND_TIME	= 1000
+		};
+
+		struct Prediction
+		{
+			int				nX;
+			int				nY;
+			wchar_t			ch;
+			unsigned int	nTime;
+		};
+
+	public:
+
+		PredictiveEcho();
+
+	public:
+
+		void SetAlwaysShow(bool bAlwaysShow) { m_bAlwaysShow = bAlwaysShow; }
+
+		// forgets predictions and what the screen looked like
+		void Reset();
+
+		void OnPrintable(wchar_t ch, unsigned int nNow);
+		void OnOtherKey(unsigned int nNow);
+
+		// checks predictions against a new screen, charAt(x, y) returns the
+		// character in a cell
+		template <class CharAt>
+		void OnScreen(int nCursorX, int nCursorY, int nColumns, int nRows, CharAt charAt, unsigned int nNow)
+		{
+			SetScreen(nCursorX, nCursorY, nColumns, nRows, nNow);
+
+			while (!m_predictions.empty())
+			{
+				const Prediction& prediction = m_predictions.front();
+
+				if (!IsCursorPast(prediction))
+				{
+					Expire(nNow);
+					return;
+				}
+
+				if (charAt(prediction.nX, prediction.nY) != prediction.ch)
+				{
+					Rollback();
+					++m_dwMispredicted;
+					return;
+				}
+
+				Confirm(nNow);
+			}
+		}
+
+		// drops predictions nothing showed up for, returns true if it did
+		bool Expire(unsigned int nNow);
+
+		bool HasPredictions() const { return !m_predictions.empty(); }
+
+		// predictions to draw, none if they aren't shown
+		const std::vector<Prediction>& GetShownPredictions() const;
+
+		unsigned long GetConfirmed() const		{ return m_dwConfirmed; }
+		unsigned long GetMispredicted() const	{ return m_dwMispredicted; }
+		unsigned long GetExpired() const		{ return m_dwExpired; }
+
+		// smoothed echo latency in milliseconds, 0 before the first one
+		unsigned int GetLatency() const			{ return m_nLatency; }
+
+	private:
+
+		void SetScreen(int nCursorX, int nCursorY, int nColumns, int nRows, unsigned int nNow);
+
+		bool IsCursorPast(const Prediction& prediction) const;
+
+		void Confirm(unsigned int nNow);
+		void Rollback();
+
+	private:
+
+		static const std::vector<Prediction>	s_noPredictions;
+
+		bool					m_bAlwaysShow;
+
+		std::vector<Prediction>	m_predictions;
+
+		// last screen, m_nColumns is 0 before the first one
+		int						m_nCursorX;
+		int						m_nCursorY;
+		int						m_nColumns;
+		int						m_nRows;
+
+		// predictions aren't shown until one is confirmed
+		bool					m_bTrusted;
+		// echo latency is over SHOW_LATENCY
+		bool					m_bSlow;
+
+		bool					m_bSuspended;
+		int						m_nSuspendX;
+		int						m_nSuspendY;
+		unsigned int			m_nSuspendTime;
+
+		unsigned int			m_nLatency;
+
+		unsigned long			m_dwConfirmed;
+		unsigned long			m_dwMispredicted;
+		unsigned long			m_dwExpired;
+};
+
+//////////////////////////////////////////////////////////////////////////////
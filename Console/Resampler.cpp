@@ -0,0 +1,245 @@
+#include "stdafx.h"
+
+#include <math.h>
+#include <algorithm>
+
+#include "Resampler.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// filter weights are 14 bit fixed point, they add up to WEIGHT_ONE
+static const int	WEIGHT_BITS	= 14;
+static const int	WEIGHT_ONE	= 1 << WEIGHT_BITS;
+
+// the vertical pass keeps 8 fractional bits for the horizontal one
+static const int	ROW_SHIFT	= WEIGHT_BITS - 8;
+static const int	PIXEL_SHIFT	= WEIGHT_BITS + 8;
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool Resampler::Resample(
+				const unsigned char* pSrc,
+				int nSrcWidth,
+				int nSrcHeight,
+				int nSrcPitch,
+				unsigned char* pDst,
+				int nDstWidth,
+				int nDstHeight,
+				int nDstPitch,
+				const CancelCallback& cancel)
+{
+	if ((nSrcWidth <= 0) || (nSrcHeight <= 0) || (nDstWidth <= 0) || (nDstHeight <= 0)) return true;
+
+	Filters	filters;
+
+	CalcFilters(nSrcWidth, nSrcHeight, nDstWidth, nDstHeight, filters);
+
+	const Contributions&	vertical = filters.vertical;
+
+	// one row of the vertical pass, the whole intermediate image is never needed
+	std::vector<int>	row(nSrcWidth * 4);
+
+	for (int y = 0; y < nDstHeight; ++y)
+	{
+		if (cancel && cancel()) return false;
+
+		FilterRows(
+			pSrc + vertical.first[y] * nSrcPitch,
+			nSrcPitch,
+			nSrcWidth * 4,
+			&vertical.weights[y * vertical.nTaps],
+			vertical.nTaps,
+			&row[0]);
+
+		FilterRow(&row[0], 0, pDst + y * nDstPitch, 0, nDstWidth, filters.horizontal);
+	}
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void Resampler::CalcFilters(int nSrcWidth, int nSrcHeight, int nDstWidth, int nDstHeight, Filters& filters)
+{
+	CalcContributions(nSrcWidth, nDstWidth, filters.horizontal);
+	CalcContributions(nSrcHeight, nDstHeight, filters.vertical);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void Resampler::ResampleRect(
+				const Filters& filters,
+				const unsigned char* pSrc,
+				int nSrcPitch,
+				int nDstX,
+				int nDstY,
+				int nDstWidth,
+				int nDstHeight,
+				unsigned char* pDst,
+				int nDstPitch)
+{
+	if ((nDstWidth <= 0) || (nDstHeight <= 0)) return;
+
+	const Contributions&	horizontal	= filters.horizontal;
+	const Contributions&	vertical	= filters.vertical;
+
+	// the vertical pass only needs the source columns under the rectangle;
+	// first source pixels grow with the destination pixel
+	int	nRowFirst	= horizontal.first[nDstX];
+	int	nRowLast	= horizontal.first[nDstX + nDstWidth - 1] + horizontal.nTaps;
+
+	std::vector<int>	row((nRowLast - nRowFirst) * 4);
+
+	for (int y = 0; y < nDstHeight; ++y)
+	{
+		FilterRows(
+			pSrc + vertical.first[nDstY + y] * nSrcPitch + nRowFirst * 4,
+			nSrcPitch,
+			(nRowLast - nRowFirst) * 4,
+			&vertical.weights[(nDstY + y) * vertical.nTaps],
+			vertical.nTaps,
+			&row[0]);
+
+		FilterRow(&row[0], nRowFirst, pDst + y * nDstPitch, nDstX, nDstWidth, horizontal);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void Resampler::CalcContributions(int nSrcSize, int nDstSize, Contributions& contributions)
+{
+	double	dScale	= static_cast<double>(nDstSize) / static_cast<double>(nSrcSize);
+	// filter radius in source pixels
+	double	dRadius	= (dScale < 1.0) ? 1.0 / dScale : 1.0;
+	int		nSpan	= static_cast<int>(::ceil(dRadius * 2.0)) + 1;
+	int		nTaps	= (nSpan < nSrcSize) ? nSpan : nSrcSize;
+
+	contributions.nTaps = nTaps;
+	contributions.first.resize(nDstSize);
+	contributions.weights.resize(nDstSize * nTaps);
+
+	std::vector<double>	weights(nTaps);
+
+	for (int i = 0; i < nDstSize; ++i)
+	{
+		// pixel centers are at .5
+		double	dCenter	= (static_cast<double>(i) + 0.5) / dScale - 0.5;
+		int		nLeft	= static_cast<int>(::floor(dCenter - dRadius));
+		int		nFirst	= nLeft;
+
+		// keep all taps inside the source, weights past the edges go to the edge pixels
+		if (nFirst > nSrcSize - nTaps) nFirst = nSrcSize - nTaps;
+		if (nFirst < 0) nFirst = 0;
+
+		std::fill(weights.begin(), weights.end(), 0.0);
+
+		double dTotal = 0.0;
+
+		for (int j = nLeft; j < nLeft + nSpan; ++j)
+		{
+			double dWeight = 1.0 - ::fabs(static_cast<double>(j) - dCenter) / dRadius;
+			if (dWeight <= 0.0) continue;
+
+			int nSrc = j;
+			if (nSrc < 0) nSrc = 0;
+			if (nSrc >= nSrcSize) nSrc = nSrcSize - 1;
+
+			weights[nSrc - nFirst] += dWeight;
+			dTotal += dWeight;
+		}
+
+		// normalize to fixed point, rounding errors go to the largest weight
+		int*	pWeights	= &contributions.weights[i * nTaps];
+		int		nTotal		= 0;
+		int		nLargest	= 0;
+
+		for (int t = 0; t < nTaps; ++t)
+		{
+			pWeights[t] = static_cast<int>(::floor(weights[t] / dTotal * WEIGHT_ONE + 0.5));
+			nTotal += pWeights[t];
+
+			if (pWeights[t] > pWeights[nLargest]) nLargest = t;
+		}
+
+		pWeights[nLargest] += WEIGHT_ONE - nTotal;
+
+		contributions.first[i] = nFirst;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void Resampler::FilterRows(const unsigned char* pSrc, int nSrcPitch, int nValues, const int* pWeights, int nTaps, int* pRow)
+{
+	std::fill(pRow, pRow + nValues, 0);
+
+	// row by row, so the inner loop runs over contiguous memory
+	for (int t = 0; t < nTaps; ++t, pSrc += nSrcPitch)
+	{
+		int nWeight = pWeights[t];
+		if (nWeight == 0) continue;
+
+		for (int x = 0; x < nValues; ++x) pRow[x] += nWeight * pSrc[x];
+	}
+
+	for (int x = 0; x < nValues; ++x) pRow[x] = (pRow[x] + (1 << (ROW_SHIFT - 1))) >> ROW_SHIFT;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void Resampler::FilterRow(const int* pRow, int nRowFirst, unsigned char* pDst, int nDstX, int nDstWidth, const Contributions& contributions)
+{
+	const int nTaps = contributions.nTaps;
+
+	for (int x = nDstX; x < nDstX + nDstWidth; ++x, pDst += 4)
+	{
+		const int*	pWeights	= &contributions.weights[x * nTaps];
+		const int*	pValues		= pRow + (contributions.first[x] - nRowFirst) * 4;
+		int			nSum0		= 1 << (PIXEL_SHIFT - 1);
+		int			nSum1		= nSum0;
+		int			nSum2		= nSum0;
+		int			nSum3		= nSum0;
+
+		// weights add up to one, the sums can't overflow a byte
+		for (int t = 0; t < nTaps; ++t, pValues += 4)
+		{
+			nSum0 += pWeights[t] * pValues[0];
+			nSum1 += pWeights[t] * pValues[1];
+			nSum2 += pWeights[t] * pValues[2];
+			nSum3 += pWeights[t] * pValues[3];
+		}
+
+		pDst[0] = static_cast<unsigned char>(nSum0 >> PIXEL_SHIFT);
+		pDst[1] = static_cast<unsigned char>(nSum1 >> PIXEL_SHIFT);
+		pDst[2] = static_cast<unsigned char>(nSum2 >> PIXEL_SHIFT);
+		pDst[3] = static_cast<unsigned char>(nSum3 >> PIXEL_SHIFT);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
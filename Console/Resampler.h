@@ -0,0 +1,88 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Separable bilinear (triangle filter) resampler for 32 bpp images. When
+// shrinking, the filter is widened to the scale factor, like FreeImage's
+// FILTER_BILINEAR, so large wallpapers don't alias.
+//
+// Channels are filtered independently, the channel order doesn't matter.
+// It doesn't depend on Win32 or FreeImage and can be built and benchmarked
+// on its own.
+
+class Resampler
+{
+	public:
+
+		// polled once per row, return true to abandon the resample
+		typedef std::function<bool()>	CancelCallback;
+
+	public:
+
+		// pitches are in bytes; returns false if cancelled
+		static bool Resample(
+						const unsigned char* pSrc,
+						int nSrcWidth,
+						int nSrcHeight,
+						int nSrcPitch,
+						unsigned char* pDst,
+						int nDstWidth,
+						int nDstHeight,
+						int nDstPitch,
+						const CancelCallback& cancel);
+
+	public:
+
+		// filter taps of one destination row or column
+		struct Contributions
+		{
+			Contributions() : nTaps(0), first(), weights() {}
+
+			int					nTaps;
+			// first source pixel of each destination pixel
+			std::vector<int>	first;
+			// nTaps weights per destination pixel, 14 bit fixed point
+			std::vector<int>	weights;
+		};
+
+		// filters for one source and destination size, they can be kept
+		// around when the image is resampled a piece at a time
+		struct Filters
+		{
+			Contributions	horizontal;
+			Contributions	vertical;
+		};
+
+		static void CalcFilters(int nSrcWidth, int nSrcHeight, int nDstWidth, int nDstHeight, Filters& filters);
+
+		// resamples only the given rectangle of the destination image, pDst
+		// points at its top left pixel; pixels are the same as Resample's
+		static void ResampleRect(
+						const Filters& filters,
+						const unsigned char* pSrc,
+						int nSrcPitch,
+						int nDstX,
+						int nDstY,
+						int nDstWidth,
+						int nDstHeight,
+						unsigned char* pDst,
+						int nDstPitch);
+
+	private:
+
+		static void CalcContributions(int nSrcSize, int nDstSize, Contributions& contributions);
+
+		// vertical pass, nTaps source rows into one row of 8.8 fixed point values
+		static void FilterRows(const unsigned char* pSrc, int nSrcPitch, int nValues, const int* pWeights, int nTaps, int* pRow);
+		// horizontal pass, 8.8 fixed point row into destination pixels nDstX
+		// to nDstX + nDstWidth; the row starts at source pixel nRowFirst
+		static void FilterRow(const int* pRow, int nRowFirst, unsigned char* pDst, int nDstX, int nDstWidth, const Contributions& contributions);
+};
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,83 @@
+#include "stdafx.h"
+
+#include "ResizeThrottle.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+ResizeThrottle::ResizeThrottle()
+: m_bPending(false)
+, m_bTicking(false)
+, m_dwRequests(0)
+, m_dwSent(0)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool ResizeThrottle::OnRequest(bool bVisible)
+{
+	++m_dwRequests;
+	m_bPending = true;
+
+	if (!bVisible || m_bTicking) return false;
+
+	m_bTicking = true;
+
+	return Send();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool ResizeThrottle::OnTick(bool bVisible)
+{
+	// keep ticking while sizes come in, stop after a quiet tick
+	if (bVisible && m_bPending) return Send();
+
+	m_bTicking = false;
+
+	return false;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool ResizeThrottle::OnShow()
+{
+	return m_bPending ? Send() : false;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool ResizeThrottle::Send()
+{
+	m_bPending = false;
+	++m_dwSent;
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,59 @@
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Decides when a view sends its console size to the hook. Every resize of
+// the hook's console makes it read the whole buffer again, and a window or
+// split bar drag asks for one per pane on every mouse move.
+//
+// A visible view sends the first size at once and starts a tick timer;
+// sizes coming in during a tick are sent together when it ends, the latest
+// one only. The timer stops after a tick with nothing pending. A hidden
+// view keeps its size pending until it's shown.
+//
+// The view keeps the size and the timer, this only tells it what to do.
+// No Win32 dependency, it can be built and tested on its own.
+
+class ResizeThrottle
+{
+	public:
+
+		ResizeThrottle();
+
+	public:
+
+		// a new size is pending; returns true if it must be sent now, the
+		// caller then starts the tick timer
+		bool OnRequest(bool bVisible);
+
+		// tick timer; returns true if the pending size must be sent now,
+		// false if the timer must be stopped
+		bool OnTick(bool bVisible);
+
+		// the view is shown; returns true if the pending size must be sent
+		bool OnShow();
+
+		bool IsTicking() const { return m_bTicking; }
+
+		// sizes asked for, each one went to the hook before throttling, and
+		// sizes sent
+		unsigned long GetRequests() const { return m_dwRequests; }
+		unsigned long GetSent() const { return m_dwSent; }
+
+	private:
+
+		bool Send();
+
+	private:
+
+		bool			m_bPending;
+		bool			m_bTicking;
+
+		unsigned long	m_dwRequests;
+		unsigned long	m_dwSent;
+};
+
+//////////////////////////////////////////////////////////////////////////////
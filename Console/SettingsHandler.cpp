@@ -28,6 +28,7 @@ ConsoleSettings::ConsoleSettings()
 , dwBufferColumns(80)
 , bStartHidden(false)
 , bSaveSize(false)
+, localEcho(localEchoOff)
 , backgroundTextOpacity(255)
 {
 	defaultConsoleColors[0]	= 0x000000;
@@ -73,6 +74,11 @@ bool ConsoleSettings::Load(const CComPtr<IXMLDOMElement>& pSettingsRoot)
 	XmlHelper::GetAttribute(pConsoleElement, CComBSTR(L"save_size"), bSaveSize, false);
 	XmlHelper::GetAttribute(pConsoleElement, CComBSTR(L"background_text_opacity"), backgroundTextOpacity, 255);
 
+	int nLocalEcho;
+
+	XmlHelper::GetAttribute(pConsoleElement, CComBSTR(L"local_echo"), nLocalEcho, 0);
+	localEcho = static_cast<LocalEcho>(nLocalEcho);
+
 	if( !XmlHelper::LoadColors(pConsoleElement, consoleColors) )
 		::CopyMemory(consoleColors, defaultConsoleColors, sizeof(COLORREF)*16);
 
@@ -101,6 +107,7 @@ bool ConsoleSettings::Save(const CComPtr<IXMLDOMElement>& pSettingsRoot)
 	XmlHelper::SetAttribute(pConsoleElement, CComBSTR(L"start_hidden"), bStartHidden);
 	XmlHelper::SetAttribute(pConsoleElement, CComBSTR(L"save_size"), bSaveSize);
 	XmlHelper::SetAttribute(pConsoleElement, CComBSTR(L"background_text_opacity"), backgroundTextOpacity);
+	XmlHelper::SetAttribute(pConsoleElement, CComBSTR(L"local_echo"), static_cast<int>(localEcho));
 
 	XmlHelper::SaveColors(pConsoleElement, consoleColors);
 	return true;
@@ -124,6 +131,7 @@ ConsoleSettings& ConsoleSettings::operator=(const ConsoleSettings& other)
 	dwBufferColumns			= other.dwBufferColumns;
 	bStartHidden			= other.bStartHidden;
 	bSaveSize				= other.bSaveSize;
+	localEcho				= other.localEcho;
 
 	::CopyMemory(consoleColors, other.consoleColors, sizeof(COLORREF)*16);
 
@@ -152,6 +160,7 @@ FontSettings::FontSettings()
 , crFontColor(0)
 , bBoldIntensified(false)
 , bItalicIntensified(false)
+, dwRenderThreads(0)
 {
 }
 
@@ -176,6 +185,7 @@ bool FontSettings::Load(const CComPtr<IXMLDOMElement>& pSettingsRoot)
 	XmlHelper::GetAttribute(pFontElement, CComBSTR(L"smoothing"), nFontSmoothing, 0);
 	XmlHelper::GetAttribute(pFontElement, CComBSTR(L"bold_intensified"), bBoldIntensified, false);
 	XmlHelper::GetAttribute(pFontElement, CComBSTR(L"italic_intensified"), bItalicIntensified, false);
+	XmlHelper::GetAttribute(pFontElement, CComBSTR(L"render_threads"), dwRenderThreads, 0);
 
 	fontSmoothing = static_cast<FontSmoothing>(nFontSmoothing);
 
@@ -207,6 +217,7 @@ bool FontSettings::Save(const CComPtr<IXMLDOMElement>& pSettingsRoot)
 	XmlHelper::SetAttribute(pFontElement, CComBSTR(L"smoothing"), static_cast<int>(fontSmoothing));
 	XmlHelper::SetAttribute(pFontElement, CComBSTR(L"bold_intensified"), bBoldIntensified);
 	XmlHelper::SetAttribute(pFontElement, CComBSTR(L"italic_intensified"), bItalicIntensified);
+	XmlHelper::SetAttribute(pFontElement, CComBSTR(L"render_threads"), dwRenderThreads);
 
 	CComPtr<IXMLDOMElement>	pColorElement;
 
@@ -236,6 +247,8 @@ FontSettings& FontSettings::operator=(const FontSettings& other)
 	bUseColor		= other.bUseColor;
 	crFontColor		= other.crFontColor;
 
+	dwRenderThreads	= other.dwRenderThreads;
+
 	return *this;
 }
 
@@ -1228,6 +1241,11 @@ HotKeys::HotKeys()
 	commands.push_back(std::shared_ptr<CommandData>(new CommandData(L"scrollpageright",	ID_SCROLL_PAGE_RIGHT,	L"Scroll buffer page right")));
 
 	commands.push_back(std::shared_ptr<CommandData>(new CommandData(L"dumpbuffer",	IDC_DUMP_BUFFER,	L"Dump screen buffer")));
+	commands.push_back(std::shared_ptr<CommandData>(new CommandData(L"dumptrace",	IDC_DUMP_TRACE,		L"Dump trace events")));
+	commands.push_back(std::shared_ptr<CommandData>(new CommandData(L"dumplatency",	IDC_DUMP_LATENCY,	L"Dump input latency")));
+	commands.push_back(std::shared_ptr<CommandData>(new CommandData(L"latencyoverlay",	IDC_LATENCY_OVERLAY,	L"Show/hide input latency")));
+	commands.push_back(std::shared_ptr<CommandData>(new CommandData(L"dumpimages",	IDC_DUMP_IMAGES,	L"Dump background image memory")));
+	commands.push_back(std::shared_ptr<CommandData>(new CommandData(L"dumpviews",	IDC_DUMP_VIEWS,		L"Dump view resources")));
 
 	// global commands
 	commands.push_back(std::shared_ptr<CommandData>(new CommandData(L"activate",	IDC_GLOBAL_ACTIVATE,	L"Activate Console (global)", true)));
@@ -1566,7 +1584,10 @@ MouseSettings& MouseSettings::operator=(const MouseSettings& other)
 //////////////////////////////////////////////////////////////////////////////
 
 TabSettings::TabSettings()
-: strDefaultShell(L"")
+: dwShellPoolSize(0)
+, dwImageCacheSize(128)
+, dwHibernateTime(300)
+, strDefaultShell(L"")
 , strDefaultInitialDir(L"")
 {
 }
@@ -1584,6 +1605,14 @@ bool TabSettings::Load(const CComPtr<IXMLDOMElement>& pSettingsRoot)
 	hr = pSettingsRoot->selectNodes(CComBSTR(L"tabs/tab"), &pTabNodes);
 	if (FAILED(hr)) return false;
 
+	CComPtr<IXMLDOMElement>	pTabsElement;
+	if (SUCCEEDED(XmlHelper::GetDomElement(pSettingsRoot, CComBSTR(L"tabs"), pTabsElement)))
+	{
+		XmlHelper::GetAttribute(pTabsElement, CComBSTR(L"shell_pool_size"), dwShellPoolSize, 0);
+		XmlHelper::GetAttribute(pTabsElement, CComBSTR(L"image_cache_size"), dwImageCacheSize, 128);
+		XmlHelper::GetAttribute(pTabsElement, CComBSTR(L"hibernate_time"), dwHibernateTime, 300);
+	}
+
 	long	lListLength;
 	pTabNodes->get_length(&lListLength);
 
@@ -1613,6 +1642,7 @@ bool TabSettings::Load(const CComPtr<IXMLDOMElement>& pSettingsRoot)
 			XmlHelper::GetAttribute(pConsoleElement, CComBSTR(L"run_as_user"), tabData->bRunAsUser, false);
 			XmlHelper::GetAttribute(pConsoleElement, CComBSTR(L"user"), tabData->strUser, L"");
 			XmlHelper::GetAttribute(pConsoleElement, CComBSTR(L"net_only"), tabData->bNetOnly, false);
+			XmlHelper::GetAttribute(pConsoleElement, CComBSTR(L"warm_shell"), tabData->bWarmShell, false);
 		}
 
 		if (SUCCEEDED(XmlHelper::GetDomElement(pTabElement, CComBSTR(L"cursor"), pCursorElement)))
@@ -1685,6 +1715,10 @@ bool TabSettings::Save(const CComPtr<IXMLDOMElement>& pSettingsRoot)
 
 	if (FAILED(XmlHelper::GetDomElement(pSettingsRoot, CComBSTR(L"tabs"), pTabsElement))) return false;
 
+	XmlHelper::SetAttribute(pTabsElement, CComBSTR(L"shell_pool_size"), dwShellPoolSize);
+	XmlHelper::SetAttribute(pTabsElement, CComBSTR(L"image_cache_size"), dwImageCacheSize);
+	XmlHelper::SetAttribute(pTabsElement, CComBSTR(L"hibernate_time"), dwHibernateTime);
+
 	if (FAILED(pTabsElement->get_childNodes(&pTabChildNodes))) return false;
 
 	long	lListLength;
@@ -1736,6 +1770,7 @@ bool TabSettings::Save(const CComPtr<IXMLDOMElement>& pSettingsRoot)
 		XmlHelper::SetAttribute(pNewConsoleElement, CComBSTR(L"run_as_user"), (*itTab)->bRunAsUser);
 		XmlHelper::SetAttribute(pNewConsoleElement, CComBSTR(L"user"), (*itTab)->strUser);
 		XmlHelper::SetAttribute(pNewConsoleElement, CComBSTR(L"net_only"), (*itTab)->bNetOnly);
+		XmlHelper::SetAttribute(pNewConsoleElement, CComBSTR(L"warm_shell"), (*itTab)->bWarmShell);
 
 		XmlHelper::AddTextNode(pNewTabElement, CComBSTR(L"\n\t\t\t"));
 		pNewTabElement->appendChild(pNewConsoleElement, &pNewConsoleOut);
@@ -1883,6 +1918,8 @@ SettingsHandler::~SettingsHandler()
 
 bool SettingsHandler::LoadSettings(const wstring& strSettingsFileName)
 {
+	TRACE_SCOPE("SettingsHandler::LoadSettings");
+
 	HRESULT hr = S_OK;
 
 	size_t pos = strSettingsFileName.rfind(L'\\');
@@ -23,6 +23,19 @@ struct SettingsBase
 //////////////////////////////////////////////////////////////////////////////
 
 
+//////////////////////////////////////////////////////////////////////////////
+
+enum LocalEcho
+{
+	localEchoOff		= 0,
+	// typed characters are drawn ahead of the console when it's slow to echo
+	localEchoAdaptive	= 1,
+	localEchoAlways		= 2
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+
 //////////////////////////////////////////////////////////////////////////////
 
 struct ConsoleSettings : public SettingsBase
@@ -47,6 +60,8 @@ struct ConsoleSettings : public SettingsBase
 	bool		bStartHidden;
 	bool		bSaveSize;
 
+	LocalEcho	localEcho;
+
 	COLORREF	defaultConsoleColors[16];
 	COLORREF	consoleColors[16];
 	BYTE		backgroundTextOpacity;
@@ -92,6 +107,11 @@ struct FontSettings : public SettingsBase
 
 	bool			bUseColor;
 	COLORREF		crFontColor;
+
+	// experimental: worker threads drawing text into the view's bitmap,
+	// 0 (the default) draws with GDI. Not shown to be faster than GDI yet,
+	// Tests/BandRendererBench times it against one thread only
+	DWORD			dwRenderThreads;
 };
 
 //////////////////////////////////////////////////////////////////////////////
@@ -644,6 +664,7 @@ struct TabData
 	, bRunAsUser(false)
 	, strUser()
 	, bNetOnly(false)
+	, bWarmShell(false)
 	, dwCursorStyle(0)
 	, crCursorColor(RGB(255, 255, 255))
 	, backgroundImageType(bktypeNone)
@@ -664,6 +685,7 @@ struct TabData
 	bool							bRunAsUser;
 	wstring							strUser;
 	bool							bNetOnly;
+	bool							bWarmShell;
 
 	DWORD							dwCursorStyle;
 	COLORREF						crCursorColor;
@@ -713,6 +735,15 @@ struct TabSettings : public SettingsBase
 
 	TabDataVector	tabDataVector;
 
+	// warm consoles kept per tab with bWarmShell set (0 disables the pool)
+	DWORD			dwShellPoolSize;
+
+	// MB of decoded background images kept when not in use
+	DWORD			dwImageCacheSize;
+
+	// seconds a background tab keeps its render resources (0 keeps them)
+	DWORD			dwHibernateTime;
+
 private:
 
 	wstring			strDefaultShell;
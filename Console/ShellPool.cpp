@@ -0,0 +1,307 @@
+#include "stdafx.h"
+
+#include "Console.h"
+#include "ConsoleException.h"
+#include "ShellPool.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+ShellPool::ShellKey::ShellKey(const std::shared_ptr<TabData>& tabData)
+: tabData(tabData)
+, strShell(g_settingsHandler->GetConsoleSettings().strShell)
+, strInitialDir(g_settingsHandler->GetConsoleSettings().strInitialDir)
+, strTitle()
+{
+	// same rules as ConsoleView::OnCreate
+	if (tabData->strShell.length() > 0)		strShell		= tabData->strShell;
+	if (tabData->strInitialDir.length() > 0)	strInitialDir	= tabData->strInitialDir;
+
+	if (g_settingsHandler->GetAppearanceSettings().windowSettings.bUseConsoleTitle) strTitle = tabData->strTitle;
+}
+
+bool ShellPool::ShellKey::operator==(const ShellKey& other) const
+{
+	return
+		(tabData == other.tabData) &&
+		(strShell == other.strShell) &&
+		(strInitialDir == other.strInitialDir) &&
+		(strTitle == other.strTitle);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+ShellPool::ShellPool()
+: m_poolCritSec()
+, m_keys()
+, m_dwPoolSize(0)
+, m_dwRows(0)
+, m_dwColumns(0)
+, m_shellStartup()
+, m_shells()
+, m_hRefillEvent(::CreateEvent(NULL, FALSE, FALSE, NULL))
+{
+	// the watchdog mutex is owned by the thread that creates it, make sure
+	// that's the UI thread and not the pool thread
+	ConsoleHandler::CreateWatchdog();
+}
+
+ShellPool::~ShellPool()
+{
+	try
+	{
+		Stop(INFINITE);
+	}
+	catch(std::exception&)
+	{
+	}
+
+	Clear();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool ShellPool::Adopt(const std::shared_ptr<TabData>& tabData, ConsoleHandler& consoleHandler, DWORD dwRows, DWORD dwColumns)
+{
+	if (!tabData->bWarmShell || tabData->bRunAsUser) return false;
+
+	ShellKey					shellKey(tabData);
+	std::shared_ptr<WarmShell>	warmShell;
+
+	{
+		CriticalSectionLock	lock(m_poolCritSec);
+
+		for (WarmShells::iterator it = m_shells.begin(); it != m_shells.end(); ++it)
+		{
+			if ((*it)->key == shellKey)
+			{
+				warmShell = *it;
+				m_shells.erase(it);
+				break;
+			}
+		}
+	}
+
+	if (!warmShell) return false;
+
+	::SetEvent(m_hRefillEvent.get());
+
+	// the shell might have exited while waiting in the pool
+	if (::WaitForSingleObject(warmShell->consoleHandler->GetConsoleHandle().get(), 0) != WAIT_TIMEOUT) return false;
+
+	consoleHandler.AdoptShellProcess(*warmShell->consoleHandler);
+
+	SharedMemory<ConsoleParams>& consoleParams = consoleHandler.GetConsoleParams();
+
+	if ((consoleParams->dwRows != dwRows) || (consoleParams->dwColumns != dwColumns))
+	{
+		SharedMemory<ConsoleSize>& newConsoleSize = consoleHandler.GetNewConsoleSize();
+
+		{
+			SharedMemoryLock	memLock(newConsoleSize);
+
+			newConsoleSize->dwColumns			= dwColumns;
+			newConsoleSize->dwRows				= dwRows;
+			newConsoleSize->dwResizeWindowEdge	= WMSZ_BOTTOM;
+		}
+
+		newConsoleSize.SetReqEvent();
+
+		// the view sizes its first frame from the params, don't leave it the
+		// pool's size until the resize comes back
+		consoleParams->dwRows		= dwRows;
+		consoleParams->dwColumns	= dwColumns;
+	}
+
+	TRACE(L"ShellPool: adopted console %i for '%s'\n", consoleHandler.GetConsolePid(), shellKey.strShell.c_str());
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ShellPool::Refresh()
+{
+	TabSettings&	tabSettings		= g_settingsHandler->GetTabSettings();
+	ConsoleSettings&consoleSettings	= g_settingsHandler->GetConsoleSettings();
+	ShellStartup	shellStartup(ConsoleHandler::GetShellStartup());
+
+	// evicted consoles are closed after we leave the critical section
+	WarmShells		evictedShells;
+
+	{
+		CriticalSectionLock	lock(m_poolCritSec);
+
+		m_dwPoolSize	= tabSettings.dwShellPoolSize;
+		m_dwRows		= consoleSettings.dwRows;
+		m_dwColumns		= consoleSettings.dwColumns;
+		m_shellStartup	= shellStartup;
+
+		m_keys.clear();
+
+		if (m_dwPoolSize > 0)
+		{
+			for (TabDataVector::iterator it = tabSettings.tabDataVector.begin(); it != tabSettings.tabDataVector.end(); ++it)
+			{
+				if ((*it)->bWarmShell && !(*it)->bRunAsUser) m_keys.push_back(ShellKey(*it));
+			}
+		}
+
+		WarmShells	shells;
+		shells.swap(m_shells);
+
+		for (WarmShells::iterator it = shells.begin(); it != shells.end(); ++it)
+		{
+			DWORD dwCount = static_cast<DWORD>(std::count_if(
+								m_shells.begin(),
+								m_shells.end(),
+								[&it](const std::shared_ptr<WarmShell>& warmShell) { return warmShell->key == (*it)->key; }));
+
+			if ((dwCount < m_dwPoolSize) && (std::find(m_keys.begin(), m_keys.end(), (*it)->key) != m_keys.end()))
+			{
+				m_shells.push_back(*it);
+			}
+			else
+			{
+				evictedShells.push_back(*it);
+			}
+		}
+	}
+
+	::SetEvent(m_hRefillEvent.get());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ShellPool::Clear()
+{
+	WarmShells	shells;
+
+	{
+		CriticalSectionLock	lock(m_poolCritSec);
+		shells.swap(m_shells);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+DWORD ShellPool::Process(HANDLE hStopSignal)
+{
+	HANDLE arrWaitHandles[] = { hStopSignal, m_hRefillEvent.get() };
+
+	while (::WaitForMultipleObjects(sizeof(arrWaitHandles)/sizeof(arrWaitHandles[0]), arrWaitHandles, FALSE, INFINITE) == WAIT_OBJECT_0 + 1)
+	{
+		// spawn one console at a time, the critical section is never held
+		// while a shell is starting
+		for (;;)
+		{
+			if (::WaitForSingleObject(hStopSignal, 0) == WAIT_OBJECT_0) return 0;
+
+			std::unique_ptr<ShellKey>	missingKey;
+			DWORD						dwRows		= 0;
+			DWORD						dwColumns	= 0;
+			ShellStartup				shellStartup;
+
+			{
+				CriticalSectionLock	lock(m_poolCritSec);
+
+				for (vector<ShellKey>::iterator it = m_keys.begin(); it != m_keys.end(); ++it)
+				{
+					DWORD dwCount = static_cast<DWORD>(std::count_if(
+										m_shells.begin(),
+										m_shells.end(),
+										[&it](const std::shared_ptr<WarmShell>& warmShell) { return warmShell->key == *it; }));
+
+					if (dwCount < m_dwPoolSize)
+					{
+						missingKey.reset(new ShellKey(*it));
+						break;
+					}
+				}
+
+				dwRows			= m_dwRows;
+				dwColumns		= m_dwColumns;
+				shellStartup	= m_shellStartup;
+			}
+
+			if (!missingKey) break;
+
+			// don't keep retrying a broken shell, wait for the next refresh
+			if (!SpawnShell(*missingKey, dwRows, dwColumns, shellStartup)) break;
+		}
+	}
+
+	return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool ShellPool::SpawnShell(const ShellKey& shellKey, DWORD dwRows, DWORD dwColumns, const ShellStartup& shellStartup)
+{
+	std::shared_ptr<WarmShell>	warmShell(new WarmShell(shellKey));
+
+	try
+	{
+		warmShell->consoleHandler->StartShellProcess(
+									shellKey.strShell,
+									shellKey.strInitialDir,
+									UserCredentials(),
+									wstring(L""),
+									shellKey.strTitle,
+									dwRows,
+									dwColumns,
+									shellStartup);
+	}
+	catch (const ConsoleException& ex)
+	{
+		TRACE(L"ShellPool: can't start '%s': %s\n", shellKey.strShell.c_str(), ex.GetMessage().c_str());
+		return false;
+	}
+
+	// finish the hook handshake right away, the hook stops waiting for
+	// it after 10 seconds; the monitor thread is started on adoption
+	warmShell->consoleHandler->GetConsoleParams().SetRespEvent();
+
+	CriticalSectionLock	lock(m_poolCritSec);
+
+	// settings might have changed while the shell was starting, in that
+	// case warmShell closes the console when it goes out of scope
+	if (std::find(m_keys.begin(), m_keys.end(), shellKey) != m_keys.end())
+	{
+		m_shells.push_back(warmShell);
+	}
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Wallpaper.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Keeps hidden, hook-attached consoles ready for tabs that have warm shells
+// enabled, so a new tab can skip process creation, DLL injection and the
+// hook handshake. The pool is refilled on its own thread.
+
+class ShellPool : public MyThread
+{
+	public:
+
+		ShellPool();
+		virtual ~ShellPool();
+
+	public:
+
+		// hands a warm console for the tab over to consoleHandler and resizes
+		// it to dwRows x dwColumns; returns false if none is ready
+		bool Adopt(const std::shared_ptr<TabData>& tabData, ConsoleHandler& consoleHandler, DWORD dwRows, DWORD dwColumns);
+
+		// re-reads tab settings, evicts warm consoles for changed or removed
+		// tabs and schedules a refill
+		void Refresh();
+
+		// closes all warm consoles (e.g. when the environment has changed)
+		void Clear();
+
+		virtual DWORD Process(HANDLE hStopSignal);
+
+	private:
+
+		struct ShellKey
+		{
+			ShellKey(const std::shared_ptr<TabData>& tabData);
+
+			bool operator==(const ShellKey& other) const;
+
+			std::shared_ptr<TabData>	tabData;
+			wstring						strShell;
+			wstring						strInitialDir;
+			wstring						strTitle;
+		};
+
+		struct WarmShell
+		{
+			WarmShell(const ShellKey& shellKey)
+			: key(shellKey)
+			, consoleHandler(new ConsoleHandler())
+			{
+			}
+
+			ShellKey						key;
+			std::unique_ptr<ConsoleHandler>	consoleHandler;
+		};
+
+		typedef vector<std::shared_ptr<WarmShell> >	WarmShells;
+
+	private:
+
+		bool SpawnShell(const ShellKey& shellKey, DWORD dwRows, DWORD dwColumns, const ShellStartup& shellStartup);
+
+	private:
+
+		CriticalSection			m_poolCritSec;
+
+		// tabs we keep warm consoles for and the settings to start them
+		// with, copied on the UI thread; the pool thread never reads the
+		// settings themselves
+		vector<ShellKey>		m_keys;
+		DWORD					m_dwPoolSize;
+		DWORD					m_dwRows;
+		DWORD					m_dwColumns;
+		ShellStartup			m_shellStartup;
+
+		WarmShells				m_shells;
+
+		std::unique_ptr<void, CloseHandleHelper>	m_hRefillEvent;
+};
+
+//////////////////////////////////////////////////////////////////////////////
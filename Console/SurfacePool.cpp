@@ -0,0 +1,60 @@
+#include "stdafx.h"
+
+#include <algorithm>
+
+#include "SurfacePool.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+int SurfacePolicy::Round(int nSize)
+{
+	if (nSize < 1) nSize = 1;
+
+	return (nSize + GRAIN - 1) / GRAIN * GRAIN;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool SurfacePolicy::Fits(int nCapacityWidth, int nCapacityHeight, int nWidth, int nHeight)
+{
+	return (nWidth <= nCapacityWidth) && (nHeight <= nCapacityHeight);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool SurfacePolicy::IsOversized(int nCapacityWidth, int nCapacityHeight, int nWidth, int nHeight)
+{
+	long long llCapacity	= static_cast<long long>(nCapacityWidth) * nCapacityHeight;
+	long long llNeeded		= static_cast<long long>(Round(nWidth)) * Round(nHeight);
+
+	return llCapacity > llNeeded * OVERSIZE;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void SurfacePolicy::CalcGrowSize(int nCapacityWidth, int nCapacityHeight, int nWidth, int nHeight, int& nNewWidth, int& nNewHeight)
+{
+	// a dimension that fits keeps its size, so dragging one edge doesn't
+	// grow the other one
+	nNewWidth	= (nWidth <= nCapacityWidth) ? nCapacityWidth : (std::max)(Round(nWidth), Round(nCapacityWidth + nCapacityWidth / 2));
+	nNewHeight	= (nHeight <= nCapacityHeight) ? nCapacityHeight : (std::max)(Round(nHeight), Round(nCapacityHeight + nCapacityHeight / 2));
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// How pooled surfaces are sized. Sizes are rounded up to GRAIN pixels, a
+// surface that's too small grows by half in the dimension that doesn't fit,
+// and one is oversized when it has more than OVERSIZE times the pixels it
+// needs (a grown surface usually is, until the size settles).
+
+class SurfacePolicy
+{
+	public:
+
+		enum
+		{
+			GRAIN		= 32,
+			OVERSIZE	= 2
+		};
+
+	public:
+
+		static int Round(int nSize);
+
+		static bool Fits(int nCapacityWidth, int nCapacityHeight, int nWidth, int nHeight);
+		static bool IsOversized(int nCapacityWidth, int nCapacityHeight, int nWidth, int nHeight);
+
+		static void CalcGrowSize(int nCapacityWidth, int nCapacityHeight, int nWidth, int nHeight, int& nNewWidth, int& nNewHeight);
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+struct SurfacePoolStats
+{
+	SurfacePoolStats()
+	: stSurfaces(0)
+	, stInUse(0)
+	, stBytes(0)
+	, stPeakBytes(0)
+	, dwAllocations(0)
+	, dwReuses(0)
+	, dwGrows(0)
+	, dwShrinks(0)
+	{
+	}
+
+	size_t			stSurfaces;
+	size_t			stInUse;
+	size_t			stBytes;
+	size_t			stPeakBytes;
+
+	unsigned long	dwAllocations;
+	unsigned long	dwReuses;
+	unsigned long	dwGrows;
+	unsigned long	dwShrinks;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// 32 bpp surfaces shared by the views of a window. Views take surfaces while
+// they're shown and give them back when they're hidden, so the next view
+// shown can use them without allocating.
+//
+// Surfaces are created as Surface(nWidth, nHeight) and must have GetWidth()
+// and GetHeight(). They're at least as big as asked for; held surfaces only
+// grow while a view is resized, shrinking is up to the caller once it's done.
+// Free surfaces are kept until Trim.
+//
+// Not thread safe. No Win32 dependency, it can be built and tested on its
+// own.
+
+template <class Surface>
+class SurfacePool
+{
+	public:
+
+		typedef std::shared_ptr<Surface>	SurfacePtr;
+
+	public:
+
+		SurfacePool()
+		: m_freeSurfaces()
+		, m_stats()
+		{
+		}
+
+	public:
+
+		// a free surface that fits, or a new one
+		SurfacePtr Acquire(int nWidth, int nHeight)
+		{
+			SurfacePtr surface(TakeFreeSurface(nWidth, nHeight));
+
+			if (surface) return surface;
+
+			return Allocate(SurfacePolicy::Round(nWidth), SurfacePolicy::Round(nHeight));
+		}
+
+		// makes a held surface fit, growing it geometrically; oversized ones
+		// are shrunk only when bShrink is set. Returns true if the surface was
+		// replaced, its contents are gone then.
+		bool Resize(SurfacePtr& surface, int nWidth, int nHeight, bool bShrink)
+		{
+			if (!surface)
+			{
+				surface = Acquire(nWidth, nHeight);
+				return true;
+			}
+
+			int		nCapacityWidth	= surface->GetWidth();
+			int		nCapacityHeight	= surface->GetHeight();
+			bool	bFits			= SurfacePolicy::Fits(nCapacityWidth, nCapacityHeight, nWidth, nHeight);
+
+			if (bFits && !(bShrink && SurfacePolicy::IsOversized(nCapacityWidth, nCapacityHeight, nWidth, nHeight))) return false;
+
+			int nNewWidth	= SurfacePolicy::Round(nWidth);
+			int nNewHeight	= SurfacePolicy::Round(nHeight);
+
+			if (bFits)
+			{
+				++m_stats.dwShrinks;
+			}
+			else
+			{
+				SurfacePolicy::CalcGrowSize(nCapacityWidth, nCapacityHeight, nWidth, nHeight, nNewWidth, nNewHeight);
+				++m_stats.dwGrows;
+			}
+
+			// the old one is too small or oversized for this view, and likely
+			// for the others being resized with it
+			Free(surface);
+
+			surface = TakeFreeSurface(nWidth, nHeight);
+			if (!surface) surface = Allocate(nNewWidth, nNewHeight);
+
+			return true;
+		}
+
+		void Release(SurfacePtr& surface)
+		{
+			if (!surface) return;
+
+			m_freeSurfaces.push_back(surface);
+			surface.reset();
+
+			--m_stats.stInUse;
+		}
+
+		// frees the surfaces nobody took back
+		void Trim()
+		{
+			for (size_t i = 0; i < m_freeSurfaces.size(); ++i)
+			{
+				m_stats.stBytes -= GetBytes(*m_freeSurfaces[i]);
+				--m_stats.stSurfaces;
+			}
+
+			m_freeSurfaces.clear();
+		}
+
+		SurfacePoolStats GetStats() const { return m_stats; }
+
+	private:
+
+		static size_t GetBytes(const Surface& surface)
+		{
+			return static_cast<size_t>(surface.GetWidth()) * surface.GetHeight() * 4;
+		}
+
+		void Free(SurfacePtr& surface)
+		{
+			m_stats.stBytes -= GetBytes(*surface);
+			--m_stats.stSurfaces;
+			--m_stats.stInUse;
+
+			surface.reset();
+		}
+
+		// smallest free surface that fits and isn't oversized
+		SurfacePtr TakeFreeSurface(int nWidth, int nHeight)
+		{
+			size_t stBest = m_freeSurfaces.size();
+
+			for (size_t i = 0; i < m_freeSurfaces.size(); ++i)
+			{
+				const Surface& surface = *m_freeSurfaces[i];
+
+				if (!SurfacePolicy::Fits(surface.GetWidth(), surface.GetHeight(), nWidth, nHeight)) continue;
+				if (SurfacePolicy::IsOversized(surface.GetWidth(), surface.GetHeight(), nWidth, nHeight)) continue;
+
+				if ((stBest == m_freeSurfaces.size()) || (GetBytes(surface) < GetBytes(*m_freeSurfaces[stBest]))) stBest = i;
+			}
+
+			if (stBest == m_freeSurfaces.size()) return SurfacePtr();
+
+			SurfacePtr surface(m_freeSurfaces[stBest]);
+
+			m_freeSurfaces.erase(m_freeSurfaces.begin() + stBest);
+
+			++m_stats.stInUse;
+			++m_stats.dwReuses;
+
+			return surface;
+		}
+
+		SurfacePtr Allocate(int nWidth, int nHeight)
+		{
+			SurfacePtr surface(new Surface(nWidth, nHeight));
+
+			m_stats.stBytes += GetBytes(*surface);
+			if (m_stats.stBytes > m_stats.stPeakBytes) m_stats.stPeakBytes = m_stats.stBytes;
+
+			++m_stats.stSurfaces;
+			++m_stats.stInUse;
+			++m_stats.dwAllocations;
+
+			return surface;
+		}
+
+	private:
+
+		std::vector<SurfacePtr>	m_freeSurfaces;
+
+		SurfacePoolStats		m_stats;
+};
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,103 @@
+#include "stdafx.h"
+
+#include <algorithm>
+
+#include "TabStripLayout.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+TabStripLayout::TabStripLayout()
+: m_widths()
+, m_offsets(1, 0)
+, m_stFirstDirty(0)
+, m_stFirstMoved(0)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void TabStripLayout::SetCount(size_t stCount)
+{
+	if (stCount == m_widths.size()) return;
+
+	m_stFirstDirty = (std::min)(m_stFirstDirty, (std::min)(stCount, m_widths.size()));
+
+	m_widths.resize(stCount, 0);
+	m_offsets.resize(stCount + 1, m_offsets.back());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool TabStripLayout::SetWidth(size_t stTab, int nWidth)
+{
+	if (m_widths[stTab] == nWidth) return false;
+
+	m_widths[stTab] = nWidth;
+	m_stFirstDirty	= (std::min)(m_stFirstDirty, stTab);
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void TabStripLayout::Arrange(int nStart)
+{
+	// a different start moves everything
+	if (m_offsets[0] != nStart)
+	{
+		m_offsets[0]	= nStart;
+		m_stFirstDirty	= 0;
+	}
+
+	m_stFirstMoved = m_widths.size();
+
+	for (size_t i = m_stFirstDirty; i < m_widths.size(); ++i)
+	{
+		int nRight = m_offsets[i] + m_widths[i];
+
+		// the first dirty tab changed width (or is new) even if it didn't move
+		if ((m_stFirstMoved == m_widths.size()) && ((i == m_stFirstDirty) || (m_offsets[i + 1] != nRight)))
+		{
+			m_stFirstMoved = i;
+		}
+
+		m_offsets[i + 1] = nRight;
+	}
+
+	m_stFirstDirty = m_widths.size();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+int TabStripLayout::HitTest(int x) const
+{
+	if (m_widths.empty() || (x < m_offsets[0]) || (x >= m_offsets.back())) return -1;
+
+	// last left edge at or before x; zero width tabs share their left edge
+	// with the next one, which is the one that gets hit
+	std::vector<int>::const_iterator it = std::upper_bound(m_offsets.begin(), m_offsets.end() - 1, x);
+
+	return static_cast<int>(it - m_offsets.begin()) - 1;
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Positions of the tabs in a tab strip, left to right and back to back, in
+// logical (unscrolled) coordinates. The tab control sets each tab's width
+// after measuring it; only tabs from the first one whose width changed are
+// moved, and the ones that moved tell the control what to repaint.
+//
+// No Win32 dependency, it can be built and tested on its own.
+
+class TabStripLayout
+{
+	public:
+
+		TabStripLayout();
+
+	public:
+
+		// tabs added are zero width until they're set
+		void SetCount(size_t stCount);
+		size_t GetCount() const { return m_widths.size(); }
+
+		// returns true if the width changed, the tab and the ones after it
+		// move on the next Arrange
+		bool SetWidth(size_t stTab, int nWidth);
+		int GetWidth(size_t stTab) const { return m_widths[stTab]; }
+
+		// lays the tabs out from nStart
+		void Arrange(int nStart);
+
+		int GetLeft(size_t stTab) const { return m_offsets[stTab]; }
+		int GetRight(size_t stTab) const { return m_offsets[stTab + 1]; }
+		int GetEnd() const { return m_offsets.back(); }
+
+		// first tab that moved or changed width in the last Arrange, GetCount()
+		// if none did
+		size_t GetFirstMoved() const { return m_stFirstMoved; }
+
+		// tab under x (logical coordinates), -1 if there's none
+		int HitTest(int x) const;
+
+	private:
+
+		std::vector<int>	m_widths;
+
+		// m_offsets[i] is the left edge of tab i, the last one is the right
+		// edge of the strip
+		std::vector<int>	m_offsets;
+
+		// tabs from here on must be moved
+		size_t				m_stFirstDirty;
+		size_t				m_stFirstMoved;
+};
+
+//////////////////////////////////////////////////////////////////////////////
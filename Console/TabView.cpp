@@ -17,6 +17,7 @@ TabView::TabView(MainFrame& mainFrame, std::shared_ptr<TabData> tabData, const w
 ,m_viewsMutex(NULL, FALSE, NULL)
 ,m_tabData(tabData)
 ,m_strTitle(tabData->strTitle.c_str())
+,m_strShownTitle()
 ,m_bigIcon()
 ,m_smallIcon()
 ,m_boolIsGrouped(false)
@@ -257,6 +258,17 @@ void TabView::InitializeScrollbars()
   }
 }
 
+void TabView::ApplyTitleSettings()
+{
+  MutexLock	viewMapLock(m_viewsMutex);
+  for (ConsoleViewMap::iterator it = m_views.begin(); it != m_views.end(); ++it)
+  {
+    it->second->ApplyTitleSettings();
+  }
+
+  ResetShownTitle();
+}
+
 void TabView::Repaint(bool bFullRepaint)
 {
   MutexLock	viewMapLock(m_viewsMutex);
@@ -266,6 +278,15 @@ void TabView::Repaint(bool bFullRepaint)
   }
 }
 
+void TabView::CatchUp()
+{
+  MutexLock	viewMapLock(m_viewsMutex);
+  for (ConsoleViewMap::iterator it = m_views.begin(); it != m_views.end(); ++it)
+  {
+    it->second->CatchUp();
+  }
+}
+
 void TabView::SetResizing(bool bResizing)
 {
   MutexLock	viewMapLock(m_viewsMutex);
@@ -295,6 +316,14 @@ void TabView::SetTitle(const CString& strTitle)
   }
 }
 
+bool TabView::UpdateShownTitle(const CString& strTitle)
+{
+  if (strTitle == m_strShownTitle) return false;
+
+  m_strShownTitle = strTitle;
+  return true;
+}
+
 void TabView::SetActive(bool bActive)
 {
   MutexLock	viewMapLock(m_viewsMutex);
@@ -546,6 +575,46 @@ void TabView::PasteToConsoles()
 
 /////////////////////////////////////////////////////////////////////////////
 
+void TabView::DumpLatency(wostream& os)
+{
+  MutexLock	viewMapLock(m_viewsMutex);
+  for (ConsoleViewMap::iterator it = m_views.begin(); it != m_views.end(); ++it)
+  {
+    it->second->DumpLatency(os);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////
+
+void TabView::DumpResources(wostream& os)
+{
+  MutexLock	viewMapLock(m_viewsMutex);
+  for (ConsoleViewMap::iterator it = m_views.begin(); it != m_views.end(); ++it)
+  {
+    it->second->DumpResources(os);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////
+
+void TabView::AddResizeCounts(DWORD& dwRequests, DWORD& dwSent)
+{
+  MutexLock	viewMapLock(m_viewsMutex);
+  for (ConsoleViewMap::iterator it = m_views.begin(); it != m_views.end(); ++it)
+  {
+    dwRequests += it->second->GetResizeThrottle().GetRequests();
+    dwSent     += it->second->GetResizeThrottle().GetSent();
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////
+
 void TabView::SendTextToConsoles(const wchar_t* pszText)
 {
   MutexLock	viewMapLock(m_viewsMutex);
@@ -56,13 +56,19 @@ public:
 
   void SetTitle(const CString& strTitle);
   const CString& GetTitle() const { return m_strTitle; }
+  // title last shown on the tab; returns false if it's the same, so
+  // MainFrame can leave the tab control alone
+  bool UpdateShownTitle(const CString& strTitle);
+  void ResetShownTitle() { m_strShownTitle.Empty(); }
   CIcon& GetIcon(bool bBigIcon = true) { return bBigIcon ? m_bigIcon : m_smallIcon; }
   void SetActive(bool bActive);
   void SetAppActiveStatus(bool bAppActive);
   void SetResizing(bool bResizing);
   void MainframeMoving();
   void Repaint(bool bFullRepaint);
+  void CatchUp();
   void InitializeScrollbars();
+  void ApplyTitleSettings();
   void AdjustRectAndResize(ADJUSTSIZE as, CRect& clientRect, DWORD dwResizeWindowEdge);
   void GetRect(CRect& clientRect);
 
@@ -74,6 +80,10 @@ public:
 
   void PostMessageToConsoles(UINT Msg, WPARAM wParam, LPARAM lParam);
   void PasteToConsoles();
+  void DumpLatency(wostream& os);
+  void DumpResources(wostream& os);
+  // adds the console resizes asked for and sent by the views
+  void AddResizeCounts(DWORD& dwRequests, DWORD& dwSent);
   void SendTextToConsoles(const wchar_t* pszText);
 
   inline bool IsGrouped() const { return m_boolIsGrouped; }
@@ -90,6 +100,7 @@ private:
   Mutex               m_viewsMutex;
   std::shared_ptr<TabData> m_tabData;
   CString             m_strTitle;
+  CString             m_strShownTitle;
   CIcon               m_bigIcon;
   CIcon               m_smallIcon;
   bool                m_boolIsGrouped;
@@ -0,0 +1,143 @@
+#include "stdafx.h"
+
+#include <chrono>
+
+#include "BackgroundTiles.h"
+#include "PixelKernels.h"
+#include "Check.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+// A 6000x4000 wallpaper stretched over three 4K monitors: the whole virtual
+// screen bitmap built up front, against tiles rendered as a 1200x800
+// window is dragged across two monitors.
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static double Elapsed(const chrono::steady_clock::time_point& start)
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+	const int nSrcWidth		= 6000;
+	const int nSrcHeight	= 4000;
+	const int nMonitors		= 3;
+	const int nWidth		= nMonitors * 3840;
+	const int nHeight		= 2160;
+
+	vector<unsigned char> src(static_cast<size_t>(nSrcWidth) * nSrcHeight * 4);
+	for (size_t i = 0; i < src.size(); i += 4097) src[i] = static_cast<unsigned char>(i);
+
+	TileSource source;
+
+	source.pPixels	= &src[0];
+	source.nPitch	= nSrcWidth * 4;
+	source.nWidth	= nSrcWidth;
+	source.nHeight	= nSrcHeight;
+
+	// the old way: one bitmap for the whole virtual screen
+	auto start = chrono::steady_clock::now();
+
+	vector<unsigned char> full(static_cast<size_t>(nWidth) * nHeight * 4);
+
+	{
+		vector<unsigned char> scaled(static_cast<size_t>(3840) * 2560 * 4);
+
+		Resampler::Resample(&src[0], nSrcWidth, nSrcHeight, nSrcWidth * 4, &scaled[0], 3840, 2560, 3840 * 4, Resampler::CancelCallback());
+
+		for (int m = 0; m < nMonitors; ++m)
+		{
+			for (int y = 0; y < nHeight; ++y)
+			{
+				::memcpy(&full[(static_cast<size_t>(y) * nWidth + m * 3840) * 4], &scaled[static_cast<size_t>(y + 200) * 3840 * 4], 3840 * 4);
+			}
+		}
+
+		PixelKernels::Tint(&full[0], nWidth * 4, nWidth, nHeight, 0x00FF0000, 40);
+	}
+
+	::printf("whole %dx%d bitmap: %zu MB, %.1f ms\n", nWidth, nHeight, full.size() >> 20, Elapsed(start));
+
+	// tiles
+	BackgroundTiles tiles(nWidth, nHeight, 0, 0x00FF0000, 40, 256);
+
+	size_t stSource = tiles.AddSource(source);
+
+	for (int m = 0; m < nMonitors; ++m)
+	{
+		TilePlacement placement;
+
+		placement.stSource		= stSource;
+		placement.nClipLeft		= m * 3840;
+		placement.nClipRight	= (m + 1) * 3840;
+		placement.nClipBottom	= nHeight;
+		placement.nLeft			= m * 3840;
+		placement.nTop			= -200;
+		placement.nWidth		= 3840;
+		placement.nHeight		= 2560;
+
+		tiles.AddPlacement(placement);
+	}
+
+	BackgroundTiles::PaintCallback noPaint([](const BackgroundTiles::Tile&) {});
+
+	int x = 500;
+	int y = 300;
+	int w = 1200;
+	int h = 800;
+
+	start = chrono::steady_clock::now();
+	tiles.Paint(x, y, x + w, y + h, noPaint);
+
+	::printf("first paint of a %dx%d window: %.2f ms, %zu tiles, %zu MB\n", w, h, Elapsed(start), tiles.GetStats().stTiles, tiles.GetStats().stBytes >> 20);
+
+	// dragged by 10 px steps, wobbling up and down
+	double			dWorst		= 0.0;
+	double			dTotal		= 0.0;
+	int				nMoves		= 0;
+	unsigned long	dwRenders	= tiles.GetStats().dwRenders;
+
+	for (; (x + w < 2 * 3840 + 1000) && (nMoves < 800); x += 10, y += (nMoves % 40 < 20) ? 2 : -2, ++nMoves)
+	{
+		start = chrono::steady_clock::now();
+		tiles.Paint(x, y, x + w, y + h, noPaint);
+
+		double dMove = Elapsed(start);
+
+		dTotal += dMove;
+		dWorst = max(dWorst, dMove);
+	}
+
+	BackgroundTilesStats stats(tiles.GetStats());
+
+	::printf(
+		"%d moves: avg %.3f ms, worst %.2f ms, %lu tiles rendered, %zu resident (%zu MB), %lu evicted\n",
+		nMoves,
+		dTotal / nMoves,
+		dWorst,
+		stats.dwRenders - dwRenders,
+		stats.stTiles,
+		stats.stBytes >> 20,
+		stats.dwEvictions);
+
+	CHECK(stats.stTiles <= 256);
+
+	start = chrono::steady_clock::now();
+	tiles.Paint(9000, 1000, 9000 + w, 1000 + h, noPaint);
+
+	::printf("jump to another monitor: %.2f ms\n", Elapsed(start));
+
+	return TEST_EXIT("BackgroundTilesBench");
+}
+
+//////////////////////////////////////////////////////////////////////////////
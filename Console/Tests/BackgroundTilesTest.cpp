@@ -0,0 +1,254 @@
+#include "stdafx.h"
+
+#include <cstdlib>
+
+#include "BackgroundTiles.h"
+#include "PixelKernels.h"
+#include "Check.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static vector<unsigned char> RandomPixels(int nWidth, int nHeight)
+{
+	vector<unsigned char> pixels(static_cast<size_t>(nWidth) * nHeight * 4);
+	for (size_t i = 0; i < pixels.size(); ++i) pixels[i] = static_cast<unsigned char>(::rand());
+	return pixels;
+}
+
+// the whole layout the way it was done before tiles: background color, the
+// scaled image copied in, clipped to the placement
+
+static void RenderFull(int nWidth, int nHeight, unsigned int dwBackground, const vector<unsigned char>& src, int nSrcWidth, int nSrcHeight, const TilePlacement& placement, vector<unsigned char>& pixels)
+{
+	pixels.assign(static_cast<size_t>(nWidth) * nHeight * 4, 0);
+	PixelKernels::Fill(&pixels[0], nWidth * 4, nWidth, nHeight, dwBackground);
+
+	vector<unsigned char> scaled(static_cast<size_t>(placement.nWidth) * placement.nHeight * 4);
+
+	Resampler::Resample(
+		&src[0], nSrcWidth, nSrcHeight, nSrcWidth * 4,
+		&scaled[0], placement.nWidth, placement.nHeight, placement.nWidth * 4,
+		Resampler::CancelCallback());
+
+	int nTop	= max(placement.nTop, placement.nClipTop);
+	int nBottom	= min(placement.nTop + placement.nHeight, placement.nClipBottom);
+	int nLeft	= max(placement.nLeft, placement.nClipLeft);
+	int nRight	= min(placement.nLeft + placement.nWidth, placement.nClipRight);
+
+	for (int y = nTop; y < nBottom; ++y)
+	{
+		::memcpy(
+			&pixels[(static_cast<size_t>(y) * nWidth + nLeft) * 4],
+			&scaled[(static_cast<size_t>(y - placement.nTop) * placement.nWidth + (nLeft - placement.nLeft)) * 4],
+			(nRight - nLeft) * 4);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// a scaled, cropped placement on the second of three monitors, from a
+// bottom-up source like a fipImage
+
+static void TestScaledPlacement()
+{
+	const int nSrcWidth		= 1500;
+	const int nSrcHeight	= 1000;
+	const int nWidth		= 3 * 1920 + 100;
+	const int nHeight		= 1200;
+
+	vector<unsigned char> src(RandomPixels(nSrcWidth, nSrcHeight));
+	vector<unsigned char> bottomUp(src.size());
+
+	for (int y = 0; y < nSrcHeight; ++y)
+	{
+		::memcpy(&bottomUp[static_cast<size_t>(nSrcHeight - 1 - y) * nSrcWidth * 4], &src[static_cast<size_t>(y) * nSrcWidth * 4], nSrcWidth * 4);
+	}
+
+	TileSource source;
+
+	source.pPixels	= &bottomUp[static_cast<size_t>(nSrcHeight - 1) * nSrcWidth * 4];
+	source.nPitch	= -nSrcWidth * 4;
+	source.nWidth	= nSrcWidth;
+	source.nHeight	= nSrcHeight;
+
+	BackgroundTiles tiles(nWidth, nHeight, 0x00102030, 0, 0, 1000);
+
+	TilePlacement placement;
+
+	placement.stSource		= tiles.AddSource(source);
+	placement.nClipLeft		= 1920;
+	placement.nClipRight	= 3840;
+	placement.nClipBottom	= 1200;
+	placement.nLeft			= 1920 + 60;
+	placement.nTop			= -50;
+	placement.nWidth		= 1800;
+	placement.nHeight		= 1300;
+
+	tiles.AddPlacement(placement);
+
+	vector<unsigned char> expected;
+	RenderFull(nWidth, nHeight, 0x00102030, src, nSrcWidth, nSrcHeight, placement, expected);
+
+	int nTiles		= 0;
+	int nMismatches	= 0;
+
+	tiles.Paint(0, 0, nWidth, nHeight, [&](const BackgroundTiles::Tile& tile)
+	{
+		++nTiles;
+
+		int nColumns = min<int>(BackgroundTiles::TILE_SIZE, nWidth - tile.nLeft);
+
+		for (int y = 0; (y < BackgroundTiles::TILE_SIZE) && (tile.nTop + y < nHeight); ++y)
+		{
+			if (::memcmp(
+					&tile.pixels[y * BackgroundTiles::TILE_SIZE * 4],
+					&expected[(static_cast<size_t>(tile.nTop + y) * nWidth + tile.nLeft) * 4],
+					nColumns * 4) != 0)
+			{
+				++nMismatches;
+			}
+		}
+	});
+
+	CHECK(nTiles == 23 * 5);
+	CHECK(nMismatches == 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// a tiled placement repeats the source from its origin in both directions
+
+static void TestTiledPlacement()
+{
+	const int nSrcWidth		= 300;
+	const int nSrcHeight	= 170;
+
+	vector<unsigned char> src(RandomPixels(nSrcWidth, nSrcHeight));
+
+	TileSource source;
+
+	source.pPixels	= &src[0];
+	source.nPitch	= nSrcWidth * 4;
+	source.nWidth	= nSrcWidth;
+	source.nHeight	= nSrcHeight;
+
+	BackgroundTiles tiles(1000, 700, 0, 0, 0, 100);
+
+	TilePlacement placement;
+
+	placement.stSource		= tiles.AddSource(source);
+	placement.bTile			= true;
+	placement.nClipRight	= 1000;
+	placement.nClipBottom	= 700;
+	placement.nLeft			= 1920;
+	placement.nTop			= -37;
+	placement.nWidth		= nSrcWidth;
+	placement.nHeight		= nSrcHeight;
+
+	tiles.AddPlacement(placement);
+
+	int nMismatches = 0;
+
+	tiles.Paint(0, 0, 1000, 700, [&](const BackgroundTiles::Tile& tile)
+	{
+		for (int y = 0; y < BackgroundTiles::TILE_SIZE; ++y)
+		{
+			for (int x = 0; x < BackgroundTiles::TILE_SIZE; ++x)
+			{
+				int nX = tile.nLeft + x;
+				int nY = tile.nTop + y;
+
+				if ((nX >= 1000) || (nY >= 700)) continue;
+
+				int nSrcX = ((nX - 1920) % nSrcWidth + nSrcWidth) % nSrcWidth;
+				int nSrcY = ((nY + 37) % nSrcHeight + nSrcHeight) % nSrcHeight;
+
+				if (::memcmp(&tile.pixels[(y * BackgroundTiles::TILE_SIZE + x) * 4], &src[(nSrcY * nSrcWidth + nSrcX) * 4], 4) != 0) ++nMismatches;
+			}
+		}
+	});
+
+	CHECK(nMismatches == 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// the tint goes over the background color
+
+static void TestTint()
+{
+	BackgroundTiles tiles(300, 300, 0x00FFFFFF, 0x00000000, 255, 10);
+
+	int nMismatches = 0;
+
+	tiles.Paint(0, 0, 300, 300, [&](const BackgroundTiles::Tile& tile)
+	{
+		for (size_t i = 0; i < tile.pixels.size(); i += 4)
+		{
+			if ((tile.pixels[i] != 0) || (tile.pixels[i + 1] != 0) || (tile.pixels[i + 2] != 0)) ++nMismatches;
+		}
+	});
+
+	CHECK(nMismatches == 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestEviction()
+{
+	BackgroundTiles tiles(2560, 2560, 0, 0, 0, 16);
+
+	// a 512x512 window moved right a tile at a time
+	for (int i = 0; i < 9; ++i) tiles.Paint(i * 256, 0, i * 256 + 512, 512, [](const BackgroundTiles::Tile&) {});
+
+	BackgroundTilesStats stats(tiles.GetStats());
+
+	CHECK(stats.stTiles == 16);
+	CHECK(stats.dwRenders == 20);
+	CHECK(stats.dwHits == 16);
+	CHECK(stats.dwEvictions == 4);
+
+	// repainting the same spot renders nothing
+	tiles.Paint(8 * 256, 0, 8 * 256 + 512, 512, [](const BackgroundTiles::Tile&) {});
+	CHECK(tiles.GetStats().dwRenders == 20);
+
+	// a paint larger than the maximum keeps all its tiles until the next one
+	tiles.Paint(0, 0, 2560, 512, [](const BackgroundTiles::Tile&) {});
+	CHECK(tiles.GetStats().stTiles == 20);
+
+	tiles.Clear();
+	CHECK(tiles.GetStats().stTiles == 0);
+	CHECK(tiles.GetStats().stBytes == 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+	TestScaledPlacement();
+	TestTiledPlacement();
+	TestTint();
+	TestEviction();
+
+	return TEST_EXIT("BackgroundTilesTest");
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,135 @@
+#include "stdafx.h"
+
+#include <chrono>
+
+#include "BandRenderer.h"
+#include "Check.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Full frames of random text, on one thread and on worker threads, opaque
+// and on glass. There's no GDI here to compare with; the one thread numbers
+// are what a worker thread count has to beat, and GDI has to be timed on
+// Windows (dumpviews) before render_threads is worth turning on.
+//
+// Threads past the machine's cores aren't started and small frames are one
+// band, so those rows should match the one thread numbers; the speedup
+// depends on the cores the bench runs on.
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static const int CELL_WIDTH		= 8;
+static const int CELL_HEIGHT	= 16;
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void Rasterize(wchar_t ch, bool bHigh, unsigned char* pCoverage)
+{
+	::memset(pCoverage, 0, CELL_WIDTH * 2 * CELL_HEIGHT);
+
+	if (ch == L' ') return;
+
+	int nLimit = bHigh ? CELL_WIDTH + 2 : CELL_WIDTH;
+
+	for (int y = 0; y < CELL_HEIGHT; ++y)
+	{
+		for (int x = 0; x < nLimit; ++x)
+		{
+			if ((x * 7 + y * 3 + ch) % 5 < 3) pCoverage[y * CELL_WIDTH * 2 + x] = static_cast<unsigned char>((x * 37 + y * 11 + ch) & 0xFF);
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void Time(int nColumns, int nRows, bool bPremultiplied)
+{
+	const int nWidth	= nColumns * CELL_WIDTH;
+	const int nHeight	= nRows * CELL_HEIGHT;
+
+	vector<BandRenderer::Cell>	cells(nColumns * nRows);
+	BandRenderer::Frame			frame;
+	GlyphAtlas					atlas;
+	unsigned int				dwSeed = 1;
+
+	for (size_t i = 0; i < cells.size(); ++i)
+	{
+		dwSeed = dwSeed * 1103515245 + 12345;
+
+		cells[i].ch				= static_cast<wchar_t>(L' ' + (dwSeed >> 16) % 95);
+		cells[i].wAttributes	= static_cast<unsigned short>((dwSeed >> 8) & 0xFF);
+	}
+
+	frame.pCells				= &cells[0];
+	frame.nColumns				= nColumns;
+	frame.nRows					= nRows;
+	frame.bIntensified			= true;
+	frame.bPremultiplied		= bPremultiplied;
+	frame.byBackgroundOpacity	= 200;
+
+	for (int i = 0; i < 16; ++i) frame.palette[i] = (i * 0x102030u) & 0xFFFFFF;
+
+	atlas.SetCellSize(CELL_WIDTH, CELL_HEIGHT);
+	BandRenderer::PrepareGlyphs(frame, atlas, Rasterize);
+
+	vector<unsigned int>	pixels(nWidth * nHeight);
+	PixelSurface			surface;
+
+	surface.nWidth	= nWidth;
+	surface.nHeight	= nHeight;
+	surface.nPitch	= -nWidth * 4;
+	surface.pPixels	= reinterpret_cast<unsigned char*>(&pixels[(nHeight - 1) * nWidth]);
+
+	double dSingle = 0;
+
+	for (size_t stThreads = 1; stThreads <= 4; stThreads *= 2)
+	{
+		BandRenderer	renderer(stThreads);
+		double			dBest = 1e9;
+
+		for (int i = 0; i < 10; ++i)
+		{
+			auto start = chrono::steady_clock::now();
+			renderer.Render(frame, atlas, surface);
+			dBest = min(dBest, chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+		}
+
+		if (stThreads == 1) dSingle = dBest;
+
+		::printf(
+			"%3dx%-3d %-6s  %zu thread%s (%zu running)  %2lu bands  %7.2f ms/frame  %4.2fx\n",
+			nColumns, nRows, bPremultiplied ? "glass" : "opaque", stThreads, (stThreads == 1) ? " " : "s", renderer.GetRunningThreads(),
+			renderer.GetBands() / renderer.GetFrames(), dBest, dSingle / dBest);
+
+		CHECK(renderer.GetFrames() == 10);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+	::printf("%u hardware threads\n", thread::hardware_concurrency());
+
+	Time(80, 25, false);
+	Time(120, 40, false);
+	Time(120, 40, true);
+	Time(250, 80, false);
+	Time(250, 80, true);
+
+	return TEST_EXIT("BandRendererBench");
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,345 @@
+#include "stdafx.h"
+
+#include "BandRenderer.h"
+#include "Check.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static const int CELL_WIDTH		= 8;
+static const int CELL_HEIGHT	= 16;
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// made up coverage, intensified glyphs overhang into the next cell
+static void Rasterize(wchar_t ch, bool bHigh, unsigned char* pCoverage)
+{
+	::memset(pCoverage, 0, CELL_WIDTH * 2 * CELL_HEIGHT);
+
+	if (ch == L' ') return;
+
+	int nLimit = bHigh ? CELL_WIDTH + 2 : CELL_WIDTH;
+
+	for (int y = 0; y < CELL_HEIGHT; ++y)
+	{
+		for (int x = 0; x < nLimit; ++x)
+		{
+			if ((x * 7 + y * 3 + ch) % 5 < 3) pCoverage[y * CELL_WIDTH * 2 + x] = static_cast<unsigned char>((x * 37 + y * 11 + ch) & 0xFF);
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// bottom-up, like the view's DIB sections
+class Surface
+{
+	public:
+
+		Surface(int nWidth, int nHeight, unsigned int dwFill)
+		: m_pixels(nWidth * nHeight, dwFill)
+		{
+			m_surface.nWidth	= nWidth;
+			m_surface.nHeight	= nHeight;
+			m_surface.nPitch	= -nWidth * 4;
+			m_surface.pPixels	= reinterpret_cast<unsigned char*>(&m_pixels[(nHeight - 1) * nWidth]);
+		}
+
+		const PixelSurface& Get() const { return m_surface; }
+		const vector<unsigned int>& GetPixels() const { return m_pixels; }
+
+		// top-down coordinates
+		unsigned int GetPixel(int x, int y) const { return m_pixels[(m_surface.nHeight - 1 - y) * m_surface.nWidth + x]; }
+
+	private:
+
+		vector<unsigned int>	m_pixels;
+		PixelSurface			m_surface;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void MakeFrame(BandRenderer::Frame& frame, vector<BandRenderer::Cell>& cells, int nColumns, int nRows)
+{
+	unsigned int dwSeed = 1;
+
+	cells.resize(nColumns * nRows);
+
+	for (size_t i = 0; i < cells.size(); ++i)
+	{
+		dwSeed = dwSeed * 1103515245 + 12345;
+
+		cells[i].ch				= static_cast<wchar_t>(L' ' + (dwSeed >> 16) % 95);
+		cells[i].wAttributes	= static_cast<unsigned short>((dwSeed >> 8) & 0xFF);
+
+		if ((i > 0) && ((dwSeed >> 24) % 50 == 0)) cells[i].wAttributes |= BandRenderer::ATTR_TRAILING_BYTE;
+	}
+
+	frame.pCells		= &cells[0];
+	frame.nColumns		= nColumns;
+	frame.nRows			= nRows;
+	frame.nX			= 2;
+	frame.nY			= 2;
+	frame.bIntensified	= true;
+
+	for (int i = 0; i < 16; ++i) frame.palette[i] = (i * 0x102030u) & 0xFFFFFF;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestThreads()
+{
+	// every thread count draws what one thread does
+	const int nColumns	= 120;
+	const int nRows		= 40;
+	const int nWidth	= nColumns * CELL_WIDTH + 4;
+	const int nHeight	= nRows * CELL_HEIGHT + 4;
+
+	vector<BandRenderer::Cell>	cells;
+	BandRenderer::Frame			frame;
+	GlyphAtlas					atlas;
+
+	MakeFrame(frame, cells, nColumns, nRows);
+	atlas.SetCellSize(CELL_WIDTH, CELL_HEIGHT);
+	BandRenderer::PrepareGlyphs(frame, atlas, Rasterize);
+
+	CHECK(atlas.Find(L' ', false) == NULL);
+	CHECK(atlas.Find(L'A', false) != NULL);
+
+	for (int nPremultiplied = 0; nPremultiplied < 2; ++nPremultiplied)
+	{
+		const unsigned int dwFill = nPremultiplied ? 0x80102030 : 0x00405060;
+
+		frame.bPremultiplied		= (nPremultiplied != 0);
+		frame.byBackgroundOpacity	= 200;
+
+		Surface reference(nWidth, nHeight, dwFill);
+
+		BandRenderer::RenderRows(frame, atlas, reference.Get(), 0, nRows);
+
+		for (size_t stThreads = 1; stThreads <= 8; stThreads *= 2)
+		{
+			// a core for each, so the bands are split on any machine
+			BandRenderer renderer(stThreads, stThreads);
+
+			for (int i = 0; i < 2; ++i)
+			{
+				Surface surface(nWidth, nHeight, dwFill);
+
+				renderer.Render(frame, atlas, surface.Get());
+				CHECK(surface.GetPixels() == reference.GetPixels());
+			}
+
+			CHECK(renderer.GetFrames() == 2);
+		}
+
+		// the border around the cells is left alone
+		CHECK(reference.GetPixel(0, 0) == dwFill);
+
+		// alpha is only touched on glass
+		if (!frame.bPremultiplied)
+		{
+			bool bAlpha = false;
+
+			for (size_t i = 0; i < reference.GetPixels().size(); ++i)
+			{
+				if ((reference.GetPixels()[i] >> 24) != 0) bAlpha = true;
+			}
+
+			CHECK(!bAlpha);
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestRowsAndClipping()
+{
+	const int nColumns	= 40;
+	const int nRows		= 20;
+	const int nWidth	= nColumns * CELL_WIDTH + 4;
+	const int nHeight	= nRows * CELL_HEIGHT + 4;
+
+	vector<BandRenderer::Cell>	cells;
+	BandRenderer::Frame			frame;
+	GlyphAtlas					atlas;
+	BandRenderer				renderer(4);
+
+	MakeFrame(frame, cells, nColumns, nRows);
+	atlas.SetCellSize(CELL_WIDTH, CELL_HEIGHT);
+	BandRenderer::PrepareGlyphs(frame, atlas, Rasterize);
+
+	// only the masked rows change
+	bool arrRows[nRows] = {};
+
+	arrRows[3]		= true;
+	arrRows[17]		= true;
+	frame.pRows		= arrRows;
+
+	Surface surface(nWidth, nHeight, 0x00405060);
+
+	renderer.Render(frame, atlas, surface.Get());
+
+	for (int y = 0; y < nHeight; ++y)
+	{
+		bool bChanged = false;
+
+		for (int x = 0; x < nWidth; ++x)
+		{
+			if (surface.GetPixel(x, y) != 0x00405060) bChanged = true;
+		}
+
+		int nRow = (y - 2) / CELL_HEIGHT;
+
+		CHECK(bChanged == ((y >= 2) && (y < nHeight - 2) && ((nRow == 3) || (nRow == 17))));
+	}
+
+	// a surface smaller than the cells, and cells starting off it
+	frame.pRows	= NULL;
+	frame.nX	= -5;
+	frame.nY	= -7;
+
+	Surface small(100, 50, 0);
+
+	renderer.Render(frame, atlas, small.Get());
+	CHECK(renderer.GetFrames() == 2);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestFallback()
+{
+	// one band unless there's a core per thread and enough cells
+	vector<BandRenderer::Cell>	cells;
+	BandRenderer::Frame			frame;
+	GlyphAtlas					atlas;
+
+	MakeFrame(frame, cells, 120, 40);
+	atlas.SetCellSize(CELL_WIDTH, CELL_HEIGHT);
+	BandRenderer::PrepareGlyphs(frame, atlas, Rasterize);
+
+	Surface surface(120 * CELL_WIDTH + 4, 40 * CELL_HEIGHT + 4, 0);
+
+	BandRenderer renderer(4, 4);
+
+	CHECK(renderer.GetRunningThreads() == 4);
+
+	renderer.Render(frame, atlas, surface.Get());
+	CHECK(renderer.GetBands() == 4 * BandRenderer::BANDS_PER_THREAD);
+
+	// 3 changed rows of the big frame
+	bool arrRows[40] = {};
+
+	arrRows[0]		= true;
+	arrRows[20]		= true;
+	arrRows[39]		= true;
+	frame.pRows		= arrRows;
+
+	renderer.Render(frame, atlas, surface.Get());
+	CHECK(renderer.GetBands() == 4 * BandRenderer::BANDS_PER_THREAD + 1);
+
+	// a small frame
+	frame.pRows		= NULL;
+	frame.nColumns	= 80;
+	frame.nRows		= 25;
+
+	renderer.Render(frame, atlas, surface.Get());
+	CHECK(renderer.GetBands() == 4 * BandRenderer::BANDS_PER_THREAD + 2);
+
+	// a single core starts no threads
+	BandRenderer single(4, 1);
+
+	frame.nColumns	= 120;
+	frame.nRows		= 40;
+
+	single.Render(frame, atlas, surface.Get());
+	CHECK(single.GetThreads() == 4);
+	CHECK(single.GetRunningThreads() == 1);
+	CHECK(single.GetBands() == 1);
+
+	// an unknown core count starts what's asked for
+	BandRenderer unknown(3, 0);
+
+	CHECK(unknown.GetRunningThreads() == 3);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestBlend()
+{
+	// a glyph drawn on black matches its coverage times the color
+	BandRenderer::Cell	cells[2] = { { L'A', 0x07 }, { L' ', 0x07 } };
+	BandRenderer::Frame	frame;
+	GlyphAtlas			atlas;
+
+	frame.pCells		= cells;
+	frame.nColumns		= 2;
+	frame.nRows			= 1;
+	frame.palette[7]	= 0xC0C0C0;
+
+	atlas.SetCellSize(CELL_WIDTH, CELL_HEIGHT);
+	BandRenderer::PrepareGlyphs(frame, atlas, Rasterize);
+
+	Surface surface(CELL_WIDTH * 2, CELL_HEIGHT, 0);
+
+	BandRenderer::RenderRows(frame, atlas, surface.Get(), 0, 1);
+
+	unsigned char arrCoverage[CELL_WIDTH * 2 * CELL_HEIGHT];
+
+	Rasterize(L'A', false, arrCoverage);
+
+	int nWrong = 0;
+
+	for (int y = 0; y < CELL_HEIGHT; ++y)
+	{
+		for (int x = 0; x < CELL_WIDTH * 2; ++x)
+		{
+			unsigned int dwValue = (0xC0 * arrCoverage[y * CELL_WIDTH * 2 + x] + 127) / 255;
+			unsigned int dwPixel = surface.GetPixel(x, y);
+
+			if (((dwPixel & 0xFF) != dwValue) || (((dwPixel >> 16) & 0xFF) != dwValue) || ((dwPixel >> 24) != 0)) ++nWrong;
+		}
+	}
+
+	CHECK(nWrong == 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+	TestThreads();
+	TestRowsAndClipping();
+	TestFallback();
+	TestBlend();
+
+	return TEST_EXIT("BandRendererTest");
+}
+
+//////////////////////////////////////////////////////////////////////////////
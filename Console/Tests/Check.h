@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdio>
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Checks for the tests: a failed check is reported with its location and
+// makes TEST_EXIT return non-zero.
+
+namespace Check
+{
+	inline int& Failures()
+	{
+		static int nFailures = 0;
+		return nFailures;
+	}
+
+	inline int& Checks()
+	{
+		static int nChecks = 0;
+		return nChecks;
+	}
+}
+
+#define CHECK(expr)																		\
+	do																					\
+	{																					\
+		++Check::Checks();																\
+		if (!(expr))																	\
+		{																				\
+			::fprintf(stderr, "%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #expr);	\
+			++Check::Failures();														\
+		}																				\
+	} while (0)
+
+#define TEST_EXIT(name)																	\
+	(::printf("%s: %d checks, %d failed\n", name, Check::Checks(), Check::Failures()),	\
+	 (Check::Failures() == 0) ? 0 : 1)
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,167 @@
+#include "stdafx.h"
+
+#include "FloodDetector.h"
+#include "Check.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// an 80x25 console window
+static const unsigned long CELLS = 80 * 25;
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestTyping()
+{
+	// a few cells every 100 ms for 10 s never floods
+	FloodDetector	detector;
+	unsigned int	nNow = 5000;
+
+	for (int i = 0; i < 100; ++i, nNow += 100)
+	{
+		detector.OnUpdate(3, CELLS, nNow);
+		CHECK(!detector.IsFlooded());
+		CHECK(detector.IsFrameDue(nNow));
+	}
+
+	CHECK(detector.GetFloods() == 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestBurst()
+{
+	// a screen clear and redraw, 200 ms of full screens, doesn't flood
+	FloodDetector	detector;
+	unsigned int	nNow = 5000;
+
+	for (int i = 0; i < 20; ++i, nNow += 10) detector.OnUpdate(CELLS, CELLS, nNow);
+	for (int i = 0; i < 50; ++i, nNow += 100) detector.OnTick(nNow);
+
+	CHECK(!detector.IsFlooded());
+	CHECK(detector.GetFloods() == 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestBigConsole()
+{
+	// full redraws of a 300x150 and a 400x300 console, 10 ms apart: more
+	// than 42949 cells each, past what 32 bits hold times 100000
+	const unsigned long arrCells[] = { 300 * 150, 400 * 300 };
+
+	for (int k = 0; k < 2; ++k)
+	{
+		FloodDetector	detector;
+		unsigned int	nNow = 5000;
+
+		for (int i = 0; i < 100; ++i, nNow += 10) detector.OnUpdate(arrCells[k], arrCells[k], nNow);
+
+		// 100 screens a second
+		CHECK(detector.GetRate() == 10000);
+		CHECK(detector.IsFlooded());
+
+		// half of one, as 50 screens a second
+		for (int i = 0; i < 100; ++i, nNow += 10) detector.OnUpdate(arrCells[k] / 2, arrCells[k], nNow);
+
+		CHECK(detector.GetRate() == 5000);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestFlood()
+{
+	// dir /s: a full screen every 10 ms, starting just before the tick
+	// counter wraps
+	FloodDetector	detector;
+	unsigned int	nNow		= 0xFFFFF000u;
+	unsigned int	nStart		= nNow;
+	unsigned int	nEntered	= 0;
+	int				nFrames		= 0;
+
+	for (int i = 0; i < 300; ++i, nNow += 10)
+	{
+		detector.OnUpdate(CELLS, CELLS, nNow);
+
+		if (detector.IsFlooded() && (nEntered == 0)) nEntered = nNow - nStart;
+
+		if (detector.IsFrameDue(nNow))
+		{
+			detector.OnFrame(nNow);
+			++nFrames;
+		}
+	}
+
+	::printf("dir /s: flood mode after %u ms, %d frames painted for 300 updates in 3 s (rate %lu%%/s)\n", nEntered, nFrames, detector.GetRate());
+
+	CHECK(detector.IsFlooded());
+	CHECK(nEntered >= FloodDetector::ENTER_TIME && nEntered <= FloodDetector::ENTER_TIME + 2 * FloodDetector::RATE_WINDOW);
+	CHECK(nFrames < 60);
+
+	// a 500 ms pause doesn't end it
+	for (int i = 0; i < 2; ++i)
+	{
+		nNow += 250;
+		detector.OnTick(nNow);
+	}
+
+	CHECK(detector.IsFlooded());
+
+	for (int i = 0; i < 30; ++i, nNow += 10) detector.OnUpdate(CELLS, CELLS, nNow);
+
+	// output stops, ticks end it after EXIT_TIME
+	unsigned int nStop = nNow;
+
+	while (detector.IsFlooded() && (nNow - nStop < 2000))
+	{
+		nNow += 250;
+		detector.OnTick(nNow);
+	}
+
+	::printf("flood mode left %u ms after the output stopped\n", nNow - nStop);
+
+	CHECK(!detector.IsFlooded());
+	CHECK(nNow - nStop >= FloodDetector::EXIT_TIME);
+
+	// a trickle under the exit rate doesn't bring it back
+	for (int i = 0; i < 100; ++i, nNow += 100)
+	{
+		detector.OnUpdate(CELLS / 20, CELLS, nNow);
+		CHECK(!detector.IsFlooded());
+	}
+
+	CHECK(detector.GetFloods() == 1);
+	CHECK(detector.IsFrameDue(nNow));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+	TestTyping();
+	TestBurst();
+	TestBigConsole();
+	TestFlood();
+
+	return TEST_EXIT("FloodDetectorTest");
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,73 @@
+#include "stdafx.h"
+
+#include <chrono>
+
+#include "FontCache.h"
+#include "Check.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Ctrl+wheel zooming back and forth over 8 sizes, each step getting the
+// normal and the intensified font the way ConsoleView::CreateFont does.
+// Only the first pass over the sizes creates fonts.
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static int g_nCreated = 0;
+
+static std::shared_ptr<FontCache::Font> CreateFakeFont(const FontCache::Key& key)
+{
+	++g_nCreated;
+
+	int nHeight = static_cast<int>(key.dwSize * key.dwDpi / 72);
+
+	return std::make_shared<FontCache::Font>(std::shared_ptr<void>(new int(0)), nHeight / 2, nHeight, nHeight * 3 / 4);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+	const int nSteps = 100000;
+
+	FontCache		cache(CreateFakeFont, FontCache::MAX_FONTS);
+	FontCache::Key	key;
+
+	key.strFace		= L"Consolas";
+	key.dwDpi		= 96;
+	key.dwQuality	= 5;
+
+	int nHeights = 0;
+
+	auto start = chrono::steady_clock::now();
+
+	for (int i = 0; i < nSteps; ++i)
+	{
+		// 8 up, 8 down
+		int nStep = i % 16;
+
+		key.dwSize		= 8 + ((nStep < 8) ? nStep : 15 - nStep) * 2;
+		key.dwWeight	= 0;
+		nHeights += cache.Get(key)->GetCharHeight();
+
+		key.dwWeight	= 700;
+		nHeights += cache.Get(key)->GetCharHeight();
+	}
+
+	double dMicroseconds = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+
+	::printf("%d zoom steps: %.3f us/step, %d fonts created, %lu hits\n", nSteps, dMicroseconds / nSteps, g_nCreated, cache.GetHits());
+
+	CHECK(g_nCreated == 16);
+	CHECK(nHeights > 0);
+
+	return TEST_EXIT("FontCacheBench");
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,207 @@
+#include "stdafx.h"
+
+#include "FontCache.h"
+#include "Check.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// makes fonts whose cell size comes from the key and whose handle counts
+// the fonts alive; faces named "bad" can't be created
+
+static int g_nCreated	= 0;
+static int g_nDeleted	= 0;
+
+static std::shared_ptr<FontCache::Font> CreateFakeFont(const FontCache::Key& key)
+{
+	if (key.strFace == L"bad") return std::shared_ptr<FontCache::Font>();
+
+	++g_nCreated;
+
+	std::shared_ptr<void> handle(new int(0), [](void* p) { ++g_nDeleted; delete static_cast<int*>(p); });
+
+	int nHeight = static_cast<int>(key.dwSize * key.dwDpi / 72);
+
+	return std::make_shared<FontCache::Font>(handle, nHeight / 2, nHeight, nHeight * 3 / 4);
+}
+
+static FontCache::Key MakeKey(const wchar_t* pszFace, unsigned long dwSize, bool bBold = false)
+{
+	FontCache::Key key;
+
+	key.strFace		= pszFace;
+	key.dwSize		= dwSize;
+	key.dwWeight	= bBold ? 700 : 0;
+	key.dwDpi		= 96;
+
+	return key;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestHits()
+{
+	FontCache cache(CreateFakeFont, 4);
+
+	std::shared_ptr<FontCache::Font> font = cache.Get(MakeKey(L"Consolas", 12));
+
+	CHECK(font);
+	CHECK(font->GetCharHeight() == 16);
+	CHECK(font->GetCharWidth() == 8);
+	CHECK(font->GetAscent() == 12);
+
+	// the same font, not created again; bold is another font
+	CHECK(cache.Get(MakeKey(L"Consolas", 12)) == font);
+	CHECK(cache.Get(MakeKey(L"Consolas", 12, true)) != font);
+
+	CHECK(cache.GetHits() == 1);
+	CHECK(cache.GetMisses() == 2);
+	CHECK(cache.GetSize() == 2);
+	CHECK(g_nCreated == 2);
+
+	cache.Clear();
+	font.reset();
+
+	CHECK(cache.GetSize() == 0);
+	CHECK(g_nDeleted == g_nCreated);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestLru()
+{
+	g_nCreated = g_nDeleted = 0;
+
+	FontCache cache(CreateFakeFont, 3);
+
+	cache.Get(MakeKey(L"Consolas", 10));
+	cache.Get(MakeKey(L"Consolas", 11));
+	cache.Get(MakeKey(L"Consolas", 12));
+
+	// using 10 again makes 11 the least recently used one
+	cache.Get(MakeKey(L"Consolas", 10));
+	cache.Get(MakeKey(L"Consolas", 13));
+
+	CHECK(cache.GetSize() == 3);
+	CHECK(cache.GetEvictions() == 1);
+	CHECK(g_nDeleted == 1);
+
+	cache.Get(MakeKey(L"Consolas", 10));
+	cache.Get(MakeKey(L"Consolas", 12));
+	CHECK(g_nCreated == 4);
+
+	cache.Get(MakeKey(L"Consolas", 11));
+	CHECK(g_nCreated == 5);
+	CHECK(cache.GetEvictions() == 2);
+
+	// 13 was the oldest then
+	cache.Get(MakeKey(L"Consolas", 10));
+	cache.Get(MakeKey(L"Consolas", 12));
+	CHECK(g_nCreated == 5);
+
+	cache.Get(MakeKey(L"Consolas", 13));
+	CHECK(g_nCreated == 6);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestHeldFonts()
+{
+	g_nCreated = g_nDeleted = 0;
+
+	FontCache cache(CreateFakeFont, 2);
+
+	// a view still drawing with a dropped font keeps it
+	std::shared_ptr<FontCache::Font> font = cache.Get(MakeKey(L"Consolas", 10));
+
+	void* pHandle = font->GetHandle();
+
+	cache.Get(MakeKey(L"Consolas", 11));
+	cache.Get(MakeKey(L"Consolas", 12));
+
+	CHECK(cache.GetEvictions() == 1);
+	CHECK(g_nDeleted == 0);
+	CHECK(font->GetHandle() == pHandle);
+
+	font.reset();
+	CHECK(g_nDeleted == 1);
+
+	// and gets a new one the next time
+	font = cache.Get(MakeKey(L"Consolas", 10));
+	CHECK(g_nCreated == 4);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestFailures()
+{
+	g_nCreated = g_nDeleted = 0;
+
+	FontCache cache(CreateFakeFont, 4);
+
+	// not cached, the next try creates it again
+	CHECK(!cache.Get(MakeKey(L"bad", 10)));
+	CHECK(!cache.Get(MakeKey(L"bad", 10)));
+
+	CHECK(cache.GetSize() == 0);
+	CHECK(cache.GetMisses() == 2);
+	CHECK(cache.GetHits() == 0);
+	CHECK(cache.GetEvictions() == 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestKeys()
+{
+	FontCache::Key key = MakeKey(L"Consolas", 12);
+
+	// every attribute tells fonts apart
+	FontCache::Key arrKeys[7] = { key, key, key, key, key, key, key };
+
+	arrKeys[0].strFace		= L"Lucida Console";
+	arrKeys[1].dwSize		= 13;
+	arrKeys[2].dwWeight		= 700;
+	arrKeys[3].bItalic		= true;
+	arrKeys[4].dwDpi		= 144;
+	arrKeys[5].dwQuality	= 5;
+	arrKeys[6].dwScale		= 96;
+
+	for (int i = 0; i < 7; ++i) CHECK((key < arrKeys[i]) != (arrKeys[i] < key));
+
+	CHECK(!(key < key));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+	TestHits();
+	TestLru();
+	TestHeldFonts();
+	TestFailures();
+	TestKeys();
+
+	return TEST_EXIT("FontCacheTest");
+}
+
+//////////////////////////////////////////////////////////////////////////////
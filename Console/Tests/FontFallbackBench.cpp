@@ -0,0 +1,117 @@
+#include "stdafx.h"
+
+#include <chrono>
+
+#include "FontFallback.h"
+#include "Check.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+// A 250x80 screen of ASCII, CJK and both mixed, split into font runs and
+// turned into glyph indices a row at a time, the way AddTextRun does it
+// every frame. And how long a CJK font's coverage map takes to build.
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static std::shared_ptr<FontCache::Font> MakeFont()
+{
+	return std::make_shared<FontCache::Font>(std::shared_ptr<void>(), 8, 16, 13);
+}
+
+static void LoadGlyphs(wchar_t chFirst, int nCount, unsigned short* pwGlyphs)
+{
+	for (int i = 0; i < nCount; ++i) pwGlyphs[i] = static_cast<unsigned short>(chFirst + i);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+	const int	nColumns	= 250;
+	const int	nRows		= 80;
+	const int	nFrames		= 200;
+
+	CoverageMap latin;
+	CoverageMap cjk;
+
+	latin.AddRange(0x20, 0x5F);
+	latin.AddRange(0xA0, 0x180);
+	cjk.AddRange(0x20, 0x5F);
+	cjk.AddRange(0x3000, 0x100);
+	cjk.AddRange(0x4E00, 0x5200);
+
+	static const char*	arrNames[] = { "ascii", "cjk", "mixed" };
+	unsigned int		dwSeed = 7;
+
+	for (int nKind = 0; nKind < 3; ++nKind)
+	{
+		vector<wchar_t> screen(nColumns * nRows);
+
+		for (size_t i = 0; i < screen.size(); ++i)
+		{
+			dwSeed = dwSeed * 1103515245 + 12345;
+
+			wchar_t chAscii	= static_cast<wchar_t>(0x21 + (dwSeed >> 16) % 94);
+			wchar_t chCjk	= static_cast<wchar_t>(0x4E00 + (dwSeed >> 12) % 0x5200);
+
+			screen[i] = (nKind == 0) ? chAscii : (nKind == 1) ? chCjk : (((dwSeed >> 28) & 1) ? chAscii : chCjk);
+		}
+
+		FontFallback			fallback;
+		FontFallback::Runs		runs;
+		vector<unsigned short>	glyphs(nColumns);
+		size_t					stRuns = 0;
+
+		fallback.AddFont(MakeFont(), latin, LoadGlyphs);
+		fallback.AddFont(MakeFont(), cjk, LoadGlyphs);
+
+		auto start = chrono::steady_clock::now();
+
+		for (int nFrame = 0; nFrame < nFrames; ++nFrame)
+		{
+			for (int nRow = 0; nRow < nRows; ++nRow)
+			{
+				const wchar_t* pszRow = &screen[nRow * nColumns];
+
+				fallback.SplitRuns(pszRow, nColumns, runs);
+				stRuns += runs.size();
+
+				for (size_t i = 0; i < runs.size(); ++i)
+				{
+					if (runs[i].nFont != FontFallback::NO_FONT) fallback.GetGlyphs(runs[i].nFont, pszRow + runs[i].nStart, runs[i].nCount, &glyphs[0]);
+				}
+			}
+		}
+
+		double dMicroseconds = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / nFrames;
+
+		::printf("%-6s %7.1f us/frame  %6.1f runs/row\n", arrNames[nKind], dMicroseconds, static_cast<double>(stRuns) / nFrames / nRows);
+
+		CHECK(stRuns >= static_cast<size_t>(nFrames * nRows));
+	}
+
+	// a CJK font's worth of ranges
+	auto	start	= chrono::steady_clock::now();
+	size_t	stBytes	= 0;
+
+	for (int i = 0; i < 1000; ++i)
+	{
+		CoverageMap coverage;
+
+		for (unsigned long dwChar = 0x20; dwChar < 0xFFF0; dwChar += 40) coverage.AddRange(dwChar, 37);
+
+		stBytes = coverage.GetBytes();
+	}
+
+	::printf("coverage map of 1600 ranges: %.1f us, %zu bytes\n", chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / 1000, stBytes);
+
+	return TEST_EXIT("FontFallbackBench");
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,208 @@
+#include "stdafx.h"
+
+#include <set>
+
+#include "FontFallback.h"
+#include "Check.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static int g_nGlyphLoads = 0;
+
+static std::shared_ptr<FontCache::Font> MakeFont(int nAscent)
+{
+	return std::make_shared<FontCache::Font>(std::shared_ptr<void>(), 8, 16, nAscent);
+}
+
+// glyph indices made up from the character, wBase tells the fonts apart
+static FontFallback::GlyphLoader MakeLoader(unsigned short wBase)
+{
+	return [wBase](wchar_t chFirst, int nCount, unsigned short* pwGlyphs)
+	{
+		++g_nGlyphLoads;
+		for (int i = 0; i < nCount; ++i) pwGlyphs[i] = static_cast<unsigned short>(wBase + ((chFirst + i) & 0xFFF));
+	};
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestCoverage()
+{
+	// random ranges against a set of the characters in them
+	CoverageMap				coverage;
+	std::set<unsigned long>	chars;
+	unsigned int			dwSeed = 7;
+
+	for (int i = 0; i < 500; ++i)
+	{
+		dwSeed = dwSeed * 1103515245 + 12345;
+
+		unsigned long dwFirst = (dwSeed >> 8) % 0x10000;
+		unsigned long dwCount = (dwSeed >> 4) % 700;
+
+		coverage.AddRange(dwFirst, dwCount);
+
+		for (unsigned long dwChar = dwFirst; (dwChar < dwFirst + dwCount) && (dwChar < 0x10000); ++dwChar) chars.insert(dwChar);
+	}
+
+	// past the BMP, and across its end
+	coverage.AddRange(0x1F600, 10);
+	coverage.AddRange(0xFFF0, 100);
+
+	for (unsigned long dwChar = 0xFFF0; dwChar < 0x10000; ++dwChar) chars.insert(dwChar);
+
+	int nWrong = 0;
+
+	for (unsigned long dwChar = 0; dwChar < 0x10000; ++dwChar)
+	{
+		if (coverage.Contains(static_cast<wchar_t>(dwChar)) != (chars.count(dwChar) != 0)) ++nWrong;
+	}
+
+	CHECK(nWrong == 0);
+	CHECK(!coverage.Contains(static_cast<wchar_t>(0x1F600)));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestResolve()
+{
+	// a latin text font, a CJK and a symbol fallback font
+	CoverageMap latin;
+	CoverageMap cjk;
+	CoverageMap symbols;
+
+	latin.AddRange(0x20, 0x5F);
+	latin.AddRange(0xA0, 0x180);
+	latin.AddRange(0x2500, 0x80);
+	cjk.AddRange(0x20, 0x5F);
+	cjk.AddRange(0x3000, 0x100);
+	cjk.AddRange(0x4E00, 0x5200);
+	cjk.AddRange(0xFF00, 0xF0);
+	symbols.AddRange(0x2500, 0x80);
+	symbols.AddRange(0x2600, 0x100);
+
+	FontFallback fallback;
+
+	fallback.AddFont(MakeFont(13), latin, MakeLoader(0));
+	fallback.AddFont(MakeFont(11), cjk, MakeLoader(0x1000));
+	fallback.AddFont(MakeFont(15), symbols, MakeLoader(0x2000));
+
+	// the first font that has it
+	CHECK(fallback.Resolve(L'A') == 0);
+	CHECK(fallback.Resolve(0x4E2D) == 1);
+	CHECK(fallback.Resolve(0x2603) == 2);
+	CHECK(fallback.Resolve(0x2550) == 0);
+	CHECK(fallback.Resolve(0xAC00) == FontFallback::NO_FONT);
+	CHECK(fallback.Resolve(0xD83D) == FontFallback::NO_FONT);
+	CHECK(fallback.GetResolvedPages() == 6);
+
+	// runs of the same font
+	const wchar_t	arrText[] = { L'a', L'b', 0x4E2D, 0x6587, L' ', 0x2603, 0xAC00, 0xAC01, L'z' };
+	FontFallback::Runs runs;
+
+	fallback.SplitRuns(arrText, 9, runs);
+
+	CHECK(runs.size() == 6);
+	if (runs.size() == 6)
+	{
+		CHECK((runs[0].nStart == 0) && (runs[0].nCount == 2) && (runs[0].nFont == 0));
+		CHECK((runs[1].nStart == 2) && (runs[1].nCount == 2) && (runs[1].nFont == 1));
+		CHECK((runs[2].nStart == 4) && (runs[2].nFont == 0));
+		CHECK((runs[3].nStart == 5) && (runs[3].nFont == 2));
+		CHECK((runs[4].nStart == 6) && (runs[4].nCount == 2) && (runs[4].nFont == FontFallback::NO_FONT));
+		CHECK((runs[5].nStart == 8) && (runs[5].nFont == 0));
+	}
+
+	// glyphs are loaded a page at a time
+	unsigned short arrGlyphs[2];
+
+	g_nGlyphLoads = 0;
+	fallback.GetGlyphs(1, arrText + 2, 2, arrGlyphs);
+
+	CHECK(arrGlyphs[0] == 0x1000 + (0x4E2D & 0xFFF));
+	CHECK(arrGlyphs[1] == 0x1000 + (0x6587 & 0xFFF));
+	CHECK(g_nGlyphLoads == 2);
+
+	fallback.GetGlyphs(1, arrText + 2, 2, arrGlyphs);
+	CHECK(g_nGlyphLoads == 2);
+
+	// fallback glyphs are moved onto the text font's baseline
+	CHECK(fallback.GetBaselineOffset(0) == 0);
+	CHECK(fallback.GetBaselineOffset(1) == 2);
+	CHECK(fallback.GetBaselineOffset(2) == -2);
+
+	// a new font resolves again
+	CoverageMap hangul;
+
+	hangul.AddRange(0xAC00, 11172);
+	fallback.AddFont(MakeFont(13), hangul, MakeLoader(0x3000));
+
+	CHECK(fallback.GetResolvedPages() == 0);
+	CHECK(fallback.Resolve(0xAC00) == 3);
+	CHECK(fallback.Resolve(L'A') == 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestParseLink()
+{
+	wstring			strFace;
+	unsigned long	dwScale = 0;
+
+	CHECK(FontFallback::ParseLink(L"MSGOTHIC.TTC,MS UI Gothic", strFace, dwScale));
+	CHECK(strFace == L"MS UI Gothic");
+	CHECK(dwScale == FontCache::SCALE_NONE);
+
+	CHECK(FontFallback::ParseLink(L"MEIRYO.TTC,Meiryo,128,96", strFace, dwScale));
+	CHECK(strFace == L"Meiryo");
+	CHECK(dwScale == 128);
+
+	CHECK(FontFallback::ParseLink(L"SIMSUN.TTC,SimSun,115,96", strFace, dwScale));
+	CHECK(strFace == L"SimSun");
+	CHECK(dwScale == 115);
+
+	// a broken factor is left out
+	CHECK(FontFallback::ParseLink(L"MINGLIU.TTC,PMingLiU,0,96", strFace, dwScale));
+	CHECK(dwScale == FontCache::SCALE_NONE);
+
+	// no face name
+	CHECK(!FontFallback::ParseLink(L"SEGUISYM.TTF", strFace, dwScale));
+	CHECK(!FontFallback::ParseLink(L"SEGUISYM.TTF,", strFace, dwScale));
+
+	// scaled links are other fonts in the cache
+	FontCache::Key key;
+	FontCache::Key keyScaled;
+
+	keyScaled.dwScale = 115;
+
+	CHECK(keyScaled < key);
+	CHECK(!(key < keyScaled));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+	TestCoverage();
+	TestResolve();
+	TestParseLink();
+
+	return TEST_EXIT("FontFallbackTest");
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,200 @@
+#include "stdafx.h"
+
+#include "ImageCache.h"
+#include "Check.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+// the cache only holds and counts images, it never looks inside them
+class fipImage
+{
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// every image decodes to 10 bytes, "missing" fails to load
+
+class FakeLoader
+{
+	public:
+
+		FakeLoader() : nLoads(0) {}
+
+		ImageCache::Loader Get()
+		{
+			return [this](const wstring& strFilename, size_t& stBytes)
+			{
+				++nLoads;
+				stBytes = 10;
+
+				if (strFilename == L"missing") return std::shared_ptr<fipImage>();
+				return std::shared_ptr<fipImage>(new fipImage());
+			};
+		}
+
+	public:
+
+		int nLoads;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestShared()
+{
+	FakeLoader	loader;
+	ImageCache	cache(loader.Get(), 100);
+
+	std::shared_ptr<ImageCacheEntry> a(cache.GetEntry(L"a"));
+	std::shared_ptr<ImageCacheEntry> a2(cache.GetEntry(L"a"));
+
+	CHECK(a == a2);
+
+	std::shared_ptr<fipImage> image(cache.GetImage(a));
+
+	CHECK(image == cache.GetImage(a2));
+	CHECK(loader.nLoads == 1);
+	CHECK(cache.GetStats().dwLoads == 1);
+	CHECK(cache.GetStats().dwHits == 1);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// over budget, the least recently used decode goes first, but never one
+// in use or the most recent one
+
+static void TestEviction()
+{
+	FakeLoader	loader;
+	ImageCache	cache(loader.Get(), 25);
+
+	std::shared_ptr<ImageCacheEntry> a(cache.GetEntry(L"a"));
+	std::shared_ptr<ImageCacheEntry> b(cache.GetEntry(L"b"));
+	std::shared_ptr<ImageCacheEntry> c(cache.GetEntry(L"c"));
+
+	cache.GetImage(b);
+
+	std::shared_ptr<fipImage> pinnedA(cache.GetImage(a));
+
+	// 30 bytes: b is the least recently used one not in use
+	cache.GetImage(c);
+
+	CHECK(cache.GetStats().stBytes == 20);
+	CHECK(!b->image && a->image && c->image);
+
+	// b comes back from disk, c goes
+	cache.GetImage(b);
+
+	CHECK(loader.nLoads == 4);
+	CHECK(!c->image && a->image && b->image);
+	CHECK(cache.GetStats().dwEvictions == 2);
+
+	// a is in use, b the most recent: both stay over budget
+	cache.SetBudget(5);
+
+	CHECK(a->image && b->image);
+	CHECK(cache.GetStats().stBytes == 20);
+
+	pinnedA.reset();
+	cache.Trim();
+
+	CHECK(!a->image && b->image);
+	CHECK(cache.GetStats().stBytes == 10);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestFailures()
+{
+	FakeLoader	loader;
+	ImageCache	cache(loader.Get(), 100);
+
+	std::shared_ptr<ImageCacheEntry> missing(cache.GetEntry(L"missing"));
+
+	CHECK(!cache.GetImage(missing));
+	CHECK(missing->bFailed);
+
+	// not retried until invalidated
+	CHECK(!cache.GetImage(missing));
+	CHECK(loader.nLoads == 1);
+
+	cache.Invalidate(missing);
+	CHECK(!missing->bFailed);
+	CHECK(!cache.GetImage(missing));
+	CHECK(loader.nLoads == 2);
+
+	// a decode that failed on a worker thread
+	std::shared_ptr<ImageCacheEntry> c(cache.GetEntry(L"c"));
+
+	cache.SetImage(c, std::shared_ptr<fipImage>(), 0);
+	CHECK(c->bFailed);
+	CHECK(!cache.GetImage(c));
+
+	cache.SetImage(c, std::shared_ptr<fipImage>(new fipImage()), 10);
+	CHECK(!c->bFailed);
+	CHECK(cache.GetImage(c));
+	CHECK(loader.nLoads == 2);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestUnusedEntriesRemoved()
+{
+	FakeLoader	loader;
+	ImageCache	cache(loader.Get(), 100);
+
+	std::shared_ptr<ImageCacheEntry> a(cache.GetEntry(L"a"));
+	std::shared_ptr<ImageCacheEntry> a2(cache.GetEntry(L"a"));
+	std::shared_ptr<ImageCacheEntry> b(cache.GetEntry(L"b"));
+
+	cache.GetImage(a);
+	cache.GetImage(b);
+
+	b.reset();
+	cache.Trim();
+
+	CHECK(cache.GetStats().stEntries == 1);
+	CHECK(cache.GetStats().stBytes == 10);
+
+	a.reset();
+	cache.Trim();
+
+	CHECK(cache.GetStats().stEntries == 1);
+
+	a2.reset();
+	cache.Trim();
+
+	CHECK(cache.GetStats().stEntries == 0);
+	CHECK(cache.GetStats().stBytes == 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+	TestShared();
+	TestEviction();
+	TestFailures();
+	TestUnusedEntriesRemoved();
+
+	return TEST_EXIT("ImageCacheTest");
+}
+
+//////////////////////////////////////////////////////////////////////////////
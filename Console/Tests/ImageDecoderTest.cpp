@@ -0,0 +1,217 @@
+#include "stdafx.h"
+
+#include <atomic>
+#include <chrono>
+
+#include "ImageDecoder.h"
+#include "Check.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+class fipImage
+{
+	public:
+
+		explicit fipImage(const wstring& strFilename) : strFilename(strFilename) {}
+
+		wstring strFilename;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Decoder that holds its worker until opened, and records the order files
+// were decoded in. "bad" fails to decode.
+
+class GatedDecoder
+{
+	public:
+
+		GatedDecoder()
+		: bOpen(false)
+		, nWaiting(0)
+		{
+		}
+
+		ImageDecoder::Decoder Get()
+		{
+			return [this](const wstring& strFilename, size_t& stBytes)
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+
+				++nWaiting;
+				condition.notify_all();
+				while (!bOpen) condition.wait(lock);
+				--nWaiting;
+
+				order.push_back(strFilename);
+				stBytes = 4;
+
+				if (strFilename == L"bad") return std::shared_ptr<fipImage>();
+				return std::shared_ptr<fipImage>(new fipImage(strFilename));
+			};
+		}
+
+		void WaitForWorker()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (nWaiting == 0) condition.wait(lock);
+		}
+
+		void Open()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			bOpen = true;
+			condition.notify_all();
+		}
+
+	public:
+
+		std::mutex				mutex;
+		std::condition_variable	condition;
+		bool					bOpen;
+		int						nWaiting;
+		vector<wstring>			order;
+};
+
+// collects results until there are nCount of them, or gives up after 5 s
+
+static void WaitForResults(ImageDecoder& decoder, size_t stCount, ImageDecoder::Results& results)
+{
+	for (int i = 0; (i < 1000) && (results.size() < stCount); ++i)
+	{
+		ImageDecoder::Results newResults;
+		decoder.GetResults(newResults);
+
+		results.insert(results.end(), newResults.begin(), newResults.end());
+
+		if (results.size() < stCount) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestPriorities()
+{
+	GatedDecoder		gatedDecoder;
+	std::atomic<int>	nNotifies(0);
+
+	ImageDecoder decoder(gatedDecoder.Get(), [&nNotifies]() { ++nNotifies; }, 1);
+
+	// the only worker takes this one and waits at the gate
+	decoder.Request(L"first", ImageDecoder::priorityBackground);
+	gatedDecoder.WaitForWorker();
+
+	decoder.Request(L"bg1", ImageDecoder::priorityBackground);
+	decoder.Request(L"bg2", ImageDecoder::priorityBackground);
+	decoder.Request(L"bad", ImageDecoder::priorityBackground);
+	decoder.Request(L"vis", ImageDecoder::priorityVisible);
+	// raised, and older than vis
+	decoder.Request(L"bg2", ImageDecoder::priorityVisible);
+	// running, not queued again
+	decoder.Request(L"first", ImageDecoder::priorityVisible);
+
+	CHECK(decoder.IsPending(L"first"));
+	CHECK(decoder.IsPending(L"bg1"));
+	CHECK(!decoder.IsPending(L"other"));
+
+	gatedDecoder.Open();
+
+	ImageDecoder::Results results;
+	WaitForResults(decoder, 5, results);
+
+	CHECK(results.size() == 5);
+
+	const wchar_t* arrExpected[] = { L"first", L"bg2", L"vis", L"bg1", L"bad" };
+
+	{
+		std::lock_guard<std::mutex> lock(gatedDecoder.mutex);
+
+		CHECK(gatedDecoder.order.size() == 5);
+		for (size_t i = 0; (i < 5) && (i < gatedDecoder.order.size()); ++i) CHECK(gatedDecoder.order[i] == arrExpected[i]);
+	}
+
+	for (auto it = results.begin(); it != results.end(); ++it)
+	{
+		if (it->strFilename == L"bad")
+		{
+			CHECK(!it->image);
+		}
+		else
+		{
+			CHECK(it->image && (it->image->strFilename == it->strFilename));
+			CHECK(it->stBytes == 4);
+		}
+	}
+
+	CHECK(!decoder.IsPending(L"bg1"));
+
+	// results taken, the next decode notifies again
+	int nNotifiesBefore = nNotifies;
+
+	decoder.Request(L"again", ImageDecoder::priorityBackground);
+
+	results.clear();
+	WaitForResults(decoder, 1, results);
+
+	CHECK(results.size() == 1);
+	CHECK(nNotifies == nNotifiesBefore + 1);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// repeated requests for the same file are decoded once while pending, and
+// the destructor drops queued work
+
+static void TestPool()
+{
+	std::atomic<int> nDecodes(0);
+
+	{
+		ImageDecoder decoder(
+						[&nDecodes](const wstring& strFilename, size_t& stBytes)
+						{
+							++nDecodes;
+							stBytes = 1;
+							return std::shared_ptr<fipImage>(new fipImage(strFilename));
+						},
+						[]() {},
+						4);
+
+		for (int i = 0; i < 1000; ++i) decoder.Request(std::to_wstring(i % 300), ImageDecoder::priorityBackground);
+
+		ImageDecoder::Results results;
+		WaitForResults(decoder, 300, results);
+
+		CHECK(results.size() == 300);
+		CHECK(nDecodes == 300);
+
+		for (int i = 0; i < 50; ++i) decoder.Request(L"late" + std::to_wstring(i), ImageDecoder::priorityBackground);
+	}
+
+	CHECK(nDecodes <= 350);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+	TestPriorities();
+	TestPool();
+
+	return TEST_EXIT("ImageDecoderTest");
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,261 @@
+#include "stdafx.h"
+
+#include <chrono>
+#include <thread>
+
+#include "../../shared/InputEventQueue.h"
+#include "Check.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Console pushes under the shared memory mutex and the hook pops under it;
+// a std::mutex stands in for that here.
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+struct TestEvent
+{
+	unsigned int	nProducer;
+	// per producer
+	unsigned int	nSequence;
+	// across producers, stamped under the lock
+	unsigned int	nOrder;
+	unsigned int	nButtons;
+	bool			bMove;
+};
+
+// like MouseEventTraits: moves with the same buttons coalesce, from the same
+// producer so each one's sequence can be followed
+
+struct TestEventTraits
+{
+	static bool CanCoalesce(const TestEvent& tail, const TestEvent& event)
+	{
+		return tail.bMove && event.bMove && (tail.nButtons == event.nButtons) && (tail.nProducer == event.nProducer);
+	}
+
+	static bool CanDrop(const TestEvent& event)
+	{
+		return event.bMove;
+	}
+};
+
+typedef InputEventQueue<TestEvent, TestEventTraits, 64>	TestEventQueue;
+
+static TestEvent MakeEvent(unsigned int nSequence, bool bMove, unsigned int nButtons = 0)
+{
+	TestEvent event = { 0, nSequence, 0, nButtons, bMove };
+	return event;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestCoalesceAndDrop()
+{
+	TestEvent events[TestEventQueue::CAPACITY];
+
+	// zeroed shared memory is an empty queue
+	unsigned char memory[sizeof(TestEventQueue)] = {};
+	CHECK(reinterpret_cast<TestEventQueue*>(memory)->Pop(events, 1) == 0);
+
+	TestEventQueue queue;
+
+	queue.Push(MakeEvent(0, true));
+	queue.Push(MakeEvent(1, true));
+	CHECK((queue.nCount == 1) && (queue.nCoalesced == 1));
+
+	// a click in between stops coalescing, so do different buttons
+	queue.Push(MakeEvent(2, false, 1));
+	queue.Push(MakeEvent(3, true));
+	queue.Push(MakeEvent(4, true, 1));
+
+	CHECK(queue.Pop(events, TestEventQueue::CAPACITY) == 4);
+	CHECK((events[0].nSequence == 1) && (events[1].nSequence == 2) && (events[3].nSequence == 4));
+
+	// full of clicks: new ones are dropped
+	for (unsigned int i = 0; i < 70; ++i) queue.Push(MakeEvent(i, false));
+	CHECK((queue.nCount == 64) && (queue.nDropped == 6));
+
+	// wraps around
+	CHECK(queue.Pop(events, 10) == 10);
+	CHECK(events[0].nSequence == 0);
+
+	for (unsigned int i = 0; i < 10; ++i) CHECK(queue.Push(MakeEvent(100 + i, false)));
+
+	CHECK(queue.Pop(events, TestEventQueue::CAPACITY) == 64);
+	CHECK((events[53].nSequence == 63) && (events[54].nSequence == 100) && (events[63].nSequence == 109));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// a hook that doesn't read: clicks survive, moves make room, the newest
+// move is kept
+
+static void TestStalled()
+{
+	TestEventQueue	queue;
+	unsigned int	nClicks		= 0;
+	unsigned int	nRejected	= 0;
+
+	for (unsigned int i = 0; i < 100000; ++i)
+	{
+		bool bMove = (i % 3001) != 0;
+
+		if (!bMove) ++nClicks;
+		if (!queue.Push(MakeEvent(i, bMove, (i / 7) & 1))) ++nRejected;
+	}
+
+	CHECK(nRejected == 0);
+
+	TestEvent		events[TestEventQueue::CAPACITY];
+	unsigned int	nCount		= queue.Pop(events, TestEventQueue::CAPACITY);
+	unsigned int	nGotClicks	= 0;
+
+	for (unsigned int i = 0; i < nCount; ++i)
+	{
+		if (!events[i].bMove) ++nGotClicks;
+		if (i > 0) CHECK(events[i].nSequence > events[i - 1].nSequence);
+	}
+
+	CHECK(nGotClicks == nClicks);
+	CHECK(events[nCount - 1].nSequence == 99999);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Several producers and a consumer draining in batches, stalling now and
+// then so the queue fills up. Events come out in the order they went in,
+// and every event pushed is delivered, coalesced or counted as dropped.
+// Clicks are lost only when Push said so.
+
+static void TestProducers()
+{
+	const unsigned int	nProducers	= 4;
+	const unsigned int	nEvents		= 100000;
+
+	TestEventQueue		queue;
+	std::mutex			mutex;
+	unsigned int		nOrder		= 0;
+	unsigned int		nDone		= 0;
+
+	vector<unsigned int> clicksPushed(nProducers, 0);
+	vector<unsigned int> clicksRejected(nProducers, 0);
+
+	vector<std::thread> producers;
+
+	for (unsigned int p = 0; p < nProducers; ++p)
+	{
+		producers.push_back(std::thread([&, p]()
+		{
+			for (unsigned int i = 0; i < nEvents; ++i)
+			{
+				TestEvent event = MakeEvent(i, (i % 97) != 0, (i / 1000) & 1);
+
+				event.nProducer = p;
+
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+
+					event.nOrder = nOrder++;
+
+					if (!queue.Push(event) && !event.bMove) ++clicksRejected[p];
+				}
+
+				if (!event.bMove) ++clicksPushed[p];
+				if (i % 16 == 0) std::this_thread::yield();
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			++nDone;
+		}));
+	}
+
+	vector<unsigned int>	clicksGot(nProducers, 0);
+	vector<unsigned int>	lastSequence(nProducers, 0);
+	vector<bool>			gotAny(nProducers, false);
+	unsigned int			nDelivered	= 0;
+	unsigned int			nLastOrder	= 0;
+	int						nOutOfOrder	= 0;
+	unsigned int			nBatches	= 0;
+
+	for (;;)
+	{
+		TestEvent		events[TestEventQueue::CAPACITY];
+		unsigned int	nCount	= 0;
+		bool			bDone	= false;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			nCount	= queue.Pop(events, TestEventQueue::CAPACITY);
+			bDone	= (nDone == nProducers);
+		}
+
+		for (unsigned int i = 0; i < nCount; ++i)
+		{
+			const TestEvent& event = events[i];
+
+			if ((nDelivered + i > 0) && (event.nOrder <= nLastOrder)) ++nOutOfOrder;
+			if (gotAny[event.nProducer] && (event.nSequence <= lastSequence[event.nProducer])) ++nOutOfOrder;
+
+			nLastOrder						= event.nOrder;
+			lastSequence[event.nProducer]	= event.nSequence;
+			gotAny[event.nProducer]			= true;
+
+			if (!event.bMove) ++clicksGot[event.nProducer];
+		}
+
+		nDelivered += nCount;
+
+		if (bDone && (nCount == 0)) break;
+
+		// a hook busy writing to the console
+		if (++nBatches % 64 == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	for (size_t i = 0; i < producers.size(); ++i) producers[i].join();
+
+	CHECK(nOutOfOrder == 0);
+	CHECK(nDelivered + queue.nCoalesced + queue.nDropped == nProducers * nEvents);
+
+	for (unsigned int p = 0; p < nProducers; ++p)
+	{
+		CHECK(clicksGot[p] + clicksRejected[p] == clicksPushed[p]);
+	}
+
+	::printf(
+		"%u producers, %u events: %u delivered, %u coalesced, %u dropped\n",
+		nProducers,
+		nProducers * nEvents,
+		nDelivered,
+		queue.nCoalesced,
+		queue.nDropped);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+	TestCoalesceAndDrop();
+	TestStalled();
+	TestProducers();
+
+	return TEST_EXIT("InputEventQueueTest");
+}
+
+//////////////////////////////////////////////////////////////////////////////
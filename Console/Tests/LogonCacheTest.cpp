@@ -0,0 +1,364 @@
+#include "stdafx.h"
+
+#include <stdexcept>
+
+#include "LogonCache.h"
+#include "Check.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// counts the calls and hands out fake tokens and environment blocks; a
+// block still holding data when destroyed wasn't wiped
+
+class FakeLogonProvider : public LogonProvider
+{
+	public:
+
+		FakeLogonProvider()
+		: nLogons(0)
+		, nEnvironments(0)
+		, nClosedTokens(0)
+		, nDestroyedEnvironments(0)
+		, nUnwipedEnvironments(0)
+		, nRandom(0)
+		, bFailLogon(false)
+		, bFailEnvironment(false)
+		, strLastUser()
+		, strPasswordValid(L"secret")
+		{
+		}
+
+		virtual HANDLE LogonUser(const wstring& strUser, const wstring& /*strDomain*/, const wstring& strPassword)
+		{
+			if (bFailLogon || (strPassword != strPasswordValid)) throw std::runtime_error("logon failed");
+
+			++nLogons;
+			strLastUser = strUser;
+
+			return reinterpret_cast<HANDLE>(static_cast<size_t>(0x1000 + nLogons));
+		}
+
+		virtual void* CreateEnvironmentBlock(HANDLE /*hToken*/)
+		{
+			if (bFailEnvironment) throw std::runtime_error("no environment");
+
+			++nEnvironments;
+
+			static const wchar_t szBlock[] = L"USERNAME=test\0PATH=C:\\Windows\0";
+
+			wchar_t* pBlock = new wchar_t[sizeof(szBlock) / sizeof(wchar_t)];
+			::memcpy(pBlock, szBlock, sizeof(szBlock));
+
+			return pBlock;
+		}
+
+		virtual void CloseToken(HANDLE /*hToken*/)
+		{
+			++nClosedTokens;
+		}
+
+		virtual void DestroyEnvironmentBlock(void* pEnvironment)
+		{
+			wchar_t* pBlock = static_cast<wchar_t*>(pEnvironment);
+
+			for (size_t i = 0; i < 31; ++i)
+			{
+				if (pBlock[i] != L'\0')
+				{
+					++nUnwipedEnvironments;
+					break;
+				}
+			}
+
+			++nDestroyedEnvironments;
+			delete[] pBlock;
+		}
+
+		virtual void GenRandom(unsigned char* pBuffer, size_t stSize)
+		{
+			for (size_t i = 0; i < stSize; ++i) pBuffer[i] = static_cast<unsigned char>(++nRandom);
+		}
+
+		// FNV-1a, a byte of the hash per round
+		virtual void Hash(const unsigned char* pData, size_t stSize, unsigned char* pHash)
+		{
+			for (size_t nRound = 0; nRound < HASH_SIZE; ++nRound)
+			{
+				unsigned int dwHash = 2166136261u + static_cast<unsigned int>(nRound);
+
+				for (size_t i = 0; i < stSize; ++i) dwHash = (dwHash ^ pData[i]) * 16777619u;
+
+				pHash[nRound] = static_cast<unsigned char>(dwHash >> 24);
+			}
+		}
+
+	public:
+
+		int		nLogons;
+		int		nEnvironments;
+		int		nClosedTokens;
+		int		nDestroyedEnvironments;
+		int		nUnwipedEnvironments;
+		int		nRandom;
+
+		bool	bFailLogon;
+		bool	bFailEnvironment;
+
+		wstring	strLastUser;
+		wstring	strPasswordValid;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestSessionReused()
+{
+	std::shared_ptr<FakeLogonProvider>	provider(new FakeLogonProvider());
+	LogonCache							cache(provider);
+
+	std::shared_ptr<LogonSession> session1 = cache.GetSession(L"DOMAIN", L"user", L"secret", false, 0);
+	std::shared_ptr<LogonSession> session2 = cache.GetSession(L"domain", L"USER", L"secret", false, 0);
+
+	// account names are case insensitive, the second tab skips the logon
+	CHECK(session1 == session2);
+	CHECK(provider->nLogons == 1);
+	CHECK(provider->nEnvironments == 1);
+	CHECK(cache.GetSize() == 1);
+
+	CHECK(session1->token.get() != NULL);
+	CHECK(::wcscmp(static_cast<wchar_t*>(session1->environment.get()), L"USERNAME=test") == 0);
+
+	// another domain or user is another session
+	cache.GetSession(L"OTHER", L"user", L"secret", false, 0);
+	cache.GetSession(L"DOMAIN", L"admin", L"secret", false, 0);
+
+	CHECK(provider->nLogons == 3);
+	CHECK(cache.GetSize() == 3);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestNetOnlyNotCached()
+{
+	std::shared_ptr<FakeLogonProvider>	provider(new FakeLogonProvider());
+	LogonCache							cache(provider);
+
+	std::shared_ptr<LogonSession> session = cache.GetSession(L"DOMAIN", L"user", L"secret", true, 0);
+
+	// CreateProcessWithLogonW logs on net only users itself
+	CHECK(session.get() != NULL);
+	CHECK(session->token.get() == NULL);
+	CHECK(session->environment.get() == NULL);
+	CHECK(provider->nLogons == 0);
+	CHECK(cache.GetSize() == 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestClearWipes()
+{
+	std::shared_ptr<FakeLogonProvider>	provider(new FakeLogonProvider());
+	LogonCache							cache(provider);
+
+	cache.GetSession(L"DOMAIN", L"user", L"secret", false, 0);
+
+	std::shared_ptr<LogonSession> session = cache.GetSession(L"DOMAIN", L"admin", L"secret", false, 0);
+
+	cache.Clear();
+
+	// the session nobody holds is released right away, wiped
+	CHECK(cache.GetSize() == 0);
+	CHECK(provider->nClosedTokens == 1);
+	CHECK(provider->nDestroyedEnvironments == 1);
+
+	// a shell being started keeps its session until it's done
+	session.reset();
+
+	CHECK(provider->nClosedTokens == 2);
+	CHECK(provider->nDestroyedEnvironments == 2);
+	CHECK(provider->nUnwipedEnvironments == 0);
+
+	// and the next tab logs on again
+	cache.GetSession(L"DOMAIN", L"user", L"secret", false, 0);
+	CHECK(provider->nLogons == 3);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestFailuresNotCached()
+{
+	std::shared_ptr<FakeLogonProvider>	provider(new FakeLogonProvider());
+	LogonCache							cache(provider);
+
+	bool bThrown = false;
+
+	try
+	{
+		cache.GetSession(L"DOMAIN", L"user", L"wrong", false, 0);
+	}
+	catch (const std::runtime_error&)
+	{
+		bThrown = true;
+	}
+
+	CHECK(bThrown);
+	CHECK(cache.GetSize() == 0);
+
+	// a token whose environment can't be built is closed, not cached
+	provider->bFailEnvironment	= true;
+	bThrown						= false;
+
+	try
+	{
+		cache.GetSession(L"DOMAIN", L"user", L"secret", false, 0);
+	}
+	catch (const std::runtime_error&)
+	{
+		bThrown = true;
+	}
+
+	CHECK(bThrown);
+	CHECK(cache.GetSize() == 0);
+	CHECK(provider->nLogons == 1);
+	CHECK(provider->nClosedTokens == 1);
+
+	// the next try logs on again
+	provider->bFailEnvironment = false;
+
+	cache.GetSession(L"DOMAIN", L"user", L"secret", false, 0);
+	CHECK(provider->nLogons == 2);
+	CHECK(cache.GetSize() == 1);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestPasswordChecked()
+{
+	std::shared_ptr<FakeLogonProvider>	provider(new FakeLogonProvider());
+	LogonCache							cache(provider);
+
+	std::shared_ptr<LogonSession> session = cache.GetSession(L"DOMAIN", L"user", L"secret", false, 0);
+
+	// a wrong password doesn't get the cached token, it logs on and fails
+	bool bThrown = false;
+
+	try
+	{
+		cache.GetSession(L"DOMAIN", L"user", L"wrong", false, 1000);
+	}
+	catch (const std::runtime_error&)
+	{
+		bThrown = true;
+	}
+
+	CHECK(bThrown);
+	CHECK(provider->nLogons == 1);
+
+	// the right one still does
+	CHECK(cache.GetSession(L"DOMAIN", L"user", L"secret", false, 2000) == session);
+	CHECK(provider->nLogons == 1);
+
+	// a changed password replaces the session, the old one no longer gets it
+	provider->strPasswordValid = L"changed";
+
+	std::shared_ptr<LogonSession> changed = cache.GetSession(L"DOMAIN", L"user", L"changed", false, 3000);
+
+	CHECK(changed != session);
+	CHECK(provider->nLogons == 2);
+	CHECK(cache.GetSize() == 1);
+
+	bThrown = false;
+
+	try
+	{
+		cache.GetSession(L"DOMAIN", L"user", L"secret", false, 4000);
+	}
+	catch (const std::runtime_error&)
+	{
+		bThrown = true;
+	}
+
+	CHECK(bThrown);
+	CHECK(cache.GetSession(L"DOMAIN", L"user", L"changed", false, 5000) == changed);
+
+	// the replaced session is released once its shell is started
+	session.reset();
+	CHECK(provider->nClosedTokens == 1);
+	CHECK(provider->nUnwipedEnvironments == 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestSessionsExpire()
+{
+	std::shared_ptr<FakeLogonProvider>	provider(new FakeLogonProvider());
+	LogonCache							cache(provider);
+	unsigned long long					qwStart = 0x100000000ull;
+
+	std::shared_ptr<LogonSession> session = cache.GetSession(L"DOMAIN", L"user", L"secret", false, qwStart);
+	cache.GetSession(L"DOMAIN", L"admin", L"secret", false, qwStart + 1000);
+
+	// used or not, a session lasts SESSION_TTL from its logon
+	CHECK(cache.GetSession(L"DOMAIN", L"user", L"secret", false, qwStart + LogonCache::SESSION_TTL - 1) == session);
+	CHECK(provider->nLogons == 2);
+
+	std::shared_ptr<LogonSession> renewed = cache.GetSession(L"DOMAIN", L"user", L"secret", false, qwStart + LogonCache::SESSION_TTL);
+
+	CHECK(renewed != session);
+	CHECK(provider->nLogons == 3);
+
+	// expired sessions are dropped on the next lookup, not only their own
+	session.reset();
+	CHECK(provider->nClosedTokens == 1);
+
+	cache.GetSession(L"DOMAIN", L"user", L"secret", false, qwStart + LogonCache::SESSION_TTL + 1000);
+	CHECK(cache.GetSize() == 1);
+	CHECK(provider->nClosedTokens == 2);
+	CHECK(provider->nLogons == 3);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestSessionsOutliveCache()
+{
+	std::shared_ptr<FakeLogonProvider>	provider(new FakeLogonProvider());
+	std::shared_ptr<LogonSession>		session;
+
+	{
+		LogonCache cache(provider);
+		session = cache.GetSession(L"DOMAIN", L"user", L"secret", false, 0);
+	}
+
+	CHECK(provider->nClosedTokens == 0);
+
+	session.reset();
+
+	CHECK(provider->nClosedTokens == 1);
+	CHECK(provider->nDestroyedEnvironments == 1);
+	CHECK(provider->nUnwipedEnvironments == 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+	TestSessionReused();
+	TestNetOnlyNotCached();
+	TestClearWipes();
+	TestFailuresNotCached();
+	TestPasswordChecked();
+	TestSessionsExpire();
+	TestSessionsOutliveCache();
+
+	return TEST_EXIT("LogonCacheTest");
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,72 @@
+#include "stdafx.h"
+
+#include <chrono>
+#include <cstdlib>
+
+#include "PixelKernels.h"
+#include "Check.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+// A 4K frame through each kernel, per supported instruction set.
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+template<typename Kernel>
+static void Time(PixelKernels::Isa isa, const char* pszName, int nPixels, Kernel kernel)
+{
+	static const char* arrIsaNames[] = { "scalar", "sse2", "avx2" };
+
+	double dBest = 1e9;
+
+	for (int i = 0; i < 10; ++i)
+	{
+		auto start = chrono::steady_clock::now();
+		kernel();
+		dBest = min(dBest, chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+	}
+
+	::printf("%-6s  %-12s %7.2f ms  %6.2f Gpix/s\n", arrIsaNames[isa], pszName, dBest, nPixels / dBest / 1e6);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+	const int nWidth	= 3840;
+	const int nHeight	= 2160;
+	const int nPitch	= nWidth * 4;
+
+	vector<unsigned char> pixels(nPitch * nHeight);
+	vector<unsigned char> src(nPitch * nHeight);
+
+	for (size_t i = 0; i < pixels.size(); ++i)
+	{
+		pixels[i]	= static_cast<unsigned char>(::rand());
+		src[i]		= static_cast<unsigned char>(::rand());
+	}
+
+	for (int nIsa = PixelKernels::isaScalar; nIsa <= PixelKernels::GetSupportedIsa(); ++nIsa)
+	{
+		PixelKernels::Isa isa = static_cast<PixelKernels::Isa>(nIsa);
+
+		PixelKernels::SetIsa(isa);
+		CHECK(PixelKernels::GetIsa() == isa);
+
+		Time(isa, "fill", nWidth * nHeight, [&]() { PixelKernels::Fill(&pixels[0], nPitch, nWidth, nHeight, 0x12345678); });
+		Time(isa, "tint", nWidth * nHeight, [&]() { PixelKernels::Tint(&pixels[0], nPitch, nWidth, nHeight, 0x12345678, 100); });
+		Time(isa, "blendfill", nWidth * nHeight, [&]() { PixelKernels::BlendFill(&pixels[0], nPitch, nWidth, nHeight, 0x12345678, 100); });
+		Time(isa, "premultiply", nWidth * nHeight, [&]() { PixelKernels::Premultiply(&pixels[0], nPitch, nWidth, nHeight); });
+		Time(isa, "alphablend", nWidth * nHeight, [&]() { PixelKernels::AlphaBlend(&pixels[0], nPitch, &src[0], nPitch, nWidth, nHeight); });
+	}
+
+	return TEST_EXIT("PixelKernelsBench");
+}
+
+//////////////////////////////////////////////////////////////////////////////
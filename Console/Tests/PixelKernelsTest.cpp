@@ -0,0 +1,355 @@
+#include "stdafx.h"
+
+#include <cmath>
+#include <cstdlib>
+
+#include "PixelKernels.h"
+#include "Check.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Every instruction set the CPU supports is checked against a per channel
+// reference, on odd widths (SIMD tails) and padded pitches; against the
+// scalar kernels on every tail length and row alignment; and on the alpha
+// values the kernels special case in effect, 0 and 255.
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+typedef vector<unsigned char> Pixels;
+
+static Pixels RandomPixels(size_t stSize)
+{
+	Pixels pixels(stSize);
+	for (size_t i = 0; i < stSize; ++i) pixels[i] = static_cast<unsigned char>(::rand());
+	return pixels;
+}
+
+static unsigned int Channel(unsigned int dwColor, int nChannel)
+{
+	return (dwColor >> (nChannel * 8)) & 0xFF;
+}
+
+static unsigned int Scale(unsigned int dwValue, unsigned int dwFactor)
+{
+	return static_cast<unsigned int>(::lround(dwValue * dwFactor / 255.0));
+}
+
+static unsigned char Saturate(unsigned int dwValue)
+{
+	return static_cast<unsigned char>(min(dwValue, 255u));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// the reference, a pixel at a time; channel 3 is alpha
+
+static void RefTint(unsigned char* pPixel, unsigned int dwColor, unsigned char byOpacity)
+{
+	for (int c = 0; c < 3; ++c) pPixel[c] = Saturate(Scale(Channel(dwColor, c), byOpacity) + Scale(pPixel[c], 255 - byOpacity));
+}
+
+static void RefBlendFill(unsigned char* pPixel, unsigned int dwColor, unsigned char byAlpha)
+{
+	for (int c = 0; c < 3; ++c) pPixel[c] = Saturate(Scale(Channel(dwColor, c), byAlpha) + Scale(pPixel[c], 255 - byAlpha));
+	pPixel[3] = Saturate(byAlpha + Scale(pPixel[3], 255 - byAlpha));
+}
+
+static void RefPremultiply(unsigned char* pPixel)
+{
+	for (int c = 0; c < 3; ++c) pPixel[c] = static_cast<unsigned char>(Scale(pPixel[c], pPixel[3]));
+}
+
+static void RefAlphaBlend(unsigned char* pDst, const unsigned char* pSrc)
+{
+	for (int c = 0; c < 4; ++c) pDst[c] = Saturate(pSrc[c] + Scale(pDst[c], 255 - pSrc[3]));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// runs a kernel and the reference over the same rectangle; padding past
+// the row's end must not be touched
+
+template<typename Kernel, typename Reference>
+static bool Matches(const Pixels& pixels, int nPitch, int nWidth, int nHeight, Kernel kernel, Reference reference)
+{
+	Pixels actual(pixels);
+	Pixels expected(pixels);
+
+	kernel(&actual[0]);
+
+	for (int y = 0; y < nHeight; ++y)
+	{
+		for (int x = 0; x < nWidth; ++x) reference(&expected[y * nPitch + x * 4], y * nPitch + x * 4);
+	}
+
+	return actual == expected;
+}
+
+static void TestKernels(PixelKernels::Isa isa)
+{
+	PixelKernels::SetIsa(isa);
+	CHECK(PixelKernels::GetIsa() == isa);
+
+	int nMismatches = 0;
+
+	for (int i = 0; i < 300; ++i)
+	{
+		int				nWidth		= 1 + ::rand() % 67;
+		int				nHeight		= 1 + ::rand() % 5;
+		int				nPitch		= nWidth * 4 + 4 * (::rand() % 3);
+		Pixels			pixels		= RandomPixels(nPitch * nHeight);
+		Pixels			src			= RandomPixels(nPitch * nHeight);
+		unsigned int	dwColor		= static_cast<unsigned int>(::rand()) * 7919u;
+		unsigned char	byAlpha		= static_cast<unsigned char>(::rand());
+
+		// premultiplied sources, as AlphaBlend expects
+		PixelKernels::SetIsa(PixelKernels::isaScalar);
+		PixelKernels::Premultiply(&src[0], nPitch, nWidth, nHeight);
+		PixelKernels::SetIsa(isa);
+
+		if (!Matches(pixels, nPitch, nWidth, nHeight,
+				[&](unsigned char* p) { PixelKernels::Fill(p, nPitch, nWidth, nHeight, dwColor); },
+				[&](unsigned char* p, int) { ::memcpy(p, &dwColor, 4); })) ++nMismatches;
+
+		if (!Matches(pixels, nPitch, nWidth, nHeight,
+				[&](unsigned char* p) { PixelKernels::Tint(p, nPitch, nWidth, nHeight, dwColor, byAlpha); },
+				[&](unsigned char* p, int) { RefTint(p, dwColor, byAlpha); })) ++nMismatches;
+
+		if (!Matches(pixels, nPitch, nWidth, nHeight,
+				[&](unsigned char* p) { PixelKernels::BlendFill(p, nPitch, nWidth, nHeight, dwColor, byAlpha); },
+				[&](unsigned char* p, int) { RefBlendFill(p, dwColor, byAlpha); })) ++nMismatches;
+
+		if (!Matches(pixels, nPitch, nWidth, nHeight,
+				[&](unsigned char* p) { PixelKernels::Premultiply(p, nPitch, nWidth, nHeight); },
+				[&](unsigned char* p, int) { RefPremultiply(p); })) ++nMismatches;
+
+		if (!Matches(pixels, nPitch, nWidth, nHeight,
+				[&](unsigned char* p) { PixelKernels::AlphaBlend(p, nPitch, &src[0], nPitch, nWidth, nHeight); },
+				[&](unsigned char* p, int nOffset) { RefAlphaBlend(p, &src[nOffset]); })) ++nMismatches;
+	}
+
+	if (nMismatches != 0) ::printf("isa %d: %d mismatches\n", isa, nMismatches);
+	CHECK(nMismatches == 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// each kernel on a rectangle of the buffer, at the instruction set in use
+
+enum Kernel
+{
+	kernelFill,
+	kernelTint,
+	kernelBlendFill,
+	kernelPremultiply,
+	kernelAlphaBlend,
+	kernelCount
+};
+
+static void RunKernel(Kernel kernel, unsigned char* pPixels, const unsigned char* pSrc, int nPitch, int nWidth, int nHeight, unsigned int dwColor, unsigned char byAlpha)
+{
+	switch (kernel)
+	{
+		case kernelFill			: PixelKernels::Fill(pPixels, nPitch, nWidth, nHeight, dwColor); break;
+		case kernelTint			: PixelKernels::Tint(pPixels, nPitch, nWidth, nHeight, dwColor, byAlpha); break;
+		case kernelBlendFill	: PixelKernels::BlendFill(pPixels, nPitch, nWidth, nHeight, dwColor, byAlpha); break;
+		case kernelPremultiply	: PixelKernels::Premultiply(pPixels, nPitch, nWidth, nHeight); break;
+		case kernelAlphaBlend	: PixelKernels::AlphaBlend(pPixels, nPitch, pSrc, nPitch, nWidth, nHeight); break;
+		default					: break;
+	}
+}
+
+// every width up to a few AVX2 blocks, so every tail length, starting at
+// every pixel of a 32 byte block; the scalar kernels are the reference and
+// the pixels around the rectangle must not change
+
+static void TestTails(PixelKernels::Isa isa)
+{
+	const int nMaxWidth	= 3 * 8 + 7;
+	const int nHeight	= 3;
+	// the rows start on different pixels of a block too
+	const int nPitch	= (nMaxWidth + 8 + 1) * 4;
+
+	Pixels buffer(nPitch * nHeight + 64);
+	Pixels srcBuffer(nPitch * nHeight + 64);
+
+	size_t stAlign		= (32 - reinterpret_cast<size_t>(&buffer[0]) % 32) % 32;
+	size_t stSrcAlign	= (32 - reinterpret_cast<size_t>(&srcBuffer[0]) % 32) % 32;
+
+	for (int k = 0; k < kernelCount; ++k)
+	{
+		int nMismatches = 0;
+
+		for (int nWidth = 0; nWidth <= nMaxWidth; ++nWidth)
+		{
+			for (int nOffset = 0; nOffset < 8; ++nOffset)
+			{
+				Pixels			pixels		= RandomPixels(nPitch * nHeight);
+				Pixels			src			= RandomPixels(nPitch * nHeight);
+				unsigned int	dwColor		= static_cast<unsigned int>(::rand()) * 7919u;
+				unsigned char	byAlpha		= static_cast<unsigned char>(::rand());
+
+				PixelKernels::SetIsa(PixelKernels::isaScalar);
+				PixelKernels::Premultiply(&src[0], nPitch, nMaxWidth + 8, nHeight);
+
+				unsigned char*	pPixels		= &buffer[stAlign];
+				unsigned char*	pSrc		= &srcBuffer[stSrcAlign];
+
+				::memcpy(pSrc, &src[0], src.size());
+
+				::memcpy(pPixels, &pixels[0], pixels.size());
+				RunKernel(static_cast<Kernel>(k), pPixels + nOffset * 4, pSrc + nOffset * 4, nPitch, nWidth, nHeight, dwColor, byAlpha);
+
+				Pixels expected(pPixels, pPixels + pixels.size());
+
+				PixelKernels::SetIsa(isa);
+
+				::memcpy(pPixels, &pixels[0], pixels.size());
+				RunKernel(static_cast<Kernel>(k), pPixels + nOffset * 4, pSrc + nOffset * 4, nPitch, nWidth, nHeight, dwColor, byAlpha);
+
+				if (!std::equal(expected.begin(), expected.end(), pPixels)) ++nMismatches;
+			}
+		}
+
+		if (nMismatches != 0) ::printf("isa %d, kernel %d: %d mismatches\n", isa, k, nMismatches);
+		CHECK(nMismatches == 0);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// opacities and pixel alphas of 0 and 255 give exact results, on a width
+// with a SIMD block and a tail
+
+static void TestAlphaEdges(PixelKernels::Isa isa)
+{
+	const int			nWidth	= 13;
+	const Pixels		pixels	= RandomPixels(nWidth * 4);
+	const unsigned int	dwColor	= 0x80336699;
+
+	PixelKernels::SetIsa(isa);
+
+	// nothing blended
+	Pixels actual(pixels);
+
+	PixelKernels::Tint(&actual[0], nWidth * 4, nWidth, 1, dwColor, 0);
+	CHECK(actual == pixels);
+
+	PixelKernels::BlendFill(&actual[0], nWidth * 4, nWidth, 1, dwColor, 0);
+	CHECK(actual == pixels);
+
+	// the color replaces the pixels; Tint keeps their alpha, BlendFill is opaque
+	bool bTint		= true;
+	bool bBlendFill	= true;
+
+	actual = pixels;
+	PixelKernels::Tint(&actual[0], nWidth * 4, nWidth, 1, dwColor, 255);
+
+	for (int x = 0; x < nWidth; ++x)
+	{
+		if ((Channel(dwColor, 0) != actual[x * 4]) || (Channel(dwColor, 1) != actual[x * 4 + 1]) || (Channel(dwColor, 2) != actual[x * 4 + 2]) || (actual[x * 4 + 3] != pixels[x * 4 + 3])) bTint = false;
+	}
+
+	actual = pixels;
+	PixelKernels::BlendFill(&actual[0], nWidth * 4, nWidth, 1, dwColor, 255);
+
+	for (int x = 0; x < nWidth; ++x)
+	{
+		if ((Channel(dwColor, 0) != actual[x * 4]) || (Channel(dwColor, 1) != actual[x * 4 + 1]) || (Channel(dwColor, 2) != actual[x * 4 + 2]) || (actual[x * 4 + 3] != 255)) bBlendFill = false;
+	}
+
+	CHECK(bTint);
+	CHECK(bBlendFill);
+
+	// transparent pixels premultiply to black, opaque ones are left alone
+	Pixels transparent(pixels);
+	Pixels opaque(pixels);
+
+	for (int x = 0; x < nWidth; ++x)
+	{
+		transparent[x * 4 + 3]	= 0;
+		opaque[x * 4 + 3]		= 255;
+	}
+
+	actual = transparent;
+	PixelKernels::Premultiply(&actual[0], nWidth * 4, nWidth, 1);
+
+	bool bBlack = true;
+
+	for (size_t i = 0; i < actual.size(); ++i) if (actual[i] != 0) bBlack = false;
+
+	CHECK(bBlack);
+
+	actual = opaque;
+	PixelKernels::Premultiply(&actual[0], nWidth * 4, nWidth, 1);
+	CHECK(actual == opaque);
+
+	// a transparent (premultiplied, so black) source leaves the destination
+	// alone, an opaque one replaces it
+	Pixels clear(nWidth * 4, 0);
+
+	actual = pixels;
+	PixelKernels::AlphaBlend(&actual[0], nWidth * 4, &clear[0], nWidth * 4, nWidth, 1);
+	CHECK(actual == pixels);
+
+	actual = pixels;
+	PixelKernels::AlphaBlend(&actual[0], nWidth * 4, &opaque[0], nWidth * 4, nWidth, 1);
+	CHECK(actual == opaque);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// bottom-up DIBs are walked with a negative pitch
+
+static void TestNegativePitch()
+{
+	Pixels pixels(RandomPixels(16 * 4 * 3));
+	Pixels expected(pixels);
+
+	PixelKernels::SetIsa(PixelKernels::GetSupportedIsa());
+	PixelKernels::Tint(&expected[0], 16 * 4, 13, 3, 0x00336699, 100);
+	PixelKernels::Tint(&pixels[2 * 16 * 4], -16 * 4, 13, 3, 0x00336699, 100);
+
+	CHECK(pixels == expected);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+	::printf("supported isa: %d\n", PixelKernels::GetSupportedIsa());
+
+	for (int nIsa = PixelKernels::isaScalar; nIsa <= PixelKernels::GetSupportedIsa(); ++nIsa)
+	{
+		TestKernels(static_cast<PixelKernels::Isa>(nIsa));
+		TestTails(static_cast<PixelKernels::Isa>(nIsa));
+		TestAlphaEdges(static_cast<PixelKernels::Isa>(nIsa));
+	}
+
+	TestNegativePitch();
+
+	return TEST_EXIT("PixelKernelsTest");
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,274 @@
+#include "stdafx.h"
+
+#include "PredictiveEcho.h"
+#include "Check.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// A scripted console: a screen with a cursor, the test echoes the typed
+// characters into it whenever it likes and passes it on to PredictiveEcho.
+
+class Screen
+{
+	public:
+
+		Screen(int nColumns, int nRows)
+		: m_nColumns(nColumns)
+		, m_nRows(nRows)
+		, m_lines(nRows, wstring(nColumns, L' '))
+		, m_nCursorX(0)
+		, m_nCursorY(0)
+		{
+		}
+
+		void Put(wchar_t ch)
+		{
+			m_lines[m_nCursorY][m_nCursorX] = ch;
+			if (++m_nCursorX == m_nColumns)
+			{
+				m_nCursorX = 0;
+				++m_nCursorY;
+			}
+		}
+
+		void MoveCursor(int nX, int nY)
+		{
+			m_nCursorX = nX;
+			m_nCursorY = nY;
+		}
+
+		void Update(PredictiveEcho& echo, unsigned int nNow) const
+		{
+			echo.OnScreen(m_nCursorX, m_nCursorY, m_nColumns, m_nRows, [this](int nX, int nY) { return m_lines[nY][nX]; }, nNow);
+		}
+
+	private:
+
+		int				m_nColumns;
+		int				m_nRows;
+		vector<wstring>	m_lines;
+		int				m_nCursorX;
+		int				m_nCursorY;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestConfirm()
+{
+	// keys typed 20 ms apart, the console echoes each one 100 ms later
+	PredictiveEcho	echo;
+	Screen			screen(10, 3);
+	const wstring	strText(L"abcdefghijklm");
+	size_t			nEchoed = 0;
+
+	screen.Update(echo, 0);
+
+	for (unsigned int nNow = 0; nNow < 2000; nNow += 10)
+	{
+		if ((nNow % 20 == 0) && (nNow / 20 < strText.size())) echo.OnPrintable(strText[nNow / 20], nNow);
+
+		while ((nEchoed < strText.size()) && (nEchoed * 20 + 100 <= nNow))
+		{
+			screen.Put(strText[nEchoed++]);
+			screen.Update(echo, nNow);
+		}
+
+		if (nNow == 150)
+		{
+			// the first echoes are confirmed, the rest are shown at their cells
+			CHECK(echo.GetConfirmed() >= 1);
+			CHECK(!echo.GetShownPredictions().empty());
+
+			for (const auto& prediction : echo.GetShownPredictions())
+			{
+				CHECK(prediction.ch == strText[prediction.nY * 10 + prediction.nX]);
+			}
+		}
+
+		echo.Expire(nNow);
+	}
+
+	CHECK(echo.GetConfirmed() == strText.size());
+	CHECK(echo.GetMispredicted() == 0);
+	CHECK(echo.GetExpired() == 0);
+	CHECK(echo.GetLatency() >= 95 && echo.GetLatency() <= 105);
+	CHECK(!echo.HasPredictions());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestMispredict()
+{
+	PredictiveEcho	echo;
+	Screen			screen(20, 2);
+
+	echo.SetAlwaysShow(true);
+	screen.Update(echo, 0);
+
+	echo.OnPrintable(L'a', 0);
+	screen.Put(L'a');
+	screen.Update(echo, 50);
+
+	// the console upcases what's typed
+	echo.OnPrintable(L'b', 60);
+	echo.OnPrintable(L'c', 70);
+	screen.Put(L'B');
+	screen.Update(echo, 120);
+
+	CHECK(echo.GetMispredicted() == 1);
+	CHECK(!echo.HasPredictions());
+
+	// untrusted: predicted, not shown until one is confirmed
+	screen.Put(L'C');
+	screen.Update(echo, 130);
+	echo.OnPrintable(L'd', 140);
+	CHECK(echo.GetShownPredictions().empty());
+
+	screen.Put(L'd');
+	screen.Update(echo, 190);
+	echo.OnPrintable(L'e', 200);
+	CHECK(echo.GetShownPredictions().size() == 1);
+	CHECK(echo.GetShownPredictions()[0].nX == 4);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestExpire()
+{
+	// a password prompt: nothing gets echoed
+	PredictiveEcho	echo;
+	Screen			screen(20, 2);
+
+	echo.SetAlwaysShow(true);
+	screen.Update(echo, 0);
+
+	echo.OnPrintable(L'a', 0);
+	screen.Put(L'a');
+	screen.Update(echo, 10);
+	CHECK(echo.GetConfirmed() == 1);
+
+	echo.OnPrintable(L's', 20);
+	echo.OnPrintable(L'e', 30);
+	CHECK(echo.GetShownPredictions().size() == 2);
+
+	screen.Update(echo, 500);
+	CHECK(!echo.Expire(20 + PredictiveEcho::EXPIRE_TIME - 1));
+	CHECK(echo.Expire(20 + PredictiveEcho::EXPIRE_TIME));
+	CHECK(echo.GetExpired() == 1);
+	CHECK(!echo.HasPredictions());
+
+	// and the next predictions aren't shown
+	echo.OnPrintable(L'c', 1100);
+	CHECK(echo.HasPredictions());
+	CHECK(echo.GetShownPredictions().empty());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestOtherKeys()
+{
+	PredictiveEcho	echo;
+	Screen			screen(4, 2);
+
+	echo.SetAlwaysShow(true);
+	screen.Update(echo, 0);
+
+	echo.OnPrintable(L'x', 0);
+	screen.Put(L'x');
+	screen.Update(echo, 40);
+
+	// enter: nothing predicted until the cursor moves
+	echo.OnOtherKey(50);
+	echo.OnPrintable(L'y', 60);
+	CHECK(!echo.HasPredictions());
+
+	screen.MoveCursor(0, 1);
+	screen.Update(echo, 90);
+
+	// the last row is full, nothing predicted past it
+	echo.OnPrintable(L'p', 100);
+	echo.OnPrintable(L'q', 110);
+	echo.OnPrintable(L'r', 120);
+	echo.OnPrintable(L's', 130);
+	echo.OnPrintable(L't', 140);
+	CHECK(!echo.HasPredictions());
+
+	// suspended until SUSPEND_TIME without a cursor move as well
+	CHECK(!echo.Expire(1000));
+	echo.OnPrintable(L'u', 1200);
+	CHECK(echo.HasPredictions());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestWrap()
+{
+	PredictiveEcho	echo;
+	Screen			screen(4, 3);
+
+	echo.SetAlwaysShow(true);
+	screen.MoveCursor(2, 0);
+	screen.Update(echo, 0);
+
+	echo.OnPrintable(L'a', 0);
+	screen.Put(L'a');
+	screen.Update(echo, 40);
+
+	echo.OnPrintable(L'b', 50);
+	echo.OnPrintable(L'c', 50);
+	echo.OnPrintable(L'd', 50);
+
+	const vector<PredictiveEcho::Prediction>& shown = echo.GetShownPredictions();
+
+	CHECK(shown.size() == 3);
+	if (shown.size() == 3)
+	{
+		CHECK(shown[0].nX == 3 && shown[0].nY == 0);
+		CHECK(shown[1].nX == 0 && shown[1].nY == 1);
+		CHECK(shown[2].nX == 1 && shown[2].nY == 1);
+	}
+
+	screen.Put(L'b');
+	screen.Put(L'c');
+	screen.Put(L'd');
+	screen.Update(echo, 90);
+
+	CHECK(echo.GetConfirmed() == 4);
+	CHECK(!echo.HasPredictions());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+	TestConfirm();
+	TestMispredict();
+	TestExpire();
+	TestOtherKeys();
+	TestWrap();
+
+	return TEST_EXIT("PredictiveEchoTest");
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,73 @@
+#include "stdafx.h"
+
+#include <chrono>
+#include <cstdlib>
+
+#include "Resampler.h"
+#include "Check.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+// What ImageRescaler's worker spends on a 4K wallpaper per window size.
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+	const int nSrcWidth		= 3840;
+	const int nSrcHeight	= 2160;
+
+	vector<unsigned char> src(nSrcWidth * nSrcHeight * 4);
+	for (size_t i = 0; i < src.size(); ++i) src[i] = static_cast<unsigned char>(::rand());
+
+	const int arrSizes[][2] = { { 1280, 720 }, { 1920, 1080 }, { 2560, 1440 }, { 5120, 2880 } };
+
+	for (size_t i = 0; i < sizeof(arrSizes)/sizeof(arrSizes[0]); ++i)
+	{
+		int nDstWidth	= arrSizes[i][0];
+		int nDstHeight	= arrSizes[i][1];
+
+		vector<unsigned char> dst(nDstWidth * nDstHeight * 4);
+
+		double dBest = 1e9;
+
+		for (int nRun = 0; nRun < 3; ++nRun)
+		{
+			auto start = chrono::steady_clock::now();
+
+			CHECK(Resampler::Resample(
+					&src[0], nSrcWidth, nSrcHeight, nSrcWidth * 4,
+					&dst[0], nDstWidth, nDstHeight, nDstWidth * 4,
+					Resampler::CancelCallback()));
+
+			dBest = min(dBest, chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+		}
+
+		::printf("%dx%d -> %dx%d: %.1f ms\n", nSrcWidth, nSrcHeight, nDstWidth, nDstHeight, dBest);
+	}
+
+	// a cancelled rescale gives the thread back within a row
+	vector<unsigned char>	dst(1920 * 1080 * 4);
+	int						nPolls	= 0;
+	double					dCancel	= 0.0;
+	auto					start	= chrono::steady_clock::now();
+
+	CHECK(!Resampler::Resample(
+			&src[0], nSrcWidth, nSrcHeight, nSrcWidth * 4,
+			&dst[0], 1920, 1080, 1920 * 4,
+			[&]()
+			{
+				if (++nPolls < 100) return false;
+				dCancel = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+				return true;
+			}));
+
+	::printf("cancelled after 100 rows: %.2f ms, %.3f ms/row\n", dCancel, dCancel / 100);
+
+	return TEST_EXIT("ResamplerBench");
+}
+
+//////////////////////////////////////////////////////////////////////////////
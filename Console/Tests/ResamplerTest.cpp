@@ -0,0 +1,160 @@
+#include "stdafx.h"
+
+#include <cstdlib>
+
+#include "Resampler.h"
+#include "Check.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Resampler is the part of ImageRescaler that does the work; the rescaler
+// itself only adds the Win32 worker thread and FreeImage bitmaps.
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static vector<unsigned char> RandomImage(int nWidth, int nHeight)
+{
+	vector<unsigned char> image(nWidth * nHeight * 4);
+	for (size_t i = 0; i < image.size(); ++i) image[i] = static_cast<unsigned char>(::rand());
+	return image;
+}
+
+static bool AllEqual(const vector<unsigned char>& image, unsigned char value)
+{
+	return std::all_of(image.begin(), image.end(), [value](unsigned char v) { return v == value; });
+}
+
+static bool Resample(const vector<unsigned char>& src, int nSrcWidth, int nSrcHeight, vector<unsigned char>& dst, int nDstWidth, int nDstHeight)
+{
+	dst.assign(nDstWidth * nDstHeight * 4, 0);
+
+	return Resampler::Resample(
+				&src[0], nSrcWidth, nSrcHeight, nSrcWidth * 4,
+				&dst[0], nDstWidth, nDstHeight, nDstWidth * 4,
+				Resampler::CancelCallback());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestIdentity()
+{
+	vector<unsigned char> src(RandomImage(317, 211));
+	vector<unsigned char> dst;
+
+	CHECK(Resample(src, 317, 211, dst, 317, 211));
+	CHECK(dst == src);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// weights add up to one, a flat image stays flat both ways
+
+static void TestConstant()
+{
+	vector<unsigned char> src(100 * 80 * 4, 200);
+	vector<unsigned char> dst;
+
+	CHECK(Resample(src, 100, 80, dst, 33, 47));
+	CHECK(AllEqual(dst, 200));
+
+	CHECK(Resample(src, 100, 80, dst, 301, 199));
+	CHECK(AllEqual(dst, 200));
+
+	vector<unsigned char> pixel(4, 77);
+
+	CHECK(Resample(pixel, 1, 1, dst, 5, 3));
+	CHECK(AllEqual(dst, 77));
+
+	CHECK(Resample(src, 100, 80, dst, 1, 1));
+	CHECK(AllEqual(dst, 200));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// a rectangle at a time gives the same pixels as the whole image
+
+static void TestRect()
+{
+	const int nSrcWidth		= 640;
+	const int nSrcHeight	= 480;
+	const int nDstWidth		= 333;
+	const int nDstHeight	= 250;
+
+	vector<unsigned char> src(RandomImage(nSrcWidth, nSrcHeight));
+	vector<unsigned char> whole;
+
+	CHECK(Resample(src, nSrcWidth, nSrcHeight, whole, nDstWidth, nDstHeight));
+
+	Resampler::Filters filters;
+	Resampler::CalcFilters(nSrcWidth, nSrcHeight, nDstWidth, nDstHeight, filters);
+
+	vector<unsigned char> pieces(whole.size(), 0);
+
+	for (int y = 0; y < nDstHeight; y += 64)
+	{
+		for (int x = 0; x < nDstWidth; x += 64)
+		{
+			Resampler::ResampleRect(
+				filters,
+				&src[0],
+				nSrcWidth * 4,
+				x,
+				y,
+				min(64, nDstWidth - x),
+				min(64, nDstHeight - y),
+				&pieces[(y * nDstWidth + x) * 4],
+				nDstWidth * 4);
+		}
+	}
+
+	CHECK(pieces == whole);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestCancel()
+{
+	vector<unsigned char> src(RandomImage(800, 600));
+	vector<unsigned char> dst(400 * 300 * 4);
+	int nPolls = 0;
+
+	bool bDone = Resampler::Resample(
+					&src[0], 800, 600, 800 * 4,
+					&dst[0], 400, 300, 400 * 4,
+					[&nPolls]() { return ++nPolls > 10; });
+
+	CHECK(!bDone);
+	CHECK(nPolls == 11);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+	TestIdentity();
+	TestConstant();
+	TestRect();
+	TestCancel();
+
+	return TEST_EXIT("ResamplerTest");
+}
+
+//////////////////////////////////////////////////////////////////////////////
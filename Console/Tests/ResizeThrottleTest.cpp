@@ -0,0 +1,156 @@
+#include "stdafx.h"
+
+#include "ResizeThrottle.h"
+#include "Check.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestRules()
+{
+	ResizeThrottle throttle;
+
+	// first size goes at once and starts the timer
+	CHECK(throttle.OnRequest(true));
+	CHECK(throttle.IsTicking());
+
+	// the next ones wait for the tick, the latest is sent
+	CHECK(!throttle.OnRequest(true));
+	CHECK(!throttle.OnRequest(true));
+	CHECK(throttle.OnTick(true));
+
+	// a quiet tick stops the timer
+	CHECK(!throttle.OnTick(true));
+	CHECK(!throttle.IsTicking());
+
+	CHECK(throttle.GetRequests() == 3);
+	CHECK(throttle.GetSent() == 2);
+
+	// hidden: kept until shown, once
+	ResizeThrottle hidden;
+
+	CHECK(!hidden.OnRequest(false));
+	CHECK(!hidden.OnRequest(false));
+	CHECK(!hidden.IsTicking());
+	CHECK(hidden.OnShow());
+	CHECK(!hidden.OnShow());
+	CHECK(hidden.GetSent() == 1);
+
+	// hidden while ticking: the timer stops, the size waits for the show
+	ResizeThrottle switched;
+
+	CHECK(switched.OnRequest(true));
+	CHECK(!switched.OnRequest(true));
+	CHECK(!switched.OnTick(false));
+	CHECK(!switched.IsTicking());
+	CHECK(switched.OnShow());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// A drag the way ConsoleView drives the throttle, a millisecond at a time:
+// every nRequestInterval ms all views get a new size, visible views tick
+// every 16 ms (RESIZE_TIMER_INTERVAL) from when their timer started. When
+// the drag is over the hidden views are shown one after the other.
+
+struct SimulatedView
+{
+	SimulatedView() : throttle(), bVisible(false), nNextTick(0) {}
+
+	ResizeThrottle	throttle;
+	bool			bVisible;
+	int				nNextTick;
+};
+
+static void SimulateDrag(vector<SimulatedView>& views, int nDuration, int nRequestInterval, unsigned long& dwRequests, unsigned long& dwSent)
+{
+	const int nTickInterval = 16;
+
+	for (int nNow = 0; nNow < nDuration + 10 * nTickInterval; ++nNow)
+	{
+		for (size_t i = 0; i < views.size(); ++i)
+		{
+			SimulatedView& view = views[i];
+
+			if (view.throttle.IsTicking() && (nNow == view.nNextTick))
+			{
+				view.throttle.OnTick(view.bVisible);
+				view.nNextTick = nNow + nTickInterval;
+			}
+
+			if ((nNow < nDuration) && (nNow % nRequestInterval == 0))
+			{
+				if (view.throttle.OnRequest(view.bVisible)) view.nNextTick = nNow + nTickInterval;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < views.size(); ++i)
+	{
+		CHECK(!views[i].throttle.IsTicking());
+
+		if (!views[i].bVisible) views[i].throttle.OnShow();
+
+		dwRequests	+= views[i].throttle.GetRequests();
+		dwSent		+= views[i].throttle.GetSent();
+	}
+}
+
+static void TestDrags()
+{
+	// a 2 s window drag with WM_SIZE every 8 ms, 4 tabs of 4 panes; every
+	// pane of every tab is resized (MainFrame::AdjustWindowSize)
+	{
+		vector<SimulatedView> views(16);
+		for (size_t i = 0; i < 4; ++i) views[i].bVisible = true;
+
+		unsigned long dwRequests	= 0;
+		unsigned long dwSent		= 0;
+
+		SimulateDrag(views, 2000, 8, dwRequests, dwSent);
+
+		::printf("window drag, 4 tabs x 4 panes: %lu hook resizes before, %lu after\n", dwRequests, dwSent);
+
+		CHECK(dwRequests == 16 * 250);
+		// at most one per visible pane per tick plus the last one, one per
+		// hidden pane when it's shown
+		CHECK(dwSent <= 4 * (2000 / 16 + 2) + 12);
+	}
+
+	// a 1 s split bar drag between 2 panes of the active tab, a mouse move
+	// every 4 ms
+	{
+		vector<SimulatedView> views(2);
+		for (size_t i = 0; i < views.size(); ++i) views[i].bVisible = true;
+
+		unsigned long dwRequests	= 0;
+		unsigned long dwSent		= 0;
+
+		SimulateDrag(views, 1000, 4, dwRequests, dwSent);
+
+		::printf("split bar drag, 2 panes: %lu hook resizes before, %lu after\n", dwRequests, dwSent);
+
+		CHECK(dwRequests == 2 * 250);
+		CHECK(dwSent <= 2 * (1000 / 16 + 2));
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+	TestRules();
+	TestDrags();
+
+	return TEST_EXIT("ResizeThrottleTest");
+}
+
+//////////////////////////////////////////////////////////////////////////////
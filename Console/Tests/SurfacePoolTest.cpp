@@ -0,0 +1,196 @@
+#include "stdafx.h"
+
+#include "SurfacePool.h"
+#include "Check.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+class FakeSurface
+{
+	public:
+
+		FakeSurface(int nWidth, int nHeight) : m_nWidth(nWidth), m_nHeight(nHeight) {}
+
+		int GetWidth() const { return m_nWidth; }
+		int GetHeight() const { return m_nHeight; }
+
+	private:
+
+		int m_nWidth;
+		int m_nHeight;
+};
+
+typedef SurfacePool<FakeSurface> FakeSurfacePool;
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestPolicy()
+{
+	// GRAIN rounding, never below one grain
+	CHECK(SurfacePolicy::Round(0) == SurfacePolicy::GRAIN);
+	CHECK(SurfacePolicy::Round(1) == 32);
+	CHECK(SurfacePolicy::Round(32) == 32);
+	CHECK(SurfacePolicy::Round(33) == 64);
+	CHECK(SurfacePolicy::Round(1080) == 1088);
+
+	CHECK(SurfacePolicy::Fits(64, 64, 64, 64));
+	CHECK(!SurfacePolicy::Fits(64, 64, 65, 10));
+	CHECK(!SurfacePolicy::Fits(64, 64, 10, 65));
+
+	// oversized past OVERSIZE times the pixels needed
+	CHECK(!SurfacePolicy::IsOversized(128, 64, 64, 64));
+	CHECK(SurfacePolicy::IsOversized(128, 96, 64, 64));
+	CHECK(SurfacePolicy::IsOversized(1024, 1024, 100, 100));
+
+	int nWidth	= 0;
+	int nHeight	= 0;
+
+	// grows by half in the dimension that doesn't fit
+	SurfacePolicy::CalcGrowSize(640, 480, 650, 400, nWidth, nHeight);
+	CHECK((nWidth == 960) && (nHeight == 480));
+
+	// or to the rounded size when that's more
+	SurfacePolicy::CalcGrowSize(640, 480, 2000, 481, nWidth, nHeight);
+	CHECK((nWidth == 2016) && (nHeight == 736));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestResize()
+{
+	FakeSurfacePool pool;
+
+	FakeSurfacePool::SurfacePtr surface(pool.Acquire(480, 270));
+
+	CHECK((surface->GetWidth() == 480) && (surface->GetHeight() == 288));
+
+	// fits: kept, contents and all
+	CHECK(!pool.Resize(surface, 470, 280, false));
+
+	// doesn't fit: grows geometrically
+	CHECK(pool.Resize(surface, 500, 280, false));
+	CHECK((surface->GetWidth() == 736) && (surface->GetHeight() == 288));
+	CHECK(pool.GetStats().dwGrows == 1);
+
+	// oversized surfaces shrink only when asked to
+	CHECK(!pool.Resize(surface, 100, 100, false));
+	CHECK(pool.Resize(surface, 100, 100, true));
+	CHECK((surface->GetWidth() == 128) && (surface->GetHeight() == 128));
+	CHECK(pool.GetStats().dwShrinks == 1);
+
+	// the replaced surfaces are freed right away
+	CHECK(pool.GetStats().stSurfaces == 1);
+	CHECK(pool.GetStats().stInUse == 1);
+	CHECK(pool.GetStats().stBytes == 128 * 128 * 4);
+	CHECK(pool.GetStats().stPeakBytes == 736 * 288 * 4);
+
+	// an empty pointer is acquired
+	FakeSurfacePool::SurfacePtr empty;
+
+	CHECK(pool.Resize(empty, 10, 10, false));
+	CHECK(empty && (empty->GetWidth() == 32));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestReuse()
+{
+	FakeSurfacePool pool;
+
+	FakeSurfacePool::SurfacePtr a(pool.Acquire(100, 100));
+	FakeSurfacePool::SurfacePtr b(pool.Acquire(200, 200));
+
+	FakeSurface* pA = a.get();
+	FakeSurface* pB = b.get();
+
+	pool.Release(a);
+	pool.Release(b);
+
+	CHECK(!a && !b);
+	CHECK(pool.GetStats().stInUse == 0);
+	CHECK(pool.GetStats().stSurfaces == 2);
+
+	// the smallest free surface that fits
+	FakeSurfacePool::SurfacePtr c(pool.Acquire(90, 90));
+	CHECK(c.get() == pA);
+	CHECK(pool.GetStats().dwReuses == 1);
+
+	// a free surface more than OVERSIZE times too big isn't handed out
+	FakeSurfacePool::SurfacePtr d(pool.Acquire(60, 60));
+	CHECK(d.get() != pB);
+	CHECK((d->GetWidth() == 64) && (d->GetHeight() == 64));
+	CHECK(pool.GetStats().dwAllocations == 3);
+
+	// one that isn't oversized is
+	FakeSurfacePool::SurfacePtr e(pool.Acquire(180, 150));
+	CHECK(e.get() == pB);
+
+	// a resize picks up a free surface before allocating
+	pool.Release(e);
+	CHECK(pool.Resize(c, 190, 190, false));
+	CHECK(c.get() == pB);
+	CHECK(pool.GetStats().dwAllocations == 3);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Trim frees the free surfaces only
+
+static void TestTrim()
+{
+	FakeSurfacePool pool;
+
+	FakeSurfacePool::SurfacePtr a(pool.Acquire(100, 100));
+	FakeSurfacePool::SurfacePtr b(pool.Acquire(100, 100));
+
+	pool.Release(a);
+	pool.Trim();
+
+	CHECK(pool.GetStats().stSurfaces == 1);
+	CHECK(pool.GetStats().stInUse == 1);
+	CHECK(pool.GetStats().stBytes == 128 * 128 * 4);
+
+	// the trimmed one is gone, a new acquire allocates
+	FakeSurfacePool::SurfacePtr c(pool.Acquire(100, 100));
+	CHECK(pool.GetStats().dwAllocations == 3);
+	CHECK(pool.GetStats().dwReuses == 0);
+
+	pool.Release(b);
+	pool.Release(c);
+	pool.Trim();
+
+	CHECK(pool.GetStats().stSurfaces == 0);
+	CHECK(pool.GetStats().stBytes == 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+	TestPolicy();
+	TestResize();
+	TestReuse();
+	TestTrim();
+
+	return TEST_EXIT("SurfacePoolTest");
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,100 @@
+#include "stdafx.h"
+
+#include <chrono>
+#include <cstdlib>
+
+#include "TabStripLayout.h"
+#include "Check.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+// A 1000 tab strip: hit tests against a linear scan, and re-arranging after
+// one tab is retitled.
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static int LinearHitTest(const vector<int>& widths, int nStart, int x)
+{
+	int nLeft = nStart;
+
+	for (size_t i = 0; i < widths.size(); ++i)
+	{
+		if ((x >= nLeft) && (x < nLeft + widths[i])) return static_cast<int>(i);
+		nLeft += widths[i];
+	}
+
+	return -1;
+}
+
+static double Elapsed(const chrono::steady_clock::time_point& start, int nCount)
+{
+	return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / nCount;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+	const int nTabs		= 1000;
+	const int nCount	= 200000;
+
+	::srand(1);
+
+	TabStripLayout	layout;
+	vector<int>		widths(nTabs);
+
+	layout.SetCount(nTabs);
+
+	for (int i = 0; i < nTabs; ++i)
+	{
+		widths[i] = 80 + ::rand() % 120;
+		layout.SetWidth(i, widths[i]);
+	}
+
+	layout.Arrange(5);
+
+	volatile long lSink = 0;
+
+	auto start = chrono::steady_clock::now();
+	for (int i = 0; i < nCount; ++i) lSink += LinearHitTest(widths, 5, (i * 7919) % layout.GetEnd());
+	double dLinear = Elapsed(start, nCount);
+
+	start = chrono::steady_clock::now();
+	for (int i = 0; i < nCount; ++i) lSink += layout.HitTest((i * 7919) % layout.GetEnd());
+	double dBinary = Elapsed(start, nCount);
+
+	::printf("hit test, %d tabs: linear %.1f ns, binary search %.1f ns\n", nTabs, dLinear, dBinary);
+
+	// every other retitle changes the width
+	size_t stMoved = 0;
+
+	start = chrono::steady_clock::now();
+
+	for (int i = 0; i < nCount; ++i)
+	{
+		size_t stTab = (i * 31) % nTabs;
+
+		layout.SetWidth(stTab, layout.GetWidth(stTab) + (((i & 1) != 0) ? 0 : 1));
+		layout.Arrange(5);
+
+		stMoved += nTabs - layout.GetFirstMoved();
+	}
+
+	double dArrange = Elapsed(start, nCount);
+
+	::printf("retitle, %d tabs: %.1f ns to arrange, %.1f tabs moved on average\n", nTabs, dArrange, static_cast<double>(stMoved) / nCount);
+
+	(void)lSink;
+
+	CHECK(dBinary < dLinear);
+
+	return TEST_EXIT("TabStripLayoutBench");
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,178 @@
+#include "stdafx.h"
+
+#include <cstdlib>
+
+#include "TabStripLayout.h"
+#include "Check.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// the layout from scratch, for comparison
+
+static int LinearHitTest(const vector<int>& widths, int nStart, int x)
+{
+	int nLeft = nStart;
+
+	for (size_t i = 0; i < widths.size(); ++i)
+	{
+		if ((x >= nLeft) && (x < nLeft + widths[i])) return static_cast<int>(i);
+		nLeft += widths[i];
+	}
+
+	return -1;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestMoved()
+{
+	TabStripLayout layout;
+
+	layout.SetCount(3);
+
+	CHECK(layout.SetWidth(0, 100));
+	CHECK(layout.SetWidth(1, 50));
+	CHECK(layout.SetWidth(2, 70));
+	CHECK(!layout.SetWidth(2, 70));
+
+	layout.Arrange(5);
+
+	CHECK(layout.GetFirstMoved() == 0);
+	CHECK((layout.GetLeft(1) == 105) && (layout.GetRight(1) == 155));
+	CHECK(layout.GetEnd() == 225);
+
+	// nothing changed
+	layout.Arrange(5);
+	CHECK(layout.GetFirstMoved() == 3);
+
+	// a retitled tab and the ones after it move
+	layout.SetWidth(1, 60);
+	layout.Arrange(5);
+
+	CHECK(layout.GetFirstMoved() == 1);
+	CHECK(layout.GetLeft(2) == 165);
+
+	// a different start moves everything
+	layout.Arrange(0);
+	CHECK(layout.GetFirstMoved() == 0);
+
+	// zero width tabs are never hit
+	layout.SetWidth(1, 0);
+	layout.Arrange(0);
+
+	CHECK(layout.HitTest(99) == 0);
+	CHECK(layout.HitTest(100) == 2);
+	CHECK(layout.HitTest(-1) == -1);
+	CHECK(layout.HitTest(170) == -1);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// random count and width changes against a layout from scratch
+
+static void TestRandom()
+{
+	::srand(1);
+
+	TabStripLayout	layout;
+	vector<int>		widths;
+	int				nMismatches	= 0;
+
+	for (int nRound = 0; nRound < 2000; ++nRound)
+	{
+		if (::rand() % 4 == 0)
+		{
+			size_t stCount = ::rand() % 50;
+
+			widths.resize(stCount, 0);
+			layout.SetCount(stCount);
+		}
+		else if (!widths.empty())
+		{
+			size_t	stTab	= ::rand() % widths.size();
+			int		nWidth	= (::rand() % 3 == 0) ? 0 : ::rand() % 200;
+
+			widths[stTab] = nWidth;
+			layout.SetWidth(stTab, nWidth);
+		}
+
+		int nStart = (::rand() % 3 == 0) ? ::rand() % 10 : 5;
+
+		layout.Arrange(nStart);
+
+		int nLeft = nStart;
+
+		for (size_t i = 0; i < widths.size(); ++i)
+		{
+			if (layout.GetLeft(i) != nLeft) ++nMismatches;
+			nLeft += widths[i];
+			if (layout.GetRight(i) != nLeft) ++nMismatches;
+		}
+
+		if (layout.GetEnd() != nLeft) ++nMismatches;
+
+		for (int x = -5; x < nLeft + 5; x += 3)
+		{
+			if (layout.HitTest(x) != LinearHitTest(widths, nStart, x)) ++nMismatches;
+		}
+	}
+
+	CHECK(nMismatches == 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// 1000 tabs: a retitle with the same width moves nothing, the last tab
+// moves only itself
+
+static void TestThousandTabs()
+{
+	const size_t stTabs = 1000;
+
+	TabStripLayout layout;
+
+	layout.SetCount(stTabs);
+	for (size_t i = 0; i < stTabs; ++i) layout.SetWidth(i, 80 + static_cast<int>(i % 120));
+	layout.Arrange(5);
+
+	CHECK(layout.GetFirstMoved() == 0);
+
+	layout.SetWidth(500, layout.GetWidth(500));
+	layout.Arrange(5);
+	CHECK(layout.GetFirstMoved() == stTabs);
+
+	layout.SetWidth(stTabs - 1, 300);
+	layout.Arrange(5);
+	CHECK(layout.GetFirstMoved() == stTabs - 1);
+
+	CHECK(layout.HitTest(layout.GetEnd() - 1) == static_cast<int>(stTabs - 1));
+	CHECK(layout.HitTest(layout.GetLeft(777)) == 777);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+	TestMoved();
+	TestRandom();
+	TestThousandTabs();
+
+	return TEST_EXIT("TabStripLayoutTest");
+}
+
+//////////////////////////////////////////////////////////////////////////////
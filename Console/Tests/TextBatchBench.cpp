@@ -0,0 +1,72 @@
+#include "stdafx.h"
+
+#include <chrono>
+
+#include "TextBatchFrame.h"
+#include "Check.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+// A 250x80 screen of colored words, short to long, as one batch: the DC
+// state changes drawing it takes in row order and sorted, and what building
+// and sorting it costs.
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+	const int	arrMaxWords[]	= { 2, 6, 20 };
+	const int	nFrames			= 100;
+
+	for (size_t k = 0; k < sizeof(arrMaxWords) / sizeof(arrMaxWords[0]); ++k)
+	{
+		TextBatch			batch;
+		TextBatch::Stats	rowOrder = TextBatch::Stats();
+		TextBatch::Stats	sorted = TextBatch::Stats();
+		double				dBuild	= 0;
+		double				dSort	= 1e9;
+
+		for (int i = 0; i < nFrames; ++i)
+		{
+			batch.Clear();
+
+			auto start = chrono::steady_clock::now();
+			AddFrame(batch, arrMaxWords[k]);
+			auto built = chrono::steady_clock::now();
+
+			rowOrder = batch.GetStats();
+
+			auto sortStart = chrono::steady_clock::now();
+			batch.Sort();
+			auto sortEnd = chrono::steady_clock::now();
+
+			sorted = batch.GetStats();
+
+			dBuild	+= chrono::duration<double, micro>(built - start).count();
+			dSort	= min(dSort, chrono::duration<double, micro>(sortEnd - sortStart).count());
+		}
+
+		// state changes: drawing in row order sets the font, color and brush
+		// whenever they differ from the last run or fill
+		::printf(
+			"words <= %2d: %5zu runs, %4zu fills (%4zu merged)\n"
+			"  row order: %5zu font, %5zu color, %4zu brush changes\n"
+			"  sorted:    %5zu font, %5zu color, %4zu brush changes\n"
+			"  build %6.0f us, sort %6.0f us\n",
+			arrMaxWords[k], rowOrder.stRuns, rowOrder.stFills, sorted.stFills,
+			rowOrder.stFontChanges, rowOrder.stColorChanges, rowOrder.stBrushChanges,
+			sorted.stFontChanges, sorted.stColorChanges, sorted.stBrushChanges,
+			dBuild / nFrames, dSort);
+
+		CHECK(sorted.stFontChanges <= rowOrder.stFontChanges);
+		CHECK(sorted.stColorChanges <= rowOrder.stColorChanges);
+		CHECK(sorted.stBrushChanges <= rowOrder.stBrushChanges);
+	}
+
+	return TEST_EXIT("TextBatchBench");
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "TextBatch.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+// The screen TextBatchTest and TextBatchBench fill batches with: 250x80
+// cells of colored output, words of random colors and backgrounds, every
+// tenth row a full width bar.
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static const int COLUMNS		= 250;
+static const int ROWS			= 80;
+static const int CELL_WIDTH		= 8;
+static const int CELL_HEIGHT	= 16;
+
+static unsigned int g_dwSeed = 3;
+
+static unsigned int Random()
+{
+	g_dwSeed = g_dwSeed * 1103515245 + 12345;
+	return g_dwSeed >> 8;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// words are 1 to nMaxWord cells long, bright colors are in the bold font
+static void AddFrame(TextBatch& batch, int nMaxWord)
+{
+	vector<int>		advances(COLUMNS, CELL_WIDTH);
+	vector<wchar_t>	text(COLUMNS, L'x');
+
+	for (int nRow = 0; nRow < ROWS; ++nRow)
+	{
+		bool bBar = (nRow % 10 == 0);
+
+		for (int nColumn = 0; nColumn < COLUMNS; )
+		{
+			int nCount = bBar ? COLUMNS : 1 + static_cast<int>(Random() % nMaxWord);
+
+			if (nColumn + nCount > COLUMNS) nCount = COLUMNS - nColumn;
+
+			unsigned int dwBackground	= bBar ? 1 : ((Random() % 4 == 0) ? Random() % 8 : 0);
+			unsigned int dwColor		= Random() % 16;
+			unsigned int dwFont			= (dwColor & 8) ? 1 : 0;
+
+			TextBatch::Rect rect = { nColumn * CELL_WIDTH, nRow * CELL_HEIGHT, (nColumn + nCount) * CELL_WIDTH, (nRow + 1) * CELL_HEIGHT };
+
+			if (dwBackground != 0) batch.AddFill(rect, dwBackground);
+			batch.AddRun(rect.nLeft, rect.nTop, rect, dwFont, dwColor, &text[nColumn], &advances[nColumn], nCount);
+
+			nColumn += nCount;
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,189 @@
+#include "stdafx.h"
+
+#include <map>
+
+#include "TextBatchFrame.h"
+#include "Check.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// paints the fills, each pixel once; returns false if they overlap
+static bool PaintFills(const vector<TextBatch::Fill>& fills, vector<unsigned int>& pixels)
+{
+	const int nWidth = COLUMNS * CELL_WIDTH;
+
+	pixels.assign(nWidth * ROWS * CELL_HEIGHT, 0);
+
+	for (size_t i = 0; i < fills.size(); ++i)
+	{
+		const TextBatch::Rect& rect = fills[i].rect;
+
+		for (int y = rect.nTop; y < rect.nBottom; ++y)
+		{
+			for (int x = rect.nLeft; x < rect.nRight; ++x)
+			{
+				if (pixels[y * nWidth + x] != 0) return false;
+				pixels[y * nWidth + x] = fills[i].dwColor;
+			}
+		}
+	}
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestSort()
+{
+	TextBatch batch;
+
+	AddFrame(batch, 6);
+
+	typedef std::map<std::pair<int, int>, std::pair<unsigned int, unsigned int>> RunMap;
+
+	vector<unsigned int>	before;
+	vector<unsigned int>	after;
+	RunMap					runsBefore;
+	RunMap					runsAfter;
+
+	CHECK(PaintFills(batch.GetFills(), before));
+
+	for (const auto& run : batch.GetRuns()) runsBefore[std::make_pair(run.nX, run.nY)] = std::make_pair(run.dwFont, run.dwColor);
+
+	TextBatch::Stats rowOrder = batch.GetStats();
+
+	batch.Sort();
+
+	TextBatch::Stats sorted = batch.GetStats();
+
+	// the same pixels with fewer fills
+	CHECK(PaintFills(batch.GetFills(), after));
+	CHECK(before == after);
+	CHECK(sorted.stFills < rowOrder.stFills);
+
+	// the same runs, their text moved with them
+	bool bText = true;
+
+	for (auto& run : batch.GetRuns())
+	{
+		runsAfter[std::make_pair(run.nX, run.nY)] = std::make_pair(run.dwFont, run.dwColor);
+
+		if ((batch.GetText(run)[0] != L'x') || (batch.GetAdvances(run)[run.nCount - 1] != CELL_WIDTH)) bText = false;
+	}
+
+	CHECK(sorted.stRuns == rowOrder.stRuns);
+	CHECK(runsBefore == runsAfter);
+	CHECK(bText);
+
+	// runs of a font and color stay in screen order
+	const vector<TextBatch::Run>&	runs	= batch.GetRuns();
+	bool							bOrder	= true;
+
+	for (size_t i = 1; i < runs.size(); ++i)
+	{
+		if ((runs[i].dwFont != runs[i - 1].dwFont) || (runs[i].dwColor != runs[i - 1].dwColor)) continue;
+		if ((runs[i].nY < runs[i - 1].nY) || ((runs[i].nY == runs[i - 1].nY) && (runs[i].nX <= runs[i - 1].nX))) bOrder = false;
+	}
+
+	CHECK(bOrder);
+
+	// a state change per font, color and brush
+	CHECK(sorted.stFontChanges == 2);
+	CHECK(sorted.stColorChanges <= 16 + 1);
+	CHECK(sorted.stBrushChanges <= 8);
+
+	// the bars are merged into one fill each
+	size_t stBars = 0;
+
+	for (const auto& fill : batch.GetFills())
+	{
+		if ((fill.dwColor == 1) && (fill.rect.nRight - fill.rect.nLeft == COLUMNS * CELL_WIDTH)) ++stBars;
+	}
+
+	CHECK(stBars == ROWS / 10);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestMerge()
+{
+	// two fills of a column merge down, the one next to them can't after
+	TextBatch		batch;
+	TextBatch::Rect	arrRects[] = { { 0, 0, 80, 16 }, { 0, 16, 80, 32 }, { 80, 0, 160, 16 }, { 0, 32, 80, 48 } };
+
+	batch.AddFill(arrRects[0], 5);
+	batch.AddFill(arrRects[1], 5);
+	batch.AddFill(arrRects[2], 5);
+	batch.AddFill(arrRects[3], 6);
+
+	batch.Sort();
+
+	CHECK(batch.GetFills().size() == 3);
+
+	batch.Clear();
+	CHECK(batch.IsEmpty());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestOrder()
+{
+	// fills out of row order, and colors and fonts added in no order
+	TextBatch		batch;
+	TextBatch::Rect	arrRects[] = { { 0, 16, 8, 32 }, { 8, 0, 16, 16 }, { 0, 0, 8, 16 }, { 8, 16, 16, 32 } };
+	const wchar_t	szText[] = L"a";
+	int				nAdvance = CELL_WIDTH;
+
+	batch.AddFill(arrRects[0], 0x00FF00);
+	batch.AddFill(arrRects[1], 0x0000FF);
+	batch.AddFill(arrRects[2], 0x00FF00);
+	batch.AddFill(arrRects[3], 0x0000FF);
+
+	const unsigned int arrRuns[][2] = { { 2, 0xC0C0C0 }, { 0, 0xFFFFFF }, { 2, 0x000080 }, { 0, 0x000080 }, { 0xFFFFFFFF, 0 }, { 0, 0xFFFFFF } };
+
+	for (int i = 0; i < 6; ++i) batch.AddRun(i * CELL_WIDTH, 0, arrRects[0], arrRuns[i][0], arrRuns[i][1], szText, &nAdvance, 1);
+
+	batch.Sort();
+
+	// a fill per color, both columns merged down
+	const vector<TextBatch::Fill>& fills = batch.GetFills();
+
+	CHECK(fills.size() == 2);
+	if (fills.size() == 2)
+	{
+		CHECK((fills[0].dwColor == 0x0000FF) && (fills[0].rect.nLeft == 8) && (fills[0].rect.nTop == 0) && (fills[0].rect.nBottom == 32));
+		CHECK((fills[1].dwColor == 0x00FF00) && (fills[1].rect.nLeft == 0) && (fills[1].rect.nTop == 0) && (fills[1].rect.nBottom == 32));
+	}
+
+	// runs by font, then color, then as added
+	const vector<TextBatch::Run>&	runs		= batch.GetRuns();
+	const int						arrOrder[]	= { 3, 1, 5, 2, 0, 4 };
+
+	CHECK(runs.size() == 6);
+	for (size_t i = 0; i < runs.size(); ++i) CHECK(runs[i].nX == arrOrder[i] * CELL_WIDTH);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+	TestSort();
+	TestMerge();
+	TestOrder();
+
+	return TEST_EXIT("TextBatchTest");
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,110 @@
+#include "stdafx.h"
+
+#include <chrono>
+#include <sstream>
+#include <thread>
+
+#include "Check.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Cost of a trace event on the recording thread, built with _TRACE_EVENTS
+// (see the Makefile). A scope is a begin and an end event, each reads the
+// tick counter once; the budget is 20 ns an event, clock read included.
+// The read is a few ns on bare metal, but a hypervisor may trap rdtsc and
+// make it cost about the whole budget. The budget is only checked where the
+// read leaves at least half of it; elsewhere the bench says so instead.
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static double TimeScopes(int nCount)
+{
+	auto start = chrono::steady_clock::now();
+
+	for (int i = 0; i < nCount; ++i)
+	{
+		TRACE_SCOPE("TracerBench::Scope");
+	}
+
+	return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / nCount;
+}
+
+static double TimeTicks(int nCount)
+{
+	volatile long long	llSink	= 0;
+	auto				start	= chrono::steady_clock::now();
+
+	for (int i = 0; i < nCount; ++i)
+	{
+		llSink = Tracer::GetTicks();
+	}
+
+	(void)llSink;
+
+	return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / nCount;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+	Tracer::Init();
+	TRACE_THREAD_NAME("TracerBench");
+
+	// warm up: first event allocates the thread's buffer
+	TimeScopes(100000);
+
+	const double dBudget = 20.0;
+
+	double dScope = 1e9;
+	double dTicks = 1e9;
+
+	for (int i = 0; i < 5; ++i)
+	{
+		dScope = min(dScope, TimeScopes(2000000));
+		dTicks = min(dTicks, TimeTicks(2000000));
+	}
+
+	double dEvent = dScope / 2;
+
+	::printf("TRACE_SCOPE: %.1f ns, %.1f ns/event (tick read %.1f ns)\n", dScope, dEvent, dTicks);
+
+	if (dTicks < dBudget / 2)
+	{
+		CHECK(dEvent < dBudget);
+	}
+	else
+	{
+		::printf("tick read takes over half the %.0f ns budget (rdtsc trapped?), budget not checked\n", dBudget);
+	}
+
+	// a second thread's events end up in the same dump
+	thread worker([]
+	{
+		TRACE_THREAD_NAME("TracerBench::Worker");
+		TRACE_INSTANT("TracerBench::Instant");
+		TRACE_COUNTER("TracerBench::Counter", 42);
+	});
+	worker.join();
+
+	ostringstream os;
+	Tracer::Dump(os);
+
+	// scopes as begin/end pairs
+	CHECK(os.str().find("\"ph\":\"B\"}") != string::npos);
+	CHECK(os.str().find("\"ph\":\"E\"}") != string::npos);
+	CHECK(os.str().find("TracerBench::Worker") != string::npos);
+	CHECK(os.str().find("TracerBench::Instant") != string::npos);
+	CHECK(os.str().find("\"name\":\"TracerBench::Counter\",\"cat\":\"console\"") != string::npos);
+	CHECK(os.str().find("\"ph\":\"C\",\"args\":{\"value\":42}}") != string::npos);
+
+	return TEST_EXIT("TracerBench");
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,241 @@
+#include "stdafx.h"
+
+#include "VisibilityState.h"
+#include "Check.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// The active view and the frame the way ConsoleView and MainFrame use
+// VisibilityState: console updates that come in while nothing is seen are
+// skipped and leave a catch-up pending, the frame turning visible again
+// paints it once.
+
+class FakeView
+{
+	public:
+
+		FakeView()
+		: m_bCatchUpPending(false)
+		, m_dwPaints(0)
+		, m_dwSkipped(0)
+		{
+		}
+
+		void OnConsoleUpdate(bool bRendering)
+		{
+			if (!bRendering)
+			{
+				m_bCatchUpPending = true;
+				++m_dwSkipped;
+				return;
+			}
+
+			++m_dwPaints;
+		}
+
+		void CatchUp()
+		{
+			if (!m_bCatchUpPending) return;
+
+			m_bCatchUpPending = false;
+			OnConsoleUpdate(true);
+		}
+
+		unsigned long GetPaints() const { return m_dwPaints; }
+		unsigned long GetSkipped() const { return m_dwSkipped; }
+
+	private:
+
+		bool			m_bCatchUpPending;
+		unsigned long	m_dwPaints;
+		unsigned long	m_dwSkipped;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+class FakeFrame
+{
+	public:
+
+		explicit FakeFrame(FakeView& view)
+		: m_view(view)
+		{
+		}
+
+		void SetVisibility(VisibilityState::Reason reason, bool bSet)
+		{
+			if (m_visibility.Set(reason, bSet) && m_visibility.IsVisible()) m_view.CatchUp();
+		}
+
+		// the occlusion timer only runs while occlusion can be checked
+		void CheckOcclusion(bool bOccluded)
+		{
+			if (m_visibility.CanBeOccluded()) SetVisibility(VisibilityState::reasonOccluded, bOccluded);
+		}
+
+		void ConsoleUpdates(int nUpdates)
+		{
+			for (int i = 0; i < nUpdates; ++i) m_view.OnConsoleUpdate(m_visibility.IsVisible());
+		}
+
+		const VisibilityState& GetVisibility() const { return m_visibility; }
+
+	private:
+
+		FakeView&		m_view;
+		VisibilityState	m_visibility;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void TestReasons()
+{
+	typedef VisibilityState V;
+
+	// minimize and restore: one change each way
+	{
+		V visibility;
+
+		CHECK(visibility.IsVisible());
+		CHECK(visibility.Set(V::reasonMinimized, true));
+		CHECK(!visibility.IsVisible());
+		CHECK(!visibility.Set(V::reasonMinimized, true));
+		CHECK(visibility.Set(V::reasonMinimized, false));
+		CHECK(visibility.IsVisible());
+		CHECK(visibility.GetHiddenCount() == 1);
+	}
+
+	// hidden in quake mode while locked: visible after both are gone
+	{
+		V visibility;
+
+		CHECK(visibility.Set(V::reasonHidden, true));
+		CHECK(!visibility.Set(V::reasonLocked, true));
+		CHECK(!visibility.Set(V::reasonHidden, false));
+		CHECK(!visibility.IsVisible());
+		CHECK(visibility.Set(V::reasonLocked, false));
+		CHECK(visibility.IsVisible());
+		CHECK(visibility.GetHiddenCount() == 1);
+	}
+
+	// occluded, then minimized: the occlusion is forgotten, and a late
+	// occlusion result while minimized is ignored
+	{
+		V visibility;
+
+		CHECK(visibility.CanBeOccluded());
+		CHECK(visibility.Set(V::reasonOccluded, true));
+		CHECK(!visibility.Set(V::reasonMinimized, true));
+		CHECK(visibility.GetReasons() == V::reasonMinimized);
+		CHECK(!visibility.CanBeOccluded());
+		CHECK(!visibility.Set(V::reasonOccluded, true));
+		CHECK(visibility.GetReasons() == V::reasonMinimized);
+		CHECK(visibility.Set(V::reasonMinimized, false));
+		CHECK(visibility.IsVisible());
+	}
+
+	// display off: occlusion can't be checked, but it's kept
+	{
+		V visibility;
+
+		CHECK(visibility.Set(V::reasonOccluded, true));
+		CHECK(!visibility.Set(V::reasonDisplayOff, true));
+		CHECK(!visibility.CanBeOccluded());
+		CHECK(!visibility.Set(V::reasonDisplayOff, false));
+		CHECK(!visibility.IsVisible());
+		CHECK(visibility.CanBeOccluded());
+		CHECK(visibility.Set(V::reasonOccluded, false));
+		CHECK(visibility.IsVisible());
+		CHECK(visibility.GetHiddenCount() == 1);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Covered by another window, minimized, the session locked and the machine
+// suspended, with the console writing all along, then back the other way.
+// Suspending turns the display off, which MainFrame gets as the monitor
+// power setting.
+
+static void TestCatchUp()
+{
+	typedef VisibilityState V;
+
+	FakeView	view;
+	FakeFrame	frame(view);
+
+	frame.ConsoleUpdates(5);
+	CHECK(view.GetPaints() == 5);
+
+	frame.CheckOcclusion(true);
+	frame.ConsoleUpdates(10);
+
+	frame.SetVisibility(V::reasonMinimized, true);
+	frame.ConsoleUpdates(10);
+
+	// an occlusion check that was already on its way
+	frame.CheckOcclusion(false);
+	frame.ConsoleUpdates(10);
+
+	frame.SetVisibility(V::reasonLocked, true);
+	frame.ConsoleUpdates(10);
+
+	frame.SetVisibility(V::reasonDisplayOff, true);
+	frame.ConsoleUpdates(10);
+
+	CHECK(frame.GetVisibility().GetReasons() == (V::reasonMinimized | V::reasonLocked | V::reasonDisplayOff));
+
+	// resume, unlock: still minimized, nothing painted
+	frame.SetVisibility(V::reasonDisplayOff, false);
+	frame.ConsoleUpdates(10);
+	frame.SetVisibility(V::reasonLocked, false);
+	frame.ConsoleUpdates(10);
+
+	CHECK(!frame.GetVisibility().IsVisible());
+	CHECK(view.GetPaints() == 5);
+	CHECK(view.GetSkipped() == 70);
+
+	// restored: one catch-up paint for everything that was skipped
+	frame.SetVisibility(V::reasonMinimized, false);
+
+	CHECK(frame.GetVisibility().IsVisible());
+	CHECK(view.GetPaints() == 6);
+
+	// nothing left to catch up on
+	frame.CheckOcclusion(false);
+	CHECK(view.GetPaints() == 6);
+
+	frame.ConsoleUpdates(5);
+	CHECK(view.GetPaints() == 11);
+
+	CHECK(frame.GetVisibility().GetHiddenCount() == 1);
+
+	::printf("occluded, minimized, locked, suspended: %lu updates skipped, 1 catch-up paint\n", view.GetSkipped());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+	TestReasons();
+	TestCatchUp();
+
+	return TEST_EXIT("VisibilityStateTest");
+}
+
+//////////////////////////////////////////////////////////////////////////////
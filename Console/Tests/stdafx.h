@@ -0,0 +1,79 @@
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Stands in for Console's stdafx.h when the portable modules are built for
+// the tests: the standard and boost headers they expect, the tracer, and
+// the few Win32 pieces LogonCache uses.
+
+#include <algorithm>
+#include <cstring>
+#include <cwchar>
+#include <cwctype>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+using namespace boost::multi_index;
+
+#include "../../shared/Tracer.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef _WIN32
+
+typedef void*	HANDLE;
+
+inline void SecureZeroMemory(void* pMemory, size_t stSize)
+{
+	volatile unsigned char* pBytes = static_cast<volatile unsigned char*>(pMemory);
+	while (stSize--) *pBytes++ = 0;
+}
+
+// same interface as the one in Helpers.h
+
+class CriticalSection
+{
+	public:
+
+		void Enter() { m_mutex.lock(); }
+		void Leave() { m_mutex.unlock(); }
+
+	private:
+
+		std::recursive_mutex m_mutex;
+};
+
+class CriticalSectionLock
+{
+	public:
+
+		explicit CriticalSectionLock(CriticalSection& critSection)
+		: m_critSection(critSection)
+		{
+			m_critSection.Enter();
+		}
+
+		~CriticalSectionLock()
+		{
+			m_critSection.Leave();
+		}
+
+	private:
+
+		CriticalSection& m_critSection;
+};
+
+#endif // _WIN32
+
+//////////////////////////////////////////////////////////////////////////////
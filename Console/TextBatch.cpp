@@ -0,0 +1,304 @@
+#include "stdafx.h"
+
+#include <algorithm>
+
+#include "TextBatch.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+TextBatch::TextBatch()
+: m_fills()
+, m_runs()
+, m_text()
+, m_advances()
+, m_sortedFills()
+, m_sortedRuns()
+, m_slots()
+, m_keys()
+, m_bucketOrder()
+, m_bucketStarts()
+, m_itemBuckets()
+, m_fillsAbove()
+, m_fillsRow()
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void TextBatch::Clear()
+{
+	// buffers are kept for the next frame
+	m_fills.clear();
+	m_runs.clear();
+	m_text.clear();
+	m_advances.clear();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void TextBatch::AddFill(const Rect& rect, unsigned int dwColor)
+{
+	Fill fill;
+
+	fill.rect		= rect;
+	fill.dwColor	= dwColor;
+
+	m_fills.push_back(fill);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void TextBatch::AddRun(int nX, int nY, const Rect& clip, unsigned int dwFont, unsigned int dwColor, const wchar_t* pszText, const int* pnAdvances, int nCount)
+{
+	if (nCount <= 0) return;
+
+	Run run;
+
+	run.nX		= nX;
+	run.nY		= nY;
+	run.clip	= clip;
+	run.dwFont	= dwFont;
+	run.dwColor	= dwColor;
+	run.stText	= m_text.size();
+	run.nCount	= nCount;
+
+	m_text.insert(m_text.end(), pszText, pszText + nCount);
+	m_advances.insert(m_advances.end(), pnAdvances, pnAdvances + nCount);
+
+	m_runs.push_back(run);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void TextBatch::Sort()
+{
+	// fills are added a row at a time, left to right; anything else is put
+	// in that order first
+	auto rowOrder = [](const Fill& a, const Fill& b)
+	{
+		if (a.rect.nTop != b.rect.nTop) return a.rect.nTop < b.rect.nTop;
+		return a.rect.nLeft < b.rect.nLeft;
+	};
+
+	if (!std::is_sorted(m_fills.begin(), m_fills.end(), rowOrder)) std::sort(m_fills.begin(), m_fills.end(), rowOrder);
+
+	// fills of a color stay in row order
+	BucketSort(m_fills, m_sortedFills, [](const Fill& fill) { return static_cast<unsigned long long>(fill.dwColor); });
+
+	MergeFillsAcross(m_fills);
+	MergeFillsDown(m_fills);
+
+	// runs of a font and color stay in screen order
+	BucketSort(m_runs, m_sortedRuns, [](const Run& run) { return (static_cast<unsigned long long>(run.dwFont) << 32) | run.dwColor; });
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+TextBatch::Stats TextBatch::GetStats() const
+{
+	Stats stats;
+
+	stats.stFills			= m_fills.size();
+	stats.stRuns			= m_runs.size();
+	stats.stBrushChanges	= 0;
+	stats.stFontChanges		= 0;
+	stats.stColorChanges	= 0;
+
+	for (size_t i = 0; i < m_fills.size(); ++i)
+	{
+		if ((i == 0) || (m_fills[i].dwColor != m_fills[i - 1].dwColor)) ++stats.stBrushChanges;
+	}
+
+	for (size_t i = 0; i < m_runs.size(); ++i)
+	{
+		if ((i == 0) || (m_runs[i].dwFont != m_runs[i - 1].dwFont)) ++stats.stFontChanges;
+		if ((i == 0) || (m_runs[i].dwColor != m_runs[i - 1].dwColor)) ++stats.stColorChanges;
+	}
+
+	return stats;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+template<typename T, typename KeyOf>
+void TextBatch::BucketSort(vector<T>& items, vector<T>& sorted, KeyOf keyOf)
+{
+	if (items.size() < 2) return;
+
+	// at least twice as many slots as items, the table is never half full
+	size_t	stSlots	= 16;
+	int		nBits	= 4;
+
+	while (stSlots < items.size() * 2)
+	{
+		stSlots *= 2;
+		++nBits;
+	}
+
+	m_slots.assign(stSlots, -1);
+	m_keys.clear();
+	m_itemBuckets.resize(items.size());
+
+	for (size_t i = 0; i < items.size(); ++i)
+	{
+		unsigned long long	qwKey	= keyOf(items[i]);
+		size_t				stSlot	= static_cast<size_t>((qwKey * 0x9E3779B97F4A7C15ull) >> (64 - nBits));
+
+		while ((m_slots[stSlot] >= 0) && (m_keys[m_slots[stSlot]] != qwKey)) stSlot = (stSlot + 1) & (stSlots - 1);
+
+		if (m_slots[stSlot] < 0)
+		{
+			m_slots[stSlot] = static_cast<int>(m_keys.size());
+			m_keys.push_back(qwKey);
+		}
+
+		m_itemBuckets[i] = static_cast<unsigned int>(m_slots[stSlot]);
+	}
+
+	// the buckets in key order, and where each one starts
+	m_bucketOrder.resize(m_keys.size());
+	for (size_t i = 0; i < m_bucketOrder.size(); ++i) m_bucketOrder[i] = static_cast<unsigned int>(i);
+
+	std::sort(m_bucketOrder.begin(), m_bucketOrder.end(), [this](unsigned int a, unsigned int b) { return m_keys[a] < m_keys[b]; });
+
+	m_bucketStarts.assign(m_keys.size(), 0);
+	for (size_t i = 0; i < items.size(); ++i) ++m_bucketStarts[m_itemBuckets[i]];
+
+	size_t stStart = 0;
+
+	for (size_t i = 0; i < m_bucketOrder.size(); ++i)
+	{
+		size_t stCount = m_bucketStarts[m_bucketOrder[i]];
+
+		m_bucketStarts[m_bucketOrder[i]] = stStart;
+		stStart += stCount;
+	}
+
+	sorted.resize(items.size());
+	for (size_t i = 0; i < items.size(); ++i) sorted[m_bucketStarts[m_itemBuckets[i]]++] = items[i];
+
+	items.swap(sorted);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void TextBatch::MergeFillsAcross(vector<Fill>& fills)
+{
+	if (fills.empty()) return;
+
+	size_t stLast = 0;
+
+	for (size_t i = 1; i < fills.size(); ++i)
+	{
+		Rect&		last	= fills[stLast].rect;
+		const Rect&	rect	= fills[i].rect;
+
+		if ((fills[i].dwColor == fills[stLast].dwColor) && (rect.nTop == last.nTop) && (rect.nBottom == last.nBottom) && (rect.nLeft == last.nRight))
+		{
+			last.nRight = rect.nRight;
+		}
+		else
+		{
+			fills[++stLast] = fills[i];
+		}
+	}
+
+	fills.resize(stLast + 1);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void TextBatch::MergeFillsDown(vector<Fill>& fills)
+{
+	// m_fillsAbove holds where the fills of the row above ended up, left to
+	// right, m_fillsRow the same for the row being merged
+	size_t			stOut		= 0;
+	size_t			stAbove		= 0;
+	int				nRowTop		= 0;
+	unsigned int	dwRowColor	= 0;
+
+	m_fillsAbove.clear();
+	m_fillsRow.clear();
+
+	for (size_t i = 0; i < fills.size(); ++i)
+	{
+		const Fill fill = fills[i];
+
+		if ((i == 0) || (fill.dwColor != dwRowColor) || (fill.rect.nTop != nRowTop))
+		{
+			// a new row; the one before is the row above unless the color changed
+			if ((i > 0) && (fill.dwColor == dwRowColor))
+			{
+				m_fillsAbove.swap(m_fillsRow);
+			}
+			else
+			{
+				m_fillsAbove.clear();
+			}
+
+			m_fillsRow.clear();
+
+			stAbove		= 0;
+			nRowTop		= fill.rect.nTop;
+			dwRowColor	= fill.dwColor;
+		}
+
+		while ((stAbove < m_fillsAbove.size()) && (fills[m_fillsAbove[stAbove]].rect.nLeft < fill.rect.nLeft)) ++stAbove;
+
+		if (stAbove < m_fillsAbove.size())
+		{
+			Rect& above = fills[m_fillsAbove[stAbove]].rect;
+
+			if ((above.nLeft == fill.rect.nLeft) && (above.nRight == fill.rect.nRight) && (above.nBottom == fill.rect.nTop))
+			{
+				above.nBottom = fill.rect.nBottom;
+				m_fillsRow.push_back(m_fillsAbove[stAbove++]);
+				continue;
+			}
+		}
+
+		fills[stOut] = fill;
+		m_fillsRow.push_back(stOut++);
+	}
+
+	fills.resize(stOut);
+}
+
+//////////////////////////////////////////////////////////////////////////////
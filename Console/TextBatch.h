@@ -0,0 +1,121 @@
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// A frame's text drawing: the cell background fills and text runs of all
+// the rows being repainted, collected before anything is drawn. Sort puts
+// fills of a color together and merges those that touch, and orders runs
+// by font, then color, so the DC's state changes once per font and color
+// in a frame instead of once per run.
+//
+// Fills never overlap and all go before the runs, and runs are drawn
+// transparent, so reordering them doesn't change what's drawn. Fonts and
+// colors are opaque numbers for the caller to map.
+//
+// A frame has thousands of runs but only a few fonts and colors, so Sort
+// buckets them with a counting sort, one pass to count and one to move
+// them, instead of comparing them. No Win32 dependency, it can be built
+// and tested on its own.
+
+class TextBatch
+{
+	public:
+
+		struct Rect
+		{
+			int	nLeft;
+			int	nTop;
+			int	nRight;
+			int	nBottom;
+		};
+
+		struct Fill
+		{
+			Rect			rect;
+			unsigned int	dwColor;
+		};
+
+		struct Run
+		{
+			int				nX;
+			int				nY;
+			Rect			clip;
+			unsigned int	dwFont;
+			unsigned int	dwColor;
+			// chars (or glyph indices) and advances, in the batch's buffers
+			size_t			stText;
+			int				nCount;
+		};
+
+		// what drawing the batch in its current order takes
+		struct Stats
+		{
+			size_t	stFills;
+			size_t	stRuns;
+			size_t	stBrushChanges;
+			size_t	stFontChanges;
+			size_t	stColorChanges;
+		};
+
+	public:
+
+		TextBatch();
+
+	public:
+
+		void Clear();
+
+		void AddFill(const Rect& rect, unsigned int dwColor);
+		void AddRun(int nX, int nY, const Rect& clip, unsigned int dwFont, unsigned int dwColor, const wchar_t* pszText, const int* pnAdvances, int nCount);
+
+		void Sort();
+
+		Stats GetStats() const;
+
+		bool IsEmpty() const { return m_fills.empty() && m_runs.empty(); }
+
+		const vector<Fill>& GetFills() const { return m_fills; }
+		const vector<Run>& GetRuns() const { return m_runs; }
+
+		const wchar_t* GetText(const Run& run) const { return &m_text[run.stText]; }
+		// not const, ExtTextOut takes them that way
+		int* GetAdvances(const Run& run) { return &m_advances[run.stText]; }
+
+	private:
+
+		// stable counting sort of items by key; keys are numbered through
+		// a hash table, then the few distinct ones are put in order
+		template<typename T, typename KeyOf>
+		void BucketSort(vector<T>& items, vector<T>& sorted, KeyOf keyOf);
+
+		// merges fills of a color in the same row that touch; fills must be
+		// grouped by color and in row order
+		static void MergeFillsAcross(vector<Fill>& fills);
+		// merges fills of a color into the one they continue in the row
+		// above; same order
+		void MergeFillsDown(vector<Fill>& fills);
+
+	private:
+
+		vector<Fill>	m_fills;
+		vector<Run>		m_runs;
+
+		vector<wchar_t>	m_text;
+		vector<int>		m_advances;
+
+		// BucketSort's and MergeFillsDown's buffers, kept across frames
+		vector<Fill>				m_sortedFills;
+		vector<Run>					m_sortedRuns;
+		vector<int>					m_slots;
+		vector<unsigned long long>	m_keys;
+		vector<unsigned int>		m_bucketOrder;
+		vector<size_t>				m_bucketStarts;
+		vector<unsigned int>		m_itemBuckets;
+		vector<size_t>				m_fillsAbove;
+		vector<size_t>				m_fillsRow;
+};
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,63 @@
+#include "stdafx.h"
+
+#include "VisibilityState.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+VisibilityState::VisibilityState()
+: m_dwReasons(0)
+, m_dwHiddenCount(0)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool VisibilityState::Set(Reason reason, bool bSet)
+{
+	bool bWasVisible = IsVisible();
+
+	// a late occlusion check for a frame that's gone already
+	if ((reason == reasonOccluded) && bSet && !CanBeOccluded()) return false;
+
+	if (bSet)
+	{
+		m_dwReasons |= reason;
+
+		// windows in front of a minimized or hidden frame don't matter, and
+		// they may be gone when it's shown again
+		if ((reason == reasonMinimized) || (reason == reasonHidden)) m_dwReasons &= ~reasonOccluded;
+	}
+	else
+	{
+		m_dwReasons &= ~reason;
+	}
+
+	if (IsVisible() == bWasVisible) return false;
+
+	if (bWasVisible) ++m_dwHiddenCount;
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool VisibilityState::CanBeOccluded() const
+{
+	return (m_dwReasons & (reasonMinimized | reasonHidden | reasonDisplayOff | reasonLocked)) == 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
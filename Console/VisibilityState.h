@@ -0,0 +1,58 @@
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Whether anything the main frame draws can be seen. Each reason it can't
+// is tracked on its own; the frame is visible when there's none left, and
+// only a change between visible and not is reported, so views render once
+// when the last reason goes away.
+//
+// Occlusion is only known while the frame is shown: minimizing or hiding
+// it forgets it, and it's checked again after the frame comes back.
+//
+// No Win32 dependency, it can be built and tested on its own.
+
+class VisibilityState
+{
+	public:
+
+		enum Reason
+		{
+			reasonMinimized		= 0x01,
+			// hidden in quake mode or to the tray
+			reasonHidden		= 0x02,
+			// covered by other windows
+			reasonOccluded		= 0x04,
+			reasonDisplayOff	= 0x08,
+			reasonLocked		= 0x10
+		};
+
+	public:
+
+		VisibilityState();
+
+	public:
+
+		// returns true if the frame went from visible to not or back
+		bool Set(Reason reason, bool bSet);
+
+		bool IsVisible() const { return m_dwReasons == 0; }
+		unsigned long GetReasons() const { return m_dwReasons; }
+
+		// true while the frame is on a screen that's on, other windows are
+		// all that can hide it
+		bool CanBeOccluded() const;
+
+		// times the frame stopped being visible
+		unsigned long GetHiddenCount() const { return m_dwHiddenCount; }
+
+	private:
+
+		unsigned long	m_dwReasons;
+		unsigned long	m_dwHiddenCount;
+};
+
+//////////////////////////////////////////////////////////////////////////////
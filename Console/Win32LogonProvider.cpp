@@ -0,0 +1,106 @@
+#include "stdafx.h"
+
+#include <wincrypt.h>
+
+#include "Win32LogonProvider.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+HANDLE Win32LogonProvider::LogonUser(const wstring& strUser, const wstring& strDomain, const wstring& strPassword)
+{
+	HANDLE hUserToken = NULL;
+
+	if (!::LogonUser(
+			strUser.c_str(),
+			strDomain.length() > 0 ? strDomain.c_str() : NULL,
+			strPassword.c_str(),
+			LOGON32_LOGON_INTERACTIVE,
+			LOGON32_PROVIDER_DEFAULT,
+			&hUserToken))
+	{
+		Win32Exception::ThrowFromLastError();
+	}
+
+	return hUserToken;
+}
+
+void* Win32LogonProvider::CreateEnvironmentBlock(HANDLE hToken)
+{
+	void* pEnvironment = nullptr;
+
+	if (!::CreateEnvironmentBlock(&pEnvironment, hToken, FALSE))
+	{
+		Win32Exception::ThrowFromLastError();
+	}
+
+	return pEnvironment;
+}
+
+void Win32LogonProvider::CloseToken(HANDLE hToken)
+{
+	::CloseHandle(hToken);
+}
+
+void Win32LogonProvider::DestroyEnvironmentBlock(void* pEnvironment)
+{
+	::DestroyEnvironmentBlock(pEnvironment);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+void Win32LogonProvider::GenRandom(unsigned char* pBuffer, size_t stSize)
+{
+	HCRYPTPROV hProv = NULL;
+
+	if (!::CryptAcquireContext(&hProv, NULL, NULL, PROV_RSA_AES, CRYPT_VERIFYCONTEXT | CRYPT_SILENT))
+	{
+		Win32Exception::ThrowFromLastError();
+	}
+
+	std::shared_ptr<void> prov(reinterpret_cast<void*>(hProv), [](void* p) { ::CryptReleaseContext(reinterpret_cast<HCRYPTPROV>(p), 0); });
+
+	if (!::CryptGenRandom(hProv, static_cast<DWORD>(stSize), pBuffer))
+	{
+		Win32Exception::ThrowFromLastError();
+	}
+}
+
+void Win32LogonProvider::Hash(const unsigned char* pData, size_t stSize, unsigned char* pHash)
+{
+	HCRYPTPROV	hProv		= NULL;
+	HCRYPTHASH	hHash		= NULL;
+	DWORD		dwHashSize	= HASH_SIZE;
+
+	if (!::CryptAcquireContext(&hProv, NULL, NULL, PROV_RSA_AES, CRYPT_VERIFYCONTEXT | CRYPT_SILENT))
+	{
+		Win32Exception::ThrowFromLastError();
+	}
+
+	std::shared_ptr<void> prov(reinterpret_cast<void*>(hProv), [](void* p) { ::CryptReleaseContext(reinterpret_cast<HCRYPTPROV>(p), 0); });
+
+	if (!::CryptCreateHash(hProv, CALG_SHA_256, 0, 0, &hHash))
+	{
+		Win32Exception::ThrowFromLastError();
+	}
+
+	std::shared_ptr<void> hash(reinterpret_cast<void*>(hHash), [](void* p) { ::CryptDestroyHash(reinterpret_cast<HCRYPTHASH>(p)); });
+
+	if (!::CryptHashData(hHash, pData, static_cast<DWORD>(stSize), 0) ||
+		!::CryptGetHashParam(hHash, HP_HASHVAL, pHash, &dwHashSize, 0))
+	{
+		Win32Exception::ThrowFromLastError();
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "LogonCache.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// LogonProvider making the real LogonUser and CreateEnvironmentBlock calls,
+// salts and hashes come from the CryptoAPI AES provider.
+
+class Win32LogonProvider : public LogonProvider
+{
+	public:
+
+		virtual HANDLE LogonUser(const wstring& strUser, const wstring& strDomain, const wstring& strPassword);
+		virtual void* CreateEnvironmentBlock(HANDLE hToken);
+
+		virtual void CloseToken(HANDLE hToken);
+		virtual void DestroyEnvironmentBlock(void* pEnvironment);
+
+		virtual void GenRandom(unsigned char* pBuffer, size_t stSize);
+		virtual void Hash(const unsigned char* pData, size_t stSize, unsigned char* pHash);
+};
+
+//////////////////////////////////////////////////////////////////////////////
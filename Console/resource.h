@@ -257,6 +257,7 @@
 #define IDC_CHECK_CONFIRM_CLOSE_MULTI   1190
 #define IDC_BTN_INHERIT_COLORS          1191
 #define IDC_BTN_IMPORT_COLORS           1192
+#define IDC_COMBO_LOCAL_ECHO            1193
 #define ID_NEW_TAB_1                    2000
 #define ID_SWITCH_TAB_1                 2100
 #define ID_NEXT_TAB                     2200
@@ -276,6 +277,11 @@
 #define ID_TOP_VIEW                     2214
 #define ID_BOTTOM_VIEW                  2215
 #define IDC_DUMP_BUFFER                 3000
+#define IDC_DUMP_TRACE                  3001
+#define IDC_DUMP_LATENCY                3002
+#define IDC_LATENCY_OVERLAY             3003
+#define IDC_DUMP_IMAGES                 3004
+#define IDC_DUMP_VIEWS                  3005
 #define IDS_ERR_CANT_START_SHELL        5000
 #define IDS_ERR_CANT_START_SHELL_AS_USER 5001
 #define IDS_ERR_DLL_INJECTION_FAILED    5002
@@ -308,7 +314,7 @@
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE        219
 #define _APS_NEXT_COMMAND_VALUE         32797
-#define _APS_NEXT_CONTROL_VALUE         1193
+#define _APS_NEXT_CONTROL_VALUE         1194
 #define _APS_NEXT_SYMED_VALUE           101
 #endif
 #endif
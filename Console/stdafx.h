@@ -45,6 +45,7 @@ extern CAppModule _Module;
 #pragma warning(pop)
 
 #include <userenv.h>
+#include <wtsapi32.h>
 
 #pragma warning(push)
 #pragma warning(disable: 4189 4267)
@@ -118,6 +119,7 @@ using namespace boost::multi_index;
 #include "../shared/Structures.h"
 
 #include "../shared/Cpp11Helpers.h"
+#include "../shared/Tracer.h"
 #include "../shared/Win32Exception.h"
 #include "Helpers.h"
 #include "ConsoleHandler.h"
@@ -159,9 +161,12 @@ using namespace boost::multi_index;
 #define UM_SHOW_POPUP_MENU		WM_USER + 0x1004
 #define UM_START_MOUSE_DRAG		WM_USER + 0x1005
 #define UM_TRAY_NOTIFY			WM_USER + 0x1006
+#define UM_IMAGE_RESCALED		WM_USER + 0x1007
+#define UM_IMAGE_DECODED		WM_USER + 0x1008
 
 #define UPDATE_CONSOLE_RESIZE		0x0001
 #define UPDATE_CONSOLE_TEXT_CHANGED	0x0002
+#define UPDATE_CONSOLE_TITLE_CHANGED	0x0004
 
 #define IDC_TRAY_ICON		0x0001
 
@@ -1,12 +1,95 @@
 #include "stdafx.h"
 using namespace std;
 
+#ifdef _TRACE_EVENTS
+#include <fstream>
+#include <sstream>
+#endif
+
 #include "../shared/SharedMemNames.h"
 #include "ConsoleHandler.h"
 
 //////////////////////////////////////////////////////////////////////////////
 
 
+//////////////////////////////////////////////////////////////////////////////
+
+// FNV-1a, good enough to tell titles apart
+static DWORD HashTitle(const wchar_t* pszTitle)
+{
+	DWORD dwHash = 2166136261;
+
+	for (; *pszTitle != L'\0'; ++pszTitle)
+	{
+		dwHash ^= static_cast<DWORD>(*pszTitle);
+		dwHash *= 16777619;
+	}
+
+	return dwHash;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// reads sRows rows of the console window, starting sFirstRow rows from its
+// top, into the same rows of pScreenBuffer (which holds the whole window)
+static void ReadConsoleRows(HANDLE hStdOut, const SMALL_RECT& srWindow, SHORT sFirstRow, SHORT sRows, CHAR_INFO* pScreenBuffer)
+{
+	COORD		coordBufferSize;
+	// start coordinates for the buffer are always (0, 0) - we use offset
+	COORD		coordStart = {0, 0};
+	SMALL_RECT	srBuffer;
+
+	DWORD		dwScreenBufferOffset = sFirstRow * (srWindow.Right - srWindow.Left + 1);
+
+	// ReadConsoleOutput seems to fail for large (around 6k CHAR_INFO's) buffers
+	// here we calculate max buffer size (row count) for safe reading
+	coordBufferSize.X	= srWindow.Right - srWindow.Left + 1;
+	coordBufferSize.Y	= 6144 / coordBufferSize.X;
+
+	// initialize reading rectangle
+	srBuffer.Top		= srWindow.Top + sFirstRow;
+	srBuffer.Bottom		= srBuffer.Top + coordBufferSize.Y - 1;
+	srBuffer.Left		= srWindow.Left;
+	srBuffer.Right		= srWindow.Right;
+
+	// read rows 'chunks'
+	SHORT i = 0;
+	for (; i < sRows / coordBufferSize.Y; ++i)
+	{
+		::ReadConsoleOutput(
+			hStdOut, 
+			pScreenBuffer + dwScreenBufferOffset, 
+			coordBufferSize, 
+			coordStart, 
+			&srBuffer);
+
+		srBuffer.Top		= srBuffer.Top + coordBufferSize.Y;
+		srBuffer.Bottom		= srBuffer.Bottom + coordBufferSize.Y;
+
+		dwScreenBufferOffset += coordBufferSize.X * coordBufferSize.Y;
+	}
+
+	// read the last 'chunk', we need to calculate the number of rows in the
+	// last chunk and update bottom coordinate for the region
+	coordBufferSize.Y	= sRows - i * coordBufferSize.Y;
+	srBuffer.Bottom		= srWindow.Top + sFirstRow + sRows - 1;
+
+	if (coordBufferSize.Y == 0) return;
+
+	::ReadConsoleOutput(
+		hStdOut, 
+		pScreenBuffer + dwScreenBufferOffset, 
+		coordBufferSize, 
+		coordStart, 
+		&srBuffer);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
 //////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
@@ -27,6 +110,9 @@ ConsoleHandler::ConsoleHandler()
 , m_hMonitorThread()
 , m_hMonitorThreadExit(std::shared_ptr<void>(::CreateEvent(NULL, FALSE, FALSE, NULL), ::CloseHandle))
 , m_dwScreenBufferSize(0)
+, m_lWakeSeq(0)
+, m_llWakeTime(0)
+, m_dwTitleHash(0)
 {
 }
 
@@ -108,7 +194,7 @@ bool ConsoleHandler::OpenSharedObjects()
     m_consoleTextInfo.Open((SharedMemNames::formatTextInfo % dwProcessId).str(), syncObjBoth);
 
     // mouse event
-    m_consoleMouseEvent.Open((SharedMemNames::formatMouseEvent % dwProcessId).str(), syncObjBoth);
+    m_consoleMouseEvent.Open((SharedMemNames::formatMouseEvent % dwProcessId).str(), syncObjRequest);
 
     // open new console size shared memory object
     m_newConsoleSize.Open((SharedMemNames::formatNewConsoleSize % dwProcessId).str(), syncObjRequest);
@@ -130,8 +216,10 @@ bool ConsoleHandler::OpenSharedObjects()
 
 //////////////////////////////////////////////////////////////////////////////
 
-void ConsoleHandler::ReadConsoleBuffer()
+void ConsoleHandler::ReadConsoleBuffer(bool bScrolled)
 {
+	TRACE_SCOPE("ConsoleHook::ReadConsoleBuffer");
+
 	// we take a fresh STDOUT handle - seems to work better (in case a program
 	// has opened a new screen output buffer)
 	// no need to call CloseHandle when done, we're reusing console handles
@@ -171,72 +259,51 @@ void ConsoleHandler::ReadConsoleBuffer()
 
 	// do console output buffer reading
 	DWORD					dwScreenBufferSize	= coordConsoleSize.X * coordConsoleSize.Y;
-	DWORD					dwScreenBufferOffset= 0;
 
 	std::unique_ptr<CHAR_INFO[]> pScreenBuffer(new CHAR_INFO[dwScreenBufferSize]);
 
-	COORD		coordBufferSize;
-	// start coordinates for the buffer are always (0, 0) - we use offset
-	COORD		coordStart = {0, 0};
-	SMALL_RECT	srBuffer;
-
-//	TRACE(L"===================================================================\n");
-
-	// ReadConsoleOutput seems to fail for large (around 6k CHAR_INFO's) buffers
-	// here we calculate max buffer size (row count) for safe reading
-	coordBufferSize.X	= csbiConsole.srWindow.Right - csbiConsole.srWindow.Left + 1;
-	coordBufferSize.Y	= 6144 / coordBufferSize.X;
-
-	// initialize reading rectangle
-	srBuffer.Top		= csbiConsole.srWindow.Top;
-	srBuffer.Bottom		= csbiConsole.srWindow.Top + coordBufferSize.Y - 1;
-	srBuffer.Left		= csbiConsole.srWindow.Left;
-	srBuffer.Right		= csbiConsole.srWindow.Left + csbiConsole.srWindow.Right - csbiConsole.srWindow.Left;
-
-/*
-	TRACE(L"Buffer size for loop reads: %ix%i\n", coordBufferSize.X, coordBufferSize.Y);
-	TRACE(L"-------------------------------------------------------------------\n");
-*/
-
-	// read rows 'chunks'
-	SHORT i = 0;
-	for (; i < coordConsoleSize.Y / coordBufferSize.Y; ++i)
+	// after our own scroll, rows still in view are taken from the buffer we
+	// published and only the rows scrolled into view are read; output that
+	// changed the kept rows meanwhile shows up on the next refresh
+	const SMALL_RECT&	srPublished	= m_consoleInfo->csbi.srWindow;
+	int					nScrolled	= csbiConsole.srWindow.Top - srPublished.Top;
+
+	if (bScrolled &&
+		(m_dwScreenBufferSize == dwScreenBufferSize) &&
+		(csbiConsole.srWindow.Left == srPublished.Left) &&
+		(csbiConsole.srWindow.Right == srPublished.Right) &&
+		(nScrolled != 0) &&
+		(abs(nScrolled) < coordConsoleSize.Y))
 	{
-//		TRACE(L"Reading region: (%i, %i) - (%i, %i)\n", srBuffer.Left, srBuffer.Top, srBuffer.Right, srBuffer.Bottom);
-
-		::ReadConsoleOutput(
-			hStdOut.get(), 
-			pScreenBuffer.get() + dwScreenBufferOffset, 
-			coordBufferSize, 
-			coordStart, 
-			&srBuffer);
-
-		srBuffer.Top		= srBuffer.Top + coordBufferSize.Y;
-		srBuffer.Bottom		= srBuffer.Bottom + coordBufferSize.Y;
-
-		dwScreenBufferOffset += coordBufferSize.X * coordBufferSize.Y;
+		SHORT	sKeptRows	= static_cast<SHORT>(coordConsoleSize.Y - abs(nScrolled));
+		SHORT	sFirstKept	= (nScrolled > 0) ? 0 : static_cast<SHORT>(-nScrolled);
+
+		// only we write the published buffer, no need to lock it for reading
+		::CopyMemory(
+			pScreenBuffer.get() + sFirstKept * coordConsoleSize.X,
+			m_consoleBuffer.Get() + ((nScrolled > 0) ? nScrolled : 0) * coordConsoleSize.X,
+			sKeptRows * coordConsoleSize.X * sizeof(CHAR_INFO));
+
+		ReadConsoleRows(
+			hStdOut.get(),
+			csbiConsole.srWindow,
+			(nScrolled > 0) ? sKeptRows : 0,
+			static_cast<SHORT>(abs(nScrolled)),
+			pScreenBuffer.get());
+	}
+	else
+	{
+		ReadConsoleRows(hStdOut.get(), csbiConsole.srWindow, 0, coordConsoleSize.Y, pScreenBuffer.get());
 	}
 
-	// read the last 'chunk', we need to calculate the number of rows in the
-	// last chunk and update bottom coordinate for the region
-	coordBufferSize.Y	= coordConsoleSize.Y - i * coordBufferSize.Y;
-	srBuffer.Bottom		= csbiConsole.srWindow.Bottom;
-
-/*
-	TRACE(L"Buffer size for last read: %ix%i\n", coordBufferSize.X, coordBufferSize.Y);
-	TRACE(L"-------------------------------------------------------------------\n");
-	TRACE(L"Reading region: (%i, %i) - (%i, %i)\n", srBuffer.Left, srBuffer.Top, srBuffer.Right, srBuffer.Bottom);
-*/
-
-	::ReadConsoleOutput(
-		hStdOut.get(), 
-		pScreenBuffer.get() + dwScreenBufferOffset, 
-		coordBufferSize, 
-		coordStart, 
-		&srBuffer);
+	// the title is read here, in-process, so Console doesn't have to ask the
+	// console window for it on every update
+	wchar_t	szTitle[1024];
+	DWORD	dwTitleHash = 0;
 
+	if (::GetConsoleTitle(szTitle, _countof(szTitle)) > 0) dwTitleHash = HashTitle(szTitle);
 
-//	TRACE(L"===================================================================\n");
+	bool titleChanged = (dwTitleHash != m_dwTitleHash);
 
 	// compare previous buffer, and if different notify Console
 	SharedMemoryLock consoleInfoLock(m_consoleInfo);
@@ -246,11 +313,30 @@ void ConsoleHandler::ReadConsoleBuffer()
 
 	if ((::memcmp(&m_consoleInfo->csbi, &csbiConsole, sizeof(CONSOLE_SCREEN_BUFFER_INFO)) != 0) ||
 		(m_dwScreenBufferSize != dwScreenBufferSize) ||
-		textChanged)
+		textChanged ||
+		titleChanged)
 	{
+		if (titleChanged)
+		{
+			m_dwTitleHash = dwTitleHash;
+			++m_consoleInfo->dwTitleSeq;
+		}
+
 		// update screen buffer variables
 		m_dwScreenBufferSize = dwScreenBufferSize;
 
+		// first text change since new input arrived, stamp it for Console's
+		// latency statistics
+		if (textChanged && (m_lWakeSeq != m_consoleInfo->lReadSeq))
+		{
+			LARGE_INTEGER liReadTime;
+			::QueryPerformanceCounter(&liReadTime);
+
+			m_consoleInfo->lReadSeq		= m_lWakeSeq;
+			m_consoleInfo->llWakeTime	= m_llWakeTime;
+			m_consoleInfo->llReadTime	= liReadTime.QuadPart;
+		}
+
 		::CopyMemory(&m_consoleInfo->csbi, &csbiConsole, sizeof(CONSOLE_SCREEN_BUFFER_INFO));
 		
 		// only Console sets the flag to false, after it's done repainting text
@@ -1000,17 +1086,22 @@ void ConsoleHandler::SendConsoleText(HANDLE hStdIn, const std::shared_ptr<wchar_
 
 //////////////////////////////////////////////////////////////////////////////
 
-void ConsoleHandler::SendMouseEvent(HANDLE hStdIn)
+void ConsoleHandler::SendMouseEvents(HANDLE hStdIn, const MOUSE_EVENT_RECORD* pMouseEvents, DWORD dwCount)
 {
+	if (dwCount == 0) return;
+
 	DWORD	dwEvents = 0;
 
-	INPUT_RECORD mouseEvent;
-	::ZeroMemory(&mouseEvent, sizeof(INPUT_RECORD));
+	INPUT_RECORD mouseEvents[MouseEventQueue::CAPACITY];
+	::ZeroMemory(mouseEvents, sizeof(INPUT_RECORD) * dwCount);
 
-	mouseEvent.EventType	= MOUSE_EVENT;
+	for (DWORD i = 0; i < dwCount; ++i)
+	{
+		mouseEvents[i].EventType		= MOUSE_EVENT;
+		mouseEvents[i].Event.MouseEvent	= pMouseEvents[i];
+	}
 
-	::CopyMemory(&mouseEvent.Event.MouseEvent, m_consoleMouseEvent.Get(), sizeof(MOUSE_EVENT_RECORD));
-	::WriteConsoleInput(hStdIn, &mouseEvent, 1, &dwEvents);
+	::WriteConsoleInput(hStdIn, mouseEvents, dwCount, &dwEvents);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -1018,7 +1109,7 @@ void ConsoleHandler::SendMouseEvent(HANDLE hStdIn)
 
 //////////////////////////////////////////////////////////////////////////////
 
-void ConsoleHandler::ScrollConsole(HANDLE hStdOut, int nXDelta, int nYDelta)
+bool ConsoleHandler::ScrollConsole(HANDLE hStdOut, const ConsoleScroll& consoleScroll)
 {
 	CONSOLE_SCREEN_BUFFER_INFO csbi;
 	::GetConsoleScreenBufferInfo(hStdOut, &csbi);
@@ -1026,17 +1117,22 @@ void ConsoleHandler::ScrollConsole(HANDLE hStdOut, int nXDelta, int nYDelta)
 	int nXCurrentPos = csbi.srWindow.Right - m_consoleParams->dwColumns + 1;
 	int nYCurrentPos = csbi.srWindow.Bottom - m_consoleParams->dwRows + 1;
 
+	int nXDelta = consoleScroll.x.GetPosition(nXCurrentPos) - nXCurrentPos;
+	int nYDelta = consoleScroll.y.GetPosition(nYCurrentPos) - nYCurrentPos;
+
 	// limit deltas
 	nXDelta = max(-nXCurrentPos, min(nXDelta, (int)(m_consoleParams->dwBufferColumns-m_consoleParams->dwColumns) - nXCurrentPos));
 	nYDelta = max(-nYCurrentPos, min(nYDelta, (int)(m_consoleParams->dwBufferRows-m_consoleParams->dwRows) - nYCurrentPos));
 
+	if ((nXDelta == 0) && (nYDelta == 0)) return false;
+
 	SMALL_RECT sr;
 	sr.Top		= static_cast<SHORT>(nYDelta);
 	sr.Bottom	= static_cast<SHORT>(nYDelta);
 	sr.Left		= static_cast<SHORT>(nXDelta);
 	sr.Right	= static_cast<SHORT>(nXDelta);
 
-	::SetConsoleWindowInfo(hStdOut, FALSE, &sr);
+	return (::SetConsoleWindowInfo(hStdOut, FALSE, &sr) != FALSE);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -1068,6 +1164,14 @@ void ConsoleHandler::SetConsoleParams(DWORD dwHookThreadId, HANDLE hStdOut)
 	m_consoleParams->hwndConsoleWindow	= ::GetConsoleWindow();
 	m_consoleParams->dwHookThreadId		= dwHookThreadId;
 
+	// report kernel32 image base and timestamp
+	HMODULE				hKernel32	= ::GetModuleHandle(L"kernel32.dll");
+	PIMAGE_DOS_HEADER	pDosHeader	= reinterpret_cast<PIMAGE_DOS_HEADER>(hKernel32);
+	PIMAGE_NT_HEADERS	pNtHeaders	= reinterpret_cast<PIMAGE_NT_HEADERS>(reinterpret_cast<BYTE*>(hKernel32) + pDosHeader->e_lfanew);
+
+	m_consoleParams->dwKernel32Base			= static_cast<DWORD>(reinterpret_cast<UINT_PTR>(hKernel32));
+	m_consoleParams->dwKernel32TimeStamp	= pNtHeaders->FileHeader.TimeDateStamp;
+
 	TRACE(L"Max columns: %i, max rows: %i\n", m_consoleParams->dwMaxColumns, m_consoleParams->dwMaxRows);
 
 	// get initial window and cursor info
@@ -1101,6 +1205,12 @@ DWORD WINAPI ConsoleHandler::MonitorThreadStatic(LPVOID lpParameter)
 DWORD ConsoleHandler::MonitorThread()
 {
 	TRACE(L"Hook!\n");
+#ifdef _TRACE_EVENTS
+	// not in DllMain, it allocates under the loader lock; this thread is the
+	// only one the hook traces on
+	Tracer::Init();
+#endif
+	TRACE_THREAD_NAME("ConsoleHook::MonitorThread");
 
 	// TODO: error handling
 	// open shared objects (shared memory, events, etc)
@@ -1126,7 +1236,10 @@ DWORD ConsoleHandler::MonitorThread()
 
 	SetConsoleParams(::GetCurrentThreadId(), hStdOut);
 
-	if (::WaitForSingleObject(m_consoleParams.GetRespEvent(), 10000) == WAIT_TIMEOUT) return 0;
+	{
+		TRACE_SCOPE("ConsoleHook::WaitForConsole");
+		if (::WaitForSingleObject(m_consoleParams.GetRespEvent(), 10000) == WAIT_TIMEOUT) return 0;
+	}
 
 	ResizeConsoleWindow(hStdOut, m_consoleParams->dwColumns, m_consoleParams->dwRows, 0);
 
@@ -1148,6 +1261,9 @@ DWORD ConsoleHandler::MonitorThread()
 	};
 
 	DWORD	dwWaitRes		= 0;
+#ifdef _TRACE_EVENTS
+	DWORD	dwLastTraceDump	= ::GetTickCount();
+#endif
 
 	while ((dwWaitRes = ::WaitForMultipleObjects(
 							sizeof(arrWaitHandles)/sizeof(arrWaitHandles[0]),
@@ -1162,6 +1278,17 @@ DWORD ConsoleHandler::MonitorThread()
 			break;
 		}
 
+		// keep the input sequence number we woke up with, a text change read
+		// after this point is attributed to it
+		if (m_lWakeSeq != m_consoleInfo->lInputSeq)
+		{
+			LARGE_INTEGER liWakeTime;
+			::QueryPerformanceCounter(&liWakeTime);
+
+			m_lWakeSeq		= m_consoleInfo->lInputSeq;
+			m_llWakeTime	= liWakeTime.QuadPart;
+		}
+
 		switch (dwWaitRes)
 		{
 			// copy request
@@ -1196,20 +1323,35 @@ DWORD ConsoleHandler::MonitorThread()
 			// console scroll request
 			case WAIT_OBJECT_0 + 3 :
 			{
-				SharedMemoryLock memLock(m_newScrollPos);
+				// everything Console asked for since the last wake, scrolled
+				// in one go
+				ConsoleScroll consoleScroll;
 
-				ScrollConsole(hStdOut, m_newScrollPos->cx, m_newScrollPos->cy);
-				ReadConsoleBuffer();
+				{
+					SharedMemoryLock memLock(m_newScrollPos);
+
+					consoleScroll	= *m_newScrollPos;
+					m_newScrollPos	= ConsoleScroll();
+				}
+
+				if (ScrollConsole(hStdOut, consoleScroll)) ReadConsoleBuffer(true);
 				break;
 			}
 
-			// mouse event request
+			// mouse events queued
 			case WAIT_OBJECT_0 + 4 :
 			{
-				SharedMemoryLock memLock(m_consoleMouseEvent);
+				MOUSE_EVENT_RECORD	mouseEvents[MouseEventQueue::CAPACITY];
+				DWORD				dwCount = 0;
+
+				// Console keeps queueing while we write to the console input
+				{
+					SharedMemoryLock memLock(m_consoleMouseEvent);
+
+					dwCount = m_consoleMouseEvent->Pop(mouseEvents, MouseEventQueue::CAPACITY);
+				}
 
-				SendMouseEvent(hStdIn);
-				m_consoleMouseEvent.SetRespEvent();
+				SendMouseEvents(hStdIn, mouseEvents, dwCount);
 				break;
 			}
 
@@ -1235,10 +1377,48 @@ DWORD ConsoleHandler::MonitorThread()
 				break;
 			}
 		}
+
+#ifdef _TRACE_EVENTS
+		// the process can go away through ExitProcess without ever setting
+		// the exit event, so keep the trace file reasonably fresh
+		if (::GetTickCount() - dwLastTraceDump >= 5000)
+		{
+			DumpTrace();
+			dwLastTraceDump = ::GetTickCount();
+		}
+#endif
 	}
 
+#ifdef _TRACE_EVENTS
+	DumpTrace();
+#endif
+
 	return 0;
 }
 
 //////////////////////////////////////////////////////////////////////////////
 
+
+//////////////////////////////////////////////////////////////////////////////
+
+#ifdef _TRACE_EVENTS
+
+// written from the monitor thread, DllMain runs under the loader lock and
+// must not touch files
+void ConsoleHandler::DumpTrace()
+{
+	// one trace per console process, timestamps line up with Console's trace
+	wchar_t szTempPath[MAX_PATH] = L"";
+	::GetTempPath(MAX_PATH, szTempPath);
+
+	wstringstream strFileName;
+	strFileName << szTempPath << L"ConsoleHook." << ::GetCurrentProcessId() << L".trace.json";
+
+	ofstream of(strFileName.str().c_str());
+	Tracer::Dump(of);
+}
+
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+
@@ -25,7 +25,9 @@ class ConsoleHandler
 
 		bool OpenSharedObjects();
 
-		void ReadConsoleBuffer();
+		// bScrolled: the window was just scrolled by us, only the rows scrolled
+		// into view need reading
+		void ReadConsoleBuffer(bool bScrolled = false);
 
 		void ResizeConsoleWindow(HANDLE hStdOut, DWORD& dwColumns, DWORD& dwRows, DWORD dwResizeWindowEdge);
 
@@ -33,12 +35,16 @@ class ConsoleHandler
 
 		void SendConsoleText(HANDLE hStdIn, const std::shared_ptr<wchar_t>& textBuffer);
 
-		void SendMouseEvent(HANDLE hStdIn);
+		void SendMouseEvents(HANDLE hStdIn, const MOUSE_EVENT_RECORD* pMouseEvents, DWORD dwCount);
 
-		void ScrollConsole(HANDLE hStdOut, int nXDelta, int nYDelta);
+		bool ScrollConsole(HANDLE hStdOut, const ConsoleScroll& consoleScroll);
 
 		void SetConsoleParams(DWORD dwHookThreadId, HANDLE hStdOut);
 
+#ifdef _TRACE_EVENTS
+		void DumpTrace();
+#endif
+
 	private:
 
 		static DWORD WINAPI MonitorThreadStatic(LPVOID lpParameter);
@@ -52,15 +58,23 @@ class ConsoleHandler
 		SharedMemory<CHAR_INFO>						m_consoleBuffer;
 		SharedMemory<ConsoleCopy>					m_consoleCopyInfo;
 		SharedMemory<TextInfo>						m_consoleTextInfo;
-		SharedMemory<MOUSE_EVENT_RECORD>			m_consoleMouseEvent;
+		SharedMemory<MouseEventQueue>				m_consoleMouseEvent;
 
 		SharedMemory<ConsoleSize>					m_newConsoleSize;
-		SharedMemory<SIZE>							m_newScrollPos;
+		SharedMemory<ConsoleScroll>					m_newScrollPos;
 
 		std::shared_ptr<void>							m_hMonitorThread;
 		std::shared_ptr<void>							m_hMonitorThreadExit;
 
 		DWORD										m_dwScreenBufferSize;
+
+		// input sequence number and time seen on the last wake up, used for
+		// latency stamps in ConsoleInfo
+		LONG										m_lWakeSeq;
+		LONGLONG									m_llWakeTime;
+
+		// hash of the console title last published
+		DWORD										m_dwTitleHash;
 };
 
 //////////////////////////////////////////////////////////////////////////////
@@ -36,6 +36,7 @@ using namespace std;
 #include "../shared/Structures.h"
 
 #include "../shared/Cpp11Helpers.h"
+#include "../shared/Tracer.h"
 #include "../shared/Win32Exception.h"
 
 //////////////////////////////////////////////////////////////////////////////
@@ -359,6 +359,11 @@ protected:
 	bool m_bHighlighted;
 	bool m_bCanClose;
 
+	// text width measured with each font (tabs use one font when selected,
+	// another one otherwise), so layouts don't measure every tab again
+	mutable HFONT m_hTextSizeFont[2];
+	mutable LONG m_nTextSize[2];
+
 public:
 	// NOTE: These are here for backwards compatibility.
 	//  Use the new CTFI_NONE, CTFI_RECT, etc.
@@ -389,6 +394,7 @@ public:
 		m_bCanClose(true)
 	{
 		::SetRectEmpty(&m_rcItem);
+		this->ResetTextSize();
 	}
 
 	CCustomTabItem(const CCustomTabItem& rhs)
@@ -410,6 +416,11 @@ public:
 			m_sToolTip      = rhs.m_sToolTip;
 			m_bHighlighted  = rhs.m_bHighlighted;
 			m_bCanClose     = rhs.m_bCanClose;
+			for(int i = 0; i < 2; ++i)
+			{
+				m_hTextSizeFont[i] = rhs.m_hTextSizeFont[i];
+				m_nTextSize[i]     = rhs.m_nTextSize[i];
+			}
 		}
 		return *this;
 	}
@@ -452,9 +463,36 @@ public:
 	bool SetText(LPCTSTR sNewText)
 	{
 		m_sText = sNewText;
+		this->ResetTextSize();
 		return true;
 	}
-  virtual LONG GetTextSize(WTL::CClientDC& dc) const
+  // call when the fonts change
+  void ResetTextSize()
+  {
+    for(int i = 0; i < 2; ++i)
+    {
+      m_hTextSizeFont[i] = NULL;
+      m_nTextSize[i]     = 0;
+    }
+  }
+  LONG GetTextSize(WTL::CClientDC& dc) const
+  {
+    HFONT hFont = dc.GetCurrentFont();
+
+    for(int i = 0; i < 2; ++i)
+    {
+      if( m_hTextSizeFont[i] == hFont ) return m_nTextSize[i];
+    }
+
+    // keep the other font's size, replace the older one
+    m_hTextSizeFont[1] = m_hTextSizeFont[0];
+    m_nTextSize[1]     = m_nTextSize[0];
+    m_hTextSizeFont[0] = hFont;
+    m_nTextSize[0]     = this->MeasureText(dc);
+
+    return m_nTextSize[0];
+  }
+  virtual LONG MeasureText(WTL::CClientDC& dc) const
   {
 #ifdef _USE_AERO
     RECT rcText = { 0 };
@@ -931,6 +969,16 @@ public:
 // Implementation
 protected:
 
+	// the items cache their text sizes by font handle; call whenever the
+	// fonts are recreated, a freed handle can come back for another font
+	void ResetTextSizes(void)
+	{
+		for(size_t i = 0; i < m_Items.GetCount(); ++i)
+		{
+			m_Items[i]->ResetTextSize();
+		}
+	}
+
 	void InitializeTooltips(void)
 	{
 		ATLASSERT(!m_tooltip.IsWindow());
@@ -1956,6 +2004,8 @@ public:
 
 		m_font.CreateFontIndirect(&lfCopy);
 
+		this->ResetTextSizes();
+
 		if(LOWORD(lParam))
 		{
 			this->Invalidate();
@@ -3136,6 +3186,15 @@ public:
 	}
 	*/
 
+	// Call after changing an item's text.  Tab controls that know which
+	//  tabs moved can override this to repaint less.
+	void UpdateItemText(int /*nItem*/)
+	{
+		T* pT = static_cast<T*>(this);
+		pT->UpdateLayout();
+		this->Invalidate();
+	}
+
 	TItem* GetItem(size_t nItem) const
 	{
 		ATLASSERT(nItem < m_Items.GetCount());
@@ -195,6 +195,8 @@ public:
 			{
 				m_fontSel.Attach(AtlGetDefaultGuiFont());
 			}
+
+			this->ResetTextSizes();
 		}
 
 		// Background brush
@@ -1317,6 +1319,8 @@ public:
 			{
 				m_fontSel.Attach(AtlGetDefaultGuiFont());
 			}
+
+			this->ResetTextSizes();
 		}
 
 		// Background brush
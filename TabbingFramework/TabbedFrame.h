@@ -705,8 +705,7 @@ public:
 				if(sCurrentTabText != sText)
 				{
 					bSuccess = pItem->SetText(sText);
-					m_TabCtrl.UpdateLayout();
-					m_TabCtrl.Invalidate();
+					m_TabCtrl.UpdateItemText(nTab);
 				}
 			}
 			else
@@ -724,8 +723,7 @@ public:
 							sCurrentTabText != sWindowText)
 						{
 							bSuccess = pItem->SetText(sWindowText);
-							m_TabCtrl.UpdateLayout();
-							m_TabCtrl.Invalidate();
+							m_TabCtrl.UpdateItemText(nTab);
 						}
 
 						delete [] sWindowText;
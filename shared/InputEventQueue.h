@@ -0,0 +1,107 @@
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Fixed size queue of input events in shared memory. Console pushes events
+// under the shared memory mutex and signals the hook without waiting for it;
+// the hook takes everything queued at once and writes it to the console
+// input in one go.
+//
+// An event replaces the one at the tail when Traits::CanCoalesce(tail, event)
+// says so (mouse moves with the same buttons), so a hook that falls behind
+// only gets the latest position. When the queue is full the oldest event
+// Traits::CanDrop allows (a move) makes room; if there's none, the new event
+// is dropped rather than blocking the UI.
+//
+// Zeroed memory is an empty queue. Counters are 32 bit so 32 and 64 bit
+// processes agree on the layout. No Win32 dependency, it can be built and
+// tested on its own.
+
+template <class Event, class Traits, unsigned int nCapacity>
+struct InputEventQueue
+{
+	enum
+	{
+		CAPACITY = nCapacity
+	};
+
+	InputEventQueue()
+	: nHead(0)
+	, nCount(0)
+	, nCoalesced(0)
+	, nDropped(0)
+	{
+	}
+
+	// false if the queue is full and the event was dropped
+	bool Push(const Event& event)
+	{
+		if ((nCount > 0) && Traits::CanCoalesce(events[(nHead + nCount - 1) % CAPACITY], event))
+		{
+			events[(nHead + nCount - 1) % CAPACITY] = event;
+			++nCoalesced;
+			return true;
+		}
+
+		if ((nCount == CAPACITY) && !DropOldest())
+		{
+			++nDropped;
+			return false;
+		}
+
+		events[(nHead + nCount) % CAPACITY] = event;
+		++nCount;
+
+		return true;
+	}
+
+	// moves up to nMax events, oldest first, to pEvents; returns how many
+	unsigned int Pop(Event* pEvents, unsigned int nMax)
+	{
+		unsigned int nPopped = (nCount < nMax) ? nCount : nMax;
+
+		for (unsigned int i = 0; i < nPopped; ++i)
+		{
+			pEvents[i] = events[(nHead + i) % CAPACITY];
+		}
+
+		nHead	= (nHead + nPopped) % CAPACITY;
+		nCount	-= nPopped;
+
+		return nPopped;
+	}
+
+	// removes the oldest event that can be dropped, the ones after it move up
+	bool DropOldest()
+	{
+		unsigned int i = 0;
+
+		while ((i < nCount) && !Traits::CanDrop(events[(nHead + i) % CAPACITY])) ++i;
+
+		if (i == nCount) return false;
+
+		for (; i + 1 < nCount; ++i)
+		{
+			events[(nHead + i) % CAPACITY] = events[(nHead + i + 1) % CAPACITY];
+		}
+
+		--nCount;
+		++nDropped;
+
+		return true;
+	}
+
+	unsigned int	nHead;
+	unsigned int	nCount;
+
+	// events replaced and events dropped, for diagnostics
+	unsigned int	nCoalesced;
+	unsigned int	nDropped;
+
+	Event			events[CAPACITY];
+};
+
+//////////////////////////////////////////////////////////////////////////////
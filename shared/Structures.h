@@ -1,5 +1,7 @@
 #pragma once
 
+#include "InputEventQueue.h"
+
 //////////////////////////////////////////////////////////////////////////////
 
 struct ConsoleParams
@@ -17,6 +19,8 @@ struct ConsoleParams
 	, dwMaxColumns(0)
 	, hwndConsoleWindow(NULL)
 	, dwHookThreadId(0)
+	, dwKernel32Base(0)
+	, dwKernel32TimeStamp(0)
 	{
 	}
 
@@ -33,6 +37,8 @@ struct ConsoleParams
 	, dwMaxColumns(other.dwMaxColumns)
 	, hwndConsoleWindow(other.hwndConsoleWindow)
 	, dwHookThreadId(other.dwHookThreadId)
+	, dwKernel32Base(other.dwKernel32Base)
+	, dwKernel32TimeStamp(other.dwKernel32TimeStamp)
 	{
 	}
 
@@ -57,6 +63,11 @@ struct ConsoleParams
 	};
 
 	DWORD	dwHookThreadId;
+
+	// kernel32 as loaded in the console process, used to validate
+	// the cached 32-bit LoadLibraryW address on 64-bit Console
+	DWORD	dwKernel32Base;
+	DWORD	dwKernel32TimeStamp;
 };
 
 //////////////////////////////////////////////////////////////////////////////
@@ -94,6 +105,62 @@ struct ConsoleSize
 //////////////////////////////////////////////////////////////////////////////
 
 
+//////////////////////////////////////////////////////////////////////////////
+
+// pending scroll of one axis, relative to where the console window is when
+// the hook gets to it unless a position was set; zeroed memory is no scroll
+struct ScrollAxis
+{
+	ScrollAxis()
+	: nValue(0)
+	, bPosition(false)
+	{
+	}
+
+	void AddDelta(int nDelta)		{ nValue += nDelta; }
+	void SetPosition(int nPosition)	{ nValue = nPosition; bPosition = true; }
+
+	bool IsEmpty() const			{ return !bPosition && (nValue == 0); }
+
+	int GetPosition(int nCurrentPos) const
+	{
+		return bPosition ? nValue : nCurrentPos + nValue;
+	}
+
+	int		nValue;
+	bool	bPosition;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Console adds scroll requests up here under the shared memory lock, the hook
+// takes them all on its next wake and scrolls once
+struct ConsoleScroll
+{
+	ConsoleScroll()
+	: x()
+	, y()
+	{
+	}
+
+	bool IsEmpty() const { return x.IsEmpty() && y.IsEmpty(); }
+
+	ScrollAxis	x;
+	ScrollAxis	y;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
 //////////////////////////////////////////////////////////////////////////////
 
 enum CopyNewlineChar
@@ -150,11 +217,29 @@ struct ConsoleInfo
 	ConsoleInfo()
 	: csbi()
 	, textChanged(false)
+	, lInputSeq(0)
+	, lReadSeq(0)
+	, llWakeTime(0)
+	, llReadTime(0)
+	, dwTitleSeq(0)
 	{
 	}
 
 	CONSOLE_SCREEN_BUFFER_INFO	csbi;
 	bool						textChanged;
+
+	// input-to-pixel latency stamps (QPC values)
+	// Console increments lInputSeq for each key it forwards; the hook stamps
+	// the sequence number it saw when it woke up on the read that published
+	// the next text change
+	volatile LONG				lInputSeq;
+	LONG						lReadSeq;
+	LONGLONG					llWakeTime;
+	LONGLONG					llReadTime;
+
+	// incremented by the hook when the console title changes, Console only
+	// reads the title when it moves
+	DWORD						dwTitleSeq;
 };
 
 //////////////////////////////////////////////////////////////////////////////
@@ -179,7 +264,8 @@ struct CharInfo
 		*(reinterpret_cast<DWORD*>(&charInfo)) = 0x00000020;
 	}
 
-  inline void copy(CHAR_INFO* pnewCharInfo)
+  // returns true if the cell changed
+  inline bool copy(CHAR_INFO* pnewCharInfo)
   {
     DWORD* pold = reinterpret_cast<DWORD*>(&charInfo);
     DWORD* pnew = reinterpret_cast<DWORD*>(pnewCharInfo);
@@ -187,7 +273,9 @@ struct CharInfo
     {
       *pold = *pnew;
       changed = true;
+      return true;
     }
+    return false;
   }
 
 	CHAR_INFO	charInfo;
@@ -222,6 +310,38 @@ struct TextInfo
 //////////////////////////////////////////////////////////////////////////////
 
 
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+struct MouseEventTraits
+{
+	// consecutive moves with the same buttons and modifiers; only the last
+	// position matters
+	static bool CanCoalesce(const MOUSE_EVENT_RECORD& last, const MOUSE_EVENT_RECORD& next)
+	{
+		return
+			(last.dwEventFlags == MOUSE_MOVED) &&
+			(next.dwEventFlags == MOUSE_MOVED) &&
+			(last.dwButtonState == next.dwButtonState) &&
+			(last.dwControlKeyState == next.dwControlKeyState);
+	}
+
+	// moves can go when the queue is full, clicks and wheel events can't
+	static bool CanDrop(const MOUSE_EVENT_RECORD& event)
+	{
+		return (event.dwEventFlags == MOUSE_MOVED);
+	}
+};
+
+typedef InputEventQueue<MOUSE_EVENT_RECORD, MouseEventTraits, 64>	MouseEventQueue;
+
+//////////////////////////////////////////////////////////////////////////////
+
+
 //////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,441 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#ifdef _WIN32
+#define TRACER_THREAD_LOCAL		__declspec(thread)
+#else
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#define TRACER_THREAD_LOCAL		__thread
+#endif
+
+#if defined(_M_IX86) || defined(_M_X64)
+#include <intrin.h>
+#define TRACER_USE_TSC
+#elif defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#define TRACER_USE_TSC
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+// Lightweight event tracer
+//
+// Every thread writes begin/end (of a scope), instant and counter events into
+// its own ring buffer, so recording an event takes no locks. Each event reads
+// the clock once. Dump() writes all
+// buffers in Chrome trace-event JSON (load it in chrome://tracing).
+//
+// Event names must be string literals, only the pointer is stored.
+//
+// Use the TRACE_SCOPE/TRACE_INSTANT/TRACE_COUNTER/TRACE_THREAD_NAME macros,
+// they compile to nothing unless _TRACE_EVENTS is defined. Call
+// Tracer::Init() once before other threads are started.
+//
+// The header doesn't depend on Win32 except for the clock and thread ids,
+// windows.h has to be included first on Windows.
+
+namespace Tracer
+{
+
+//////////////////////////////////////////////////////////////////////////////
+
+// OS monotonic clock, used to calibrate the tick counter
+
+inline long long GetClock()
+{
+#ifdef _WIN32
+	LARGE_INTEGER	liCounter;
+	::QueryPerformanceCounter(&liCounter);
+	return liCounter.QuadPart;
+#else
+	timespec		ts;
+	::clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<long long>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+#endif
+}
+
+inline long long GetClockFrequency()
+{
+#ifdef _WIN32
+	LARGE_INTEGER	liFrequency;
+	::QueryPerformanceFrequency(&liFrequency);
+	return liFrequency.QuadPart;
+#else
+	return 1000000000LL;
+#endif
+}
+
+// event timestamps; the time stamp counter is several times cheaper to read
+// than QPC/clock_gettime, which would dominate the cost of an event
+
+inline long long GetTicks()
+{
+#ifdef TRACER_USE_TSC
+	return static_cast<long long>(__rdtsc());
+#else
+	return GetClock();
+#endif
+}
+
+inline unsigned long GetThreadId()
+{
+#ifdef _WIN32
+	return ::GetCurrentThreadId();
+#else
+	return static_cast<unsigned long>(::syscall(SYS_gettid));
+#endif
+}
+
+inline unsigned long GetProcessId()
+{
+#ifdef _WIN32
+	return ::GetCurrentProcessId();
+#else
+	return static_cast<unsigned long>(::getpid());
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+struct Event
+{
+	enum Type
+	{
+		BEGIN	= 0,
+		END		= 1,
+		INSTANT	= 2,
+		COUNTER	= 3
+	};
+
+	const char*	pszName;
+	long long	llTicks;
+	Type		type;
+	// counter value
+	long long	llValue;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Single writer (the owning thread), any number of readers. A reader may
+// see an event that's being overwritten when the ring wraps during a dump;
+// that's acceptable for diagnostics and keeps the writer wait-free.
+
+class ThreadBuffer
+{
+	public:
+
+		// must be a power of 2
+		static const unsigned int EVENT_COUNT = 4096;
+
+		explicit ThreadBuffer(unsigned long dwThreadId)
+		: m_dwThreadId(dwThreadId)
+		, m_pszThreadName(nullptr)
+		, m_dwHead(0)
+		{
+		}
+
+		void Add(const char* pszName, long long llTicks, Event::Type type, long long llValue = 0)
+		{
+			unsigned int	dwHead	= m_dwHead.load(std::memory_order_relaxed);
+			Event&			event	= m_events[dwHead & (EVENT_COUNT - 1)];
+
+			event.pszName		= pszName;
+			event.llTicks	= llTicks;
+			event.type		= type;
+			event.llValue	= llValue;
+
+			m_dwHead.store(dwHead + 1, std::memory_order_release);
+		}
+
+		// appends events still in the ring, oldest first
+		void GetEvents(std::vector<Event>& events) const
+		{
+			unsigned int dwHead		= m_dwHead.load(std::memory_order_acquire);
+			unsigned int dwCount	= (dwHead < EVENT_COUNT) ? dwHead : EVENT_COUNT;
+
+			for (unsigned int i = dwHead - dwCount; i != dwHead; ++i)
+			{
+				events.push_back(m_events[i & (EVENT_COUNT - 1)]);
+			}
+		}
+
+		unsigned long GetThreadId() const { return m_dwThreadId; }
+
+		const char* GetThreadName() const { return m_pszThreadName; }
+		void SetThreadName(const char* pszThreadName) { m_pszThreadName = pszThreadName; }
+
+	private:
+
+		ThreadBuffer(const ThreadBuffer&);
+		ThreadBuffer& operator=(const ThreadBuffer&);
+
+	private:
+
+		unsigned long				m_dwThreadId;
+		const char*					m_pszThreadName;
+
+		std::atomic<unsigned int>	m_dwHead;
+		Event						m_events[EVENT_COUNT];
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+class Registry
+{
+	public:
+
+		static Registry& Get()
+		{
+			static Registry	registry;
+			return registry;
+		}
+
+		ThreadBuffer& GetThreadBuffer()
+		{
+			static TRACER_THREAD_LOCAL ThreadBuffer* s_pThreadBuffer = nullptr;
+
+			if (s_pThreadBuffer == nullptr)
+			{
+				std::shared_ptr<ThreadBuffer>	threadBuffer(new ThreadBuffer(Tracer::GetThreadId()));
+				std::lock_guard<std::mutex>		lock(m_buffersMutex);
+
+				// buffers outlive their threads, events of exited threads are dumped too
+				m_buffers.push_back(threadBuffer);
+				s_pThreadBuffer = threadBuffer.get();
+			}
+
+			return *s_pThreadBuffer;
+		}
+
+		void Dump(std::ostream& os)
+		{
+			std::vector<std::shared_ptr<ThreadBuffer> >	buffers;
+
+			{
+				std::lock_guard<std::mutex>	lock(m_buffersMutex);
+				buffers = m_buffers;
+			}
+
+			unsigned long	dwProcessId	= Tracer::GetProcessId();
+			bool			bFirst		= true;
+			double			dStartUs	= 0.0;
+			double			dTicksPerUs	= 1.0;
+
+			GetTimebase(dStartUs, dTicksPerUs);
+
+			std::ios_base::fmtflags	flags		= os.flags();
+			std::streamsize			precision	= os.precision();
+
+			os.setf(std::ios_base::fixed, std::ios_base::floatfield);
+			os.precision(3);
+
+			os << "{\"traceEvents\":[";
+
+			for (auto it = buffers.begin(); it != buffers.end(); ++it)
+			{
+				const ThreadBuffer& threadBuffer = **it;
+
+				if (threadBuffer.GetThreadName() != nullptr)
+				{
+					os << (bFirst ? "\n" : ",\n");
+					os << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << dwProcessId << ",\"tid\":" << threadBuffer.GetThreadId();
+					os << ",\"args\":{\"name\":";
+					WriteString(os, threadBuffer.GetThreadName());
+					os << "}}";
+					bFirst = false;
+				}
+
+				std::vector<Event> events;
+				threadBuffer.GetEvents(events);
+
+				for (auto itEvent = events.begin(); itEvent != events.end(); ++itEvent)
+				{
+					os << (bFirst ? "\n" : ",\n");
+					os << "{\"name\":";
+					WriteString(os, itEvent->pszName);
+					os << ",\"cat\":\"console\",\"pid\":" << dwProcessId << ",\"tid\":" << threadBuffer.GetThreadId();
+					os << ",\"ts\":" << dStartUs + static_cast<double>(itEvent->llTicks - m_llStartTicks) / dTicksPerUs;
+
+					switch (itEvent->type)
+					{
+						case Event::BEGIN	: os << ",\"ph\":\"B\"}"; break;
+						case Event::END		: os << ",\"ph\":\"E\"}"; break;
+						case Event::INSTANT	: os << ",\"ph\":\"i\",\"s\":\"t\"}"; break;
+						case Event::COUNTER	: os << ",\"ph\":\"C\",\"args\":{\"value\":" << itEvent->llValue << "}}"; break;
+					}
+
+					bFirst = false;
+				}
+			}
+
+			os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+			os.flags(flags);
+			os.precision(precision);
+		}
+
+	private:
+
+		Registry()
+		: m_llStartTicks(GetTicks())
+		, m_llStartClock(GetClock())
+		, m_buffersMutex()
+		, m_buffers()
+		{
+		}
+
+		Registry(const Registry&);
+		Registry& operator=(const Registry&);
+
+		// ticks are converted to the OS clock timebase, so traces of different
+		// processes line up
+		void GetTimebase(double& dStartUs, double& dTicksPerUs) const
+		{
+			double	dClockPerUs	= static_cast<double>(GetClockFrequency()) / 1000000.0;
+
+			dStartUs	= static_cast<double>(m_llStartClock) / dClockPerUs;
+			dTicksPerUs	= dClockPerUs;
+
+#ifdef TRACER_USE_TSC
+			// calibrated over the whole tracing period
+			long long	llTicks	= GetTicks() - m_llStartTicks;
+			long long	llClock	= GetClock() - m_llStartClock;
+
+			if ((llTicks > 0) && (llClock > 0))
+			{
+				dTicksPerUs = static_cast<double>(llTicks) / (static_cast<double>(llClock) / dClockPerUs);
+			}
+#endif
+		}
+
+		static void WriteString(std::ostream& os, const char* psz)
+		{
+			os << '"';
+			for (; *psz != '\0'; ++psz)
+			{
+				if ((*psz == '"') || (*psz == '\\')) os << '\\';
+				os << *psz;
+			}
+			os << '"';
+		}
+
+	private:
+
+		long long									m_llStartTicks;
+		long long									m_llStartClock;
+
+		std::mutex									m_buffersMutex;
+		std::vector<std::shared_ptr<ThreadBuffer> >	m_buffers;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// records a begin event when it's created and an end event when it's
+// destroyed; the viewer pairs them up per thread
+
+class Scope
+{
+	public:
+
+		explicit Scope(const char* pszName)
+		: m_pszName(pszName)
+		, m_threadBuffer(Registry::Get().GetThreadBuffer())
+		{
+			m_threadBuffer.Add(m_pszName, GetTicks(), Event::BEGIN);
+		}
+
+		~Scope()
+		{
+			m_threadBuffer.Add(m_pszName, GetTicks(), Event::END);
+		}
+
+	private:
+
+		Scope(const Scope&);
+		Scope& operator=(const Scope&);
+
+	private:
+
+		const char*		m_pszName;
+		ThreadBuffer&	m_threadBuffer;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// function-local statics aren't initialized thread safely by all compilers
+inline void Init()
+{
+	Registry::Get();
+}
+
+inline void Instant(const char* pszName)
+{
+	Registry::Get().GetThreadBuffer().Add(pszName, GetTicks(), Event::INSTANT);
+}
+
+// a sample of a value plotted over time, e.g. cache hits so far
+inline void Counter(const char* pszName, long long llValue)
+{
+	Registry::Get().GetThreadBuffer().Add(pszName, GetTicks(), Event::COUNTER, llValue);
+}
+
+inline void SetThreadName(const char* pszThreadName)
+{
+	Registry::Get().GetThreadBuffer().SetThreadName(pszThreadName);
+}
+
+inline void Dump(std::ostream& os)
+{
+	Registry::Get().Dump(os);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+#define TRACER_CONCAT2(a, b)		a##b
+#define TRACER_CONCAT(a, b)			TRACER_CONCAT2(a, b)
+
+#ifdef _TRACE_EVENTS
+
+#define TRACE_SCOPE(name)			Tracer::Scope TRACER_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_INSTANT(name)			Tracer::Instant(name)
+#define TRACE_COUNTER(name, value)	Tracer::Counter(name, value)
+#define TRACE_THREAD_NAME(name)		Tracer::SetThreadName(name)
+
+#else
+
+#define TRACE_SCOPE(name)
+#define TRACE_INSTANT(name)
+#define TRACE_COUNTER(name, value)
+#define TRACE_THREAD_NAME(name)
+
+#endif // _TRACE_EVENTS
+
+//////////////////////////////////////////////////////////////////////////////